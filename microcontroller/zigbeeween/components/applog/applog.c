@@ -0,0 +1,119 @@
+#include "applog.h"
+
+#include <stdio.h>
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#ifndef CONFIG_APPLOG_DEFER_QUEUE_LEN
+#define CONFIG_APPLOG_DEFER_QUEUE_LEN 32
+#endif
+
+#define APPLOG_TASK_STACK   3072
+#define APPLOG_LINE_MAX     160
+
+typedef struct {
+    uint32_t timestamp_ms;
+    const char *tag;
+    const char *fmt;
+    uint8_t level;
+    uint8_t nargs;
+    uint32_t args[APPLOG_DEFER_MAX_ARGS];
+} applog_entry_t;
+
+static QueueHandle_t defer_queue = NULL;
+static uint32_t defer_dropped = 0;
+
+bool applog_ratelimit_check(applog_ratelimit_t *rl, uint32_t interval_ms, uint32_t *suppressed)
+{
+    uint32_t now = esp_log_timestamp();
+    if (rl->next_ms != 0 && (int32_t)(now - rl->next_ms) < 0) {
+        rl->suppressed++;
+        return false;
+    }
+    *suppressed = rl->suppressed;
+    rl->suppressed = 0;
+    rl->next_ms = now + interval_ms;
+    if (rl->next_ms == 0) {
+        rl->next_ms = 1;  // 0 means "never printed"
+    }
+    return true;
+}
+
+static void applog_emit(const applog_entry_t *e)
+{
+    static const char letters[] = "NEWIDV";
+    char line[APPLOG_LINE_MAX];
+
+    // Surplus arguments are ignored by the format
+    snprintf(line, sizeof(line), e->fmt, e->args[0], e->args[1], e->args[2], e->args[3]);
+    esp_log_write((esp_log_level_t)e->level, e->tag, "%c (%lu) %s: %s\n",
+                  letters[e->level < 6 ? e->level : 0], (unsigned long)e->timestamp_ms, e->tag, line);
+}
+
+void applog_defer(esp_log_level_t level, const char *tag, const char *fmt, const uint32_t *args, size_t nargs)
+{
+    applog_entry_t e = {
+        .timestamp_ms = esp_log_timestamp(),
+        .tag = tag,
+        .fmt = fmt,
+        .level = (uint8_t)level,
+        .nargs = (uint8_t)nargs,
+    };
+    for (size_t i = 0; i < nargs && i < APPLOG_DEFER_MAX_ARGS; i++) {
+        e.args[i] = args[i];
+    }
+
+    if (!defer_queue) {
+        applog_emit(&e);
+        return;
+    }
+    if (xQueueSend(defer_queue, &e, 0) != pdTRUE) {
+        __atomic_fetch_add(&defer_dropped, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void applog_report_dropped(void)
+{
+    uint32_t dropped = __atomic_exchange_n(&defer_dropped, 0, __ATOMIC_RELAXED);
+    if (dropped > 0) {
+        esp_log_write(ESP_LOG_WARN, "applog", "W (%lu) applog: %lu deferred log lines dropped\n",
+                      (unsigned long)esp_log_timestamp(), (unsigned long)dropped);
+    }
+}
+
+static void applog_task(void *pvParameters)
+{
+    applog_entry_t e;
+
+    while (1) {
+        if (xQueueReceive(defer_queue, &e, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        applog_emit(&e);
+        applog_report_dropped();
+    }
+}
+
+void applog_flush(void)
+{
+    applog_entry_t e;
+
+    if (!defer_queue) {
+        return;
+    }
+    while (xQueueReceive(defer_queue, &e, 0) == pdTRUE) {
+        applog_emit(&e);
+    }
+    applog_report_dropped();
+}
+
+void applog_init(UBaseType_t priority)
+{
+    if (defer_queue) {
+        return;
+    }
+    defer_queue = xQueueCreate(CONFIG_APPLOG_DEFER_QUEUE_LEN, sizeof(applog_entry_t));
+    if (defer_queue) {
+        xTaskCreate(applog_task, "applog", APPLOG_TASK_STACK, NULL, priority, NULL);
+    }
+}
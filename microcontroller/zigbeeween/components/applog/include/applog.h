@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+// Logging layer over esp_log for the hot paths of every board.
+//
+// Module levels: each line names a module (UART, ZIGBEE, TRIGGER, STATUS,
+// HTTP) whose level is fixed at build time (menuconfig "Zigbeeween
+// logging"). A line above it is compiled out, format string included, so a
+// quiet build pays nothing for it. A file may override a module by defining
+// APPLOG_LEVEL_<MODULE> before including this header.
+//
+//   APPLOGI(UART, TAG, "sent command 0x%02x", cmd);
+//
+// Rate limiting: APPLOG_RATELIMIT() prints at most one line per interval per
+// call site and reports how many it swallowed; APPLOG_ONCHANGE() prints only
+// when a caller-chosen key differs from the last one printed there.
+//
+// Deferred mode: APPLOG_DEFER() copies the format pointer and up to
+// APPLOG_DEFER_MAX_ARGS 32-bit arguments into a queue and returns; the log
+// task formats them later at low priority. The format must be a literal;
+// 64-bit values don't fit, and %s arguments (cast to uintptr_t) must outlive
+// the queue (literals, static names), since only pointers are kept. The line
+// keeps the time it was queued. Before applog_init() it prints directly.
+
+#define APPLOG_DEFER_MAX_ARGS 4
+
+#ifdef CONFIG_APPLOG_LEVEL_UART
+#define APPLOG_CONFIG_UART    CONFIG_APPLOG_LEVEL_UART
+#define APPLOG_CONFIG_ZIGBEE  CONFIG_APPLOG_LEVEL_ZIGBEE
+#define APPLOG_CONFIG_TRIGGER CONFIG_APPLOG_LEVEL_TRIGGER
+#define APPLOG_CONFIG_STATUS  CONFIG_APPLOG_LEVEL_STATUS
+#define APPLOG_CONFIG_HTTP    CONFIG_APPLOG_LEVEL_HTTP
+#else
+// Built without this component's Kconfig: everything at info
+#define APPLOG_CONFIG_UART    ESP_LOG_INFO
+#define APPLOG_CONFIG_ZIGBEE  ESP_LOG_INFO
+#define APPLOG_CONFIG_TRIGGER ESP_LOG_INFO
+#define APPLOG_CONFIG_STATUS  ESP_LOG_INFO
+#define APPLOG_CONFIG_HTTP    ESP_LOG_INFO
+#endif
+
+#ifndef APPLOG_LEVEL_UART
+#define APPLOG_LEVEL_UART     APPLOG_CONFIG_UART
+#endif
+#ifndef APPLOG_LEVEL_ZIGBEE
+#define APPLOG_LEVEL_ZIGBEE   APPLOG_CONFIG_ZIGBEE
+#endif
+#ifndef APPLOG_LEVEL_TRIGGER
+#define APPLOG_LEVEL_TRIGGER  APPLOG_CONFIG_TRIGGER
+#endif
+#ifndef APPLOG_LEVEL_STATUS
+#define APPLOG_LEVEL_STATUS   APPLOG_CONFIG_STATUS
+#endif
+#ifndef APPLOG_LEVEL_HTTP
+#define APPLOG_LEVEL_HTTP     APPLOG_CONFIG_HTTP
+#endif
+
+// Compile-time test; both sides are constants so the branch folds away
+#define APPLOG_ENABLED(module, level) (APPLOG_LEVEL_##module >= (level))
+
+#define APPLOG(module, level, tag, fmt, ...) do {                   \
+        if (APPLOG_ENABLED(module, level)) {                        \
+            ESP_LOG_LEVEL_LOCAL(level, tag, fmt, ##__VA_ARGS__);    \
+        }                                                           \
+    } while (0)
+
+#define APPLOGE(module, tag, fmt, ...) APPLOG(module, ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define APPLOGW(module, tag, fmt, ...) APPLOG(module, ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define APPLOGI(module, tag, fmt, ...) APPLOG(module, ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define APPLOGD(module, tag, fmt, ...) APPLOG(module, ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+#define APPLOGV(module, tag, fmt, ...) APPLOG(module, ESP_LOG_VERBOSE, tag, fmt, ##__VA_ARGS__)
+
+typedef struct {
+    uint32_t next_ms;       // esp_log_timestamp() at which the next line may print
+    uint32_t suppressed;
+} applog_ratelimit_t;
+
+// True if a line may print now; *suppressed is set to the count swallowed
+// since the last one. Not locked: a call site shared by tasks may let an
+// extra line through, never lose one's count for long.
+bool applog_ratelimit_check(applog_ratelimit_t *rl, uint32_t interval_ms, uint32_t *suppressed);
+
+#define APPLOG_RATELIMIT(module, level, tag, interval_ms, fmt, ...) do {                   \
+        if (APPLOG_ENABLED(module, level)) {                                               \
+            static applog_ratelimit_t _applog_rl;                                          \
+            uint32_t _applog_skipped;                                                      \
+            if (applog_ratelimit_check(&_applog_rl, (interval_ms), &_applog_skipped)) {    \
+                if (_applog_skipped > 0) {                                                 \
+                    ESP_LOG_LEVEL_LOCAL(level, tag, "(%lu similar lines suppressed)",      \
+                                        (unsigned long)_applog_skipped);                   \
+                }                                                                          \
+                ESP_LOG_LEVEL_LOCAL(level, tag, fmt, ##__VA_ARGS__);                       \
+            }                                                                              \
+        }                                                                                  \
+    } while (0)
+
+#define APPLOG_ONCHANGE(module, level, tag, key, fmt, ...) do {                            \
+        if (APPLOG_ENABLED(module, level)) {                                               \
+            static bool _applog_seen;                                                      \
+            static uint32_t _applog_key;                                                   \
+            uint32_t _applog_now = (uint32_t)(key);                                        \
+            if (!_applog_seen || _applog_now != _applog_key) {                             \
+                _applog_seen = true;                                                       \
+                _applog_key = _applog_now;                                                 \
+                ESP_LOG_LEVEL_LOCAL(level, tag, fmt, ##__VA_ARGS__);                       \
+            }                                                                              \
+        }                                                                                  \
+    } while (0)
+
+// Start the log task that formats deferred lines
+void applog_init(UBaseType_t priority);
+
+// Print whatever is still queued from the calling task, e.g. before deep sleep
+void applog_flush(void);
+
+// Queue a line for the log task. Never blocks; drops (and counts) the line
+// if the queue is full. Use the APPLOG_DEFER() wrapper.
+void applog_defer(esp_log_level_t level, const char *tag, const char *fmt, const uint32_t *args, size_t nargs);
+
+// The leading 0 makes an empty argument list legal and is skipped
+#define APPLOG_DEFER(module, level, tag, fmt, ...) do {                                    \
+        if (APPLOG_ENABLED(module, level)) {                                               \
+            const uint32_t _applog_args[] = { 0, ##__VA_ARGS__ };                          \
+            _Static_assert(sizeof(_applog_args) / sizeof(uint32_t) <= APPLOG_DEFER_MAX_ARGS + 1, \
+                           "too many deferred log arguments");                             \
+            applog_defer((level), (tag), (fmt), &_applog_args[1],                          \
+                         sizeof(_applog_args) / sizeof(uint32_t) - 1);                     \
+        }                                                                                  \
+    } while (0)
@@ -0,0 +1,57 @@
+#include "gateway_link.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "esp_log.h"
+#include "metrics.h"
+#include "applog.h"
+
+static const char *TAG = "gateway_link";
+
+static RingbufHandle_t rings[GATEWAY_LINK_ENDS] = { NULL };
+
+void gateway_link_init(void)
+{
+    for (int end = 0; end < GATEWAY_LINK_ENDS; end++) {
+        rings[end] = xRingbufferCreate(GATEWAY_LINK_RING_SIZE, RINGBUF_TYPE_NOSPLIT);
+        if (!rings[end]) {
+            ESP_LOGE(TAG, "No memory for the link ring");
+        }
+    }
+}
+
+// An item is the command byte followed by the payload; its length is the
+// item size, so nothing else is stored
+void gateway_link_send(gateway_link_end_t to, uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    void *item = NULL;
+
+    if (!rings[to] ||
+        xRingbufferSendAcquire(rings[to], &item, 1 + (size_t)len, pdMS_TO_TICKS(GATEWAY_LINK_SEND_TIMEOUT_MS)) != pdTRUE) {
+        metrics_inc(METRIC_LINK_DROPPED);
+        APPLOG_RATELIMIT(UART, ESP_LOG_WARN, TAG, 1000, "Link to %s full, dropping 0x%02x",
+                         to == GATEWAY_LINK_COORDINATOR ? "coordinator" : "web", cmd);
+        return;
+    }
+    uint8_t *p = item;
+    p[0] = cmd;
+    if (len > 0) {
+        memcpy(&p[1], payload, len);
+    }
+    xRingbufferSendComplete(rings[to], item);
+}
+
+void gateway_link_run(gateway_link_end_t end, gateway_link_handler_t handler, void *ctx)
+{
+    ESP_LOGI(TAG, "Link receiver for the %s started", end == GATEWAY_LINK_COORDINATOR ? "coordinator" : "web side");
+    while (1) {
+        size_t size = 0;
+        uint8_t *item = xRingbufferReceive(rings[end], &size, portMAX_DELAY);
+        if (!item) {
+            continue;
+        }
+        handler(ctx, item[0], &item[1], (uint16_t)(size - 1));
+        vRingbufferReturnItem(rings[end], item);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+// In-process replacement for the UART link, for the single-chip gateway
+// (zigbee_border_gateway/xiaoc6_wifi_zigbee), where the coordinator and the
+// web half run on one ESP32-C6. Each side keeps speaking the protocol of
+// uart_proto.h through its uart_send_frame() and handle_uart_frame(), but a
+// message is copied into a ring buffer for the other side instead of being
+// framed, CRC'd and clocked out at 115200 baud.
+//
+// Each direction is one FreeRTOS ring buffer with one receiving task, so
+// messages arrive in order and each side's handler still runs on a single
+// task, as it did on the UART receiver task. Any task may send.
+
+#define GATEWAY_LINK_RING_SIZE        4096  // Per direction; a full status snapshot fits with room to spare
+#define GATEWAY_LINK_SEND_TIMEOUT_MS  100   // Wait for ring space before dropping, as a full UART TX buffer would block
+
+typedef enum {
+    GATEWAY_LINK_COORDINATOR,   // The protocol's TinyS3 -> coordinator commands
+    GATEWAY_LINK_WEB,           // Coordinator -> TinyS3 responses, to the web half
+    GATEWAY_LINK_ENDS,
+} gateway_link_end_t;
+
+// Same shape as uart_frame_handler_t, so handle_uart_frame() plugs in as-is
+typedef void (*gateway_link_handler_t)(void *ctx, uint8_t cmd, const uint8_t *payload, uint16_t len);
+
+// Create both rings. Call once, before either side starts.
+void gateway_link_init(void);
+
+// Queue a message for the given end. A message that can't be queued within
+// GATEWAY_LINK_SEND_TIMEOUT_MS is dropped and counted.
+void gateway_link_send(gateway_link_end_t to, uint8_t cmd, const uint8_t *payload, uint16_t len);
+
+// Deliver the messages for end to handler, in order. Never returns: this
+// is the body of that side's receiver task.
+void gateway_link_run(gateway_link_end_t end, gateway_link_handler_t handler, void *ctx);
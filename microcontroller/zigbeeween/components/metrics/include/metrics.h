@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "metrics_catalog.h"
+
+// Fixed-slot metrics registry shared by every board. Each board has one
+// slot per catalogue entry; counters and gauges are single words updated
+// with atomic instructions, so updating one costs a few cycles from any task
+// and nothing is allocated. A metric is reported once it has been written.
+//
+// Histograms have power-of-two buckets: bucket i takes values above the
+// previous bound up to 2^(METRIC_HIST_MIN_SHIFT + i), the last one
+// everything larger.
+//
+// Boards report their metrics to the TinyS3 as records (also the payload of
+// CMD_METRICS and the props' Zigbee report):
+//
+//   scalar:    u8 id, u32 value (gauges are two's complement)
+//   histogram: u8 METRIC_RECORD_HIST | id, u32 count, u64 sum,
+//              then METRIC_HIST_BUCKETS u32 bucket counts
+
+#define METRIC_HIST_BUCKETS    16
+#define METRIC_HIST_MIN_SHIFT  6     // First bucket: <= 64
+#define METRIC_RECORD_HIST     0x80
+#define METRIC_SCALAR_RECORD_SIZE 5
+#define METRIC_HIST_RECORD_SIZE   (1 + 4 + 8 + METRIC_HIST_BUCKETS * 4)
+#define METRICS_MAX_WATCHED_TASKS 12
+
+#define METRIC_ENUM(id, type, name, help) METRIC_##id,
+#define METRIC_HIST_ENUM(id, type, name, help) METRIC_HIST_##id,
+typedef enum { METRICS_SCALARS(METRIC_ENUM) METRIC_SCALAR_COUNT } metric_id_t;
+typedef enum { METRICS_HISTOGRAMS(METRIC_HIST_ENUM) METRIC_HIST_COUNT } metric_hist_id_t;
+#undef METRIC_ENUM
+#undef METRIC_HIST_ENUM
+
+typedef enum {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM,
+} metric_type_t;
+
+typedef struct {
+    const char *name;
+    const char *help;
+    metric_type_t type;
+} metric_info_t;
+
+typedef struct {
+    uint32_t count;
+    uint64_t sum;
+    uint32_t buckets[METRIC_HIST_BUCKETS];
+} metric_hist_t;
+
+// One board's metrics: the local registry, or a copy decoded from records
+typedef struct {
+    uint32_t used[(METRIC_SCALAR_COUNT + 31) / 32];
+    uint32_t hist_used;
+    uint32_t values[METRIC_SCALAR_COUNT];
+    metric_hist_t hists[METRIC_HIST_COUNT];
+} metrics_snapshot_t;
+
+_Static_assert(METRIC_SCALAR_COUNT < METRIC_RECORD_HIST, "scalar ids must leave the histogram bit clear");
+_Static_assert(METRIC_HIST_COUNT <= 32, "hist_used is a u32 bitmask");
+
+extern metrics_snapshot_t metrics_local;
+
+const metric_info_t *metric_info(metric_id_t id);
+const metric_info_t *metric_hist_info(metric_hist_id_t id);
+
+static inline void metrics_mark(metric_id_t id)
+{
+    __atomic_fetch_or(&metrics_local.used[id / 32], 1u << (id % 32), __ATOMIC_RELAXED);
+}
+
+static inline void metrics_add(metric_id_t id, uint32_t n)
+{
+    __atomic_fetch_add(&metrics_local.values[id], n, __ATOMIC_RELAXED);
+    metrics_mark(id);
+}
+
+static inline void metrics_inc(metric_id_t id)
+{
+    metrics_add(id, 1);
+}
+
+// Gauges, and counters mirrored from an existing tally
+static inline void metrics_set(metric_id_t id, int32_t value)
+{
+    __atomic_store_n(&metrics_local.values[id], (uint32_t)value, __ATOMIC_RELAXED);
+    metrics_mark(id);
+}
+
+// Histograms take a short spinlock (count, sum and bucket move together)
+void metrics_observe(metric_hist_id_t id, uint32_t value);
+
+// Include task in STACK_MIN_FREE. Full list is ignored with a warning.
+void metrics_watch_task(TaskHandle_t task);
+
+// Refresh the system gauges: uptime, free heap, heap low-water mark and the
+// smallest stack high-water mark. Call before reporting.
+void metrics_sample_system(void);
+
+// Consistent copy of the local registry
+void metrics_snapshot_local(metrics_snapshot_t *out);
+
+// Encode the used metrics of s as records into out, starting at scalar
+// *next (0 to begin); with_hists adds the histograms after the scalars.
+// Stops before a record that doesn't fit and leaves *next there, so a big
+// snapshot goes out in several frames; *next is SIZE_MAX once done.
+size_t metrics_encode(const metrics_snapshot_t *s, bool with_hists, size_t *next, uint8_t *out, size_t out_size);
+
+// Apply records to s (values replace what was there). Records for ids this
+// build doesn't know, from a board with a newer catalogue, are skipped.
+// False if a record is truncated; the records before it are kept.
+bool metrics_decode(metrics_snapshot_t *s, const uint8_t *data, size_t len);
+
+static inline bool metrics_is_used(const metrics_snapshot_t *s, metric_id_t id)
+{
+    return (s->used[id / 32] >> (id % 32)) & 1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// Every metric any board in the system can report, in one list so a record
+// on the wire is just an id and a value: the TinyS3 knows the names without
+// them being sent. Append only; ids are positions in these lists.
+//
+// X(id, type, name, help). Names get a "zigbeeween_" prefix on /metrics.
+
+#define METRICS_SCALARS(X) \
+    X(UPTIME,                  GAUGE,   "uptime_seconds",                  "Time since boot") \
+    X(HEAP_FREE,               GAUGE,   "heap_free_bytes",                 "Free heap now") \
+    X(HEAP_MIN_FREE,           GAUGE,   "heap_min_free_bytes",             "Lowest free heap since boot") \
+    X(STACK_MIN_FREE,          GAUGE,   "task_stack_min_free_bytes",       "Smallest stack high-water mark among the watched tasks") \
+    X(UART_FRAMES_OK,          COUNTER, "uart_frames_ok_total",            "UART frames received intact") \
+    X(UART_CRC_ERRORS,         COUNTER, "uart_crc_errors_total",           "UART frames dropped for a bad CRC") \
+    X(UART_BAD_HEADER,         COUNTER, "uart_bad_header_total",           "UART frames dropped for a bad version or length") \
+    X(UART_DROPPED_BYTES,      COUNTER, "uart_dropped_bytes_total",        "UART bytes skipped while hunting for a frame") \
+    X(ZB_REQUESTS_SENT,        COUNTER, "zigbee_requests_sent_total",      "Zigbee requests handed to the stack") \
+    X(ZB_REQUESTS_DROPPED,     COUNTER, "zigbee_requests_dropped_total",   "Zigbee requests dropped on a full queue") \
+    X(ZB_FRAMES_DELIVERED,     COUNTER, "zigbee_frames_delivered_total",   "Unicast ZCL frames the device confirmed") \
+    X(ZB_FRAMES_FAILED,        COUNTER, "zigbee_frames_failed_total",      "Unicast ZCL frames that were not confirmed") \
+    X(ZB_DEFAULT_RESPONSES,    COUNTER, "zigbee_default_responses_total",  "ZCL default responses to trigger toggles") \
+    X(ZB_DEVICES_BOUND,        GAUGE,   "zigbee_devices_bound",            "Props currently on the network") \
+    X(TRIGGERS_ACCEPTED,       COUNTER, "triggers_accepted_total",         "Triggers admitted for a prop") \
+    X(TRIGGERS_COOLDOWN,       COUNTER, "triggers_dropped_cooldown_total", "Triggers dropped: prop in cooldown") \
+    X(TRIGGERS_DUPLICATE,      COUNTER, "triggers_dropped_duplicate_total","Triggers dropped: same target inside the dedup window") \
+    X(TRIGGERS_OFFLINE,        COUNTER, "triggers_dropped_offline_total",  "Triggers dropped: prop offline or queue full") \
+    X(TRIGGERS_SENT,           COUNTER, "triggers_sent_total",             "Trigger frames sent to the coordinator") \
+    X(PIR_MOTIONS,             COUNTER, "pir_motions_total",               "Motion edges seen by the PIR") \
+    X(TRIGGER_REQUESTS,        COUNTER, "trigger_requests_total",          "Trigger requests sent to the coordinator") \
+    X(ACTUATIONS,              COUNTER, "actuations_total",                "Relay fires or light shows started") \
+    X(TIME_SYNCS,              COUNTER, "time_syncs_total",                "Time syncs applied") \
+    X(WIFI_RSSI,               GAUGE,   "wifi_rssi_dbm",                   "RSSI of the WiFi access point") \
+    X(OTA_BLOCKS_SERVED,       COUNTER, "ota_blocks_served_total",         "OTA image blocks sent to props") \
+    X(OTA_CACHE_MISSES,        COUNTER, "ota_cache_misses_total",          "OTA block cache lines filled from flash") \
+    X(OTA_BLOCKS_RECEIVED,     COUNTER, "ota_blocks_received_total",       "OTA image blocks written to the update slot") \
+    X(LINK_DROPPED,            COUNTER, "gateway_link_dropped_total",      "Single-chip gateway messages dropped on a full link ring")
+
+#define METRICS_HISTOGRAMS(X) \
+    X(ZB_DISPATCH_US,          HISTOGRAM, "zigbee_dispatch_latency_us",    "Zigbee request queued -> handed to the stack")
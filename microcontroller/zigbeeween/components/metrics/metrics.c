@@ -0,0 +1,172 @@
+#include "metrics.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "uart_frame.h"
+
+static const char *TAG = "METRICS";
+
+metrics_snapshot_t metrics_local;
+
+#define METRIC_INFO(id, type, name, help) { name, help, METRIC_##type },
+static const metric_info_t scalar_info[METRIC_SCALAR_COUNT] = { METRICS_SCALARS(METRIC_INFO) };
+static const metric_info_t hist_info[METRIC_HIST_COUNT] = { METRICS_HISTOGRAMS(METRIC_INFO) };
+#undef METRIC_INFO
+
+static portMUX_TYPE hist_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static TaskHandle_t watched_tasks[METRICS_MAX_WATCHED_TASKS];
+static size_t watched_count;
+
+const metric_info_t *metric_info(metric_id_t id)
+{
+    return id < METRIC_SCALAR_COUNT ? &scalar_info[id] : NULL;
+}
+
+const metric_info_t *metric_hist_info(metric_hist_id_t id)
+{
+    return id < METRIC_HIST_COUNT ? &hist_info[id] : NULL;
+}
+
+void metrics_observe(metric_hist_id_t id, uint32_t value)
+{
+    if (id >= METRIC_HIST_COUNT) {
+        return;
+    }
+    size_t bucket = 0;
+    while (bucket < METRIC_HIST_BUCKETS - 1 && value > (1u << (METRIC_HIST_MIN_SHIFT + bucket))) {
+        bucket++;
+    }
+    metric_hist_t *h = &metrics_local.hists[id];
+    portENTER_CRITICAL(&hist_lock);
+    h->count++;
+    h->sum += value;
+    h->buckets[bucket]++;
+    metrics_local.hist_used |= 1u << id;
+    portEXIT_CRITICAL(&hist_lock);
+}
+
+void metrics_watch_task(TaskHandle_t task)
+{
+    if (task == NULL) {
+        return;
+    }
+    if (watched_count >= METRICS_MAX_WATCHED_TASKS) {
+        ESP_LOGW(TAG, "Watched task list full, not watching %s", pcTaskGetName(task));
+        return;
+    }
+    watched_tasks[watched_count++] = task;
+}
+
+void metrics_sample_system(void)
+{
+    metrics_set(METRIC_UPTIME, (int32_t)(esp_timer_get_time() / 1000000));
+    metrics_set(METRIC_HEAP_FREE, (int32_t)esp_get_free_heap_size());
+    metrics_set(METRIC_HEAP_MIN_FREE, (int32_t)esp_get_minimum_free_heap_size());
+
+    if (watched_count == 0) {
+        return;
+    }
+    UBaseType_t min_free = UINT32_MAX;
+    for (size_t i = 0; i < watched_count; i++) {
+        UBaseType_t free_words = uxTaskGetStackHighWaterMark(watched_tasks[i]);
+        if (free_words < min_free) {
+            min_free = free_words;
+        }
+    }
+    // ESP-IDF's high-water mark is already in bytes
+    metrics_set(METRIC_STACK_MIN_FREE, (int32_t)min_free);
+}
+
+void metrics_snapshot_local(metrics_snapshot_t *out)
+{
+    for (size_t i = 0; i < sizeof(out->used) / sizeof(out->used[0]); i++) {
+        out->used[i] = __atomic_load_n(&metrics_local.used[i], __ATOMIC_RELAXED);
+    }
+    for (size_t i = 0; i < METRIC_SCALAR_COUNT; i++) {
+        out->values[i] = __atomic_load_n(&metrics_local.values[i], __ATOMIC_RELAXED);
+    }
+    portENTER_CRITICAL(&hist_lock);
+    out->hist_used = metrics_local.hist_used;
+    memcpy(out->hists, metrics_local.hists, sizeof(out->hists));
+    portEXIT_CRITICAL(&hist_lock);
+}
+
+size_t metrics_encode(const metrics_snapshot_t *s, bool with_hists, size_t *next, uint8_t *out, size_t out_size)
+{
+    size_t pos = 0;
+    size_t i = *next;
+
+    for (; i < METRIC_SCALAR_COUNT; i++) {
+        if (!metrics_is_used(s, (metric_id_t)i)) {
+            continue;
+        }
+        if (pos + METRIC_SCALAR_RECORD_SIZE > out_size) {
+            *next = i;
+            return pos;
+        }
+        out[pos] = (uint8_t)i;
+        uart_frame_put_u32(&out[pos + 1], s->values[i]);
+        pos += METRIC_SCALAR_RECORD_SIZE;
+    }
+
+    for (; with_hists && i < METRIC_SCALAR_COUNT + METRIC_HIST_COUNT; i++) {
+        size_t id = i - METRIC_SCALAR_COUNT;
+        if (!(s->hist_used & (1u << id))) {
+            continue;
+        }
+        if (pos + METRIC_HIST_RECORD_SIZE > out_size) {
+            *next = i;
+            return pos;
+        }
+        const metric_hist_t *h = &s->hists[id];
+        out[pos] = METRIC_RECORD_HIST | (uint8_t)id;
+        uart_frame_put_u32(&out[pos + 1], h->count);
+        uart_frame_put_u32(&out[pos + 5], (uint32_t)h->sum);
+        uart_frame_put_u32(&out[pos + 9], (uint32_t)(h->sum >> 32));
+        for (size_t b = 0; b < METRIC_HIST_BUCKETS; b++) {
+            uart_frame_put_u32(&out[pos + 13 + b * 4], h->buckets[b]);
+        }
+        pos += METRIC_HIST_RECORD_SIZE;
+    }
+
+    *next = SIZE_MAX;
+    return pos;
+}
+
+bool metrics_decode(metrics_snapshot_t *s, const uint8_t *data, size_t len)
+{
+    size_t pos = 0;
+    while (pos < len) {
+        uint8_t tag = data[pos];
+        if (tag & METRIC_RECORD_HIST) {
+            size_t id = tag & ~METRIC_RECORD_HIST;
+            if (len - pos < METRIC_HIST_RECORD_SIZE) {
+                return false;
+            }
+            // Records are fixed-size, so one from a newer catalogue is skipped
+            if (id < METRIC_HIST_COUNT) {
+                metric_hist_t *h = &s->hists[id];
+                h->count = uart_frame_get_u32(&data[pos + 1]);
+                h->sum = uart_frame_get_u32(&data[pos + 5]) | ((uint64_t)uart_frame_get_u32(&data[pos + 9]) << 32);
+                for (size_t b = 0; b < METRIC_HIST_BUCKETS; b++) {
+                    h->buckets[b] = uart_frame_get_u32(&data[pos + 13 + b * 4]);
+                }
+                s->hist_used |= 1u << id;
+            }
+            pos += METRIC_HIST_RECORD_SIZE;
+        } else {
+            if (len - pos < METRIC_SCALAR_RECORD_SIZE) {
+                return false;
+            }
+            if (tag < METRIC_SCALAR_COUNT) {
+                s->values[tag] = uart_frame_get_u32(&data[pos + 1]);
+                s->used[tag / 32] |= 1u << (tag % 32);
+            }
+            pos += METRIC_SCALAR_RECORD_SIZE;
+        }
+    }
+    return true;
+}
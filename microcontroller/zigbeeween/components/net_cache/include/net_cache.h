@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Network cache for the props: the last network joined, kept in NVS so
+// steering after a power blip or a lost parent scans that one channel first
+// instead of all 16. BDB falls back to the secondary set (all channels) by
+// itself when the primary scan finds nothing; if the cached network is gone
+// altogether the cache is dropped and the next attempt joins whatever it
+// finds. Used by the tombstone and the scarecrow; Zigbee task only.
+
+// Read the cache from NVS. Call once at boot, after nvs_flash_init().
+void net_cache_load(void);
+
+// Record the network we're on now; writes flash only when it changed
+void net_cache_save(void);
+
+// Drop the cache, in NVS too
+void net_cache_forget(void);
+
+// Point the next steering at the cached network, or at any network on
+// ESP_ZB_PRIMARY_CHANNEL_MASK when there isn't one
+void net_cache_apply(void);
+
+// The current steering is restricted to the cached network
+bool net_cache_in_use(void);
+
+// Steering just joined on the cached network's channel
+bool net_cache_joined_cached(void);
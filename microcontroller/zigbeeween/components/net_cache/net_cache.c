@@ -0,0 +1,103 @@
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "esp_zigbee_core.h"
+#include "net_cache.h"
+
+static const char *TAG = "net_cache";
+
+#define NET_CACHE_NAMESPACE "zbnet"
+#define NET_CACHE_KEY       "net"
+
+// Channels scanned when there's no cached network
+#define ESP_ZB_PRIMARY_CHANNEL_MASK ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK
+
+typedef struct {
+    uint8_t channel;
+    uint16_t pan_id;
+    esp_zb_ieee_addr_t ext_pan_id;
+} net_cache_t;
+
+static net_cache_t net_cache;
+static bool net_cache_valid = false;
+static bool in_use = false;
+
+void net_cache_load(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(NET_CACHE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    size_t size = sizeof(net_cache);
+    net_cache_valid = nvs_get_blob(handle, NET_CACHE_KEY, &net_cache, &size) == ESP_OK &&
+                      size == sizeof(net_cache) && net_cache.channel >= 11 && net_cache.channel <= 26;
+    nvs_close(handle);
+}
+
+void net_cache_save(void)
+{
+    net_cache_t now;
+    memset(&now, 0, sizeof(now));  // Padding too, for the memcmp
+    now.channel = esp_zb_get_current_channel();
+    now.pan_id = esp_zb_get_pan_id();
+    esp_zb_get_extended_pan_id(now.ext_pan_id);
+    if (net_cache_valid && memcmp(&now, &net_cache, sizeof(now)) == 0) {
+        return;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NET_CACHE_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, NET_CACHE_KEY, &now, sizeof(now));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to cache network parameters: %s", esp_err_to_name(err));
+        return;
+    }
+    net_cache = now;
+    net_cache_valid = true;
+    ESP_LOGI(TAG, "Cached network: channel %d, PAN ID 0x%04hx", now.channel, now.pan_id);
+}
+
+void net_cache_forget(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(NET_CACHE_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+        nvs_erase_key(handle, NET_CACHE_KEY);
+        nvs_commit(handle);
+        nvs_close(handle);
+    }
+    net_cache_valid = false;
+}
+
+void net_cache_apply(void)
+{
+    static const esp_zb_ieee_addr_t any_ext_pan_id = {0};
+
+    in_use = net_cache_valid;
+    if (in_use) {
+        esp_zb_set_primary_network_channel_set(1UL << net_cache.channel);
+        esp_zb_set_secondary_network_channel_set(ESP_ZB_PRIMARY_CHANNEL_MASK);
+        esp_zb_set_extended_pan_id(net_cache.ext_pan_id);
+        ESP_LOGI(TAG, "Trying cached network first: channel %d, PAN ID 0x%04hx",
+                 net_cache.channel, net_cache.pan_id);
+    } else {
+        esp_zb_set_primary_network_channel_set(ESP_ZB_PRIMARY_CHANNEL_MASK);
+        esp_zb_set_secondary_network_channel_set(0);
+        esp_zb_set_extended_pan_id(any_ext_pan_id);
+    }
+}
+
+bool net_cache_in_use(void)
+{
+    return in_use;
+}
+
+bool net_cache_joined_cached(void)
+{
+    return in_use && esp_zb_get_current_channel() == net_cache.channel;
+}
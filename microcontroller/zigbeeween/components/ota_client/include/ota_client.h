@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include "esp_zigbee_core.h"
+
+// Zigbee OTA Upgrade client: downloads images the coordinator offers into
+// the idle OTA app slot and reboots into them. The image type comes from
+// this app's project name and the running file version from its build time
+// (ota_file.h), so the coordinator only offers a prop builds of its own
+// project that are newer than what it runs.
+//
+// A fresh image boots pending verification and the bootloader rolls it back
+// unless ota_client_confirm() runs first; a rolled-back build is refused
+// if it is offered again. Used by the tombstone and the scarecrow.
+
+// Add the client cluster to endpoint 1. Call from the Zigbee task before
+// esp_zb_device_register().
+void ota_client_add_cluster(esp_zb_cluster_list_t *cluster_list);
+
+// ESP_ZB_CORE_OTA_UPGRADE_VALUE_CB_ID. An error aborts the download.
+esp_err_t ota_client_handle(const esp_zb_zcl_ota_upgrade_value_message_t *message);
+
+// On joining the network: the running image works, cancel any rollback
+void ota_client_confirm(void);
+
+// A download is in progress: poll fast and stay out of deep sleep
+bool ota_client_busy(void);
@@ -0,0 +1,232 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_app_desc.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "ota_file.h"
+#include "metrics.h"
+#include "applog.h"
+#include "ota_client.h"
+
+static const char *TAG = "ota_client";
+
+#define OTA_QUERY_INTERVAL_MIN  2     // Query Next Image timer
+#define OTA_BLOCK_SIZE          64    // Largest block that fits one unfragmented APS frame
+
+// Download state, Zigbee task only
+static esp_ota_handle_t ota_handle = 0;
+static const esp_partition_t *ota_partition = NULL;
+static uint8_t tag_buf[OTA_FILE_TAG_SIZE];   // Sub-element header, may arrive split across blocks
+static uint8_t tag_have;
+static uint32_t image_size;                  // App image bytes, set once the tag checks out
+static uint32_t image_written;
+static uint8_t progress_decile;
+static volatile bool busy = false;
+
+static uint32_t running_version(void)
+{
+    const esp_app_desc_t *desc = esp_app_get_description();
+    return ota_file_version(desc->date, desc->time);
+}
+
+void ota_client_add_cluster(esp_zb_cluster_list_t *cluster_list)
+{
+    const esp_app_desc_t *desc = esp_app_get_description();
+    esp_zb_ota_cluster_cfg_t ota_cfg = {
+        .ota_upgrade_file_version = running_version(),
+        .ota_upgrade_manufacturer = OTA_MANUFACTURER_CODE,
+        .ota_upgrade_image_type = ota_file_image_type(desc->project_name),
+        .ota_upgrade_downloaded_file_ver = 0xFFFFFFFF,   // None, per ZCL
+    };
+    esp_zb_attribute_list_t *ota_cluster = esp_zb_ota_cluster_create(&ota_cfg);
+    esp_zb_zcl_ota_upgrade_client_variable_t ota_client_var = {
+        .timer_query = OTA_QUERY_INTERVAL_MIN,
+        .hw_version = 0,
+        .max_data_size = OTA_BLOCK_SIZE,
+    };
+    esp_zb_ota_cluster_add_attr(ota_cluster, ESP_ZB_ZCL_ATTR_OTA_UPGRADE_CLIENT_DATA_ID, &ota_client_var);
+    esp_zb_cluster_list_add_ota_cluster(cluster_list, ota_cluster, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
+    ESP_LOGI(TAG, "Running %s %s, OTA image type 0x%04x version %lu", desc->project_name, desc->version,
+             ota_cfg.ota_upgrade_image_type, (unsigned long)ota_cfg.ota_upgrade_file_version);
+}
+
+// The build the bootloader last rolled back from, so it isn't taken again
+static bool is_rejected_version(uint32_t file_version)
+{
+    const esp_partition_t *invalid = esp_ota_get_last_invalid_partition();
+    esp_app_desc_t desc;
+
+    return invalid != NULL && esp_ota_get_partition_description(invalid, &desc) == ESP_OK &&
+           ota_file_version(desc.date, desc.time) == file_version;
+}
+
+static void download_abort(void)
+{
+    if (ota_handle != 0) {
+        esp_ota_abort(ota_handle);
+        ota_handle = 0;
+    }
+    busy = false;
+}
+
+static esp_err_t download_start(const esp_zb_ota_upgrade_file_header_t *header)
+{
+    const esp_app_desc_t *desc = esp_app_get_description();
+
+    if (header->manufacturer_code != OTA_MANUFACTURER_CODE ||
+        header->image_type != ota_file_image_type(desc->project_name)) {
+        ESP_LOGW(TAG, "Refusing image type 0x%04x (manufacturer 0x%04x)", header->image_type, header->manufacturer_code);
+        return ESP_FAIL;
+    }
+    if (header->file_version <= running_version() || is_rejected_version(header->file_version)) {
+        ESP_LOGW(TAG, "Refusing image version %lu (running %lu)", (unsigned long)header->file_version,
+                 (unsigned long)running_version());
+        return ESP_FAIL;
+    }
+    ota_partition = esp_ota_get_next_update_partition(NULL);
+    if (ota_partition == NULL || header->image_size < OTA_FILE_OVERHEAD ||
+        header->image_size - OTA_FILE_OVERHEAD > ota_partition->size) {
+        ESP_LOGE(TAG, "No update slot for a %lu-byte image", (unsigned long)header->image_size);
+        return ESP_FAIL;
+    }
+    download_abort();
+    // Sector by sector as blocks arrive: erasing the whole slot up front
+    // would hold the Zigbee task for seconds
+    esp_err_t err = esp_ota_begin(ota_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(err));
+        ota_handle = 0;
+        return err;
+    }
+    tag_have = 0;
+    image_size = 0;
+    image_written = 0;
+    progress_decile = 0;
+    busy = true;
+    ESP_LOGI(TAG, "Downloading version %lu (%lu bytes) into %s", (unsigned long)header->file_version,
+             (unsigned long)header->image_size, ota_partition->label);
+    return ESP_OK;
+}
+
+// Blocks carry the file from just after the 56-byte header: the tag, then the app image
+static esp_err_t download_block(const esp_zb_ota_upgrade_file_header_t *header, const uint8_t *data, uint16_t len)
+{
+    if (ota_handle == 0) {
+        return ESP_FAIL;
+    }
+    while (tag_have < OTA_FILE_TAG_SIZE && len > 0) {
+        tag_buf[tag_have++] = *data++;
+        len--;
+        if (tag_have == OTA_FILE_TAG_SIZE) {
+            if (!ota_file_tag_check(tag_buf, header->image_size)) {
+                ESP_LOGE(TAG, "File doesn't hold a single upgrade image");
+                return ESP_FAIL;
+            }
+            image_size = header->image_size - OTA_FILE_OVERHEAD;
+        }
+    }
+    if (len == 0) {
+        return ESP_OK;
+    }
+    if (len > image_size - image_written) {
+        ESP_LOGE(TAG, "Image data past the sub-element");
+        return ESP_FAIL;
+    }
+    esp_err_t err = esp_ota_write(ota_handle, data, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_write failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    image_written += len;
+    metrics_inc(METRIC_OTA_BLOCKS_RECEIVED);
+
+    uint8_t decile = (uint8_t)((uint64_t)image_written * 10 / image_size);
+    if (decile != progress_decile) {
+        progress_decile = decile;
+        APPLOGI(ZIGBEE, TAG, "OTA download %u%% (%lu of %lu bytes)", decile * 10,
+                (unsigned long)image_written, (unsigned long)image_size);
+    }
+    return ESP_OK;
+}
+
+// Whole image received: esp_ota_end checks its format and SHA-256
+static esp_err_t download_check(void)
+{
+    if (ota_handle == 0 || image_size == 0 || image_written != image_size) {
+        ESP_LOGE(TAG, "Image incomplete (%lu of %lu bytes)", (unsigned long)image_written, (unsigned long)image_size);
+        return ESP_FAIL;
+    }
+    esp_err_t err = esp_ota_end(ota_handle);
+    ota_handle = 0;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Image failed verification: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static void download_finish(void)
+{
+    esp_err_t err = esp_ota_set_boot_partition(ota_partition);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot boot %s: %s", ota_partition->label, esp_err_to_name(err));
+        busy = false;
+        return;
+    }
+    ESP_LOGI(TAG, "Update complete, rebooting into %s", ota_partition->label);
+    applog_flush();
+    esp_restart();
+}
+
+esp_err_t ota_client_handle(const esp_zb_zcl_ota_upgrade_value_message_t *message)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (message->info.status != ESP_ZB_ZCL_STATUS_SUCCESS) {
+        ESP_LOGW(TAG, "OTA upgrade status error 0x%x", message->info.status);
+        download_abort();
+        return ESP_FAIL;
+    }
+    switch (message->upgrade_status) {
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_START:
+            ret = download_start(&message->ota_header);
+            break;
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_RECEIVE:
+            ret = download_block(&message->ota_header, message->payload, message->payload_size);
+            break;
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_CHECK:
+            ret = download_check();
+            break;
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_APPLY:
+            ESP_LOGI(TAG, "Image verified, waiting for the upgrade time");
+            break;
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_FINISH:
+            download_finish();
+            break;
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_ABORT:
+            ESP_LOGW(TAG, "Download aborted at %lu of %lu bytes", (unsigned long)image_written, (unsigned long)image_size);
+            download_abort();
+            break;
+        default:
+            break;
+    }
+    if (ret != ESP_OK) {
+        download_abort();
+    }
+    return ret;
+}
+
+void ota_client_confirm(void)
+{
+    esp_ota_img_states_t state;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+
+    if (esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY) {
+        ESP_LOGI(TAG, "Updated image joined the network, keeping it");
+        esp_ota_mark_app_valid_cancel_rollback();
+    }
+}
+
+bool ota_client_busy(void)
+{
+    return busy;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Zigbee OTA Upgrade files (ZCL 11.4) as the props receive them: the
+// 56-byte header with no optional fields, then a single upgrade-image
+// sub-element holding the ESP-IDF app image exactly as idf.py builds it.
+//
+//   header:  u32 OTA_FILE_MAGIC, u16 header version, u16 header length,
+//            u16 field control (0), u16 manufacturer code, u16 image type,
+//            u32 file version, u16 stack version, char[32] header string,
+//            u32 total size (header included)
+//   tag:     u16 OTA_FILE_TAG_UPGRADE_IMAGE, u32 image length
+//
+// Nobody needs a separate image builder: the TinyS3 wraps an uploaded
+// app image itself. The image type comes from the app's project name and
+// the file version from its build time, both read from the app descriptor,
+// so a prop computes the same version for the image it is running.
+
+#define OTA_FILE_MAGIC              0x0BEEF11E
+#define OTA_FILE_HEADER_VERSION     0x0100
+#define OTA_FILE_HEADER_SIZE        56
+#define OTA_FILE_TAG_SIZE           6
+#define OTA_FILE_OVERHEAD           (OTA_FILE_HEADER_SIZE + OTA_FILE_TAG_SIZE)
+#define OTA_FILE_TAG_UPGRADE_IMAGE  0x0000
+#define OTA_FILE_STACK_ZIGBEE_PRO   0x0002
+#define OTA_FILE_HEADER_STRING_LEN  32
+
+#define OTA_MANUFACTURER_CODE       0x131B  // Espressif
+#define OTA_IMAGE_TYPE_TOMBSTONE    0x0001
+#define OTA_IMAGE_TYPE_SCARECROW    0x0002
+#define OTA_IMAGE_TYPE_UNKNOWN      0xFFFF
+
+// The app image bytes the TinyS3 needs to see: image header, first segment
+// header, then the app descriptor's fields up to the build date
+#define OTA_APP_INFO_MIN_SIZE       (24 + 8 + 112)
+
+typedef struct {
+    uint16_t manufacturer_code;
+    uint16_t image_type;
+    uint32_t file_version;
+    uint32_t total_size;
+} ota_file_info_t;
+
+typedef struct {
+    char project[33];
+    char version[33];
+    uint16_t image_type;        // OTA_IMAGE_TYPE_UNKNOWN if not a prop's project
+    uint32_t file_version;      // 0 if the build time didn't parse
+} ota_app_info_t;
+
+// Seconds from 2020-01-01 to the build time in an app descriptor's date
+// ("Oct 14 2026") and time ("21:07:33") fields, as the build machine's
+// clock read it. 0 if either doesn't parse.
+uint32_t ota_file_version(const char *date, const char *time);
+
+// Image type for an app descriptor's project name
+uint16_t ota_file_image_type(const char *project);
+
+// Short name for an image type ("tombstone"), "unknown" for others
+const char *ota_file_image_name(uint16_t image_type);
+
+// Read the app descriptor of an ESP-IDF app image. False if the image or
+// descriptor magic is wrong or len < OTA_APP_INFO_MIN_SIZE.
+bool ota_file_app_info(const uint8_t *image, size_t len, ota_app_info_t *out);
+
+// Write the OTA_FILE_OVERHEAD bytes that go in front of an app image of
+// image_size bytes. info->total_size is ignored and computed.
+void ota_file_header_encode(uint8_t *out, const ota_file_info_t *info, uint32_t image_size, const char *header_string);
+
+// Check a file's header and tag against each other. len is the bytes at
+// data (at least OTA_FILE_OVERHEAD).
+bool ota_file_header_parse(const uint8_t *data, size_t len, ota_file_info_t *out);
+
+// Check the OTA_FILE_TAG_SIZE bytes after the header: the upgrade-image tag
+// of a file of total_size bytes
+bool ota_file_tag_check(const uint8_t *tag, uint32_t total_size);
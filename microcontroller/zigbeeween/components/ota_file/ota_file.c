@@ -0,0 +1,148 @@
+#include "ota_file.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "uart_frame.h"
+
+#define APP_IMAGE_MAGIC        0xE9
+#define APP_DESC_OFFSET        (24 + 8)    // Image header, first segment header
+#define APP_DESC_MAGIC         0xABCD5432
+#define APP_DESC_VERSION       16
+#define APP_DESC_PROJECT       48
+#define APP_DESC_TIME          80
+#define APP_DESC_DATE          96
+
+static const struct {
+    const char *project;       // CMake project() name
+    const char *name;
+    uint16_t image_type;
+} image_types[] = {
+    { "rip_tombstone", "tombstone", OTA_IMAGE_TYPE_TOMBSTONE },
+    { "zigbee_halloween_trigger", "scarecrow", OTA_IMAGE_TYPE_SCARECROW },
+};
+#define IMAGE_TYPE_COUNT (sizeof(image_types) / sizeof(image_types[0]))
+
+// Days from 1970-01-01 to y-m-d (proleptic Gregorian)
+static int32_t days_from_civil(int y, int m, int d)
+{
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+uint32_t ota_file_version(const char *date, const char *time)
+{
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char mon[4];
+    int day, year, hh, mm, ss;
+
+    if (sscanf(date, "%3s %d %d", mon, &day, &year) != 3 || sscanf(time, "%d:%d:%d", &hh, &mm, &ss) != 3) {
+        return 0;
+    }
+    const char *m = strstr(months, mon);
+    if (strlen(mon) != 3 || m == NULL || (m - months) % 3 != 0 || year < 2020 || day < 1 || day > 31 ||
+        hh > 23 || mm > 59 || ss > 60) {
+        return 0;
+    }
+    int32_t days = days_from_civil(year, (int)(m - months) / 3 + 1, day) - days_from_civil(2020, 1, 1);
+    return (uint32_t)days * 86400u + (uint32_t)(hh * 3600 + mm * 60 + ss);
+}
+
+uint16_t ota_file_image_type(const char *project)
+{
+    for (size_t i = 0; i < IMAGE_TYPE_COUNT; i++) {
+        if (strcmp(project, image_types[i].project) == 0) {
+            return image_types[i].image_type;
+        }
+    }
+    return OTA_IMAGE_TYPE_UNKNOWN;
+}
+
+const char *ota_file_image_name(uint16_t image_type)
+{
+    for (size_t i = 0; i < IMAGE_TYPE_COUNT; i++) {
+        if (image_types[i].image_type == image_type) {
+            return image_types[i].name;
+        }
+    }
+    return "unknown";
+}
+
+// Descriptor strings are NUL-padded but not guaranteed terminated
+static void desc_string(char *out, size_t out_size, const uint8_t *field, size_t field_size)
+{
+    size_t n = strnlen((const char *)field, field_size);
+    if (n >= out_size) {
+        n = out_size - 1;
+    }
+    memcpy(out, field, n);
+    out[n] = '\0';
+}
+
+bool ota_file_app_info(const uint8_t *image, size_t len, ota_app_info_t *out)
+{
+    char date[17], time[17];
+
+    if (len < OTA_APP_INFO_MIN_SIZE || image[0] != APP_IMAGE_MAGIC) {
+        return false;
+    }
+    const uint8_t *desc = image + APP_DESC_OFFSET;
+    if (uart_frame_get_u32(desc) != APP_DESC_MAGIC) {
+        return false;
+    }
+    desc_string(out->version, sizeof(out->version), desc + APP_DESC_VERSION, 32);
+    desc_string(out->project, sizeof(out->project), desc + APP_DESC_PROJECT, 32);
+    desc_string(time, sizeof(time), desc + APP_DESC_TIME, 16);
+    desc_string(date, sizeof(date), desc + APP_DESC_DATE, 16);
+    out->image_type = ota_file_image_type(out->project);
+    out->file_version = ota_file_version(date, time);
+    return true;
+}
+
+void ota_file_header_encode(uint8_t *out, const ota_file_info_t *info, uint32_t image_size, const char *header_string)
+{
+    memset(out, 0, OTA_FILE_OVERHEAD);
+    uart_frame_put_u32(&out[0], OTA_FILE_MAGIC);
+    uart_frame_put_u16(&out[4], OTA_FILE_HEADER_VERSION);
+    uart_frame_put_u16(&out[6], OTA_FILE_HEADER_SIZE);
+    uart_frame_put_u16(&out[8], 0);
+    uart_frame_put_u16(&out[10], info->manufacturer_code);
+    uart_frame_put_u16(&out[12], info->image_type);
+    uart_frame_put_u32(&out[14], info->file_version);
+    uart_frame_put_u16(&out[18], OTA_FILE_STACK_ZIGBEE_PRO);
+    if (header_string) {
+        strncpy((char *)&out[20], header_string, OTA_FILE_HEADER_STRING_LEN);
+    }
+    uart_frame_put_u32(&out[52], image_size + OTA_FILE_OVERHEAD);
+    uart_frame_put_u16(&out[56], OTA_FILE_TAG_UPGRADE_IMAGE);
+    uart_frame_put_u32(&out[58], image_size);
+}
+
+bool ota_file_header_parse(const uint8_t *data, size_t len, ota_file_info_t *out)
+{
+    if (len < OTA_FILE_OVERHEAD ||
+        uart_frame_get_u32(&data[0]) != OTA_FILE_MAGIC ||
+        uart_frame_get_u16(&data[4]) != OTA_FILE_HEADER_VERSION ||
+        uart_frame_get_u16(&data[6]) != OTA_FILE_HEADER_SIZE ||
+        uart_frame_get_u16(&data[8]) != 0) {
+        return false;
+    }
+    uint32_t total = uart_frame_get_u32(&data[52]);
+    if (!ota_file_tag_check(&data[OTA_FILE_HEADER_SIZE], total)) {
+        return false;
+    }
+    out->manufacturer_code = uart_frame_get_u16(&data[10]);
+    out->image_type = uart_frame_get_u16(&data[12]);
+    out->file_version = uart_frame_get_u32(&data[14]);
+    out->total_size = total;
+    return true;
+}
+
+bool ota_file_tag_check(const uint8_t *tag, uint32_t total_size)
+{
+    return total_size >= OTA_FILE_OVERHEAD && uart_frame_get_u16(&tag[0]) == OTA_FILE_TAG_UPGRADE_IMAGE &&
+           uart_frame_get_u32(&tag[2]) == total_size - OTA_FILE_OVERHEAD;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// The props' clock, set by the coordinator through the 0xFC00 time sync
+// cluster. Tracks how fast our clock drifts from the coordinator's (the
+// coordinator reads it back to decide how often to resync), and keeps the
+// clock through deep sleep, corrected by the sleep drift learned on earlier
+// nights. Used by the tombstone and the scarecrow; Zigbee task only unless
+// noted.
+
+// Zigbee Time Sync Cluster (using custom manufacturer-specific cluster)
+#define ZB_TIME_SYNC_CLUSTER_ID 0xFC00  // Custom cluster for time synchronization
+#define ZB_TIME_SYNC_ATTR_ID 0x0000     // Attribute ID for Unix timestamp (seconds, legacy)
+#define ZB_TIME_SYNC_US_ATTR_ID 0x0002     // U64 Unix time in microseconds
+#define ZB_TIME_SYNC_DRIFT_ATTR_ID 0x0003  // S16 measured clock drift in ppm, read by the coordinator
+
+// Legacy whole-second sync; too coarse to measure drift against
+void set_system_time(time_t timestamp);
+
+// ZB_TIME_SYNC_US_ATTR_ID written. Called from the attribute callback, so
+// the drift attribute is updated without taking the ZB lock.
+void set_system_time_us(int64_t unix_us);
+
+// Ask the coordinator for a unicast time sync now rather than waiting for
+// its next round. A wake request also gets the first sync after deep sleep
+// in quickly enough to measure the sleep drift. The sync is a write our
+// parent holds until we poll, so a sleepy prop should poll fast after it.
+void request_time_sync(void);
+
+// Deep sleep timer wake: the system clock kept running, so correct it for
+// sleep drift and treat it as synced. The sleep schedule is decided right
+// away instead of after the coordinator's next time sync. Call once at
+// boot, before the Zigbee stack starts.
+void time_restore_after_sleep(void);
+
+// Called just before a synced deep sleep
+void time_retain_for_sleep(void);
+
+// The wall clock is set, by a sync or kept through deep sleep. Any task.
+bool time_is_synced(void);
+
+// Measured drift in ppm (0 until measured), for the drift attribute's
+// initial value; retained across deep sleep
+int16_t time_drift_ppm(void);
@@ -0,0 +1,203 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_zigbee_core.h"
+#include "metrics.h"
+#include "prop_time.h"
+
+static const char *TAG = "prop_time";
+
+// Coordinator's request cluster; the time request is one of its commands
+#define ZB_TRIGGER_REQUEST_CLUSTER_ID 0xFC01
+#define ZB_TIME_REQUEST_CMD_ID 0x00        // Custom command: unicast me the time now (u8 reason below)
+#define TIME_REQUEST_BOOT      0             // Cold boot, no idea what time it is
+#define TIME_REQUEST_WAKE      1             // Woke from deep sleep with the retained clock
+
+static bool time_synced = false;
+
+// Clock drift measured from the corrections successive time syncs apply. The
+// coordinator reads it back to decide how often to resync.
+#define DRIFT_MIN_ELAPSED_US (30 * 1000000LL)  // Shorter gaps make the estimate noisy
+#define DRIFT_MAX_OFFSET_US  1000000            // Bigger corrections are clock steps, not drift
+#define DRIFT_MAX_PPM        10000
+static int64_t last_precise_sync_us = 0;        // esp_timer time of the last microsecond sync (0 = none)
+static int16_t drift_ppm = 0;
+static bool drift_known = false;
+
+// Clock state kept in RTC memory across deep sleep. The RTC timer keeps the
+// system clock running while we sleep, but off the slow RC oscillator, so
+// the wake path corrects it by the sleep drift learned on earlier nights
+// (from the correction the first sync after each wake still had to apply).
+#define RTC_TIME_MAGIC             0x54494D45  // "TIME"
+#define SLEEP_DRIFT_MAX_OFFSET_US  (120 * 1000000LL)  // Bigger means the retained clock is wrong, not drifting
+#define SLEEP_MAX_US               (24 * 3600 * 1000000LL)
+
+typedef struct {
+    uint32_t magic;            // RTC_TIME_MAGIC when the rest is valid
+    int64_t sleep_unix_us;     // Wall clock when deep sleep started
+    int16_t drift_ppm;         // Awake drift, so the coordinator has it right after wake
+    bool drift_known;
+    int16_t sleep_ppm;         // How much slower than the coordinator the sleep clock runs
+    bool sleep_ppm_known;
+} rtc_time_t;
+
+static RTC_DATA_ATTR rtc_time_t rtc_time;
+static int64_t woke_sleep_us = 0;  // Length of the deep sleep we woke from, until a sync measures it
+
+static void set_local_timezone(void)
+{
+    // Set timezone to Los Angeles (PST/PDT)
+    setenv("TZ", "PST8PDT,M3.2.0,M11.1.0", 1);
+    tzset();
+}
+
+static void apply_system_time(const struct timeval *tv)
+{
+    settimeofday(tv, NULL);
+    set_local_timezone();
+
+    struct tm timeinfo;
+    localtime_r(&tv->tv_sec, &timeinfo);
+    char time_str[64];
+    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
+
+    ESP_LOGI(TAG, "Time synchronized from coordinator!");
+    ESP_LOGI(TAG, "   Unix timestamp: %ld.%06ld", (long)tv->tv_sec, (long)tv->tv_usec);
+    ESP_LOGI(TAG, "   Time: %s", time_str);
+
+    time_synced = true;
+    metrics_inc(METRIC_TIME_SYNCS);
+}
+
+void set_system_time(time_t timestamp)
+{
+    struct timeval tv = { .tv_sec = timestamp, .tv_usec = 0 };
+    last_precise_sync_us = 0;
+    apply_system_time(&tv);
+}
+
+void set_system_time_us(int64_t unix_us)
+{
+    struct timeval before;
+    gettimeofday(&before, NULL);
+    int64_t now_us = esp_timer_get_time();
+    int64_t offset_us = unix_us - ((int64_t)before.tv_sec * 1000000 + before.tv_usec);
+
+    // First sync after a deep sleep: what's left is the sleep clock's error
+    // beyond the correction already applied on wake
+    if (woke_sleep_us > 0) {
+        if (llabs(offset_us) < SLEEP_DRIFT_MAX_OFFSET_US) {
+            int32_t sample = rtc_time.sleep_ppm + (int32_t)(offset_us * 1000000 / woke_sleep_us);
+            if (sample > DRIFT_MAX_PPM) sample = DRIFT_MAX_PPM;
+            if (sample < -DRIFT_MAX_PPM) sample = -DRIFT_MAX_PPM;
+
+            rtc_time.sleep_ppm = rtc_time.sleep_ppm_known ?
+                                 (int16_t)(rtc_time.sleep_ppm + (sample - rtc_time.sleep_ppm) / 2) : (int16_t)sample;
+            rtc_time.sleep_ppm_known = true;
+            ESP_LOGI(TAG, "   Sleep clock was %lld us off after %lld s, sleep drift now %d ppm",
+                     offset_us, woke_sleep_us / 1000000, rtc_time.sleep_ppm);
+        }
+        woke_sleep_us = 0;
+    }
+
+    // offset / elapsed is how fast our clock runs relative to the coordinator's
+    if (time_synced && last_precise_sync_us != 0) {
+        int64_t elapsed_us = now_us - last_precise_sync_us;
+        if (elapsed_us >= DRIFT_MIN_ELAPSED_US && llabs(offset_us) < DRIFT_MAX_OFFSET_US) {
+            int32_t sample = (int32_t)(offset_us * 1000000 / elapsed_us);
+            if (sample > DRIFT_MAX_PPM) sample = DRIFT_MAX_PPM;
+            if (sample < -DRIFT_MAX_PPM) sample = -DRIFT_MAX_PPM;
+
+            drift_ppm = drift_known ? (int16_t)(drift_ppm + (sample - drift_ppm) / 4) : (int16_t)sample;
+            drift_known = true;
+            esp_zb_zcl_set_attribute_val(1, ZB_TIME_SYNC_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                         ZB_TIME_SYNC_DRIFT_ATTR_ID, &drift_ppm, false);
+        }
+    }
+    last_precise_sync_us = now_us;
+
+    struct timeval tv = { .tv_sec = unix_us / 1000000, .tv_usec = unix_us % 1000000 };
+    apply_system_time(&tv);
+    ESP_LOGI(TAG, "   Correction: %lld us, drift %d ppm%s", offset_us, drift_ppm, drift_known ? "" : " (not measured yet)");
+}
+
+void time_restore_after_sleep(void)
+{
+    bool valid = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER && rtc_time.magic == RTC_TIME_MAGIC;
+    rtc_time.magic = 0;  // One use; enter_deep_sleep sets it again
+    if (!valid) {
+        return;
+    }
+
+    drift_ppm = rtc_time.drift_ppm;
+    drift_known = rtc_time.drift_known;
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t now_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+    int64_t slept_us = now_us - rtc_time.sleep_unix_us;
+    if (slept_us <= 0 || slept_us > SLEEP_MAX_US) {
+        ESP_LOGW(TAG, "Retained clock is off (%lld s since sleep), waiting for a time sync", slept_us / 1000000);
+        return;
+    }
+
+    int64_t correction_us = rtc_time.sleep_ppm_known ? slept_us * rtc_time.sleep_ppm / 1000000 : 0;
+    now_us += correction_us;
+    struct timeval tv = { .tv_sec = now_us / 1000000, .tv_usec = now_us % 1000000 };
+    settimeofday(&tv, NULL);
+    set_local_timezone();
+    time_synced = true;
+    woke_sleep_us = slept_us;
+
+    ESP_LOGI(TAG, "Clock kept through deep sleep: %lld s asleep, corrected %lld us (sleep drift %d ppm%s)",
+             slept_us / 1000000, correction_us, rtc_time.sleep_ppm, rtc_time.sleep_ppm_known ? "" : ", not measured yet");
+}
+
+void time_retain_for_sleep(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    rtc_time.sleep_unix_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+    rtc_time.drift_ppm = drift_ppm;
+    rtc_time.drift_known = drift_known;
+    rtc_time.magic = RTC_TIME_MAGIC;
+}
+
+bool time_is_synced(void)
+{
+    return time_synced;
+}
+
+int16_t time_drift_ppm(void)
+{
+    return drift_ppm;
+}
+
+void request_time_sync(void)
+{
+    uint8_t reason = woke_sleep_us > 0 ? TIME_REQUEST_WAKE : TIME_REQUEST_BOOT;
+    esp_zb_zcl_custom_cluster_cmd_req_t req = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = 0x0000,
+            .dst_endpoint = 1,
+            .src_endpoint = 1,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+        .cluster_id = ZB_TRIGGER_REQUEST_CLUSTER_ID,
+        .custom_cmd_id = ZB_TIME_REQUEST_CMD_ID,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV,
+        .data = {
+            .type = ESP_ZB_ZCL_ATTR_TYPE_U8,
+            .size = sizeof(reason),
+            .value = &reason,
+        },
+    };
+    esp_zb_zcl_custom_cluster_cmd_req(&req);
+    ESP_LOGI(TAG, "Time requested from coordinator (%s)", reason == TIME_REQUEST_WAKE ? "wake" : "boot");
+}
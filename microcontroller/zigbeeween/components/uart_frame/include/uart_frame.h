@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// UART link framing shared by the TinyS3 gateway and the XIAO C6 coordinator.
+//
+// Frame layout (all multi-byte fields little-endian):
+//
+//   +------+-----+-----+---------+-----------------+---------+
+//   | 0xAA | ver | cmd | len(2)  | payload[len]    | crc(2)  |
+//   +------+-----+-----+---------+-----------------+---------+
+//
+// The CRC is CRC-16/CCITT-FALSE over ver, cmd, len and payload. The start
+// byte is only a sync hint: a payload byte equal to 0xAA is harmless because
+// a frame is accepted only when version, length and CRC all check out. On any
+// mismatch the parser drops one byte and rescans, so it resynchronizes on the
+// next real frame without losing it.
+
+#define UART_FRAME_SOF          0xAA
+#define UART_FRAME_VERSION      0x01
+#define UART_FRAME_HEADER_SIZE  5     // sof + ver + cmd + len(2)
+#define UART_FRAME_CRC_SIZE     2
+#define UART_FRAME_MAX_PAYLOAD  512
+#define UART_FRAME_OVERHEAD     (UART_FRAME_HEADER_SIZE + UART_FRAME_CRC_SIZE)
+#define UART_FRAME_MAX_SIZE     (UART_FRAME_MAX_PAYLOAD + UART_FRAME_OVERHEAD)
+
+// Receive ring size, must be a power of two and hold at least one max frame
+#define UART_FRAME_RING_SIZE    1024
+
+typedef void (*uart_frame_handler_t)(void *ctx, uint8_t cmd, const uint8_t *payload, uint16_t len);
+
+typedef struct {
+    uint32_t frames_ok;
+    uint32_t crc_errors;
+    uint32_t bad_header;      // wrong version or oversize length
+    uint32_t dropped_bytes;   // bytes discarded while hunting for a start byte
+} uart_frame_stats_t;
+
+typedef struct {
+    uint8_t ring[UART_FRAME_RING_SIZE];
+    uint16_t head;            // next write position
+    uint16_t tail;            // oldest unparsed byte
+    uint8_t frame[UART_FRAME_MAX_PAYLOAD];  // linear copy handed to the handler
+    uart_frame_handler_t handler;
+    void *ctx;
+    uart_frame_stats_t stats;
+} uart_frame_parser_t;
+
+uint16_t uart_frame_crc16(uint16_t crc, const uint8_t *data, size_t len);
+
+// Encode a frame into out. Returns the number of bytes written, or 0 if the
+// payload is too large or out is too small.
+size_t uart_frame_encode(uint8_t *out, size_t out_size, uint8_t cmd, const uint8_t *payload, uint16_t len);
+
+void uart_frame_parser_init(uart_frame_parser_t *p, uart_frame_handler_t handler, void *ctx);
+void uart_frame_parser_reset(uart_frame_parser_t *p);
+
+// Feed raw bytes from the UART. Every complete, valid frame is delivered to the
+// handler before this returns; partial frames stay buffered for the next call.
+void uart_frame_parser_feed(uart_frame_parser_t *p, const uint8_t *data, size_t len);
+
+static inline void uart_frame_put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static inline void uart_frame_put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static inline uint16_t uart_frame_get_u16(const uint8_t *p)
+{
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static inline uint32_t uart_frame_get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
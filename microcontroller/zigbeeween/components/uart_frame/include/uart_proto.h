@@ -0,0 +1,210 @@
+#pragma once
+
+// UART command protocol between the TinyS3 gateway and the XIAO C6
+// coordinator. Each command travels as the cmd byte of a uart_frame; payload
+// layouts are listed next to each id (little-endian).
+
+// TinyS3 -> Coordinator
+#define CMD_TRIGGER_RIP         0x01  // optional u16 trigger sequence (see below)
+#define CMD_TRIGGER_HALLOWEEN   0x02  // optional u16 trigger sequence
+#define CMD_TRIGGER_BOTH        0x03  // optional u16 trigger sequence
+#define CMD_GATEWAY_MOTION      0x04  // optional u16 trigger sequence; fires the RULE_EVENT_GATEWAY_MOTION rules
+#define CMD_CHOREOGRAPHY        0x05  // u16 trigger sequence, u8 step count, steps (see below)
+#define CMD_STATUS_REQUEST      0x10  // no payload
+#define CMD_TIME_SYNC           0x20  // u32 unix timestamp, u32 microseconds
+#define CMD_RULES_BEGIN         0x40  // u16 table size (0 = revert to the built-in table)
+#define CMD_RULES_DATA          0x41  // u16 offset, then table bytes
+#define CMD_RULES_COMMIT        0x42  // no payload
+#define CMD_OTA_BEGIN           0x50  // u16 image type, u32 file version, u32 file size (0 = drop the staged image)
+#define CMD_OTA_DATA            0x51  // u32 offset, then file bytes
+#define CMD_OTA_END             0x52  // u32 CRC-32 of the whole file
+
+// Coordinator -> TinyS3
+#define CMD_HEARTBEAT           0x12  // u8 status sequence
+#define CMD_DEVICE_STATUS       0x13  // status snapshot chunk, see below
+#define CMD_TRIGGER_STATS       0x14  // u32 accepted, dropped (cooldown), dropped (duplicate), dropped (offline)
+#define CMD_RADIO_TELEMETRY     0x15  // per-device link history, see below
+#define CMD_TRIGGER_ACK         0x16  // u16 trigger sequence, u8 devices traced
+#define CMD_TRIGGER_TRACE       0x17  // per-device trigger timing, see below
+#define CMD_RULES_STATUS        0x18  // u8 RULE_RESULT_*, u8 built-in, u16 rules, u16 size, u16 crc
+#define CMD_METRICS             0x19  // u8 source, then metric records (see below)
+#define CMD_OTA_ACK             0x1A  // u8 OTA_RESULT_*, u32 file bytes stored
+#define CMD_OTA_STATUS          0x1B  // staged image and per-device progress, see below
+#define CMD_DEVICE_JOINED       0x30  // u8 device id
+#define CMD_DEVICE_LEFT         0x31  // u8 device id
+
+// The coordinator pushes a status snapshot whenever a device's state bits
+// change (and in reply to CMD_STATUS_REQUEST), bumping the status sequence
+// each time. CMD_HEARTBEAT carries the last sequence sent so the TinyS3 can
+// tell it missed a push and ask for a fresh snapshot.
+#define STATUS_HEARTBEAT_INTERVAL_MS 5000
+
+// A snapshot is one or more CMD_DEVICE_STATUS frames sharing a sequence:
+//
+//   u8 status sequence, u8 total devices, u8 index of first record,
+//   then up to DEVICE_STATUS_MAX_PER_FRAME records of
+//   u8 id, u8 state bits, u8 lqi, i8 rssi (dBm),
+//   u16 cooldown remaining (s), u16 last-seen age (s, 0xFFFF = never)
+//
+// Device ids are dense (1..total), so the last chunk is the one whose
+// first index + record count reaches total.
+#define DEVICE_STATUS_HEADER_SIZE    3
+#define DEVICE_STATUS_RECORD_SIZE    8
+#define DEVICE_STATUS_MAX_PER_FRAME  16   // 139-byte frames, well under the UART TX buffers
+#define DEVICE_STATUS_MAX_DEVICES    64   // Upper bound on total for receivers
+#define DEVICE_STATUS_AGE_NEVER      0xFFFF
+
+// Radio telemetry: once per bucket (RADIO_TELEMETRY_BUCKET_SECS) the
+// coordinator sends one CMD_RADIO_TELEMETRY frame per device with history:
+//
+//   u8 device id, u16 bucket length (s), u8 bucket count,
+//   u32 frames delivered (total), u32 frames failed (total),
+//   then bucket count records, oldest first, of
+//   u8 lqi min, u8 lqi avg, u8 lqi max, i8 rssi min, i8 rssi avg, i8 rssi max,
+//   u8 frames delivered, u8 frames failed (saturating)
+//
+// LQI/RSSI come from the coordinator's neighbor table; delivered/failed are
+// unicast ZCL sends confirmed or not by the device. A bucket without link
+// samples has lqi min/avg/max 0.
+#define RADIO_TELEMETRY_HEADER_SIZE  12
+#define RADIO_TELEMETRY_RECORD_SIZE  8
+#define RADIO_TELEMETRY_MAX_BUCKETS  29   // 244-byte frames
+#define RADIO_TELEMETRY_BUCKET_SECS  60
+
+// Trigger tracing: a CMD_TRIGGER_* frame with a nonzero u16 sequence is
+// acknowledged with CMD_TRIGGER_ACK as soon as the coordinator has admitted
+// it (so the TinyS3 can time the UART round trip), then each device it fired
+// gets one CMD_TRIGGER_TRACE once its timing is known or has timed out:
+//
+//   u16 trigger sequence (0 = trigger requested by a prop over Zigbee),
+//   u8 device id, u8 TRIGGER_TRACE_* flags,
+//   u32 coordinator us (frame received -> APS send),
+//   u32 air us (APS send -> ZCL default response),
+//   u32 device us (On/Off received -> relay/LEDs switched, reported by the prop)
+//
+// Unknown times are TRIGGER_TRACE_UNKNOWN. Groupcasts get no default
+// response, so their air time is unknown.
+#define TRIGGER_TRACE_SIZE           16
+#define TRIGGER_TRACE_UNKNOWN        0xFFFFFFFF
+#define TRIGGER_TRACE_GROUPCAST      (1 << 0)
+#define TRIGGER_TRACE_NOT_SENT       (1 << 1)  // Dropped before the APS send
+#define TRIGGER_TRACE_NO_RESPONSE    (1 << 2)  // No default response in time
+#define TRIGGER_TRACE_NO_ACTUATION   (1 << 3)  // Prop didn't report actuating (cooldown, no reply)
+
+// Rule tables: the coordinator decides what an event fires by looking it up
+// in a compiled table, so new props and sequences need no reflashing. The
+// table is a 6-byte header followed by rule_count rules:
+//
+//   header: u8 RULE_TABLE_MAGIC, u8 RULE_TABLE_VERSION, u16 rule count,
+//           u16 CRC-16/CCITT-FALSE of everything after the header
+//   rule:   u8 RULE_EVENT_*, u8 source device id (0 = any),
+//           u8 value mask (0 = any; else the event value must share a bit),
+//           u8 count (0/1 = every match; n = the nth match within window),
+//           u8 window (s), u8 RULE_FLAG_*, u8 action count, u8 reserved (0),
+//           then action count actions of
+//   action: u8 RULE_ACTION_*, u8 target, u16 delay (ms after the event)
+//
+// An upload is CMD_RULES_BEGIN, CMD_RULES_DATA frames in offset order and
+// CMD_RULES_COMMIT; the coordinator validates and stores the table, then
+// answers CMD_RULES_STATUS (which it also sends after CMD_STATUS_REQUEST).
+#define RULE_TABLE_MAGIC        0x52
+#define RULE_TABLE_VERSION      1
+#define RULE_TABLE_HEADER_SIZE  6
+#define RULE_SIZE               8
+#define RULE_ACTION_SIZE        4
+#define RULE_TABLE_MAX_SIZE     1024
+#define RULE_MAX_RULES          32
+#define RULE_MAX_ACTIONS        8     // Per rule
+#define RULE_DATA_CHUNK         256   // Table bytes per CMD_RULES_DATA frame
+
+#define RULE_EVENT_GATEWAY_MOTION  1  // TinyS3's PIR (source 0, value 0)
+#define RULE_EVENT_PROP_REQUEST    2  // Trigger request from a prop (source = its id, value = DEVICE_CAP_* mask)
+
+#define RULE_ACTION_TRIGGER_DEVICE 1  // target = device id
+#define RULE_ACTION_TRIGGER_GROUP  2  // target = coordinator group (0 all, 1 relay, 2 light props)
+#define RULE_ACTION_TRIGGER_CAPS   3  // target = DEVICE_CAP_* mask (0 = the event value)
+
+#define RULE_FLAG_STOP          (1 << 0)  // Once this rule fires, skip later rules for the event
+
+#define RULE_RESULT_OK          0
+#define RULE_RESULT_BAD_FORMAT  1
+#define RULE_RESULT_TOO_LARGE   2
+#define RULE_RESULT_BAD_CRC     3
+#define RULE_RESULT_STORAGE     4  // NVS write failed; the table is active until reboot
+#define RULE_RESULT_SEQUENCE    5  // Data or commit without a matching begin
+#define RULE_RESULT_REPORT      0xFF  // Not an upload reply: status after CMD_STATUS_REQUEST
+#define RULE_STATUS_SIZE        8
+
+// Choreography: a whole timed sequence in one frame, so the props' relative
+// timing is kept by the coordinator's timer rather than by how the TinyS3's
+// frames happen to be spaced. After the 3-byte header come step count steps:
+//
+//   u8 RULE_ACTION_*, u8 target, u16 offset (ms after the frame arrives)
+//
+// Steps at offset 0 fire before CMD_TRIGGER_ACK is sent and are traced under
+// the sequence; later ones are staged and untraced. A frame with no steps
+// cancels whatever an earlier choreography still has staged.
+#define CHOREO_HEADER_SIZE      3
+#define CHOREO_STEP_SIZE        4
+#define CHOREO_MAX_STEPS        32
+
+// Metrics: every METRICS_REPORT_INTERVAL_S the coordinator sends its
+// registry (metrics.h) as CMD_METRICS frames with source 0, each holding as
+// many whole records as fit. Props report their scalars to the coordinator
+// over Zigbee every few minutes and the coordinator forwards each report
+// with source = the prop's device id. Values replace earlier ones, so a
+// lost frame only delays an update.
+#define METRICS_SOURCE_COORDINATOR   0
+#define METRICS_REPORT_INTERVAL_S    10
+#define METRICS_FRAME_MAX            240  // Record bytes per CMD_METRICS frame
+
+// OTA: the TinyS3 wraps an uploaded app image in a Zigbee OTA file
+// (ota_file.h) and streams it to the coordinator, which stages it in flash
+// and serves it to every prop of that image type that asks. An upload is
+// CMD_OTA_BEGIN, CMD_OTA_DATA frames in offset order and CMD_OTA_END.
+//
+// Every frame is answered with CMD_OTA_ACK carrying how many bytes are
+// stored, which is also the next offset the coordinator accepts. The TinyS3
+// keeps up to OTA_WINDOW_CHUNKS data frames in flight. The coordinator
+// erases a sector on its UART task with the flash cache off; its UART ISR
+// is in IRAM (CONFIG_UART_ISR_IN_IRAM), so the window keeps arriving into
+// the 2 KB RX buffer instead of overflowing the 128-byte FIFO. Data at
+// any other offset is answered OTA_RESULT_OFFSET and dropped; the TinyS3
+// resends from the acked offset (go-back-N), as it does when acks stop.
+// BEGIN for a different image restarts; BEGIN for the image being received
+// resumes, acking what is already stored.
+//
+// The coordinator sends CMD_OTA_STATUS after each upload step that changes
+// the stage, after CMD_STATUS_REQUEST and every METRICS_REPORT_INTERVAL_S
+// while props are downloading:
+//
+//   u8 OTA_STAGE_*, u16 image type, u32 file version, u32 file size,
+//   u32 bytes stored, u8 device count, then device count records of
+//   u8 device id, u32 running file version (0 = unknown), u32 bytes served
+//
+// Only devices that have queried the OTA server are listed.
+#define OTA_DATA_CHUNK          480   // File bytes per CMD_OTA_DATA frame
+#define OTA_WINDOW_CHUNKS       2     // Data frames in flight
+#define OTA_ACK_SIZE            5
+#define OTA_STATUS_HEADER_SIZE  16
+#define OTA_STATUS_RECORD_SIZE  9
+
+#define OTA_STAGE_NONE          0
+#define OTA_STAGE_RECEIVING     1
+#define OTA_STAGE_READY         2  // Verified; offered to the props
+
+#define OTA_RESULT_OK           0
+#define OTA_RESULT_BAD_FORMAT   1  // Not an OTA file for a known prop
+#define OTA_RESULT_TOO_LARGE    2  // Bigger than the staging partition
+#define OTA_RESULT_BAD_CRC      3
+#define OTA_RESULT_STORAGE      4  // Staging partition missing or flash write failed
+#define OTA_RESULT_SEQUENCE     5  // Data or end without a matching begin
+#define OTA_RESULT_OFFSET       6  // Data not at the stored count; resend from there
+
+#define DEVICE_STATE_BOUND           (1 << 0)
+#define DEVICE_STATE_TIME_SYNCED     (1 << 1)
+#define DEVICE_STATE_COOLDOWN        (1 << 2)
+
+// Device IDs for join/leave notifications
+#define DEVICE_ID_RIP           1
+#define DEVICE_ID_HALLOWEEN     2
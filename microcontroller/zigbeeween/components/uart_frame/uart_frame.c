@@ -0,0 +1,147 @@
+#include <string.h>
+#include "uart_frame.h"
+
+#define RING_MASK (UART_FRAME_RING_SIZE - 1)
+
+_Static_assert((UART_FRAME_RING_SIZE & RING_MASK) == 0, "ring size must be a power of two");
+_Static_assert(UART_FRAME_RING_SIZE > UART_FRAME_MAX_SIZE, "ring must hold a full frame");
+
+// CRC-16/CCITT-FALSE (poly 0x1021), one nibble at a time to keep the table at 32 bytes
+static const uint16_t crc16_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+static inline uint16_t crc16_byte(uint16_t crc, uint8_t b)
+{
+    crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (b >> 4)];
+    crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (b & 0x0F)];
+    return crc;
+}
+
+uint16_t uart_frame_crc16(uint16_t crc, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc = crc16_byte(crc, data[i]);
+    }
+    return crc;
+}
+
+size_t uart_frame_encode(uint8_t *out, size_t out_size, uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    size_t total = (size_t)len + UART_FRAME_OVERHEAD;
+    if (len > UART_FRAME_MAX_PAYLOAD || out_size < total) {
+        return 0;
+    }
+
+    out[0] = UART_FRAME_SOF;
+    out[1] = UART_FRAME_VERSION;
+    out[2] = cmd;
+    uart_frame_put_u16(&out[3], len);
+    if (len > 0) {
+        memcpy(&out[UART_FRAME_HEADER_SIZE], payload, len);
+    }
+
+    uint16_t crc = uart_frame_crc16(0xFFFF, &out[1], UART_FRAME_HEADER_SIZE - 1 + len);
+    uart_frame_put_u16(&out[UART_FRAME_HEADER_SIZE + len], crc);
+    return total;
+}
+
+void uart_frame_parser_init(uart_frame_parser_t *p, uart_frame_handler_t handler, void *ctx)
+{
+    memset(p, 0, sizeof(*p));
+    p->handler = handler;
+    p->ctx = ctx;
+}
+
+void uart_frame_parser_reset(uart_frame_parser_t *p)
+{
+    p->head = 0;
+    p->tail = 0;
+}
+
+static inline uint8_t ring_at(const uart_frame_parser_t *p, uint16_t offset)
+{
+    return p->ring[(uint16_t)(p->tail + offset) & RING_MASK];
+}
+
+// Consume every complete frame currently buffered. Leaves at most one partial
+// frame (shorter than UART_FRAME_MAX_SIZE) in the ring.
+static void parse_ring(uart_frame_parser_t *p)
+{
+    for (;;) {
+        uint16_t avail = (uint16_t)(p->head - p->tail);
+        if (avail == 0) {
+            return;
+        }
+
+        if (ring_at(p, 0) != UART_FRAME_SOF) {
+            p->tail++;
+            p->stats.dropped_bytes++;
+            continue;
+        }
+
+        if (avail < UART_FRAME_HEADER_SIZE) {
+            return;
+        }
+
+        uint8_t ver = ring_at(p, 1);
+        uint16_t len = (uint16_t)ring_at(p, 3) | ((uint16_t)ring_at(p, 4) << 8);
+        if (ver != UART_FRAME_VERSION || len > UART_FRAME_MAX_PAYLOAD) {
+            p->tail++;
+            p->stats.bad_header++;
+            continue;
+        }
+
+        uint16_t total = UART_FRAME_OVERHEAD + len;
+        if (avail < total) {
+            return;
+        }
+
+        uint16_t crc = 0xFFFF;
+        for (uint16_t i = 1; i < UART_FRAME_HEADER_SIZE; i++) {
+            crc = crc16_byte(crc, ring_at(p, i));
+        }
+        for (uint16_t i = 0; i < len; i++) {
+            uint8_t b = ring_at(p, UART_FRAME_HEADER_SIZE + i);
+            p->frame[i] = b;
+            crc = crc16_byte(crc, b);
+        }
+        uint16_t rx_crc = (uint16_t)ring_at(p, UART_FRAME_HEADER_SIZE + len) |
+                          ((uint16_t)ring_at(p, UART_FRAME_HEADER_SIZE + len + 1) << 8);
+
+        if (crc != rx_crc) {
+            // False start (or corrupted frame) - rescan from the next byte
+            p->tail++;
+            p->stats.crc_errors++;
+            continue;
+        }
+
+        uint8_t cmd = ring_at(p, 2);
+        p->tail += total;
+        p->stats.frames_ok++;
+        if (p->handler) {
+            p->handler(p->ctx, cmd, p->frame, len);
+        }
+    }
+}
+
+void uart_frame_parser_feed(uart_frame_parser_t *p, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        uint16_t used = (uint16_t)(p->head - p->tail);
+        size_t space = UART_FRAME_RING_SIZE - used;
+        size_t n = (len < space) ? len : space;
+
+        for (size_t i = 0; i < n; i++) {
+            p->ring[(uint16_t)(p->head + i) & RING_MASK] = data[i];
+        }
+        p->head += (uint16_t)n;
+        data += n;
+        len -= n;
+
+        // parse_ring always leaves less than one max frame behind, so the
+        // next iteration is guaranteed to have room
+        parse_ring(p);
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Shared bits of the host benchmarks. Every suite takes its randomness from
+// one seeded generator, so a run is reproducible with --seed.
+
+typedef struct {
+    uint32_t seed;
+    bool quick;        // Smaller workloads, for a fast sanity run
+} bench_opts_t;
+
+typedef struct {
+    const char *name;
+    const char *help;
+    void (*run)(const bench_opts_t *opts);
+} bench_suite_t;
+
+extern const bench_suite_t bench_uart_frame;
+extern const bench_suite_t bench_status_json;
+extern const bench_suite_t bench_trigger_sim;
+
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift32; state must not be 0
+static inline uint32_t bench_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// Uniform in [0, 1)
+static inline double bench_rand_unit(uint32_t *state)
+{
+    return (bench_rand(state) >> 8) * (1.0 / 16777216.0);
+}
+
+// Uniform in [lo, hi]
+static inline uint32_t bench_rand_range(uint32_t *state, uint32_t lo, uint32_t hi)
+{
+    return lo + bench_rand(state) % (hi - lo + 1);
+}
+
+// Keeps the optimizer from discarding a result
+static inline void bench_keep(const void *p)
+{
+    __asm__ volatile("" : : "r"(p) : "memory");
+}
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+
+// zigbeeween_bench [--seed N] [--quick] [suite ...]
+// With no suite names every suite runs, in the order below.
+
+static const bench_suite_t *const suites[] = {
+    &bench_uart_frame,
+    &bench_status_json,
+    &bench_trigger_sim,
+};
+#define SUITE_COUNT (sizeof(suites) / sizeof(suites[0]))
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [--seed N] [--quick] [suite ...]\n\nsuites:\n", argv0);
+    for (size_t i = 0; i < SUITE_COUNT; i++) {
+        fprintf(stderr, "  %-10s %s\n", suites[i]->name, suites[i]->help);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bench_opts_t opts = { .seed = 0x5eed1031u };
+    bool selected[SUITE_COUNT] = { false };
+    bool any = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            opts.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+            if (opts.seed == 0) {
+                opts.seed = 1;  // xorshift's one bad state
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--quick") == 0) {
+            opts.quick = true;
+            continue;
+        }
+        size_t s = 0;
+        while (s < SUITE_COUNT && strcmp(argv[i], suites[s]->name) != 0) {
+            s++;
+        }
+        if (s == SUITE_COUNT) {
+            usage(argv[0]);
+            return 2;
+        }
+        selected[s] = true;
+        any = true;
+    }
+
+    printf("zigbeeween host benchmarks (seed 0x%08x%s)\n", (unsigned)opts.seed, opts.quick ? ", quick" : "");
+    for (size_t s = 0; s < SUITE_COUNT; s++) {
+        if (!any || selected[s]) {
+            printf("\n== %s: %s\n", suites[s]->name, suites[s]->help);
+            suites[s]->run(&opts);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "uart_frame.h"
+#include "uart_proto.h"
+#include "prop_status.h"
+
+// /api/status device list by device count: decoding a CMD_DEVICE_STATUS
+// snapshot into the table, then serializing the table through the same
+// 1436-byte (one MSS) buffer the handler uses, flushed into a sink that only
+// counts what httpd would have sent.
+
+#define SEND_BUF_SIZE 1436
+
+typedef struct {
+    size_t bytes;
+    size_t chunks;
+} sink_t;
+
+static esp_err_t sink_flush(void *ctx, const char *data, size_t len)
+{
+    sink_t *s = ctx;
+    bench_keep(data);
+    s->bytes += len;
+    s->chunks++;
+    return ESP_OK;
+}
+
+// The chunks send_device_status_snapshot() would send for count random props
+static size_t build_snapshot(uint8_t chunks[][DEVICE_STATUS_HEADER_SIZE + DEVICE_STATUS_MAX_PER_FRAME * DEVICE_STATUS_RECORD_SIZE],
+                             uint16_t *lens, size_t count, uint32_t *rng)
+{
+    size_t n_chunks = 0;
+    size_t first = 0;
+
+    do {
+        size_t n = count - first < DEVICE_STATUS_MAX_PER_FRAME ? count - first : DEVICE_STATUS_MAX_PER_FRAME;
+        uint8_t *p = chunks[n_chunks];
+        p[0] = 7;
+        p[1] = (uint8_t)count;
+        p[2] = (uint8_t)first;
+        uint8_t *rec = &p[DEVICE_STATUS_HEADER_SIZE];
+        for (size_t i = first; i < first + n; i++, rec += DEVICE_STATUS_RECORD_SIZE) {
+            bool cooldown = bench_rand(rng) % 4 == 0;
+            rec[0] = (uint8_t)(i + 1);
+            rec[1] = DEVICE_STATE_BOUND | (bench_rand(rng) % 2 ? DEVICE_STATE_TIME_SYNCED : 0) |
+                     (cooldown ? DEVICE_STATE_COOLDOWN : 0);
+            rec[2] = (uint8_t)bench_rand_range(rng, 40, 255);
+            rec[3] = (uint8_t)(int8_t)-(int)bench_rand_range(rng, 30, 95);
+            uart_frame_put_u16(&rec[4], cooldown ? (uint16_t)bench_rand_range(rng, 1, 120) : 0);
+            uart_frame_put_u16(&rec[6], bench_rand(rng) % 8 == 0 ? DEVICE_STATUS_AGE_NEVER
+                                                                 : (uint16_t)bench_rand_range(rng, 0, 600));
+        }
+        lens[n_chunks++] = (uint16_t)(DEVICE_STATUS_HEADER_SIZE + n * DEVICE_STATUS_RECORD_SIZE);
+        first += n;
+    } while (first < count);
+    return n_chunks;
+}
+
+static void run(const bench_opts_t *opts)
+{
+    static const size_t counts[] = { 1, 2, 4, 8, 16, 32, 48, 64 };
+    static uint8_t chunks[DEVICE_STATUS_MAX_DEVICES / DEVICE_STATUS_MAX_PER_FRAME + 1]
+                         [DEVICE_STATUS_HEADER_SIZE + DEVICE_STATUS_MAX_PER_FRAME * DEVICE_STATUS_RECORD_SIZE];
+    static prop_status_t table[DEVICE_STATUS_MAX_DEVICES];
+    uint16_t lens[sizeof(chunks) / sizeof(chunks[0])];
+    const uint64_t budget_ns = opts->quick ? 5000000 : 50000000;
+    uint32_t rng = opts->seed;
+
+    printf("  %-8s %7s %12s %12s %10s %8s %7s\n", "devices", "frames", "decode ns", "json ns",
+           "ns/device", "bytes", "chunks");
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        size_t count = counts[c];
+        size_t n_chunks = build_snapshot(chunks, lens, count, &rng);
+
+        memset(table, 0, sizeof(table));
+        strcpy(table[DEVICE_ID_RIP - 1].name, "RIP Tombstone");
+        strcpy(table[DEVICE_ID_HALLOWEEN - 1].name, "Haunted Pumpkin Scarecrow");
+
+        // Decode the whole snapshot, as handle_uart_frame() does chunk by chunk
+        uint64_t iters = 0;
+        uint64_t t0 = bench_now_ns(), elapsed;
+        do {
+            for (size_t i = 0; i < n_chunks; i++) {
+                prop_status_chunk_t chunk;
+                prop_status_decode(table, chunks[i], lens[i], &chunk);
+            }
+            bench_keep(table);
+            iters++;
+        } while ((elapsed = bench_now_ns() - t0) < budget_ns);
+        double decode_ns = (double)elapsed / iters;
+
+        static char send_buf[SEND_BUF_SIZE];
+        sink_t sink = { 0 };
+        iters = 0;
+        t0 = bench_now_ns();
+        do {
+            json_writer_t w;
+            sink = (sink_t){ 0 };
+            json_writer_init(&w, send_buf, sizeof(send_buf), sink_flush, &sink);
+            json_obj_open(&w, NULL);
+            prop_status_json(&w, "devices", table, count);
+            json_obj_close(&w);
+            json_writer_finish(&w);
+            iters++;
+        } while ((elapsed = bench_now_ns() - t0) < budget_ns);
+        double json_ns = (double)elapsed / iters;
+
+        printf("  %-8zu %7zu %12.0f %12.0f %10.1f %8zu %7zu\n", count, n_chunks, decode_ns, json_ns,
+               json_ns / count, sink.bytes, sink.chunks);
+    }
+}
+
+const bench_suite_t bench_status_json = {
+    .name = "json",
+    .help = "status snapshot decode and /api/status device JSON per device count",
+    .run = run,
+};
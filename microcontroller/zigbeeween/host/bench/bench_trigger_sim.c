@@ -0,0 +1,582 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "uart_frame.h"
+#include "uart_proto.h"
+#include "device_registry.h"
+#include "trigger_filter.h"
+#include "motion_counter.h"
+#include "latency_hist.h"
+
+// Trigger dispatch in a simulated installation: a night of visitors walking
+// past the TinyS3's PIR and the tombstone's, with N props on the Zigbee
+// network. Time is virtual (an event queue in microseconds); the firmware
+// code on the path runs for real: frames are encoded and parsed by
+// uart_frame, the tombstone counts motions with motion_counter, and the
+// coordinator admits every trigger through trigger_filter. The group
+// decision mirrors trigger_group_locked() in the coordinator.
+//
+// What the radio costs is a model, not a measurement: a unicast holds the
+// radio for 2-5 ms and reaches the prop after an air time with
+// per-attempt loss and APS retries; a sleepy prop only gets it at its next
+// data poll; a groupcast reaches every rx-on prop at once, with broadcast
+// jitter and no retries. Latency is PIR edge to prop actuation.
+//
+// Each network runs behind both gateways. Two-chip is the TinyS3 and the
+// coordinator over the UART. Single-chip (xiaoc6_wifi_zigbee) hands the
+// trigger to the coordinator's task through gateway_link with no framing,
+// but shares the radio with WiFi: a transmission may wait out a WiFi frame,
+// and a prop's frame sent while WiFi holds the radio (802.15.4 idle
+// listening is the low coexistence priority) takes a MAC retry.
+
+#define SIM_HOURS              6
+#define VISITOR_GAP_MEAN_S     20.0
+#define GATEWAY_PIR_SEES       0.9     // Chance the TinyS3's PIR sees a visitor
+#define TOMBSTONE_PIR_SEES     0.6
+#define TINYS3_PIR_TO_UART_US  200     // ISR, pir_trigger_task, uart_send_frame
+#define UART_US_PER_BYTE       87      // 115200 baud, 10 bits a byte
+#define COORD_WAKE_US          100     // UART event to the handler running
+#define LINK_HOP_US            150     // ISR, pir_trigger_task, gateway_link to the coordinator's task
+
+#define COEX_WIFI_DUTY         0.10    // Radio time WiFi holds on the single-chip gateway
+#define COEX_TX_WAIT_MAX_US    2500    // A WiFi frame in flight when 802.15.4 asks for the radio
+#define MAC_RETRY_US           2500    // A prop's MAC resend of an unacked frame
+#define MAC_MAX_ATTEMPTS       4
+
+#define RADIO_TX_MIN_US        2000    // CSMA backoff plus the frame on air
+#define RADIO_TX_MAX_US        5000
+#define AIR_MIN_US             3000    // To the prop, per attempt (one or two hops)
+#define AIR_MAX_US             9000
+#define APS_RETRY_US           40000   // Ack timeout before the next attempt
+#define APS_MAX_ATTEMPTS       4
+#define BCAST_MIN_US           8000    // Broadcast relay jitter
+#define BCAST_MAX_US           25000
+
+#define POLL_SLOW_US           1000000 // ZED_KEEP_ALIVE_MS
+#define POLL_FAST_US           250000  // ZED_FAST_POLL_MS
+#define FAST_POLL_WINDOW_US    10000000
+#define TOMBSTONE_COOLDOWN_US  10000000 // MOTION_COOLDOWN_US
+#define RELAY_ACTUATE_US       1000
+#define LIGHTS_ACTUATE_US      12000   // Render plus the first RMT refresh
+
+#define GROUP_ALL     0  // As zb_groups[] in the coordinator
+#define GROUP_RELAY   1
+#define GROUP_LIGHTS  2
+
+static const uint8_t group_caps[] = { DEVICE_CAP_RELAY | DEVICE_CAP_LIGHTS, DEVICE_CAP_RELAY, DEVICE_CAP_LIGHTS };
+
+typedef enum {
+    EV_VISITOR,
+    EV_GATEWAY_EDGE,
+    EV_UART_RX,
+    EV_TOMBSTONE_EDGE,
+    EV_ZB_REQUEST,      // Trigger request from the tombstone reaches the coordinator
+    EV_RADIO_DONE,
+    EV_ACTUATE,
+} ev_type_t;
+
+typedef enum {
+    SOURCE_GATEWAY,
+    SOURCE_PROP,
+    SOURCE_COUNT,
+} source_t;
+
+typedef struct {
+    int64_t at_us;
+    uint32_t order;     // FIFO among events at the same time
+    uint8_t type;
+    uint8_t source;
+    uint16_t dev;       // Prop index
+    int64_t origin_us;
+} event_t;
+
+typedef struct {
+    bool groupcast;     // false: a single unicast to dev
+    uint8_t source;
+    uint8_t group;
+    uint16_t dev;
+    int64_t origin_us;
+} radio_item_t;
+
+typedef struct {
+    double fail_p;      // Per-attempt loss
+    int64_t fast_poll_until_us;
+} link_t;
+
+typedef struct {
+    // Network
+    size_t n_props;
+    zigbee_device_t *props;
+    link_t *links;
+    bool use_groups;
+    bool single_chip;
+
+    // Coordinator
+    trigger_filter_t filter;
+    uart_frame_parser_t parser;
+    radio_item_t *radio_q;
+    size_t radio_head, radio_tail, radio_cap;
+    bool radio_busy;
+    int64_t now_us;
+
+    // TinyS3 trigger sequences -> PIR edge time
+    int64_t seq_origin[65536];
+    uint16_t next_seq;
+
+    // Tombstone
+    motion_counter_t motion;
+    int64_t tombstone_cooldown_until_us;
+
+    // Event queue (binary min-heap)
+    event_t *heap;
+    size_t heap_len, heap_cap;
+    uint32_t order;
+
+    uint32_t visitor_rng;   // Same visitors for every network,
+    uint32_t rng;           // and the same radio draws on both gateways;
+    uint32_t coex_rng;      // only the single chip draws WiFi's radio time
+
+    // Results
+    latency_hist_t latency[SOURCE_COUNT];
+    uint32_t requests;      // Trigger events reaching the coordinator
+    uint32_t lost;          // Frames that never reached the prop
+    uint32_t groupcasts;
+    uint32_t unicasts;
+    uint32_t rainbows;
+    uint64_t coord_ns;      // Host time in the coordinator's trigger path
+    uint64_t events;
+} sim_t;
+
+static bool ev_before(const event_t *a, const event_t *b)
+{
+    return a->at_us < b->at_us || (a->at_us == b->at_us && a->order < b->order);
+}
+
+static void ev_push(sim_t *s, event_t e)
+{
+    if (s->heap_len == s->heap_cap) {
+        s->heap_cap = s->heap_cap ? s->heap_cap * 2 : 256;
+        s->heap = realloc(s->heap, s->heap_cap * sizeof(event_t));
+    }
+    e.order = s->order++;
+    size_t i = s->heap_len++;
+    while (i > 0 && ev_before(&e, &s->heap[(i - 1) / 2])) {
+        s->heap[i] = s->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    s->heap[i] = e;
+}
+
+static event_t ev_pop(sim_t *s)
+{
+    event_t top = s->heap[0];
+    event_t last = s->heap[--s->heap_len];
+    size_t i = 0;
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= s->heap_len) {
+            break;
+        }
+        if (c + 1 < s->heap_len && ev_before(&s->heap[c + 1], &s->heap[c])) {
+            c++;
+        }
+        if (!ev_before(&s->heap[c], &last)) {
+            break;
+        }
+        s->heap[i] = s->heap[c];
+        i = c;
+    }
+    s->heap[i] = last;
+    return top;
+}
+
+static void schedule(sim_t *s, int64_t at_us, ev_type_t type, source_t source, size_t dev, int64_t origin_us)
+{
+    ev_push(s, (event_t){ .at_us = at_us, .type = type, .source = source, .dev = (uint16_t)dev, .origin_us = origin_us });
+}
+
+static int64_t rand_us(sim_t *s, uint32_t lo, uint32_t hi)
+{
+    return bench_rand_range(&s->rng, lo, hi);
+}
+
+// Single-chip: time the coordinator's transmission waits for WiFi to let go
+static int64_t coex_tx_wait(sim_t *s)
+{
+    if (!s->single_chip || bench_rand_unit(&s->coex_rng) >= COEX_WIFI_DUTY) {
+        return 0;
+    }
+    return bench_rand_range(&s->coex_rng, 0, COEX_TX_WAIT_MAX_US);
+}
+
+// ---------------------------------------------------------------------------
+// Radio
+
+static void radio_next(sim_t *s);
+
+static void radio_queue(sim_t *s, radio_item_t item)
+{
+    if (s->radio_tail - s->radio_head == s->radio_cap) {
+        // Grow, keeping the FIFO order
+        size_t cap = s->radio_cap ? s->radio_cap * 2 : 64;
+        radio_item_t *q = malloc(cap * sizeof(radio_item_t));
+        for (size_t i = s->radio_head; i < s->radio_tail; i++) {
+            q[i - s->radio_head] = s->radio_q[i % s->radio_cap];
+        }
+        free(s->radio_q);
+        s->radio_q = q;
+        s->radio_tail -= s->radio_head;
+        s->radio_head = 0;
+        s->radio_cap = cap;
+    }
+    s->radio_q[s->radio_tail++ % s->radio_cap] = item;
+    if (!s->radio_busy) {
+        radio_next(s);
+    }
+}
+
+static void radio_next(sim_t *s)
+{
+    if (s->radio_head == s->radio_tail) {
+        s->radio_busy = false;
+        return;
+    }
+    s->radio_busy = true;
+    schedule(s, s->now_us + coex_tx_wait(s) + rand_us(s, RADIO_TX_MIN_US, RADIO_TX_MAX_US), EV_RADIO_DONE, 0, 0, 0);
+}
+
+static int64_t next_poll(sim_t *s, size_t dev, int64_t at_us)
+{
+    uint32_t period = at_us < s->links[dev].fast_poll_until_us ? POLL_FAST_US : POLL_SLOW_US;
+    return at_us + rand_us(s, 0, period);
+}
+
+static uint32_t actuate_us(const zigbee_device_t *dev)
+{
+    return (dev->caps & DEVICE_CAP_RELAY) ? RELAY_ACTUATE_US : LIGHTS_ACTUATE_US;
+}
+
+// A unicast has left the coordinator: walk its APS attempts
+static void deliver_unicast(sim_t *s, const radio_item_t *item)
+{
+    const zigbee_device_t *dev = &s->props[item->dev];
+    int64_t t = s->now_us;
+
+    for (int attempt = 0; attempt < APS_MAX_ATTEMPTS; attempt++) {
+        if (dev->sleepy) {
+            t = next_poll(s, item->dev, t);  // Held in the indirect queue until the prop polls
+        }
+        t += rand_us(s, AIR_MIN_US, AIR_MAX_US);
+        if (bench_rand_unit(&s->rng) >= s->links[item->dev].fail_p) {
+            schedule(s, t + actuate_us(dev), EV_ACTUATE, item->source, item->dev, item->origin_us);
+            return;
+        }
+        t += APS_RETRY_US + coex_tx_wait(s);
+    }
+    s->lost++;
+}
+
+static void deliver_groupcast(sim_t *s, const radio_item_t *item)
+{
+    for (size_t i = 0; i < s->n_props; i++) {
+        const zigbee_device_t *dev = &s->props[i];
+        if (!dev->is_bound || dev->sleepy || !(dev->caps & group_caps[item->group])) {
+            continue;
+        }
+        // No acks and no retries for a broadcast
+        if (bench_rand_unit(&s->rng) < s->links[i].fail_p / 2) {
+            s->lost++;
+            continue;
+        }
+        schedule(s, s->now_us + rand_us(s, BCAST_MIN_US, BCAST_MAX_US) + actuate_us(dev), EV_ACTUATE,
+                 item->source, i, item->origin_us);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Coordinator
+
+// As trigger_group_locked(): one groupcast when every member that would hear
+// it is admitted and every admitted member hears it, else unicasts
+static void coord_trigger_group(sim_t *s, uint8_t group, source_t source, int64_t origin_us)
+{
+    static uint16_t admitted[DEVICE_REGISTRY_MAX_DEVICES];
+    size_t n_admitted = 0;
+    bool groupcast_ok = s->use_groups;
+
+    for (size_t i = 0; i < s->n_props; i++) {
+        zigbee_device_t *dev = &s->props[i];
+        if (!dev->is_bound || !(dev->caps & group_caps[group])) {
+            continue;
+        }
+        bool hears = (dev->groups & (1 << group)) && !dev->sleepy;
+        if (trigger_filter_admit(&s->filter, dev, s->now_us) == TRIGGER_ADMITTED) {
+            admitted[n_admitted++] = (uint16_t)i;
+            groupcast_ok &= hears;
+        } else if (hears) {
+            groupcast_ok = false;
+        }
+    }
+    if (n_admitted == 0) {
+        return;
+    }
+
+    if (groupcast_ok) {
+        s->groupcasts++;
+        radio_queue(s, (radio_item_t){ .groupcast = true, .source = source, .group = group, .origin_us = origin_us });
+        return;
+    }
+    for (size_t i = 0; i < n_admitted; i++) {
+        s->unicasts++;
+        radio_queue(s, (radio_item_t){ .source = source, .dev = admitted[i], .origin_us = origin_us });
+    }
+}
+
+static void coord_trigger(sim_t *s, uint8_t kind, uint8_t group, source_t source, int64_t origin_us)
+{
+    s->requests++;
+    if (!trigger_filter_is_duplicate(&s->filter, kind, group, s->now_us)) {
+        coord_trigger_group(s, group, source, origin_us);
+    }
+}
+
+// Built-in rules: TinyS3 motion fires all props
+static void coord_uart_frame(void *ctx, uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    sim_t *s = ctx;
+    if (cmd == CMD_GATEWAY_MOTION && len >= 2) {
+        uint16_t seq = uart_frame_get_u16(payload);
+        coord_trigger(s, TRIGGER_TARGET_GROUP, GROUP_ALL, SOURCE_GATEWAY, s->seq_origin[seq]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Events
+
+static void on_visitor(sim_t *s)
+{
+    uint32_t *rng = &s->visitor_rng;
+    double gap_s = -log(1.0 - bench_rand_unit(rng)) * VISITOR_GAP_MEAN_S;
+    schedule(s, s->now_us + (int64_t)(gap_s * 1e6), EV_VISITOR, 0, 0, 0);
+
+    if (bench_rand_unit(rng) < GATEWAY_PIR_SEES) {
+        schedule(s, s->now_us + bench_rand_range(rng, 0, 2000000), EV_GATEWAY_EDGE, SOURCE_GATEWAY, 0, 0);
+    }
+    if (bench_rand_unit(rng) < TOMBSTONE_PIR_SEES) {
+        // A visitor who lingers sets the PIR off a few times
+        int64_t t = s->now_us + bench_rand_range(rng, 500000, 4000000);
+        int edges = (int)bench_rand_range(rng, 1, 4);
+        for (int i = 0; i < edges; i++) {
+            schedule(s, t, EV_TOMBSTONE_EDGE, SOURCE_PROP, 0, 0);
+            t += bench_rand_range(rng, 2000000, 15000000);
+        }
+    }
+}
+
+static void on_gateway_edge(sim_t *s)
+{
+    uint16_t seq = ++s->next_seq ? s->next_seq : ++s->next_seq;  // 0 means untraced
+
+    // CMD_GATEWAY_MOTION with the u16 sequence crosses the UART, or the link
+    s->seq_origin[seq] = s->now_us;
+    int64_t hop_us = s->single_chip ? LINK_HOP_US
+                                    : TINYS3_PIR_TO_UART_US + (UART_FRAME_OVERHEAD + 2) * UART_US_PER_BYTE + COORD_WAKE_US;
+    schedule(s, s->now_us + hop_us, EV_UART_RX, SOURCE_GATEWAY, seq, s->now_us);
+}
+
+// The frame the TinyS3 sent, fed to the coordinator's parser in one read;
+// single-chip, the payload goes to the handler as gateway_link_run() does
+static void on_uart_rx(sim_t *s, const event_t *e)
+{
+    uint8_t payload[2];
+    uint8_t frame[UART_FRAME_OVERHEAD + sizeof(payload)];
+    uart_frame_put_u16(payload, e->dev);  // dev carries the sequence
+
+    if (s->single_chip) {
+        uint64_t t0 = bench_now_ns();
+        coord_uart_frame(s, CMD_GATEWAY_MOTION, payload, sizeof(payload));
+        s->coord_ns += bench_now_ns() - t0;
+        return;
+    }
+    size_t n = uart_frame_encode(frame, sizeof(frame), CMD_GATEWAY_MOTION, payload, sizeof(payload));
+
+    uint64_t t0 = bench_now_ns();
+    uart_frame_parser_feed(&s->parser, frame, n);
+    s->coord_ns += bench_now_ns() - t0;
+}
+
+static void on_tombstone_edge(sim_t *s)
+{
+    if (s->now_us < s->tombstone_cooldown_until_us) {
+        return;  // motion_detection_task ignores motion while triggered_recently
+    }
+    s->tombstone_cooldown_until_us = s->now_us + TOMBSTONE_COOLDOWN_US;
+    if (motion_counter_feed(&s->motion, s->now_us)) {
+        s->rainbows++;
+    }
+
+    // The scarecrow request goes straight up; the tombstone polls fast for a while
+    s->links[0].fast_poll_until_us = s->now_us + FAST_POLL_WINDOW_US;
+    int64_t t = s->now_us + rand_us(s, RADIO_TX_MIN_US, RADIO_TX_MAX_US) + rand_us(s, AIR_MIN_US, AIR_MAX_US);
+    if (s->single_chip) {
+        int attempt = 0;
+        while (bench_rand_unit(&s->coex_rng) < COEX_WIFI_DUTY) {
+            if (++attempt == MAC_MAX_ATTEMPTS) {
+                s->lost++;
+                return;
+            }
+            t += MAC_RETRY_US;
+        }
+    }
+    schedule(s, t, EV_ZB_REQUEST, SOURCE_PROP, 0, s->now_us);
+}
+
+// Prop request with a relay hint: the built-in rule fires the relay props
+static void on_zb_request(sim_t *s, const event_t *e)
+{
+    uint64_t t0 = bench_now_ns();
+    coord_trigger(s, TRIGGER_TARGET_CAPS, GROUP_RELAY, SOURCE_PROP, e->origin_us);
+    s->coord_ns += bench_now_ns() - t0;
+}
+
+static void on_radio_done(sim_t *s)
+{
+    radio_item_t item = s->radio_q[s->radio_head++ % s->radio_cap];
+    if (item.groupcast) {
+        deliver_groupcast(s, &item);
+    } else {
+        deliver_unicast(s, &item);
+    }
+    radio_next(s);
+}
+
+static void on_actuate(sim_t *s, const event_t *e)
+{
+    int64_t us = s->now_us - e->origin_us;
+    latency_hist_add(&s->latency[e->source], us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+    if (s->props[e->dev].sleepy) {
+        s->links[e->dev].fast_poll_until_us = s->now_us + FAST_POLL_WINDOW_US;
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+// Prop 0 is the tombstone (sleepy lights with the PIR), prop 1 the scarecrow
+// (relay, rx on); further props alternate. Every eighth prop is offline,
+// so group triggers skip it.
+static void sim_init(sim_t *s, size_t n_props, bool use_groups, bool single_chip, uint32_t seed)
+{
+    memset(s, 0, sizeof(*s));
+    s->n_props = n_props;
+    s->use_groups = use_groups;
+    s->single_chip = single_chip;
+    s->visitor_rng = seed;
+    s->rng = seed ^ 0x9e3779b9u;
+    s->coex_rng = seed ^ 0x85ebca6bu;
+    s->props = calloc(n_props, sizeof(zigbee_device_t));
+    s->links = calloc(n_props, sizeof(link_t));
+    trigger_filter_init(&s->filter);
+    uart_frame_parser_init(&s->parser, coord_uart_frame, s);
+    motion_counter_init(&s->motion);
+
+    for (size_t i = 0; i < n_props; i++) {
+        zigbee_device_t *dev = &s->props[i];
+        bool relay = i % 2 == 1;
+        dev->id = (uint8_t)(i + 1);
+        dev->short_addr = (uint16_t)(0x1000 + i);
+        dev->is_bound = i % 8 != 7;
+        dev->caps = relay ? DEVICE_CAP_RELAY : DEVICE_CAP_LIGHTS | DEVICE_CAP_TIME_SYNC;
+        dev->sleepy = !relay;
+        for (size_t g = 0; g < sizeof(group_caps); g++) {
+            if (dev->caps & group_caps[g]) {
+                dev->groups |= 1 << g;
+            }
+        }
+        snprintf(dev->name, sizeof(dev->name), "Prop %u", (unsigned)(i + 1));
+        s->links[i].fail_p = 0.01 + 0.14 * bench_rand_unit(&s->rng);
+    }
+    s->props[0].caps |= DEVICE_CAP_MOTION;
+}
+
+static void sim_free(sim_t *s)
+{
+    free(s->props);
+    free(s->links);
+    free(s->radio_q);
+    free(s->heap);
+}
+
+static void sim_run(sim_t *s, int64_t duration_us)
+{
+    schedule(s, 0, EV_VISITOR, 0, 0, 0);
+    while (s->heap_len > 0) {
+        event_t e = ev_pop(s);
+        if (e.at_us > duration_us) {
+            break;
+        }
+        s->now_us = e.at_us;
+        s->events++;
+        switch (e.type) {
+            case EV_VISITOR:        on_visitor(s); break;
+            case EV_GATEWAY_EDGE:   on_gateway_edge(s); break;
+            case EV_UART_RX:        on_uart_rx(s, &e); break;
+            case EV_TOMBSTONE_EDGE: on_tombstone_edge(s); break;
+            case EV_ZB_REQUEST:     on_zb_request(s, &e); break;
+            case EV_RADIO_DONE:     on_radio_done(s); break;
+            case EV_ACTUATE:        on_actuate(s, &e); break;
+        }
+    }
+}
+
+static void run(const bench_opts_t *opts)
+{
+    static const size_t prop_counts[] = { 2, 4, 8, 16, 32, 48 };
+    static const char *const source_names[SOURCE_COUNT] = { "tinys3 pir", "prop req" };
+    int64_t duration_us = (opts->quick ? 1 : SIM_HOURS) * 3600LL * 1000000;
+    sim_t *s = malloc(sizeof(*s));
+
+    printf("  %d h of visitors every %.0f s on average; latency is PIR edge to actuation (ms)\n",
+           opts->quick ? 1 : SIM_HOURS, VISITOR_GAP_MEAN_S);
+    printf("  PIR edge to the coordinator's handler: 2-chip %d us over the UART, 1-chip %d us over gateway_link\n",
+           TINYS3_PIR_TO_UART_US + (UART_FRAME_OVERHEAD + 2) * UART_US_PER_BYTE + COORD_WAKE_US, LINK_HOP_US);
+    printf("  %-5s %-7s %-9s %-10s %6s %6s %6s %5s %5s %7s %7s %7s %7s %8s\n", "props", "gateway", "mode",
+           "source", "reqs", "admit", "cool", "dup", "lost", "p50", "p95", "p99", "max", "host ns");
+    for (size_t c = 0; c < sizeof(prop_counts) / sizeof(prop_counts[0]); c++) {
+        for (int run = 0; run < 4; run++) {
+            bool single = run / 2, groups = run % 2;
+            sim_init(s, prop_counts[c], groups, single, opts->seed);
+            sim_run(s, duration_us);
+
+            const trigger_filter_stats_t *st = &s->filter.stats;
+            for (int src = 0; src < SOURCE_COUNT; src++) {
+                latency_summary_t sum;
+                latency_hist_summarize(&s->latency[src], &sum);
+                if (src == 0) {
+                    printf("  %-5zu %-7s %-9s %-10s %6u %6u %6u %5u %5u", prop_counts[c],
+                           single ? "1-chip" : "2-chip", groups ? "groupcast" : "unicast", source_names[src],
+                           (unsigned)s->requests, (unsigned)st->accepted, (unsigned)st->dropped_cooldown,
+                           (unsigned)st->dropped_duplicate, (unsigned)s->lost);
+                } else {
+                    printf("  %-5s %-7s %-9s %-10s %6s %6s %6s %5s %5s", "", "", "", source_names[src],
+                           "", "", "", "", "");
+                }
+                printf(" %7.1f %7.1f %7.1f %7.1f", sum.p50_us / 1e3, sum.p95_us / 1e3, sum.p99_us / 1e3,
+                       sum.max_us / 1e3);
+                if (src == 0) {
+                    printf(" %8.0f", s->requests ? (double)s->coord_ns / s->requests : 0.0);
+                }
+                printf("\n");
+            }
+            sim_free(s);
+        }
+    }
+    free(s);
+}
+
+const bench_suite_t bench_trigger_sim = {
+    .name = "trigger",
+    .help = "trigger dispatch latency in a simulated multi-prop network",
+    .run = run,
+};
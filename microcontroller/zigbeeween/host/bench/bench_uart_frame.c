@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "uart_frame.h"
+#include "uart_proto.h"
+
+// UART frame parser: clean-stream throughput by read size, then recovery
+// from random corruption (bit flips, dropped and inserted bytes, as a noisy
+// or overrun UART produces). Every payload starts with its frame index and
+// the rest is derived from it, so the handler can tell a real frame from one
+// that passed the CRC by accident.
+
+#define FEED_CHUNK_DEFAULT 120  // The ESP-IDF UART driver's RX FIFO full threshold
+
+typedef struct {
+    uint8_t *bytes;
+    size_t len;
+    size_t cap;
+    size_t frames;
+    size_t *frame_start;   // Offset of each frame in bytes
+} stream_t;
+
+typedef struct {
+    size_t frames;
+    uint8_t *delivered;    // Per frame index
+    uint32_t false_accepts;
+    bool adversarial;
+} verify_t;
+
+// Payload sizes of the traffic the coordinator actually sends: trigger acks
+// and heartbeats, traces, 16-record status chunks, radio telemetry, metrics
+static const uint16_t payload_sizes[] = { 4, 4, 16, 139, 244, 240 };
+static const uint8_t payload_cmds[] = {
+    CMD_HEARTBEAT, CMD_TRIGGER_ACK, CMD_TRIGGER_TRACE, CMD_DEVICE_STATUS, CMD_RADIO_TELEMETRY, CMD_METRICS,
+};
+#define PAYLOAD_KINDS (sizeof(payload_sizes) / sizeof(payload_sizes[0]))
+
+// Deterministic payload for frame index; adversarial payloads are full of
+// plausible headers (start byte, version, 511-byte length), the parser's
+// most expensive false starts
+static uint16_t make_payload(size_t index, bool adversarial, uint8_t *out, uint8_t *cmd)
+{
+    uint32_t s = (uint32_t)index * 2654435761u + 1;
+    size_t kind = bench_rand(&s) % PAYLOAD_KINDS;
+    uint16_t len = payload_sizes[kind];
+
+    *cmd = payload_cmds[kind];
+    uart_frame_put_u32(out, (uint32_t)index);
+    for (uint16_t i = 4; i < len; i++) {
+        if (adversarial) {
+            static const uint8_t pattern[] = { UART_FRAME_SOF, UART_FRAME_VERSION, 0x00, 0xFF, 0x01 };
+            out[i] = pattern[i % sizeof(pattern)];
+        } else {
+            out[i] = (uint8_t)bench_rand(&s);
+        }
+    }
+    return len;
+}
+
+static void stream_push(stream_t *st, uint8_t b)
+{
+    if (st->len == st->cap) {
+        st->cap = st->cap ? st->cap * 2 : 65536;
+        st->bytes = realloc(st->bytes, st->cap);
+    }
+    st->bytes[st->len++] = b;
+}
+
+static void stream_build(stream_t *st, size_t frames, bool adversarial)
+{
+    uint8_t payload[UART_FRAME_MAX_PAYLOAD];
+    uint8_t frame[UART_FRAME_MAX_SIZE];
+
+    memset(st, 0, sizeof(*st));
+    st->frames = frames;
+    st->frame_start = calloc(frames, sizeof(size_t));
+    for (size_t i = 0; i < frames; i++) {
+        uint8_t cmd;
+        uint16_t len = make_payload(i, adversarial, payload, &cmd);
+        size_t n = uart_frame_encode(frame, sizeof(frame), cmd, payload, len);
+        st->frame_start[i] = st->len;
+        for (size_t j = 0; j < n; j++) {
+            stream_push(st, frame[j]);
+        }
+    }
+}
+
+static void stream_free(stream_t *st)
+{
+    free(st->bytes);
+    free(st->frame_start);
+}
+
+// Copy src into dst with each byte hit at rate: 70% a bit flip, 15% dropped,
+// 15% a random byte inserted before it. corrupted[i] marks the frames hit.
+static size_t stream_corrupt(const stream_t *src, stream_t *dst, double rate, uint32_t *rng, uint8_t *corrupted)
+{
+    size_t hits = 0;
+    size_t frame = 0;
+
+    memset(dst, 0, sizeof(*dst));
+    memset(corrupted, 0, src->frames);
+    for (size_t i = 0; i < src->len; i++) {
+        while (frame + 1 < src->frames && src->frame_start[frame + 1] <= i) {
+            frame++;
+        }
+        uint8_t b = src->bytes[i];
+        if (bench_rand_unit(rng) >= rate) {
+            stream_push(dst, b);
+            continue;
+        }
+        hits++;
+        corrupted[frame] = 1;
+        double kind = bench_rand_unit(rng);
+        if (kind < 0.70) {
+            stream_push(dst, b ^ (uint8_t)(1u << (bench_rand(rng) & 7)));
+        } else if (kind < 0.85) {
+            // Dropped
+        } else {
+            stream_push(dst, (uint8_t)bench_rand(rng));
+            stream_push(dst, b);
+        }
+    }
+    return hits;
+}
+
+static void verify_handler(void *ctx, uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    verify_t *v = ctx;
+    uint8_t expect[UART_FRAME_MAX_PAYLOAD];
+    uint8_t expect_cmd;
+
+    if (len < 4) {
+        v->false_accepts++;
+        return;
+    }
+    uint32_t index = uart_frame_get_u32(payload);
+    if (index >= v->frames ||
+        make_payload(index, v->adversarial, expect, &expect_cmd) != len ||
+        expect_cmd != cmd || memcmp(expect, payload, len) != 0) {
+        v->false_accepts++;
+        return;
+    }
+    v->delivered[index] = 1;
+}
+
+static void count_handler(void *ctx, uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    (*(size_t *)ctx)++;
+}
+
+static uint64_t feed_all(uart_frame_parser_t *p, const stream_t *st, size_t chunk)
+{
+    uint64_t t0 = bench_now_ns();
+    for (size_t off = 0; off < st->len; off += chunk) {
+        size_t n = st->len - off < chunk ? st->len - off : chunk;
+        uart_frame_parser_feed(p, st->bytes + off, n);
+    }
+    return bench_now_ns() - t0;
+}
+
+static void run_throughput(const stream_t *st, int reps)
+{
+    static const size_t chunks[] = { 1, 16, FEED_CHUNK_DEFAULT, 1024 };
+    uart_frame_parser_t *p = malloc(sizeof(*p));
+
+    printf("\nclean stream: %zu frames, %zu bytes (best of %d)\n", st->frames, st->len, reps);
+    printf("  %-10s %10s %10s %12s\n", "read size", "MB/s", "ns/byte", "frames/s");
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        uint64_t best = UINT64_MAX;
+        size_t frames = 0;
+        for (int r = 0; r < reps; r++) {
+            frames = 0;
+            uart_frame_parser_init(p, count_handler, &frames);
+            uint64_t ns = feed_all(p, st, chunks[c]);
+            best = ns < best ? ns : best;
+        }
+        if (frames != st->frames) {
+            printf("  parser delivered %zu of %zu frames!\n", frames, st->frames);
+        }
+        printf("  %-10zu %10.1f %10.2f %12.0f\n", chunks[c], st->len * 1e3 / best,
+               (double)best / st->len, frames * 1e9 / best);
+    }
+    free(p);
+}
+
+static void run_corruption(const stream_t *clean, bool adversarial, const double *rates, size_t n_rates, uint32_t *rng)
+{
+    uart_frame_parser_t *p = malloc(sizeof(*p));
+    uint8_t *corrupted = malloc(clean->frames);
+    verify_t v = { .frames = clean->frames, .delivered = malloc(clean->frames), .adversarial = adversarial };
+
+    printf("\ncorruption, %s payloads: %zu frames\n", adversarial ? "adversarial" : "random", clean->frames);
+    printf("  %-8s %8s %8s %9s %8s %8s %9s %9s %8s\n", "rate", "errors", "hit", "intact ok", "lost",
+           "false ok", "crc err", "bad hdr", "MB/s");
+    for (size_t r = 0; r < n_rates; r++) {
+        stream_t st;
+        size_t hits = stream_corrupt(clean, &st, rates[r], rng, corrupted);
+
+        memset(v.delivered, 0, clean->frames);
+        v.false_accepts = 0;
+        uart_frame_parser_init(p, verify_handler, &v);
+        uint64_t ns = feed_all(p, &st, FEED_CHUNK_DEFAULT);
+
+        size_t hit = 0, intact_ok = 0, intact_lost = 0;
+        for (size_t i = 0; i < clean->frames; i++) {
+            if (corrupted[i]) {
+                hit++;
+            } else if (v.delivered[i]) {
+                intact_ok++;
+            } else {
+                intact_lost++;
+            }
+        }
+        // Lost: frames nobody touched that still didn't come out, i.e. what
+        // resynchronizing cost beyond the frames actually damaged
+        printf("  %-8.0e %8zu %8zu %8.3f%% %8zu %8u %9lu %9lu %8.1f\n", rates[r], hits, hit,
+               100.0 * intact_ok / (clean->frames - hit), intact_lost, (unsigned)v.false_accepts,
+               (unsigned long)p->stats.crc_errors, (unsigned long)p->stats.bad_header, st.len * 1e3 / ns);
+        free(st.bytes);
+    }
+    free(v.delivered);
+    free(corrupted);
+    free(p);
+}
+
+static void run(const bench_opts_t *opts)
+{
+    static const double rates[] = { 1e-5, 1e-4, 1e-3, 1e-2 };
+    size_t frames = opts->quick ? 20000 : 200000;
+    int reps = opts->quick ? 2 : 5;
+    uint32_t rng = opts->seed;
+    stream_t st;
+
+    stream_build(&st, frames, false);
+    run_throughput(&st, reps);
+    run_corruption(&st, false, rates, sizeof(rates) / sizeof(rates[0]), &rng);
+    stream_free(&st);
+
+    stream_build(&st, frames / 4, true);
+    run_corruption(&st, true, &rates[2], 2, &rng);
+    stream_free(&st);
+}
+
+const bench_suite_t bench_uart_frame = {
+    .name = "uart",
+    .help = "UART frame parse throughput and resync under corruption",
+    .run = run,
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdio.h>
+
+// Assertions for the host tests. A failed CHECK reports itself and carries
+// on, so one run lists every failure; the test's main returns
+// TEST_RESULT(), which ctest reads as pass or fail.
+
+static int test_failures;
+
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            test_failures++;                                                        \
+        }                                                                           \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                   \
+    do {                                                                                 \
+        long long a_ = (long long)(a), b_ = (long long)(b);                              \
+        if (a_ != b_) {                                                                  \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, \
+                    __LINE__, #a, #b, a_, b_);                                           \
+            test_failures++;                                                             \
+        }                                                                                \
+    } while (0)
+
+#define TEST_RESULT() (test_failures == 0 ? 0 : 1)
@@ -0,0 +1,63 @@
+#include "test.h"
+#include "motion_counter.h"
+
+// Tombstone motion counter: MOTION_SHOW_COUNT motions earn the rainbow, and
+// an idle gap starts the count over
+
+#define S 1000000LL
+
+static void test_rainbow(void)
+{
+    motion_counter_t m;
+    motion_counter_init(&m);
+
+    for (int i = 1; i < MOTION_SHOW_COUNT; i++) {
+        CHECK(!motion_counter_feed(&m, i * 10 * S));
+        CHECK_EQ(m.count, i);
+        CHECK_EQ(m.state, MOTION_COUNTING);
+    }
+    CHECK(motion_counter_feed(&m, MOTION_SHOW_COUNT * 10 * S));
+    CHECK_EQ(m.count, MOTION_SHOW_COUNT);
+    CHECK_EQ(m.state, MOTION_IDLE);
+    CHECK_EQ(m.reset, MOTION_RESET_NONE);
+
+    // The next motion starts a new series
+    CHECK(!motion_counter_feed(&m, (MOTION_SHOW_COUNT + 1) * 10 * S));
+    CHECK_EQ(m.count, 1);
+    CHECK_EQ(m.reset, MOTION_RESET_NONE);
+}
+
+static void test_idle_reset(void)
+{
+    motion_counter_t m;
+    motion_counter_init(&m);
+
+    CHECK(!motion_counter_feed(&m, 100 * S));
+    CHECK(!motion_counter_feed(&m, 100 * S + MOTION_IDLE_RESET_US + 1));
+    CHECK_EQ(m.reset, MOTION_RESET_IDLE);
+    CHECK_EQ(m.count, 1);
+}
+
+static void test_gap_at_idle_limit(void)
+{
+    motion_counter_t m;
+    motion_counter_init(&m);
+
+    // Motions exactly MOTION_IDLE_RESET_US apart still count together
+    _Static_assert((MOTION_SHOW_COUNT - 1) * MOTION_IDLE_RESET_US <= MOTION_WINDOW_US,
+                   "the series below must fit in the window");
+    int64_t t = 100 * S;
+    for (int i = 1; i < MOTION_SHOW_COUNT; i++, t += MOTION_IDLE_RESET_US) {
+        CHECK(!motion_counter_feed(&m, t));
+    }
+    CHECK(motion_counter_feed(&m, t));
+    CHECK_EQ(m.reset, MOTION_RESET_NONE);
+}
+
+int main(void)
+{
+    test_rainbow();
+    test_idle_reset();
+    test_gap_at_idle_limit();
+    return TEST_RESULT();
+}
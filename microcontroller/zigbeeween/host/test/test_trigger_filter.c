@@ -0,0 +1,119 @@
+#include "test.h"
+#include "trigger_filter.h"
+
+// Trigger filter: per-prop cooldowns, offline props, revoking an admission
+// that couldn't be queued, and the dedup window
+
+#define MS 1000LL
+
+static zigbee_device_t make_prop(uint8_t caps)
+{
+    return (zigbee_device_t){ .short_addr = 0x1234, .id = 1, .caps = caps, .is_bound = true };
+}
+
+static void test_relay_cooldown(void)
+{
+    trigger_filter_t f;
+    zigbee_device_t relay = make_prop(DEVICE_CAP_RELAY);
+    const int64_t t0 = 1000 * MS;
+
+    trigger_filter_init(&f);
+    CHECK_EQ(trigger_filter_admit(&f, &relay, t0), TRIGGER_ADMITTED);
+    CHECK_EQ(trigger_filter_admit(&f, &relay, t0 + 1 * MS), TRIGGER_DROPPED_COOLDOWN);
+    CHECK_EQ(trigger_filter_admit(&f, &relay, t0 + RELAY_COOLDOWN_MS * MS - 1), TRIGGER_DROPPED_COOLDOWN);
+    CHECK_EQ(trigger_filter_admit(&f, &relay, t0 + RELAY_COOLDOWN_MS * MS), TRIGGER_ADMITTED);
+    CHECK_EQ(f.stats.accepted, 2);
+    CHECK_EQ(f.stats.dropped_cooldown, 2);
+}
+
+static void test_lights_cooldown(void)
+{
+    trigger_filter_t f;
+    zigbee_device_t lights = make_prop(DEVICE_CAP_LIGHTS);
+    const int64_t t0 = 1000 * MS;
+
+    trigger_filter_init(&f);
+    CHECK_EQ(trigger_filter_admit(&f, &lights, t0), TRIGGER_ADMITTED);
+    CHECK_EQ(trigger_filter_admit(&f, &lights, t0 + LIGHTS_COOLDOWN_MS * MS - 1), TRIGGER_DROPPED_COOLDOWN);
+    CHECK_EQ(trigger_filter_admit(&f, &lights, t0 + LIGHTS_COOLDOWN_MS * MS), TRIGGER_ADMITTED);
+}
+
+static void test_cooldowns_are_per_prop(void)
+{
+    trigger_filter_t f;
+    zigbee_device_t a = make_prop(DEVICE_CAP_RELAY);
+    zigbee_device_t b = make_prop(DEVICE_CAP_RELAY);
+
+    trigger_filter_init(&f);
+    CHECK_EQ(trigger_filter_admit(&f, &a, 1000 * MS), TRIGGER_ADMITTED);
+    CHECK_EQ(trigger_filter_admit(&f, &b, 1001 * MS), TRIGGER_ADMITTED);
+}
+
+static void test_offline(void)
+{
+    trigger_filter_t f;
+    zigbee_device_t unbound = make_prop(DEVICE_CAP_RELAY);
+    zigbee_device_t no_addr = make_prop(DEVICE_CAP_RELAY);
+    unbound.is_bound = false;
+    no_addr.short_addr = 0;
+
+    trigger_filter_init(&f);
+    CHECK_EQ(trigger_filter_admit(&f, &unbound, 1000 * MS), TRIGGER_DROPPED_OFFLINE);
+    CHECK_EQ(trigger_filter_admit(&f, &no_addr, 1000 * MS), TRIGGER_DROPPED_OFFLINE);
+    CHECK_EQ(unbound.cooldown_until_us, 0);  // No cooldown for a trigger that never went out
+    CHECK_EQ(f.stats.dropped_offline, 2);
+    CHECK_EQ(f.stats.accepted, 0);
+}
+
+static void test_revoke(void)
+{
+    trigger_filter_t f;
+    zigbee_device_t relay = make_prop(DEVICE_CAP_RELAY);
+
+    trigger_filter_init(&f);
+    CHECK_EQ(trigger_filter_admit(&f, &relay, 1000 * MS), TRIGGER_ADMITTED);
+    trigger_filter_revoke(&f, &relay);
+    CHECK_EQ(trigger_filter_admit(&f, &relay, 1001 * MS), TRIGGER_ADMITTED);
+    CHECK_EQ(f.stats.accepted, 1);
+    CHECK_EQ(f.stats.dropped_offline, 1);
+}
+
+static void test_duplicates(void)
+{
+    trigger_filter_t f;
+    const int64_t t0 = 1000 * MS;
+
+    trigger_filter_init(&f);
+    CHECK(!trigger_filter_is_duplicate(&f, TRIGGER_TARGET_CAPS, DEVICE_CAP_RELAY, t0));
+    CHECK(trigger_filter_is_duplicate(&f, TRIGGER_TARGET_CAPS, DEVICE_CAP_RELAY, t0 + TRIGGER_DEDUP_WINDOW_MS * MS - 1));
+    CHECK(!trigger_filter_is_duplicate(&f, TRIGGER_TARGET_CAPS, DEVICE_CAP_LIGHTS, t0 + 1 * MS));
+    CHECK(!trigger_filter_is_duplicate(&f, TRIGGER_TARGET_GROUP, DEVICE_CAP_RELAY, t0 + 1 * MS));
+    CHECK(!trigger_filter_is_duplicate(&f, TRIGGER_TARGET_CAPS, DEVICE_CAP_RELAY, t0 + TRIGGER_DEDUP_WINDOW_MS * MS));
+    CHECK_EQ(f.stats.dropped_duplicate, 1);
+}
+
+static void test_duplicate_slots_wrap(void)
+{
+    trigger_filter_t f;
+    const int64_t t0 = 1000 * MS;
+
+    // More distinct targets than slots: the oldest is forgotten first
+    trigger_filter_init(&f);
+    for (int i = 0; i <= TRIGGER_DEDUP_SLOTS; i++) {
+        CHECK(!trigger_filter_is_duplicate(&f, TRIGGER_TARGET_DEVICE, (uint8_t)(i + 1), t0 + i));
+    }
+    CHECK(!trigger_filter_is_duplicate(&f, TRIGGER_TARGET_DEVICE, 1, t0 + 100));
+    CHECK(trigger_filter_is_duplicate(&f, TRIGGER_TARGET_DEVICE, TRIGGER_DEDUP_SLOTS + 1, t0 + 100));
+}
+
+int main(void)
+{
+    test_relay_cooldown();
+    test_lights_cooldown();
+    test_cooldowns_are_per_prop();
+    test_offline();
+    test_revoke();
+    test_duplicates();
+    test_duplicate_slots_wrap();
+    return TEST_RESULT();
+}
@@ -0,0 +1,155 @@
+#include <string.h>
+#include "test.h"
+#include "uart_frame.h"
+
+// UART frame parser: frames split across reads, and resynchronizing on the
+// next real frame after garbage, a corrupted frame, a bad header or a
+// truncated frame, without losing that frame
+
+typedef struct {
+    int frames;
+    uint8_t cmd;
+    uint8_t payload[UART_FRAME_MAX_PAYLOAD];
+    uint16_t len;
+} received_t;
+
+static void on_frame(void *ctx, uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    received_t *r = ctx;
+    r->frames++;
+    r->cmd = cmd;
+    r->len = len;
+    memcpy(r->payload, payload, len);
+}
+
+static size_t make_frame(uint8_t *out, uint8_t cmd, uint8_t fill, uint16_t len)
+{
+    uint8_t payload[UART_FRAME_MAX_PAYLOAD];
+    memset(payload, fill, len);
+    return uart_frame_encode(out, UART_FRAME_MAX_SIZE, cmd, payload, len);
+}
+
+static void test_byte_at_a_time(void)
+{
+    uart_frame_parser_t p;
+    received_t r = { 0 };
+    uint8_t frame[UART_FRAME_MAX_SIZE];
+    size_t n = make_frame(frame, 0x21, 0x5a, 40);
+
+    uart_frame_parser_init(&p, on_frame, &r);
+    for (size_t i = 0; i < n; i++) {
+        CHECK_EQ(r.frames, 0);
+        uart_frame_parser_feed(&p, &frame[i], 1);
+    }
+    CHECK_EQ(r.frames, 1);
+    CHECK_EQ(r.cmd, 0x21);
+    CHECK_EQ(r.len, 40);
+    CHECK_EQ(r.payload[39], 0x5a);
+    CHECK_EQ(p.stats.frames_ok, 1);
+}
+
+static void test_resync_after_garbage(void)
+{
+    uart_frame_parser_t p;
+    received_t r = { 0 };
+    uint8_t stream[64 + UART_FRAME_MAX_SIZE];
+    const uint8_t garbage[] = { 0x00, 0xAA, 0x13, UART_FRAME_SOF, 0xFF, 0x42, 0xAA };
+    size_t n = sizeof(garbage);
+
+    memcpy(stream, garbage, n);
+    n += make_frame(&stream[n], 0x22, 0x01, 8);
+
+    uart_frame_parser_init(&p, on_frame, &r);
+    uart_frame_parser_feed(&p, stream, n);
+    CHECK_EQ(r.frames, 1);
+    CHECK_EQ(r.cmd, 0x22);
+    CHECK_EQ(r.len, 8);
+}
+
+static void test_resync_after_crc_error(void)
+{
+    uart_frame_parser_t p;
+    received_t r = { 0 };
+    uint8_t stream[2 * UART_FRAME_MAX_SIZE];
+    size_t bad = make_frame(stream, 0x23, 0x11, 16);
+    stream[UART_FRAME_HEADER_SIZE + 3] ^= 0x04;  // One flipped payload bit
+    size_t n = bad + make_frame(&stream[bad], 0x24, 0x22, 16);
+
+    uart_frame_parser_init(&p, on_frame, &r);
+    uart_frame_parser_feed(&p, stream, n);
+    CHECK_EQ(r.frames, 1);
+    CHECK_EQ(r.cmd, 0x24);
+    CHECK_EQ(r.payload[0], 0x22);
+    CHECK_EQ(p.stats.crc_errors, 1);
+    CHECK_EQ(p.stats.frames_ok, 1);
+}
+
+static void test_resync_after_bad_header(void)
+{
+    uart_frame_parser_t p;
+    received_t r = { 0 };
+    uint8_t stream[16 + UART_FRAME_MAX_SIZE];
+    // A start byte with the wrong version, then one claiming an oversize
+    // payload: neither may make the parser wait for bytes that never come
+    const uint8_t bad[] = { UART_FRAME_SOF, 0x7F, 0x10, 0x02, 0x00,
+                            UART_FRAME_SOF, UART_FRAME_VERSION, 0x10, 0xFF, 0xFF };
+    size_t n = sizeof(bad);
+
+    memcpy(stream, bad, n);
+    n += make_frame(&stream[n], 0x25, 0x33, 4);
+
+    uart_frame_parser_init(&p, on_frame, &r);
+    uart_frame_parser_feed(&p, stream, n);
+    CHECK_EQ(r.frames, 1);
+    CHECK_EQ(r.cmd, 0x25);
+    CHECK_EQ(p.stats.bad_header, 2);
+}
+
+static void test_resync_after_truncated_frame(void)
+{
+    uart_frame_parser_t p;
+    received_t r = { 0 };
+    uint8_t stream[2 * UART_FRAME_MAX_SIZE];
+    // A frame cut off after a few payload bytes (its sender reset): the
+    // next frame completes its length, fails the CRC and is then found
+    make_frame(stream, 0x26, 0x44, 100);
+    size_t cut = UART_FRAME_HEADER_SIZE + 3;
+    size_t n = cut + make_frame(&stream[cut], 0x27, 0x55, 200);
+
+    uart_frame_parser_init(&p, on_frame, &r);
+    uart_frame_parser_feed(&p, stream, n);
+    CHECK_EQ(r.frames, 1);
+    CHECK_EQ(r.cmd, 0x27);
+    CHECK_EQ(r.len, 200);
+    CHECK_EQ(r.payload[199], 0x55);
+}
+
+static void test_frame_inside_corrupted_frame(void)
+{
+    uart_frame_parser_t p;
+    received_t r = { 0 };
+    uint8_t inner[UART_FRAME_MAX_SIZE];
+    uint8_t stream[2 * UART_FRAME_MAX_SIZE];
+    // A real frame carried as the payload of a corrupted one: dropping one
+    // byte at a time reaches it
+    size_t inner_len = make_frame(inner, 0x28, 0x66, 12);
+    size_t n = uart_frame_encode(stream, sizeof(stream), 0x29, inner, (uint16_t)inner_len);
+    stream[n - 1] ^= 0xFF;  // Outer CRC
+
+    uart_frame_parser_init(&p, on_frame, &r);
+    uart_frame_parser_feed(&p, stream, n);
+    CHECK_EQ(r.frames, 1);
+    CHECK_EQ(r.cmd, 0x28);
+    CHECK_EQ(r.len, 12);
+}
+
+int main(void)
+{
+    test_byte_at_a_time();
+    test_resync_after_garbage();
+    test_resync_after_crc_error();
+    test_resync_after_bad_header();
+    test_resync_after_truncated_frame();
+    test_frame_inside_corrupted_frame();
+    return TEST_RESULT();
+}
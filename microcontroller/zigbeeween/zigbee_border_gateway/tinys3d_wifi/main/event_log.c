@@ -0,0 +1,103 @@
+#include <stdatomic.h>
+#include <stddef.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "event_log.h"
+
+static const char *TAG = "event_log";
+
+_Static_assert((EVENT_LOG_PSRAM_ENTRIES & (EVENT_LOG_PSRAM_ENTRIES - 1)) == 0, "ring size must be a power of two");
+_Static_assert((EVENT_LOG_INTERNAL_ENTRIES & (EVENT_LOG_INTERNAL_ENTRIES - 1)) == 0, "ring size must be a power of two");
+
+// Each slot is a tiny seqlock: the writer zeroes seq, fills the fields and
+// then publishes seq with release ordering. A reader that sees the seq it
+// wants before and after copying the fields got a consistent entry.
+typedef struct {
+    _Atomic uint32_t seq;
+    uint32_t uptime_ms;
+    uint8_t type;
+    uint8_t device_id;
+    uint16_t reserved;
+} event_slot_t;
+
+static event_slot_t *ring = NULL;
+static uint32_t ring_mask = 0;
+
+// Next sequence number to hand out. Producers claim slots with one atomic
+// add, so concurrent appends from different tasks or cores never share a slot.
+static _Atomic uint32_t next_seq = 1;
+
+void event_log_init(void)
+{
+    size_t entries = EVENT_LOG_PSRAM_ENTRIES;
+    ring = heap_caps_calloc(entries, sizeof(event_slot_t), MALLOC_CAP_SPIRAM);
+    if (!ring) {
+        entries = EVENT_LOG_INTERNAL_ENTRIES;
+        ring = heap_caps_calloc(entries, sizeof(event_slot_t), MALLOC_CAP_INTERNAL);
+        if (!ring) {
+            ESP_LOGE(TAG, "No memory for the event log");
+            return;
+        }
+        ESP_LOGW(TAG, "PSRAM not available, event log limited to %u entries", (unsigned)entries);
+    } else {
+        ESP_LOGI(TAG, "Event log: %u entries in PSRAM", (unsigned)entries);
+    }
+    ring_mask = entries - 1;
+}
+
+uint32_t event_log_append(event_type_t type, uint8_t device_id)
+{
+    if (!ring) {
+        return 0;
+    }
+
+    uint32_t seq = atomic_fetch_add_explicit(&next_seq, 1, memory_order_relaxed);
+    event_slot_t *slot = &ring[seq & ring_mask];
+
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->uptime_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    slot->type = (uint8_t)type;
+    slot->device_id = device_id;
+    atomic_store_explicit(&slot->seq, seq, memory_order_release);
+
+    return seq;
+}
+
+uint32_t event_log_latest_seq(void)
+{
+    return atomic_load_explicit(&next_seq, memory_order_relaxed) - 1;
+}
+
+uint32_t event_log_oldest_seq(void)
+{
+    uint32_t latest = event_log_latest_seq();
+    uint32_t capacity = ring_mask + 1;
+    return latest >= capacity ? latest - capacity + 1 : 1;
+}
+
+event_log_read_t event_log_read(uint32_t seq, event_log_entry_t *out)
+{
+    if (!ring || seq == 0 || seq > event_log_latest_seq()) {
+        return EVENT_LOG_READ_PENDING;
+    }
+
+    const event_slot_t *slot = &ring[seq & ring_mask];
+    uint32_t before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (before != seq) {
+        // A newer lap already took the slot, or our writer hasn't finished
+        return (before > seq) ? EVENT_LOG_READ_OVERWRITTEN : EVENT_LOG_READ_PENDING;
+    }
+
+    out->seq = seq;
+    out->uptime_ms = slot->uptime_ms;
+    out->type = slot->type;
+    out->device_id = slot->device_id;
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq) {
+        return EVENT_LOG_READ_OVERWRITTEN;  // Rewritten while we copied it
+    }
+    return EVENT_LOG_READ_OK;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Gateway event history: a ring of compact entries, each tagged with a
+// sequence number that increases forever (1, 2, ...). Any task may append;
+// readers (the web server) take entries without a lock and can tell a torn
+// or overwritten slot from a good one by its sequence number.
+//
+// The ring lives in PSRAM (EVENT_LOG_PSRAM_ENTRIES entries); if PSRAM is not
+// available it falls back to a small internal RAM ring.
+
+#define EVENT_LOG_PSRAM_ENTRIES    8192   // 96 KB of PSRAM
+#define EVENT_LOG_INTERNAL_ENTRIES 64
+
+#define EVENT_LOG_DEVICE_NONE 0  // Device ids are the coordinator's (1-based)
+
+typedef enum {
+    EVENT_MOTION_DETECTED,
+    EVENT_MOTION_STOPPED,
+    EVENT_TRIGGER_RIP,
+    EVENT_TRIGGER_HALLOWEEN,
+    EVENT_TRIGGER_BOTH,
+    EVENT_DEVICE_JOINED,
+    EVENT_DEVICE_LEFT,
+    EVENT_TRIGGER_RULES,   // TinyS3 motion handed to the coordinator's rule table
+    EVENT_CHOREOGRAPHY,    // Timed sequence staged on the coordinator
+    EVENT_TYPE_COUNT
+} event_type_t;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t uptime_ms;   // esp_timer time of the event (monotonic, wraps after 49 days)
+    uint8_t type;         // event_type_t
+    uint8_t device_id;    // EVENT_LOG_DEVICE_NONE if the event has no device
+} event_log_entry_t;
+
+typedef enum {
+    EVENT_LOG_READ_OK,
+    EVENT_LOG_READ_PENDING,      // Not written yet (or still being written)
+    EVENT_LOG_READ_OVERWRITTEN,  // Fell off the end of the ring
+} event_log_read_t;
+
+// Allocate the ring. Call once from app_main before any event is logged.
+void event_log_init(void);
+
+// Append an event and return its sequence number (0 if the log isn't initialized)
+uint32_t event_log_append(event_type_t type, uint8_t device_id);
+
+// Sequence number of the newest event claimed so far (0 = none yet). The
+// entry itself may still be PENDING for a moment if another task is writing it.
+uint32_t event_log_latest_seq(void);
+
+// Oldest sequence number that can still be in the ring
+uint32_t event_log_oldest_seq(void);
+
+// Copy entry seq into *out
+event_log_read_t event_log_read(uint32_t seq, event_log_entry_t *out);
@@ -0,0 +1,403 @@
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "uart_frame.h"
+#include "journal.h"
+
+static const char *TAG = "journal";
+
+#define SECTOR_SIZE        4096
+#define HEADER_SIZE        16
+#define RECORD_SIZE        8
+#define RECORDS_PER_SECTOR ((SECTOR_SIZE - HEADER_SIZE) / RECORD_SIZE)   // 510
+#define JOURNAL_MAGIC      0x4A31   // "J1"
+#define TIME_UNKNOWN       0xFFFFFFFFu
+
+// Sector header. first_time and last_time are left erased when the sector is
+// started and programmed later (NOR flash can clear bits in erased words
+// without another erase), so they are hints only and not covered by the CRC.
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint16_t crc;           // Over seq
+    uint32_t seq;           // Increases by one per sector started; highest = newest
+    uint32_t first_time;    // Time of the first record, programmed with it
+    uint32_t last_time;     // Time of the last record, programmed when the sector fills
+} sector_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t time;
+    uint8_t type;
+    uint8_t device_id;
+    uint16_t crc;           // Over the first 6 bytes
+} flash_record_t;
+
+_Static_assert(sizeof(sector_header_t) == HEADER_SIZE, "header layout");
+_Static_assert(sizeof(flash_record_t) == RECORD_SIZE, "record layout");
+
+static const esp_partition_t *part = NULL;
+static uint16_t sector_count = 0;
+
+// Write position, guarded by journal_mutex (readers take it too, so a sector
+// is never erased halfway through a read)
+static SemaphoreHandle_t journal_mutex = NULL;
+static uint16_t head_sector = 0;
+static uint32_t head_seq = 0;
+static uint16_t head_slot = 0;          // Next free record slot in head_sector
+static bool head_has_first = false;
+static bool head_closed = false;        // last_time already programmed
+static uint32_t head_last_time = 0;
+
+// Events not yet on flash. Timestamps are esp_timer based until flush, so
+// events logged before NTP sync still get correct wall-clock times.
+typedef struct {
+    uint32_t uptime_ms;
+    uint8_t type;
+    uint8_t device_id;
+} pending_event_t;
+
+static portMUX_TYPE pending_lock = portMUX_INITIALIZER_UNLOCKED;
+static pending_event_t pending[JOURNAL_PENDING_MAX];
+static uint8_t pending_head = 0;        // Oldest entry
+static uint8_t pending_count = 0;
+
+static journal_stats_t stats;
+
+static uint16_t record_crc(const flash_record_t *rec)
+{
+    return uart_frame_crc16(0xFFFF, (const uint8_t *)rec, offsetof(flash_record_t, crc));
+}
+
+static uint16_t header_crc(uint32_t seq)
+{
+    return uart_frame_crc16(0xFFFF, (const uint8_t *)&seq, sizeof(seq));
+}
+
+static bool record_is_erased(const flash_record_t *rec)
+{
+    static const uint8_t erased[RECORD_SIZE] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    return memcmp(rec, erased, RECORD_SIZE) == 0;
+}
+
+static size_t slot_offset(uint16_t sector, uint16_t slot)
+{
+    return (size_t)sector * SECTOR_SIZE + HEADER_SIZE + (size_t)slot * RECORD_SIZE;
+}
+
+static bool read_header(uint16_t sector, sector_header_t *hdr)
+{
+    if (esp_partition_read(part, (size_t)sector * SECTOR_SIZE, hdr, sizeof(*hdr)) != ESP_OK) {
+        return false;
+    }
+    return hdr->magic == JOURNAL_MAGIC && hdr->crc == header_crc(hdr->seq) && hdr->seq != 0;
+}
+
+static void program_header_time(uint16_t sector, size_t field, uint32_t value)
+{
+    esp_partition_write(part, (size_t)sector * SECTOR_SIZE + field, &value, sizeof(value));
+}
+
+// Erase the next sector in the ring and make it the head
+static esp_err_t start_sector(uint16_t sector, uint32_t seq)
+{
+    esp_err_t err = esp_partition_erase_range(part, (size_t)sector * SECTOR_SIZE, SECTOR_SIZE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Erase of sector %u failed: %s", sector, esp_err_to_name(err));
+        return err;
+    }
+    stats.erases++;
+
+    sector_header_t hdr = {
+        .magic = JOURNAL_MAGIC,
+        .crc = header_crc(seq),
+        .seq = seq,
+        .first_time = TIME_UNKNOWN,
+        .last_time = TIME_UNKNOWN,
+    };
+    // Only the first 8 bytes: the time hints stay erased until known
+    err = esp_partition_write(part, (size_t)sector * SECTOR_SIZE, &hdr, offsetof(sector_header_t, first_time));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    head_sector = sector;
+    head_seq = seq;
+    head_slot = 0;
+    head_has_first = false;
+    head_closed = false;
+    return ESP_OK;
+}
+
+void journal_init(void)
+{
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, JOURNAL_PARTITION_LABEL);
+    if (!part) {
+        ESP_LOGW(TAG, "No \"%s\" partition, events will not be persisted", JOURNAL_PARTITION_LABEL);
+        return;
+    }
+    sector_count = part->size / SECTOR_SIZE;
+    if (sector_count < 2) {
+        ESP_LOGE(TAG, "Journal partition too small (%lu bytes)", (unsigned long)part->size);
+        part = NULL;
+        return;
+    }
+    stats.sectors = sector_count;
+    journal_mutex = xSemaphoreCreateMutex();
+
+    // Headers only: the newest valid sector is where writing continues
+    bool found = false;
+    for (uint16_t i = 0; i < sector_count; i++) {
+        sector_header_t hdr;
+        if (read_header(i, &hdr) && (!found || hdr.seq > head_seq)) {
+            found = true;
+            head_sector = i;
+            head_seq = hdr.seq;
+            head_has_first = hdr.first_time != TIME_UNKNOWN;
+            head_closed = hdr.last_time != TIME_UNKNOWN;
+        }
+    }
+
+    if (!found) {
+        ESP_LOGI(TAG, "Formatting journal (%u sectors)", sector_count);
+        if (start_sector(0, 1) != ESP_OK) {
+            part = NULL;
+        }
+        return;
+    }
+
+    // Records are written in order, so the first erased slot is the end
+    flash_record_t recs[JOURNAL_ITER_BATCH];
+    head_slot = RECORDS_PER_SECTOR;
+    for (uint16_t slot = 0; slot < RECORDS_PER_SECTOR && head_slot == RECORDS_PER_SECTOR; slot += JOURNAL_ITER_BATCH) {
+        uint16_t n = RECORDS_PER_SECTOR - slot;
+        if (n > JOURNAL_ITER_BATCH) {
+            n = JOURNAL_ITER_BATCH;
+        }
+        if (esp_partition_read(part, slot_offset(head_sector, slot), recs, n * RECORD_SIZE) != ESP_OK) {
+            break;
+        }
+        for (uint16_t i = 0; i < n; i++) {
+            if (record_is_erased(&recs[i])) {
+                head_slot = slot + i;
+                break;
+            }
+            if (recs[i].crc != record_crc(&recs[i])) {
+                stats.torn_records++;
+            } else {
+                head_last_time = recs[i].time;
+            }
+        }
+    }
+    if (head_closed) {
+        head_slot = RECORDS_PER_SECTOR;
+    }
+
+    ESP_LOGI(TAG, "Journal: %u sectors, head sector %u (seq %lu) at record %u, %lu torn",
+             sector_count, head_sector, (unsigned long)head_seq, head_slot, (unsigned long)stats.torn_records);
+}
+
+void journal_append(uint8_t type, uint8_t device_id)
+{
+    if (!part) {
+        return;
+    }
+
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    portENTER_CRITICAL(&pending_lock);
+    if (pending_count == JOURNAL_PENDING_MAX) {
+        pending_head = (pending_head + 1) % JOURNAL_PENDING_MAX;  // Drop the oldest
+        pending_count--;
+        stats.dropped++;
+    }
+    pending[(pending_head + pending_count) % JOURNAL_PENDING_MAX] = (pending_event_t){
+        .uptime_ms = now_ms, .type = type, .device_id = device_id,
+    };
+    pending_count++;
+    portEXIT_CRITICAL(&pending_lock);
+}
+
+// Write recs[0..count) at the head, moving to new sectors as they fill
+static void write_records(const flash_record_t *recs, size_t count)
+{
+    while (count > 0) {
+        if (head_slot == RECORDS_PER_SECTOR) {
+            if (!head_closed) {
+                program_header_time(head_sector, offsetof(sector_header_t, last_time), head_last_time);
+                head_closed = true;
+            }
+            if (start_sector((head_sector + 1) % sector_count, head_seq + 1) != ESP_OK) {
+                return;
+            }
+        }
+        if (!head_has_first) {
+            program_header_time(head_sector, offsetof(sector_header_t, first_time), recs[0].time);
+            head_has_first = true;
+        }
+
+        size_t n = RECORDS_PER_SECTOR - head_slot;
+        if (n > count) {
+            n = count;
+        }
+        esp_err_t err = esp_partition_write(part, slot_offset(head_sector, head_slot), recs, n * RECORD_SIZE);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Write failed: %s", esp_err_to_name(err));
+            return;
+        }
+        head_slot += n;
+        head_last_time = recs[n - 1].time;
+        stats.records_written += n;
+        recs += n;
+        count -= n;
+    }
+}
+
+void journal_tick(bool clock_valid)
+{
+    static int64_t last_flush_us = 0;
+    static flash_record_t recs[JOURNAL_PENDING_MAX];  // Main loop only
+
+    if (!part || !clock_valid || pending_count == 0) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    if (pending_count < JOURNAL_FLUSH_EVENTS && now_us - last_flush_us < (int64_t)JOURNAL_FLUSH_SECS * 1000000) {
+        return;
+    }
+    last_flush_us = now_us;
+
+    // Take the batch, converting uptime to wall-clock time
+    uint32_t now_ms = (uint32_t)(now_us / 1000);
+    time_t now = time(NULL);
+    size_t count = 0;
+    portENTER_CRITICAL(&pending_lock);
+    while (pending_count > 0) {
+        const pending_event_t *p = &pending[pending_head];
+        recs[count].time = (uint32_t)(now - (time_t)((now_ms - p->uptime_ms) / 1000));
+        recs[count].type = p->type;
+        recs[count].device_id = p->device_id;
+        count++;
+        pending_head = (pending_head + 1) % JOURNAL_PENDING_MAX;
+        pending_count--;
+    }
+    portEXIT_CRITICAL(&pending_lock);
+
+    for (size_t i = 0; i < count; i++) {
+        recs[i].crc = record_crc(&recs[i]);
+    }
+
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    write_records(recs, count);
+    xSemaphoreGive(journal_mutex);
+
+    stats.flushes++;
+    ESP_LOGD(TAG, "Flushed %u events to sector %u", (unsigned)count, head_sector);
+}
+
+void journal_iter_begin(journal_iter_t *it, uint32_t from, uint32_t to)
+{
+    *it = (journal_iter_t){ .from = from, .to = to, .done = (part == NULL) };
+    if (!part) {
+        return;
+    }
+
+    // Oldest sector is the one after the head
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    it->end_seq = head_seq;
+    it->sector_index = (head_sector + 1) % sector_count;
+    xSemaphoreGive(journal_mutex);
+    it->sectors_left = sector_count;
+}
+
+static void iter_next_sector(journal_iter_t *it)
+{
+    it->sector_index = (it->sector_index + 1) % sector_count;
+    it->sectors_left--;
+    it->sector_seq = 0;
+    it->slot = 0;
+    it->buf_pos = 0;
+    it->buf_count = 0;
+}
+
+bool journal_iter_next(journal_iter_t *it, journal_record_t *out)
+{
+    while (!it->done) {
+        if (it->buf_pos < it->buf_count) {
+            const flash_record_t *rec = (const flash_record_t *)&it->buf[it->buf_pos * RECORD_SIZE];
+            it->buf_pos++;
+            if (record_is_erased(rec)) {
+                iter_next_sector(it);  // End of this sector's records
+                continue;
+            }
+            if (rec->crc != record_crc(rec) || rec->time < it->from || rec->time > it->to) {
+                continue;
+            }
+            out->time = rec->time;
+            out->type = rec->type;
+            out->device_id = rec->device_id;
+            return true;
+        }
+
+        if (it->sectors_left == 0) {
+            it->done = true;
+            break;
+        }
+
+        if (it->sector_seq == 0) {
+            sector_header_t hdr;
+            xSemaphoreTake(journal_mutex, portMAX_DELAY);
+            bool valid = read_header(it->sector_index, &hdr);
+            xSemaphoreGive(journal_mutex);
+
+            if (valid && hdr.seq <= it->end_seq) {
+                if (hdr.first_time != TIME_UNKNOWN && hdr.first_time > it->to) {
+                    it->done = true;  // Sectors are in time order; nothing later matches
+                    break;
+                }
+                if (hdr.last_time == TIME_UNKNOWN || hdr.last_time >= it->from) {
+                    it->sector_seq = hdr.seq;
+                    continue;
+                }
+            }
+            iter_next_sector(it);  // Unused, started after we began, or entirely before from
+            continue;
+        }
+
+        if (it->slot >= RECORDS_PER_SECTOR) {
+            iter_next_sector(it);
+            continue;
+        }
+
+        uint16_t n = RECORDS_PER_SECTOR - it->slot;
+        if (n > JOURNAL_ITER_BATCH) {
+            n = JOURNAL_ITER_BATCH;
+        }
+
+        // Re-check the sequence under the lock: if the writer wrapped around
+        // and recycled this sector, what's there now is newer than our scan
+        sector_header_t hdr;
+        bool still_ours;
+        xSemaphoreTake(journal_mutex, portMAX_DELAY);
+        still_ours = read_header(it->sector_index, &hdr) && hdr.seq == it->sector_seq &&
+                     esp_partition_read(part, slot_offset(it->sector_index, it->slot), it->buf, n * RECORD_SIZE) == ESP_OK;
+        xSemaphoreGive(journal_mutex);
+
+        if (!still_ours) {
+            iter_next_sector(it);
+            continue;
+        }
+        it->slot += n;
+        it->buf_pos = 0;
+        it->buf_count = n;
+    }
+    return false;
+}
+
+void journal_get_stats(journal_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Persistent event journal in the "journal" data partition.
+//
+// The partition is used as a ring of 4 KB sectors, so erases spread evenly
+// over all of them. Each sector starts with a header (sequence number plus
+// first/last record time, used to skip sectors when scanning by time),
+// followed by fixed-size 8-byte records that each carry their own CRC. A
+// record torn by a power cut fails its CRC and is skipped.
+//
+// Appends are buffered in RAM and written in batches (every
+// JOURNAL_FLUSH_EVENTS events or JOURNAL_FLUSH_SECS seconds), so a burst of
+// motion costs one flash write rather than one per event, and an erase only
+// once every ~500 records.
+
+#define JOURNAL_PARTITION_LABEL "journal"
+#define JOURNAL_FLUSH_EVENTS    16
+#define JOURNAL_FLUSH_SECS      60
+#define JOURNAL_PENDING_MAX     64   // Events held while waiting for a flush (or NTP)
+
+typedef struct {
+    uint32_t time;        // Unix seconds
+    uint8_t type;         // event_type_t
+    uint8_t device_id;
+} journal_record_t;
+
+// Mount the partition and find the write position. Call once from app_main.
+void journal_init(void);
+
+// Queue an event for the journal. Any task; never touches flash.
+void journal_append(uint8_t type, uint8_t device_id);
+
+// Write batched events if a flush is due. Call periodically from the main
+// loop. Records get wall-clock times, so nothing is written until
+// clock_valid (NTP synced); until then events wait in RAM.
+void journal_tick(bool clock_valid);
+
+// Read-side iterator: records with from <= time <= to, oldest first, read
+// from flash JOURNAL_ITER_BATCH at a time so nothing is loaded wholesale
+#define JOURNAL_ITER_BATCH 16
+
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    uint32_t end_seq;       // Newest sector sequence when the scan started
+    uint32_t sector_seq;    // Sequence of the sector being read (0 = header not read yet)
+    uint16_t sector_index;  // Physical sector being read
+    uint16_t sectors_left;
+    uint16_t slot;          // Next record slot to load from that sector
+    uint8_t buf_pos;
+    uint8_t buf_count;
+    bool done;
+    uint8_t buf[JOURNAL_ITER_BATCH * 8];
+} journal_iter_t;
+
+void journal_iter_begin(journal_iter_t *it, uint32_t from, uint32_t to);
+bool journal_iter_next(journal_iter_t *it, journal_record_t *out);
+
+typedef struct {
+    uint32_t sectors;
+    uint32_t records_written;  // Since boot
+    uint32_t flushes;
+    uint32_t erases;
+    uint32_t torn_records;     // Found at boot
+    uint32_t dropped;          // Pending buffer overflowed
+} journal_stats_t;
+
+void journal_get_stats(journal_stats_t *out);
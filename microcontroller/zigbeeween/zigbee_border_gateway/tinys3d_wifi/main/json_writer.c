@@ -0,0 +1,176 @@
+#include <string.h>
+#include "json_writer.h"
+
+_Static_assert(JSON_WRITER_MAX_DEPTH <= 8, "has_items is a uint8_t bitmask");
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap, json_flush_fn_t flush, void *ctx)
+{
+    *w = (json_writer_t){ .buf = buf, .cap = cap, .flush = flush, .ctx = ctx, .err = ESP_OK };
+}
+
+static void flush_buf(json_writer_t *w)
+{
+    if (w->err != ESP_OK || w->len == 0) {
+        return;
+    }
+    if (!w->flush) {
+        w->err = ESP_ERR_NO_MEM;
+        return;
+    }
+    w->err = w->flush(w->ctx, w->buf, w->len);
+    w->len = 0;
+}
+
+static inline void put_char(json_writer_t *w, char c)
+{
+    if (w->len == w->cap) {
+        flush_buf(w);
+    }
+    if (w->err == ESP_OK) {
+        w->buf[w->len++] = c;
+    }
+}
+
+static void put_raw(json_writer_t *w, const char *s, size_t n)
+{
+    while (n > 0 && w->err == ESP_OK) {
+        if (w->len == w->cap) {
+            flush_buf(w);
+            continue;
+        }
+        size_t room = w->cap - w->len;
+        size_t take = n < room ? n : room;
+        memcpy(w->buf + w->len, s, take);
+        w->len += take;
+        s += take;
+        n -= take;
+    }
+}
+
+static void put_escaped(json_writer_t *w, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    put_char(w, '"');
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            put_char(w, '\\');
+            put_char(w, (char)c);
+        } else if (c < 0x20) {
+            put_raw(w, "\\u00", 4);
+            put_char(w, hex[c >> 4]);
+            put_char(w, hex[c & 0xF]);
+        } else {
+            put_char(w, (char)c);
+        }
+    }
+    put_char(w, '"');
+}
+
+// Comma and key for the next member of the current container
+static void member(json_writer_t *w, const char *key)
+{
+    if (w->depth > 0) {
+        uint8_t bit = 1u << (w->depth - 1);
+        if (w->has_items & bit) {
+            put_char(w, ',');
+        }
+        w->has_items |= bit;
+    }
+    if (key) {
+        put_char(w, '"');
+        put_raw(w, key, strlen(key));
+        put_raw(w, "\":", 2);
+    }
+}
+
+static void open_container(json_writer_t *w, const char *key, char c)
+{
+    member(w, key);
+    put_char(w, c);
+    if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+        w->err = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    w->depth++;
+    w->has_items &= ~(1u << (w->depth - 1));
+}
+
+static void close_container(json_writer_t *w, char c)
+{
+    if (w->depth == 0) {
+        w->err = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    w->depth--;
+    put_char(w, c);
+}
+
+esp_err_t json_writer_finish(json_writer_t *w)
+{
+    if (w->flush) {
+        flush_buf(w);
+    } else if (w->err == ESP_OK && w->len < w->cap) {
+        w->buf[w->len] = '\0';  // Fixed buffer: leave a C string when it fits
+    } else if (w->err == ESP_OK) {
+        w->err = ESP_ERR_NO_MEM;
+    }
+    return w->err;
+}
+
+void json_obj_open(json_writer_t *w, const char *key) { open_container(w, key, '{'); }
+void json_obj_close(json_writer_t *w) { close_container(w, '}'); }
+void json_arr_open(json_writer_t *w, const char *key) { open_container(w, key, '['); }
+void json_arr_close(json_writer_t *w) { close_container(w, ']'); }
+
+void json_str(json_writer_t *w, const char *key, const char *value)
+{
+    member(w, key);
+    put_escaped(w, value ? value : "");
+}
+
+void json_uint(json_writer_t *w, const char *key, uint32_t value)
+{
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    member(w, key);
+    while (n > 0) {
+        put_char(w, digits[--n]);
+    }
+}
+
+void json_int(json_writer_t *w, const char *key, int64_t value)
+{
+    char digits[20];
+    int n = 0;
+    // Work on the magnitude as unsigned so INT64_MIN is fine
+    uint64_t mag = value < 0 ? (uint64_t)0 - (uint64_t)value : (uint64_t)value;
+    do {
+        digits[n++] = (char)('0' + mag % 10);
+        mag /= 10;
+    } while (mag);
+
+    member(w, key);
+    if (value < 0) {
+        put_char(w, '-');
+    }
+    while (n > 0) {
+        put_char(w, digits[--n]);
+    }
+}
+
+void json_bool(json_writer_t *w, const char *key, bool value)
+{
+    member(w, key);
+    if (value) {
+        put_raw(w, "true", 4);
+    } else {
+        put_raw(w, "false", 5);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Streaming JSON writer. Output goes into a caller-supplied buffer; when the
+// buffer fills, it is handed to the flush callback and reused, so a response
+// of any size is sent in buffer-sized pieces without heap allocation. With no
+// flush callback the writer just fills the buffer once and records overflow
+// as ESP_ERR_NO_MEM.
+//
+// Commas are inserted automatically. Inside objects pass a key; inside
+// arrays pass NULL:
+//
+//   json_obj_open(&w, NULL);
+//   json_uint(&w, "seq", 7);
+//   json_arr_open(&w, "devices");
+//   json_obj_open(&w, NULL); json_str(&w, "name", "RIP"); json_obj_close(&w);
+//   json_arr_close(&w);
+//   json_obj_close(&w);
+
+#define JSON_WRITER_MAX_DEPTH 8
+
+typedef esp_err_t (*json_flush_fn_t)(void *ctx, const char *data, size_t len);
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    json_flush_fn_t flush;
+    void *ctx;
+    uint8_t depth;
+    uint8_t has_items;   // Bit n: the container at depth n already has a member
+    esp_err_t err;       // First error; once set, all writes are no-ops
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap, json_flush_fn_t flush, void *ctx);
+
+// Flush whatever is buffered. Returns the first error hit while writing.
+esp_err_t json_writer_finish(json_writer_t *w);
+
+void json_obj_open(json_writer_t *w, const char *key);
+void json_obj_close(json_writer_t *w);
+void json_arr_open(json_writer_t *w, const char *key);
+void json_arr_close(json_writer_t *w);
+
+void json_str(json_writer_t *w, const char *key, const char *value);    // Escaped
+void json_uint(json_writer_t *w, const char *key, uint32_t value);
+void json_int(json_writer_t *w, const char *key, int64_t value);
+void json_bool(json_writer_t *w, const char *key, bool value);
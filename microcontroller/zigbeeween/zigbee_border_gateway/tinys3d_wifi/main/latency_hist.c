@@ -0,0 +1,67 @@
+#include "latency_hist.h"
+
+static unsigned bucket_index(uint32_t us)
+{
+    if (us < LATENCY_HIST_SUB) {
+        return us;
+    }
+    unsigned msb = 31 - __builtin_clz(us);
+    if (msb >= LATENCY_HIST_MAX_BITS) {
+        return LATENCY_HIST_BUCKETS - 1;
+    }
+    unsigned sub = (us >> (msb - LATENCY_HIST_SUB_BITS)) & (LATENCY_HIST_SUB - 1);
+    return (msb - LATENCY_HIST_SUB_BITS + 1) * LATENCY_HIST_SUB + sub;
+}
+
+// Largest value that lands in bucket i
+static uint32_t bucket_upper(unsigned i)
+{
+    if (i < LATENCY_HIST_SUB) {
+        return i;
+    }
+    unsigned shift = i / LATENCY_HIST_SUB - 1;
+    uint32_t lower = (uint32_t)(LATENCY_HIST_SUB + i % LATENCY_HIST_SUB) << shift;
+    return lower + ((uint32_t)1 << shift) - 1;
+}
+
+void latency_hist_add(latency_hist_t *h, uint32_t us)
+{
+    h->counts[bucket_index(us)]++;
+    h->count++;
+    h->sum_us += us;
+    if (us > h->max_us) {
+        h->max_us = us;
+    }
+}
+
+uint32_t latency_hist_percentile(const latency_hist_t *h, unsigned pct)
+{
+    if (h->count == 0) {
+        return 0;
+    }
+    // Rank of the sample we want, 1-based and rounded up
+    uint64_t rank = ((uint64_t)h->count * pct + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint32_t upper = bucket_upper(i);
+            return upper < h->max_us ? upper : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+void latency_hist_summarize(const latency_hist_t *h, latency_summary_t *out)
+{
+    out->count = h->count;
+    out->p50_us = latency_hist_percentile(h, 50);
+    out->p95_us = latency_hist_percentile(h, 95);
+    out->p99_us = latency_hist_percentile(h, 99);
+    out->max_us = h->max_us;
+    out->avg_us = h->count ? (uint32_t)(h->sum_us / h->count) : 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+// Log-scale latency histogram. Each power of two is split into
+// LATENCY_HIST_SUB buckets, so a percentile read back from it is within 25%
+// of the true value across the whole range (1 us to ~67 s, larger samples
+// land in the last bucket). 400 bytes each with no per-sample storage.
+//
+// Not thread-safe; callers lock around it.
+
+#define LATENCY_HIST_SUB_BITS 2
+#define LATENCY_HIST_SUB      (1 << LATENCY_HIST_SUB_BITS)
+#define LATENCY_HIST_MAX_BITS 26    // 2^26 us = 67 s
+#define LATENCY_HIST_BUCKETS  ((LATENCY_HIST_MAX_BITS - LATENCY_HIST_SUB_BITS + 1) * LATENCY_HIST_SUB)
+
+typedef struct {
+    uint32_t counts[LATENCY_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+} latency_hist_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t p50_us;
+    uint32_t p95_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+    uint32_t avg_us;
+} latency_summary_t;
+
+void latency_hist_add(latency_hist_t *h, uint32_t us);
+
+// Upper edge of the bucket holding the pct-th percentile (never above the
+// largest sample); 0 when empty
+uint32_t latency_hist_percentile(const latency_hist_t *h, unsigned pct);
+
+void latency_hist_summarize(const latency_hist_t *h, latency_summary_t *out);
@@ -1,13 +1,19 @@
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
+#include <unistd.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_netif.h"
@@ -17,6 +23,22 @@
 #include "driver/gpio.h"
 #include "driver/i2c.h"
 #include "driver/uart.h"
+#include "uart_frame.h"
+#include "uart_proto.h"
+#include "event_log.h"
+#include "json_writer.h"
+#include "prop_status.h"
+#include "journal.h"
+#include "latency_hist.h"
+#include "metrics.h"
+#include "metrics_export.h"
+#include "ota_upload.h"
+#include "applog.h"
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+#include "esp_coexist.h"
+#include "gateway_link.h"
+#include "single_chip.h"
+#endif
 
 static const char *TAG = "tinys3_controller";
 
@@ -24,11 +46,17 @@ static const char *TAG = "tinys3_controller";
 #define WIFI_SSID      CONFIG_ESP_WIFI_SSID
 #define WIFI_PASS      CONFIG_ESP_WIFI_PASSWORD
 
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+// Single-chip gateway: the XIAO C6's free pins, set in menuconfig. The
+// antenna switch is the coordinator's and there is no UART to the other half.
+#define PIR_PIN CONFIG_GATEWAY_PIR_GPIO
+#define I2C_SDA_PIN CONFIG_GATEWAY_OLED_SDA_GPIO
+#define I2C_SCL_PIN CONFIG_GATEWAY_OLED_SCL_GPIO
+#else
 // Pin definitions for TinyS3
 #define PIR_PIN GPIO_NUM_1       // PIR motion sensor
 #define I2C_SDA_PIN GPIO_NUM_8   // OLED SDA
 #define I2C_SCL_PIN GPIO_NUM_9   // OLED SCL
-#define OLED_ADDR 0x3C
 
 // External antenna control for TinyS3D
 #define ANTENNA_SELECT_PIN GPIO_NUM_38  // HIGH = external antenna, LOW = internal antenna
@@ -38,10 +66,20 @@ static const char *TAG = "tinys3_controller";
 #define UART_RX_PIN GPIO_NUM_44  // RX from XIAO C6
 #define UART_NUM UART_NUM_1
 #define UART_BUF_SIZE (1024)
+#define UART_EVENT_QUEUE_LEN 20
+#endif
+#define OLED_ADDR 0x3C
+
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+#define GATEWAY_HOSTNAME "zigbeeween-gateway"
+#else
+#define GATEWAY_HOSTNAME "zigbeeween-tinys3"
+#endif
 
 // I2C configuration
 #define I2C_MASTER_NUM I2C_NUM_0
-#define I2C_MASTER_FREQ_HZ 100000
+#define I2C_MASTER_FREQ_HZ 400000  // Fast mode; a full 512-byte frame takes ~13 ms
+#define I2C_TIMEOUT_MS 50
 
 // Event group bits
 #define WIFI_CONNECTED_BIT BIT0
@@ -58,74 +96,320 @@ static char wifi_ssid[32] = "";
 static char wifi_ip[16] = "0.0.0.0";
 static int wifi_rssi = 0;
 
-// Zigbee device status (received from XIAO C6 via UART)
-typedef struct {
-    char name[32];
-    bool is_connected;
-    bool time_synced;
-    bool in_cooldown;
-} zigbee_device_t;
-
-static zigbee_device_t rip_tombstone = {"RIP Tombstone", false, false, false};
-static zigbee_device_t halloween_trigger = {"Haunted Pumpkin Scarecrow", false, false, false};
+// Zigbee device status (received from XIAO C6 via UART), indexed by device id - 1
+static prop_status_t devices[DEVICE_STATUS_MAX_DEVICES] = {
+    [DEVICE_ID_RIP - 1] = {.name = "RIP Tombstone", .last_seen_age = DEVICE_STATUS_AGE_NEVER},
+    [DEVICE_ID_HALLOWEEN - 1] = {.name = "Haunted Pumpkin Scarecrow", .last_seen_age = DEVICE_STATUS_AGE_NEVER},
+};
+static size_t device_count = 2;  // Until the first snapshot says otherwise
 
 // Coordinator status tracking
 static bool coordinator_online = false;
 static time_t last_coordinator_response = 0;
-#define COORDINATOR_TIMEOUT_SECONDS 10  // Consider coordinator offline after 10 seconds
-
-// UART command protocol
-#define CMD_TRIGGER_RIP 0x01
-#define CMD_TRIGGER_HALLOWEEN 0x02
-#define CMD_TRIGGER_BOTH 0x03
-#define CMD_STATUS_REQUEST 0x10
-#define CMD_STATUS_RESPONSE 0x11
-#define CMD_TIME_SYNC 0x20
-#define CMD_DEVICE_JOINED 0x30
-#define CMD_DEVICE_LEFT 0x31
-
-// Event logging
-#define MAX_EVENTS 50
-typedef enum {
-    EVENT_MOTION_DETECTED,
-    EVENT_MOTION_STOPPED,
-    EVENT_TRIGGER_RIP,
-    EVENT_TRIGGER_HALLOWEEN,
-    EVENT_TRIGGER_BOTH,
-    EVENT_DEVICE_JOINED,
-    EVENT_DEVICE_LEFT
-} event_type_t;
+#define COORDINATOR_TIMEOUT_SECONDS 10  // Offline after two missed heartbeats (STATUS_HEARTBEAT_INTERVAL_MS)
+static uint8_t last_status_seq = 0;
+static bool status_seq_valid = false;
+
+// Per-device link history from the coordinator (CMD_RADIO_TELEMETRY), by
+// device id - 1. Allocated in PSRAM by radio_telemetry_init().
+#define RADIO_MARGINAL_LQI       100  // Average LQI below this is flagged marginal
+#define RADIO_MARGINAL_FAIL_PCT  10   // ... as is a delivery failure rate above this
+
+typedef struct {
+    bool valid;
+    uint8_t count;                  // Buckets, oldest first
+    uint16_t bucket_secs;
+    uint32_t delivered;
+    uint32_t failed;
+    int64_t received_us;
+    uint8_t buckets[RADIO_TELEMETRY_MAX_BUCKETS][RADIO_TELEMETRY_RECORD_SIZE];
+} radio_telemetry_t;
+
+static radio_telemetry_t *radio_telemetry = NULL;
+static SemaphoreHandle_t radio_mutex = NULL;
+
+// Coordinator's trigger admission counters (CMD_TRIGGER_STATS)
+static struct {
+    uint32_t accepted;
+    uint32_t dropped_cooldown;
+    uint32_t dropped_duplicate;
+    uint32_t dropped_offline;
+} trigger_filter;
+
+// Coordinator's active rule table (CMD_RULES_STATUS). An upload waits on
+// rules_reply_sem for the coordinator's verdict.
+#define RULES_REPLY_TIMEOUT_MS 3000  // Covers the NVS write on the coordinator
+
+static struct {
+    bool valid;
+    bool builtin;
+    uint8_t result;      // Of the last upload reply
+    uint16_t rules;
+    uint16_t size;
+    uint16_t crc;
+} rules_status;
+static SemaphoreHandle_t rules_reply_sem = NULL;
+
+// UART command protocol and framing are shared with the XIAO C6 (uart_proto.h)
+#if !CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+static QueueHandle_t uart_event_queue = NULL;
+static uart_frame_parser_t uart_parser;
+static SemaphoreHandle_t uart_tx_mutex = NULL;
+static uint8_t uart_tx_buf[UART_FRAME_MAX_SIZE];
+#endif
+
+// Event log storage is in event_log.c; /api/status pages through it
+#define STATUS_EVENTS_LATEST  20   // Events returned without ?since=
+#define STATUS_EVENTS_MAX     256  // Events per ?since= response
+
+// ============================================================================
+// Live Event Stream (Server-Sent Events)
+// ============================================================================
+
+// GET /api/events keeps the connection open as a text/event-stream. Producers
+// (log_event, status updates) copy each event into every client's small ring
+// and queue one flush on the httpd task, which is the only place sockets are
+// written. A slow client loses its oldest pending events, never blocks us.
+
+#define SSE_MAX_CLIENTS    4
+#define SSE_RING_LEN       16
+#define SSE_EVENT_MAX      160   // One formatted "event: ...\ndata: ...\n\n" message
+#define SSE_KEEPALIVE_SECS 15
 
 typedef struct {
-    time_t timestamp;
-    event_type_t type;
-    char device_name[32];  // For join/leave events
-} event_log_t;
+    int fd;                      // -1 = free slot
+    uint8_t head;                // Next slot to write
+    uint8_t count;
+    uint32_t dropped;
+    char ring[SSE_RING_LEN][SSE_EVENT_MAX];
+} sse_client_t;
+
+static sse_client_t sse_clients[SSE_MAX_CLIENTS] = {
+    [0 ... SSE_MAX_CLIENTS - 1] = { .fd = -1 },
+};
+static int sse_client_count = 0;
+static httpd_handle_t sse_server = NULL;
+static SemaphoreHandle_t sse_mutex = NULL;
+static volatile bool sse_flush_queued = false;
+
+static void sse_flush_work(void *arg)
+{
+    static char msg[SSE_EVENT_MAX];  // httpd task only
+
+    sse_flush_queued = false;
+
+    for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+        sse_client_t *c = &sse_clients[i];
 
-static event_log_t event_log[MAX_EVENTS];
-static int event_log_head = 0;
-static int event_log_count = 0;
+        while (1) {
+            xSemaphoreTake(sse_mutex, portMAX_DELAY);
+            int fd = c->fd;
+            if (fd < 0 || c->count == 0) {
+                xSemaphoreGive(sse_mutex);
+                break;
+            }
+            uint8_t tail = (c->head + SSE_RING_LEN - c->count) % SSE_RING_LEN;
+            strcpy(msg, c->ring[tail]);
+            c->count--;
+            xSemaphoreGive(sse_mutex);
+
+            if (httpd_socket_send(sse_server, fd, msg, strlen(msg), 0) < 0) {
+                APPLOGW(HTTP, TAG, "SSE client fd %d send failed, closing", fd);
+                httpd_sess_trigger_close(sse_server, fd);
+                break;
+            }
+        }
+    }
+}
+
+// Queue a message for every connected client. Any task; never blocks on the network.
+static void sse_publish_raw(const char *msg)
+{
+    if (!sse_mutex) {
+        return;
+    }
+
+    xSemaphoreTake(sse_mutex, portMAX_DELAY);
+    if (sse_client_count == 0) {
+        xSemaphoreGive(sse_mutex);
+        return;
+    }
+    for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+        sse_client_t *c = &sse_clients[i];
+        if (c->fd < 0) {
+            continue;
+        }
+        if (c->count == SSE_RING_LEN) {
+            c->count--;  // Drop the oldest
+            c->dropped++;
+        }
+        strncpy(c->ring[c->head], msg, SSE_EVENT_MAX - 1);
+        c->ring[c->head][SSE_EVENT_MAX - 1] = '\0';
+        c->head = (c->head + 1) % SSE_RING_LEN;
+        c->count++;
+    }
+    xSemaphoreGive(sse_mutex);
+
+    if (!sse_flush_queued) {
+        sse_flush_queued = true;
+        if (httpd_queue_work(sse_server, sse_flush_work, NULL) != ESP_OK) {
+            sse_flush_queued = false;
+        }
+    }
+}
+
+// Publish one named event; data is a single-line JSON object
+void sse_publish(const char *event, const char *data)
+{
+    char msg[SSE_EVENT_MAX];
+    int n = snprintf(msg, sizeof(msg), "event: %s\ndata: %s\n\n", event, data);
+    if (n >= (int)sizeof(msg)) {
+        ESP_LOGW(TAG, "SSE %s event too large (%d bytes), dropped", event, n);
+        return;
+    }
+    sse_publish_raw(msg);
+}
+
+// Comment line; keeps idle connections (and any proxies) from timing out
+void sse_keepalive(void)
+{
+    sse_publish_raw(": keepalive\n\n");
+}
+
+static esp_err_t events_handler(httpd_req_t *req)
+{
+    int fd = httpd_req_to_sockfd(req);
+    int slot = -1;
+
+    xSemaphoreTake(sse_mutex, portMAX_DELAY);
+    for (int i = 0; i < SSE_MAX_CLIENTS && slot < 0; i++) {
+        if (sse_clients[i].fd < 0) {
+            slot = i;
+        }
+    }
+    xSemaphoreGive(sse_mutex);
+
+    if (slot < 0) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "30");
+        return httpd_resp_send(req, "Too many event stream clients", HTTPD_RESP_USE_STRLEN);
+    }
+
+    // Raw response: the stream has no length and must not be chunk-terminated
+    static const char header[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n"
+        "retry: 3000\n\n";
+    if (httpd_send(req, header, sizeof(header) - 1) < 0) {
+        return ESP_FAIL;
+    }
+
+    xSemaphoreTake(sse_mutex, portMAX_DELAY);
+    sse_clients[slot] = (sse_client_t){ .fd = fd };
+    sse_client_count++;
+    sse_server = req->handle;
+    xSemaphoreGive(sse_mutex);
+
+    APPLOGI(HTTP, TAG, "SSE client connected (fd %d, %d/%d)", fd, sse_client_count, SSE_MAX_CLIENTS);
+    return ESP_OK;
+}
+
+// httpd close_fn: drop the client's slot before the socket goes away
+static void http_close_fn(httpd_handle_t hd, int fd)
+{
+    if (sse_mutex) {
+        xSemaphoreTake(sse_mutex, portMAX_DELAY);
+        for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+            if (sse_clients[i].fd == fd) {
+                APPLOGI(HTTP, TAG, "SSE client disconnected (fd %d, %lu events dropped)",
+                         fd, (unsigned long)sse_clients[i].dropped);
+                sse_clients[i].fd = -1;
+                sse_client_count--;
+            }
+        }
+        xSemaphoreGive(sse_mutex);
+    }
+    close(fd);
+}
 
 // ============================================================================
 // Event Logging
 // ============================================================================
 
-void log_event(event_type_t type, const char *device_name)
+static const char *event_type_name(event_type_t type)
 {
-    event_log[event_log_head].timestamp = time(NULL);
-    event_log[event_log_head].type = type;
+    switch (type) {
+        case EVENT_MOTION_DETECTED: return "motion_detected";
+        case EVENT_MOTION_STOPPED: return "motion_stopped";
+        case EVENT_TRIGGER_RIP: return "trigger_rip";
+        case EVENT_TRIGGER_HALLOWEEN: return "trigger_halloween";
+        case EVENT_TRIGGER_BOTH: return "trigger_both";
+        case EVENT_DEVICE_JOINED: return "device_joined";
+        case EVENT_DEVICE_LEFT: return "device_left";
+        case EVENT_TRIGGER_RULES: return "trigger_rules";
+        case EVENT_CHOREOGRAPHY: return "choreography";
+        default: return "unknown";
+    }
+}
 
-    if (device_name) {
-        strncpy(event_log[event_log_head].device_name, device_name, sizeof(event_log[event_log_head].device_name) - 1);
-        event_log[event_log_head].device_name[sizeof(event_log[event_log_head].device_name) - 1] = '\0';
-    } else {
-        event_log[event_log_head].device_name[0] = '\0';
+static const char *device_name_from_id(uint8_t device_id)
+{
+    if (device_id == 0 || device_id > DEVICE_STATUS_MAX_DEVICES || devices[device_id - 1].name[0] == '\0') {
+        return "Unknown";
     }
+    return devices[device_id - 1].name;
+}
+
+// Entries only carry a monotonic timestamp; wall-clock time is derived from
+// "now" once per render instead of a localtime_r per entry
+typedef struct {
+    uint32_t now_ms;
+    int32_t now_sec_of_day;
+} event_clock_t;
+
+static event_clock_t event_clock_now(void)
+{
+    struct tm timeinfo;
+    time_t now = time(NULL);
+    localtime_r(&now, &timeinfo);
+    return (event_clock_t){
+        .now_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .now_sec_of_day = timeinfo.tm_hour * 3600 + timeinfo.tm_min * 60 + timeinfo.tm_sec,
+    };
+}
 
-    event_log_head = (event_log_head + 1) % MAX_EVENTS;
-    if (event_log_count < MAX_EVENTS) {
-        event_log_count++;
+// One event as a JSON object: {"seq":N,"time":"HH:MM:SS","type":"...","device":"..."}
+static void event_json(json_writer_t *w, const event_log_entry_t *e, const event_clock_t *clock)
+{
+    int32_t age_s = (int32_t)((clock->now_ms - e->uptime_ms) / 1000);
+    int32_t sod = ((clock->now_sec_of_day - age_s) % 86400 + 86400) % 86400;
+    int32_t hms[3] = { sod / 3600, sod / 60 % 60, sod % 60 };
+
+    char event_time[9];
+    for (int i = 0; i < 3; i++) {
+        event_time[i * 3] = (char)('0' + hms[i] / 10);
+        event_time[i * 3 + 1] = (char)('0' + hms[i] % 10);
+        event_time[i * 3 + 2] = ':';
     }
+    event_time[8] = '\0';
+
+    json_obj_open(w, NULL);
+    json_uint(w, "seq", e->seq);
+    json_str(w, "time", event_time);
+    json_str(w, "type", event_type_name(e->type));
+    if (e->device_id != EVENT_LOG_DEVICE_NONE) {
+        json_str(w, "device", device_name_from_id(e->device_id));
+    }
+    json_obj_close(w);
+}
+
+void log_event(event_type_t type, uint8_t device_id)
+{
+    uint32_t seq = event_log_append(type, device_id);
+    journal_append(type, device_id);
 
     // Log to console
     const char *event_name;
@@ -137,13 +421,45 @@ void log_event(event_type_t type, const char *device_name)
         case EVENT_TRIGGER_BOTH: event_name = "Trigger Both"; break;
         case EVENT_DEVICE_JOINED: event_name = "Device Joined"; break;
         case EVENT_DEVICE_LEFT: event_name = "Device Left"; break;
+        case EVENT_TRIGGER_RULES: event_name = "Trigger Rules"; break;
+        case EVENT_CHOREOGRAPHY: event_name = "Choreography"; break;
         default: event_name = "Unknown"; break;
     }
 
-    if (device_name) {
-        ESP_LOGI(TAG, "Event logged: %s - %s", event_name, device_name);
+    // Names are literals or the static device table, so the line can wait
+    if (device_id != EVENT_LOG_DEVICE_NONE) {
+        APPLOG_DEFER(STATUS, ESP_LOG_INFO, TAG, "Event %lu logged: %s - %s", seq, (uintptr_t)event_name,
+                     (uintptr_t)device_name_from_id(device_id));
     } else {
-        ESP_LOGI(TAG, "Event logged: %s", event_name);
+        APPLOG_DEFER(STATUS, ESP_LOG_INFO, TAG, "Event %lu logged: %s", seq, (uintptr_t)event_name);
+    }
+
+    // Same shape as /api/status "events" entries
+    event_log_entry_t entry;
+    if (event_log_read(seq, &entry) == EVENT_LOG_READ_OK) {
+        event_clock_t clock = event_clock_now();
+        char data[112];
+        json_writer_t w;
+        json_writer_init(&w, data, sizeof(data), NULL, NULL);
+        event_json(&w, &entry, &clock);
+        if (json_writer_finish(&w) == ESP_OK) {
+            sse_publish("log", data);
+        }
+    }
+}
+
+// Tell live clients the device/coordinator state changed; they re-read /api/status
+static void publish_status_change(void)
+{
+    char data[64];
+    json_writer_t w;
+    json_writer_init(&w, data, sizeof(data), NULL, NULL);
+    json_obj_open(&w, NULL);
+    json_uint(&w, "seq", last_status_seq);
+    json_bool(&w, "coordinator_online", coordinator_online);
+    json_obj_close(&w);
+    if (json_writer_finish(&w) == ESP_OK) {
+        sse_publish("status", data);
     }
 }
 
@@ -168,78 +484,14 @@ void setup_i2c(void)
     ESP_LOGI(TAG, "I2C initialized for OLED display");
 }
 
-void oled_write_cmd(uint8_t cmd)
-{
-    i2c_cmd_handle_t i2c_cmd = i2c_cmd_link_create();
-    i2c_master_start(i2c_cmd);
-    i2c_master_write_byte(i2c_cmd, (OLED_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(i2c_cmd, 0x00, true); // Command mode
-    i2c_master_write_byte(i2c_cmd, cmd, true);
-    i2c_master_stop(i2c_cmd);
-    i2c_master_cmd_begin(I2C_MASTER_NUM, i2c_cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(i2c_cmd);
-}
-
-void oled_init(void)
-{
-    vTaskDelay(pdMS_TO_TICKS(100));
-
-    // Initialization sequence for 128x32 SSD1306
-    oled_write_cmd(0xAE); // Display off
-    oled_write_cmd(0xD5); // Set display clock
-    oled_write_cmd(0x80);
-    oled_write_cmd(0xA8); // Set multiplex ratio
-    oled_write_cmd(0x1F); // 32 rows
-    oled_write_cmd(0xD3); // Set display offset
-    oled_write_cmd(0x00);
-    oled_write_cmd(0x40); // Set start line
-    oled_write_cmd(0x8D); // Charge pump
-    oled_write_cmd(0x14);
-    oled_write_cmd(0x20); // Memory mode
-    oled_write_cmd(0x00); // Horizontal
-    oled_write_cmd(0xA1); // Segment remap
-    oled_write_cmd(0xC8); // COM scan direction
-    oled_write_cmd(0xDA); // COM pins
-    oled_write_cmd(0x02);
-    oled_write_cmd(0x81); // Contrast
-    oled_write_cmd(0x8F);
-    oled_write_cmd(0xD9); // Pre-charge
-    oled_write_cmd(0xF1);
-    oled_write_cmd(0xDB); // VCOM detect
-    oled_write_cmd(0x40);
-    oled_write_cmd(0xA4); // Display resume
-    oled_write_cmd(0xA6); // Normal display
-    oled_write_cmd(0xAF); // Display on
-
-    ESP_LOGI(TAG, "OLED initialized (128x32)");
-}
-
-void oled_clear(void)
-{
-    // Set column address range
-    oled_write_cmd(0x21);
-    oled_write_cmd(0x00); // Start
-    oled_write_cmd(0x7F); // End (127)
-
-    // Set page address range
-    oled_write_cmd(0x22);
-    oled_write_cmd(0x00); // Start
-    oled_write_cmd(0x03); // End (3 pages for 32 rows)
-
-    // Send 512 bytes of zeros (128 * 4)
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (OLED_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, 0x40, true); // Data mode
+// The display is drawn into a RAM framebuffer (one byte = 8 vertical pixels,
+// laid out page by page like the SSD1306's GDDRAM) and only the columns that
+// differ from what the panel already shows are sent. Drawing and I2C both
+// happen on display_task; oled_print*() just hand it the text and return.
 
-    for (int i = 0; i < 512; i++) {
-        i2c_master_write_byte(cmd, 0x00, true);
-    }
-
-    i2c_master_stop(cmd);
-    i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
-}
+#define OLED_WIDTH  128
+#define OLED_PAGES  4     // 32 rows / 8
+#define OLED_TEXT_LEN 24
 
 // Simple 5x8 font for basic ASCII characters (space through 'z')
 static const uint8_t font_5x8[][5] = {
@@ -336,197 +588,216 @@ static const uint8_t font_5x8[][5] = {
     {0x44, 0x64, 0x54, 0x4C, 0x44}, // z
 };
 
-void oled_write_char_2x(uint8_t x, uint8_t y, char c)
-{
-    if (c < ' ' || c > 'z') c = ' ';  // Replace invalid chars with space
-
-    const uint8_t *font_data = font_5x8[c - ' '];
-
-    // 2x scaling: each character becomes 10x16 pixels
-    // We need to write to 2 pages (y and y+1)
-    for (int page = 0; page < 2; page++) {
-        // Set column address (x position)
-        oled_write_cmd(0x21);
-        oled_write_cmd(x);
-        oled_write_cmd(x + 10);
-
-        // Set page address
-        oled_write_cmd(0x22);
-        oled_write_cmd(y + page);
-        oled_write_cmd(y + page);
-
-        // Write character bitmap with 2x scaling
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (OLED_ADDR << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_write_byte(cmd, 0x40, true); // Data mode
-
-        for (int col = 0; col < 5; col++) {
-            uint8_t byte = font_data[col];
-            uint8_t scaled = 0;
-
-            // Scale vertically: take 4 bits from source, expand to 8 bits
-            if (page == 0) {
-                // Lower half of character (bits 0-3 become bits 0,0,2,2,4,4,6,6)
-                for (int bit = 0; bit < 4; bit++) {
-                    if (byte & (1 << bit)) {
-                        scaled |= (3 << (bit * 2)); // Set 2 bits
-                    }
-                }
-            } else {
-                // Upper half of character (bits 4-7 become bits 0,0,2,2,4,4,6,6)
-                for (int bit = 4; bit < 8; bit++) {
-                    if (byte & (1 << bit)) {
-                        scaled |= (3 << ((bit - 4) * 2)); // Set 2 bits
-                    }
-                }
-            }
+#define FONT_FIRST ' '
+#define FONT_LAST  'z'
+#define FONT_CHARS (FONT_LAST - FONT_FIRST + 1)
 
-            // Write each column twice (horizontal scaling)
-            i2c_master_write_byte(cmd, scaled, true);
-            i2c_master_write_byte(cmd, scaled, true);
-        }
-        // Spacing
-        i2c_master_write_byte(cmd, 0x00, true);
+#define GLYPH_2X_WIDTH     11  // 2x scale: 10 columns + 1 spacing
+#define GLYPH_NARROW_WIDTH 6   // 2x tall, 1x wide: 5 columns + 1 spacing
 
-        i2c_master_stop(cmd);
-        i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-        i2c_cmd_link_delete(cmd);
-    }
-}
+// Built once from font_5x8 by oled_build_glyphs(): [char][page][column]
+static uint8_t glyph_2x[FONT_CHARS][2][GLYPH_2X_WIDTH];
+static uint8_t glyph_narrow[FONT_CHARS][2][GLYPH_NARROW_WIDTH];
 
-void oled_print(const char *text)
-{
-    oled_clear();
+static uint8_t oled_fb[OLED_PAGES][OLED_WIDTH];
+static uint8_t oled_shown[OLED_PAGES][OLED_WIDTH];  // What the panel holds
+static bool oled_shown_valid = false;               // Panel contents unknown until the first full flush
 
-    // Write text starting at position (0, 0)
-    // Each 2x character is 11 pixels wide (10 + 1 spacing)
-    // 128 / 11 = ~11 characters per line
-    uint8_t x = 0;
-    uint8_t y = 0;
+typedef struct {
+    char line1[OLED_TEXT_LEN];
+    char line2[OLED_TEXT_LEN];
+    bool two_lines;
+} oled_text_t;
 
-    for (int i = 0; text[i] != '\0' && x < 117; i++) {
-        oled_write_char_2x(x, y, text[i]);
-        x += 11;
-    }
+static oled_text_t oled_pending;
+static portMUX_TYPE oled_pending_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t display_task_handle = NULL;
 
-    ESP_LOGI(TAG, "OLED: %s", text);
+// Send a run of command bytes in one transaction
+static void oled_write_cmds(const uint8_t *cmds, size_t len)
+{
+    i2c_cmd_handle_t i2c_cmd = i2c_cmd_link_create();
+    i2c_master_start(i2c_cmd);
+    i2c_master_write_byte(i2c_cmd, (OLED_ADDR << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(i2c_cmd, 0x00, true); // Command mode
+    i2c_master_write(i2c_cmd, cmds, len, true);
+    i2c_master_stop(i2c_cmd);
+    i2c_master_cmd_begin(I2C_MASTER_NUM, i2c_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
+    i2c_cmd_link_delete(i2c_cmd);
 }
 
-void oled_write_char_1x(uint8_t x, uint8_t y, char c)
+static void oled_write_data(const uint8_t *data, size_t len)
 {
-    if (c < ' ' || c > 'z') c = ' ';  // Replace invalid chars with space
-
-    const uint8_t *font_data = font_5x8[c - ' '];
+    i2c_cmd_handle_t i2c_cmd = i2c_cmd_link_create();
+    i2c_master_start(i2c_cmd);
+    i2c_master_write_byte(i2c_cmd, (OLED_ADDR << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(i2c_cmd, 0x40, true); // Data mode
+    i2c_master_write(i2c_cmd, data, len, true);
+    i2c_master_stop(i2c_cmd);
+    i2c_master_cmd_begin(I2C_MASTER_NUM, i2c_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
+    i2c_cmd_link_delete(i2c_cmd);
+}
 
-    // Set column address (x position)
-    oled_write_cmd(0x21);
-    oled_write_cmd(x);
-    oled_write_cmd(x + 5);
+static void oled_build_glyphs(void)
+{
+    // Each source bit becomes two rows: nibble -> byte
+    static const uint8_t nibble_2x[16] = {
+        0x00, 0x03, 0x0C, 0x0F, 0x30, 0x33, 0x3C, 0x3F,
+        0xC0, 0xC3, 0xCC, 0xCF, 0xF0, 0xF3, 0xFC, 0xFF,
+    };
 
-    // Set page address (y position - each page is 8 pixels tall)
-    oled_write_cmd(0x22);
-    oled_write_cmd(y);
-    oled_write_cmd(y);
+    for (int c = 0; c < FONT_CHARS; c++) {
+        for (int page = 0; page < 2; page++) {
+            // Page 0 is the lower half of the glyph (bits 0-3), page 1 the upper half
+            for (int col = 0; col < 5; col++) {
+                uint8_t scaled = nibble_2x[(font_5x8[c][col] >> (page * 4)) & 0x0F];
+                glyph_2x[c][page][col * 2] = scaled;
+                glyph_2x[c][page][col * 2 + 1] = scaled;
+                glyph_narrow[c][page][col] = scaled;
+            }
+            glyph_2x[c][page][GLYPH_2X_WIDTH - 1] = 0x00;
+            glyph_narrow[c][page][GLYPH_NARROW_WIDTH - 1] = 0x00;
+        }
+    }
+}
 
-    // Write character bitmap
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (OLED_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, 0x40, true); // Data mode
+void oled_init(void)
+{
+    vTaskDelay(pdMS_TO_TICKS(100));
 
-    for (int i = 0; i < 5; i++) {
-        i2c_master_write_byte(cmd, font_data[i], true);
-    }
-    i2c_master_write_byte(cmd, 0x00, true); // 1 pixel spacing between chars
+    // Initialization sequence for 128x32 SSD1306
+    static const uint8_t init_cmds[] = {
+        0xAE,       // Display off
+        0xD5, 0x80, // Set display clock
+        0xA8, 0x1F, // Set multiplex ratio: 32 rows
+        0xD3, 0x00, // Set display offset
+        0x40,       // Set start line
+        0x8D, 0x14, // Charge pump
+        0x20, 0x00, // Memory mode: horizontal
+        0xA1,       // Segment remap
+        0xC8,       // COM scan direction
+        0xDA, 0x02, // COM pins
+        0x81, 0x8F, // Contrast
+        0xD9, 0xF1, // Pre-charge
+        0xDB, 0x40, // VCOM detect
+        0xA4,       // Display resume
+        0xA6,       // Normal display
+        0xAF,       // Display on
+    };
+    oled_write_cmds(init_cmds, sizeof(init_cmds));
 
-    i2c_master_stop(cmd);
-    i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
+    oled_build_glyphs();
+    ESP_LOGI(TAG, "OLED initialized (128x32)");
 }
 
-void oled_write_char_2x_narrow(uint8_t x, uint8_t y, char c)
+// Send every page's changed column span, one address + data transaction each
+static void oled_flush(void)
 {
-    if (c < ' ' || c > 'z') c = ' ';
+    for (int page = 0; page < OLED_PAGES; page++) {
+        int first = 0;
+        int last = OLED_WIDTH - 1;
 
-    const uint8_t *font_data = font_5x8[c - ' '];
+        if (oled_shown_valid) {
+            while (first < OLED_WIDTH && oled_fb[page][first] == oled_shown[page][first]) {
+                first++;
+            }
+            if (first == OLED_WIDTH) {
+                continue;
+            }
+            while (oled_fb[page][last] == oled_shown[page][last]) {
+                last--;
+            }
+        }
 
-    // 2x vertical, 1x horizontal (narrow): 5 pixels wide, 16 pixels tall
-    // This fits 128/6 = 21 characters but keeps text tall and readable
-    for (int page = 0; page < 2; page++) {
-        oled_write_cmd(0x21);
-        oled_write_cmd(x);
-        oled_write_cmd(x + 5);
+        const uint8_t addr_cmds[] = {
+            0x21, (uint8_t)first, (uint8_t)last,  // Column range
+            0x22, (uint8_t)page, (uint8_t)page,   // Page range
+        };
+        oled_write_cmds(addr_cmds, sizeof(addr_cmds));
+        oled_write_data(&oled_fb[page][first], last - first + 1);
+        memcpy(&oled_shown[page][first], &oled_fb[page][first], last - first + 1);
+    }
+    oled_shown_valid = true;
+}
 
-        oled_write_cmd(0x22);
-        oled_write_cmd(y + page);
-        oled_write_cmd(y + page);
+static inline int glyph_index(char c)
+{
+    return (c < FONT_FIRST || c > FONT_LAST) ? 0 : c - FONT_FIRST;  // Invalid chars render as space
+}
 
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (OLED_ADDR << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_write_byte(cmd, 0x40, true);
+// Draw a 2-page-tall text line starting at page, clipped to the display
+static void oled_draw_text(uint8_t page, const char *text, bool narrow)
+{
+    size_t width = narrow ? GLYPH_NARROW_WIDTH : GLYPH_2X_WIDTH;
 
-        for (int col = 0; col < 5; col++) {
-            uint8_t byte = font_data[col];
-            uint8_t scaled = 0;
+    for (size_t i = 0, x = 0; text[i] != '\0' && x + width <= OLED_WIDTH; i++, x += width) {
+        int g = glyph_index(text[i]);
+        memcpy(&oled_fb[page][x], narrow ? glyph_narrow[g][0] : glyph_2x[g][0], width);
+        memcpy(&oled_fb[page + 1][x], narrow ? glyph_narrow[g][1] : glyph_2x[g][1], width);
+    }
+}
 
-            // 2x vertical scaling only
-            if (page == 0) {
-                // Lower half (bits 0-3 become 0,0,2,2,4,4,6,6)
-                for (int bit = 0; bit < 4; bit++) {
-                    if (byte & (1 << bit)) {
-                        scaled |= (3 << (bit * 2));
-                    }
-                }
-            } else {
-                // Upper half (bits 4-7 become 0,0,2,2,4,4,6,6)
-                for (int bit = 4; bit < 8; bit++) {
-                    if (byte & (1 << bit)) {
-                        scaled |= (3 << ((bit - 4) * 2));
-                    }
-                }
-            }
+void display_task(void *pvParameters)
+{
+    oled_text_t text;
 
-            // Write each column once (1x horizontal)
-            i2c_master_write_byte(cmd, scaled, true);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        portENTER_CRITICAL(&oled_pending_lock);
+        text = oled_pending;
+        portEXIT_CRITICAL(&oled_pending_lock);
+
+        // Line 1 at page 0 (top half) - BIG text (2x scale)
+        // Line 2 at page 2 (bottom half) - TALL but NARROW text for IP addresses
+        memset(oled_fb, 0, sizeof(oled_fb));
+        oled_draw_text(0, text.line1, false);
+        if (text.two_lines) {
+            oled_draw_text(2, text.line2, true);
         }
-        // Small spacing
-        i2c_master_write_byte(cmd, 0x00, true);
+        oled_flush();
 
-        i2c_master_stop(cmd);
-        i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-        i2c_cmd_link_delete(cmd);
+        if (text.two_lines) {
+            APPLOGD(STATUS, TAG, "OLED: %s / %s", text.line1, text.line2);
+        } else {
+            APPLOGD(STATUS, TAG, "OLED: %s", text.line1);
+        }
     }
 }
 
-void oled_print_2lines(const char *line1, const char *line2)
+// Queue new screen contents for display_task. Never blocks; if several
+// updates arrive before the task runs only the latest is drawn.
+static void oled_show(const char *line1, const char *line2)
 {
-    oled_clear();
-
-    // Line 1 at page 0 (top half) - BIG text (2x scale)
-    uint8_t x = 0;
-    for (int i = 0; line1[i] != '\0' && x < 117; i++) {
-        oled_write_char_2x(x, 0, line1[i]);
-        x += 11;
+    portENTER_CRITICAL(&oled_pending_lock);
+    strncpy(oled_pending.line1, line1, sizeof(oled_pending.line1) - 1);
+    oled_pending.line1[sizeof(oled_pending.line1) - 1] = '\0';
+    strncpy(oled_pending.line2, line2 ? line2 : "", sizeof(oled_pending.line2) - 1);
+    oled_pending.line2[sizeof(oled_pending.line2) - 1] = '\0';
+    oled_pending.two_lines = (line2 != NULL);
+    portEXIT_CRITICAL(&oled_pending_lock);
+
+    if (display_task_handle) {
+        xTaskNotifyGive(display_task_handle);
     }
+}
 
-    // Line 2 at page 2 (bottom half) - TALL but NARROW text for IP addresses
-    // 2x vertical, 1x horizontal = 6 pixels wide, fits 21 chars
-    x = 0;
-    for (int i = 0; line2[i] != '\0' && x < 122; i++) {
-        oled_write_char_2x_narrow(x, 2, line2[i]);
-        x += 6;
-    }
+void oled_print(const char *text)
+{
+    oled_show(text, NULL);
+}
 
-    ESP_LOGI(TAG, "OLED: %s / %s", line1, line2);
+void oled_print_2lines(const char *line1, const char *line2)
+{
+    oled_show(line1, line2);
 }
 
+#if !CONFIG_ZIGBEEWEEN_SINGLE_CHIP
 // ============================================================================
 // Antenna Configuration
 // ============================================================================
 
-void setup_external_antenna(void)
+static void setup_external_antenna(void)
 {
     // Configure GPIO38 to select external antenna (HIGH = external, LOW = internal)
     gpio_config_t antenna_conf = {
@@ -543,11 +814,54 @@ void setup_external_antenna(void)
 
     ESP_LOGI(TAG, "External antenna enabled on GPIO%d (HIGH)", ANTENNA_SELECT_PIN);
 }
+#endif
 
 // ============================================================================
 // PIR Sensor
 // ============================================================================
 
+// Motion edges are timestamped in the GPIO ISR and handled by
+// pir_trigger_task, which sends the UART trigger before doing anything else.
+// Logging and the OLED happen afterwards on pir_report_task so they can't
+// delay a trigger.
+
+#define PIR_EDGE_QUEUE_LEN   8
+#define PIR_REPORT_QUEUE_LEN 8
+#define PIR_TRIGGER_TASK_PRIO 12  // Above UART RX, HTTP and WiFi housekeeping
+
+typedef struct {
+    int64_t edge_us;    // esp_timer time of the GPIO edge
+    uint8_t level;
+} pir_edge_t;
+
+typedef struct {
+    bool motion;
+    uint8_t cmd;        // Trigger sent, 0 if no device was connected
+    int64_t latency_us; // Edge to the trigger frame leaving the UART
+} pir_report_t;
+
+typedef struct {
+    uint32_t count;
+    int64_t last_us;
+    int64_t max_us;
+    int64_t sum_us;
+} pir_latency_stats_t;
+
+static QueueHandle_t pir_edge_queue = NULL;
+static QueueHandle_t pir_report_queue = NULL;
+static pir_latency_stats_t pir_latency;
+
+static void IRAM_ATTR pir_isr_handler(void *arg)
+{
+    pir_edge_t edge = {
+        .edge_us = esp_timer_get_time(),
+        .level = (uint8_t)gpio_get_level(PIR_PIN),
+    };
+    BaseType_t woken = pdFALSE;
+    xQueueSendFromISR(pir_edge_queue, &edge, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
 void setup_pir_sensor(void)
 {
     gpio_config_t pir_conf = {
@@ -555,11 +869,16 @@ void setup_pir_sensor(void)
         .mode = GPIO_MODE_INPUT,
         .pull_up_en = GPIO_PULLUP_DISABLE,
         .pull_down_en = GPIO_PULLDOWN_ENABLE,
-        .intr_type = GPIO_INTR_DISABLE
+        .intr_type = GPIO_INTR_ANYEDGE
     };
     gpio_config(&pir_conf);
 
-    ESP_LOGI(TAG, "PIR sensor initialized on GPIO%d", PIR_PIN);
+    pir_edge_queue = xQueueCreate(PIR_EDGE_QUEUE_LEN, sizeof(pir_edge_t));
+    pir_report_queue = xQueueCreate(PIR_REPORT_QUEUE_LEN, sizeof(pir_report_t));
+    ESP_ERROR_CHECK(gpio_install_isr_service(0));
+    ESP_ERROR_CHECK(gpio_isr_handler_add(PIR_PIN, pir_isr_handler, NULL));
+
+    ESP_LOGI(TAG, "PIR sensor initialized on GPIO%d (edge interrupt)", PIR_PIN);
 }
 
 bool read_pir_sensor(void)
@@ -571,7 +890,20 @@ bool read_pir_sensor(void)
 // UART Communication with XIAO C6 Zigbee Coordinator
 // ============================================================================
 
-void setup_uart(void)
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+// The coordinator runs on this chip; its frames travel over gateway_link
+// with no encoding, so only the rules reply wait is needed.
+static void setup_uart(void)
+{
+    rules_reply_sem = xSemaphoreCreateBinary();
+}
+
+static void uart_send_frame(uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    gateway_link_send(GATEWAY_LINK_COORDINATOR, cmd, payload, len);
+}
+#else
+static void setup_uart(void)
 {
     uart_config_t uart_config = {
         .baud_rate = 115200,
@@ -582,18 +914,36 @@ void setup_uart(void)
         .source_clk = UART_SCLK_DEFAULT,
     };
 
-    ESP_ERROR_CHECK(uart_driver_install(UART_NUM, UART_BUF_SIZE * 2, UART_BUF_SIZE * 2, 0, NULL, 0));
+    ESP_ERROR_CHECK(uart_driver_install(UART_NUM, UART_BUF_SIZE * 2, UART_BUF_SIZE * 2,
+                                        UART_EVENT_QUEUE_LEN, &uart_event_queue, 0));
     ESP_ERROR_CHECK(uart_param_config(UART_NUM, &uart_config));
     ESP_ERROR_CHECK(uart_set_pin(UART_NUM, UART_TX_PIN, UART_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
 
+    uart_tx_mutex = xSemaphoreCreateMutex();
+    rules_reply_sem = xSemaphoreCreateBinary();
+
     ESP_LOGI(TAG, "UART initialized (TX:%d, RX:%d) for XIAO C6 communication", UART_TX_PIN, UART_RX_PIN);
 }
 
+// Encode and send one frame. PIR, HTTP and status tasks all send, so the
+// shared TX buffer is guarded and each frame goes out in one write.
+static void uart_send_frame(uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    xSemaphoreTake(uart_tx_mutex, portMAX_DELAY);
+    size_t n = uart_frame_encode(uart_tx_buf, sizeof(uart_tx_buf), cmd, payload, len);
+    if (n > 0) {
+        uart_write_bytes(UART_NUM, uart_tx_buf, n);
+    } else {
+        ESP_LOGE(TAG, "UART frame 0x%02x too large (%u bytes)", cmd, len);
+    }
+    xSemaphoreGive(uart_tx_mutex);
+}
+#endif
+
 void uart_send_command(uint8_t cmd)
 {
-    uint8_t data[3] = {0xAA, cmd, 0x55}; // Simple framing: start, command, end
-    uart_write_bytes(UART_NUM, data, sizeof(data));
-    ESP_LOGI(TAG, "UART sent command: 0x%02x", cmd);
+    uart_send_frame(cmd, NULL, 0);
+    APPLOGD(UART, TAG, "UART sent command: 0x%02x", cmd);
 }
 
 void uart_request_status(void)
@@ -601,48 +951,308 @@ void uart_request_status(void)
     uart_send_command(CMD_STATUS_REQUEST);
 }
 
-// Task to request status updates every 3 seconds
-void status_request_task(void *pvParameters)
+// Called from the main loop. Status is pushed by the coordinator, so silence
+// past the timeout (no push or heartbeat) means the link or coordinator is down.
+void check_coordinator_timeout(void)
 {
-    // Wait 2 seconds before first request
-    vTaskDelay(pdMS_TO_TICKS(2000));
+    time_t now;
+    time(&now);
+    if (coordinator_online && last_coordinator_response > 0) {
+        if (difftime(now, last_coordinator_response) > COORDINATOR_TIMEOUT_SECONDS) {
+            ESP_LOGW(TAG, "Coordinator timeout - no response for %d seconds", COORDINATOR_TIMEOUT_SECONDS);
+            coordinator_online = false;
+            status_seq_valid = false;
+            publish_status_change();
+        }
+    }
+}
 
-    while (1) {
-        uart_request_status();
-
-        // Check if coordinator has timed out
-        time_t now;
-        time(&now);
-        if (coordinator_online && last_coordinator_response > 0) {
-            if (difftime(now, last_coordinator_response) > COORDINATOR_TIMEOUT_SECONDS) {
-                ESP_LOGW(TAG, "Coordinator timeout - no response for %d seconds", COORDINATOR_TIMEOUT_SECONDS);
-                coordinator_online = false;
-            }
+// ============================================================================
+// Trigger Latency
+// ============================================================================
+
+// Every trigger frame carries a sequence number. The coordinator acks it as
+// soon as it has been admitted, then sends one CMD_TRIGGER_TRACE per device
+// it fired with its own timings, so each hop gets a histogram:
+//
+//   gateway      PIR edge or HTTP request -> trigger frame on the wire
+//   uart         frame on the wire -> CMD_TRIGGER_ACK back (round trip)
+//   coordinator  frame received -> APS send (admission plus request queue)
+//   air          APS send -> ZCL default response (radio, the parent's poll
+//                for a sleepy prop, the prop's On/Off handler)
+//   device       On/Off received -> relay/LEDs switched, timed by the prop
+//   total        origin -> default response back at the coordinator
+//
+// The per-device histograms (coordinator onwards) are in PSRAM.
+
+#define TRIGGER_PENDING_MAX       8   // Recent triggers whose traces can still be matched
+#define TRIGGER_UART_BYTES_PER_MS 11  // 115200 baud, 10 bits a byte
+// A trigger frame is 9 bytes, ~0.8 ms at 115200, but may queue behind the
+// OTA data frame on the wire (ota_send_frame keeps it to one)
+#define TRIGGER_UART_TX_WAIT_MS   (10 + UART_FRAME_MAX_SIZE / TRIGGER_UART_BYTES_PER_MS)
+
+typedef enum {
+    LATENCY_HOP_GATEWAY,
+    LATENCY_HOP_UART,
+    LATENCY_HOP_COORDINATOR,
+    LATENCY_HOP_AIR,
+    LATENCY_HOP_DEVICE,
+    LATENCY_HOP_TOTAL,
+    LATENCY_HOP_COUNT
+} latency_hop_t;
+
+#define LATENCY_DEVICE_HOP_FIRST LATENCY_HOP_COORDINATOR
+#define LATENCY_DEVICE_HOPS      (LATENCY_HOP_COUNT - LATENCY_DEVICE_HOP_FIRST)
+
+static const char *const latency_hop_names[LATENCY_HOP_COUNT] = {
+    "gateway", "uart", "coordinator", "air", "device", "total",
+};
+
+typedef struct {
+    uint16_t seq;        // 0 = free slot
+    int64_t origin_us;
+    int64_t tx_us;       // 0 until the frame is on the wire
+    int64_t ack_us;      // 0 until acked
+} pending_trigger_t;
+
+typedef struct {
+    latency_hist_t hops[LATENCY_DEVICE_HOPS];
+    uint32_t traces;
+    uint32_t not_sent;
+    uint32_t no_response;
+    uint32_t no_actuation;
+} device_latency_t;
+
+static latency_hist_t latency_hops[LATENCY_HOP_COUNT];
+static device_latency_t *device_latency = NULL;  // By device id - 1; NULL without PSRAM
+static pending_trigger_t pending_triggers[TRIGGER_PENDING_MAX];
+static size_t pending_trigger_next = 0;
+static uint16_t trigger_seq_next = 1;
+static uint32_t traces_unmatched = 0;  // Traced trigger no longer pending (or sent before a reboot)
+static SemaphoreHandle_t latency_mutex = NULL;
+static _Atomic int triggers_sending = 0;  // OTA frames hold off while nonzero
+
+void trigger_latency_init(void)
+{
+    device_latency = heap_caps_calloc(DEVICE_STATUS_MAX_DEVICES, sizeof(device_latency_t), MALLOC_CAP_SPIRAM);
+    if (!device_latency) {
+        ESP_LOGW(TAG, "No PSRAM for per-device latency histograms, keeping totals only");
+    }
+    latency_mutex = xSemaphoreCreateMutex();
+}
+
+// Caller holds latency_mutex. seq must be nonzero.
+static pending_trigger_t *pending_trigger_find(uint16_t seq)
+{
+    for (size_t i = 0; i < TRIGGER_PENDING_MAX; i++) {
+        if (pending_triggers[i].seq == seq) {
+            return &pending_triggers[i];
         }
+    }
+    return NULL;
+}
+
+// Send a traced trigger frame and return once it has left the UART.
+// origin_us is when the trigger was asked for (PIR edge, HTTP request);
+// args (may be NULL) follow the sequence in the payload.
+void trigger_send_args(uint8_t cmd, int64_t origin_us, const uint8_t *args, uint16_t args_len)
+{
+    atomic_fetch_add(&triggers_sending, 1);
+    xSemaphoreTake(latency_mutex, portMAX_DELAY);
+    uint16_t seq = trigger_seq_next++;
+    if (trigger_seq_next == 0) {
+        trigger_seq_next = 1;  // 0 means untraced
+    }
+    pending_trigger_t *p = &pending_triggers[pending_trigger_next];
+    pending_trigger_next = (pending_trigger_next + 1) % TRIGGER_PENDING_MAX;
+    *p = (pending_trigger_t){ .seq = seq, .origin_us = origin_us };
+    xSemaphoreGive(latency_mutex);
+
+    uint8_t payload[CHOREO_HEADER_SIZE + CHOREO_MAX_STEPS * CHOREO_STEP_SIZE];  // Largest trigger frame
+    if (args_len > sizeof(payload) - 2) {
+        args_len = sizeof(payload) - 2;
+    }
+    uart_frame_put_u16(payload, seq);
+    if (args_len > 0) {
+        memcpy(&payload[2], args, args_len);
+    }
+    uart_send_frame(cmd, payload, 2 + args_len);
+#if !CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+    if (uart_wait_tx_done(UART_NUM, pdMS_TO_TICKS(TRIGGER_UART_TX_WAIT_MS + args_len / TRIGGER_UART_BYTES_PER_MS)) != ESP_OK) {
+        APPLOG_RATELIMIT(TRIGGER, ESP_LOG_WARN, TAG, 1000, "Trigger 0x%02x still in the UART TX buffer", cmd);
+    }
+#endif
+    int64_t tx_us = esp_timer_get_time();
+    atomic_fetch_sub(&triggers_sending, 1);
+    metrics_inc(METRIC_TRIGGERS_SENT);
+
+    xSemaphoreTake(latency_mutex, portMAX_DELAY);
+    if (p->seq == seq) {  // A burst of triggers may have recycled the slot
+        p->tx_us = tx_us;
+    }
+    latency_hist_add(&latency_hops[LATENCY_HOP_GATEWAY], (uint32_t)(tx_us - origin_us));
+    xSemaphoreGive(latency_mutex);
+}
 
-        vTaskDelay(pdMS_TO_TICKS(3000));  // Request every 3 seconds
+void trigger_send(uint8_t cmd, int64_t origin_us)
+{
+    trigger_send_args(cmd, origin_us, NULL, 0);
+}
+
+// ota_upload's sender. A burst of OTA frames in the TX buffer would hold a
+// trigger back by 40 ms each, so each frame waits for any trigger being
+// sent and then for itself to leave the UART.
+static void ota_send_frame(uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    while (atomic_load(&triggers_sending) > 0) {
+        vTaskDelay(1);
+    }
+    uart_send_frame(cmd, payload, len);
+#if !CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+    uart_wait_tx_done(UART_NUM, pdMS_TO_TICKS(10 + (UART_FRAME_OVERHEAD + len) / TRIGGER_UART_BYTES_PER_MS));
+#endif
+}
+
+// CMD_TRIGGER_ACK (UART receiver task)
+static void trigger_latency_ack(uint16_t seq, uint8_t fired)
+{
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(latency_mutex, portMAX_DELAY);
+    pending_trigger_t *p = seq ? pending_trigger_find(seq) : NULL;
+    if (p && p->tx_us) {
+        p->ack_us = now;
+        latency_hist_add(&latency_hops[LATENCY_HOP_UART], (uint32_t)(now - p->tx_us));
+    }
+    if (p && fired == 0) {
+        p->seq = 0;  // Nothing admitted, no traces will follow
     }
+    xSemaphoreGive(latency_mutex);
+}
+
+// CMD_TRIGGER_TRACE (UART receiver task)
+static void trigger_latency_trace(const uint8_t *payload)
+{
+    uint16_t seq = uart_frame_get_u16(&payload[0]);
+    uint8_t id = payload[2];
+    uint8_t flags = payload[3];
+    uint32_t hop_us[LATENCY_HOP_COUNT];
+    hop_us[LATENCY_HOP_COORDINATOR] = uart_frame_get_u32(&payload[4]);
+    hop_us[LATENCY_HOP_AIR] = uart_frame_get_u32(&payload[8]);
+    hop_us[LATENCY_HOP_DEVICE] = uart_frame_get_u32(&payload[12]);
+    hop_us[LATENCY_HOP_TOTAL] = TRIGGER_TRACE_UNKNOWN;
+
+    xSemaphoreTake(latency_mutex, portMAX_DELAY);
+    pending_trigger_t *p = seq ? pending_trigger_find(seq) : NULL;
+    if (seq && !p) {
+        traces_unmatched++;
+    }
+    // The UART hop one way is taken as half the ack round trip
+    if (p && p->tx_us && p->ack_us && hop_us[LATENCY_HOP_COORDINATOR] != TRIGGER_TRACE_UNKNOWN &&
+        hop_us[LATENCY_HOP_AIR] != TRIGGER_TRACE_UNKNOWN) {
+        int64_t total = (p->tx_us - p->origin_us) + (p->ack_us - p->tx_us) / 2 +
+                        hop_us[LATENCY_HOP_COORDINATOR] + hop_us[LATENCY_HOP_AIR];
+        hop_us[LATENCY_HOP_TOTAL] = total < TRIGGER_TRACE_UNKNOWN ? (uint32_t)total : TRIGGER_TRACE_UNKNOWN - 1;
+    }
+
+    device_latency_t *d = (device_latency && id >= 1 && id <= DEVICE_STATUS_MAX_DEVICES) ? &device_latency[id - 1] : NULL;
+    for (int hop = LATENCY_DEVICE_HOP_FIRST; hop < LATENCY_HOP_COUNT; hop++) {
+        if (hop_us[hop] == TRIGGER_TRACE_UNKNOWN) {
+            continue;
+        }
+        latency_hist_add(&latency_hops[hop], hop_us[hop]);
+        if (d) {
+            latency_hist_add(&d->hops[hop - LATENCY_DEVICE_HOP_FIRST], hop_us[hop]);
+        }
+    }
+    if (d) {
+        d->traces++;
+        d->not_sent += (flags & TRIGGER_TRACE_NOT_SENT) != 0;
+        d->no_response += (flags & TRIGGER_TRACE_NO_RESPONSE) != 0;
+        d->no_actuation += (flags & TRIGGER_TRACE_NO_ACTUATION) != 0;
+    }
+    xSemaphoreGive(latency_mutex);
+
+    APPLOGD(TRIGGER, TAG, "Trigger %u device %u flags 0x%02x: coordinator %lu us, air %lu us, device %lu us, total %lu us",
+            seq, id, flags, hop_us[LATENCY_HOP_COORDINATOR], hop_us[LATENCY_HOP_AIR],
+            hop_us[LATENCY_HOP_DEVICE], hop_us[LATENCY_HOP_TOTAL]);
 }
 
 void trigger_rip_tombstone_uart(void)
 {
-    ESP_LOGI(TAG, "Triggering RIP Tombstone via UART");
-    uart_send_command(CMD_TRIGGER_RIP);
-    log_event(EVENT_TRIGGER_RIP, NULL);
+    int64_t origin_us = esp_timer_get_time();
+    APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Triggering RIP Tombstone via UART");
+    trigger_send(CMD_TRIGGER_RIP, origin_us);
+    log_event(EVENT_TRIGGER_RIP, EVENT_LOG_DEVICE_NONE);
 }
 
 void trigger_halloween_decoration_uart(void)
 {
-    ESP_LOGI(TAG, "Triggering Haunted Pumpkin Scarecrow via UART");
-    uart_send_command(CMD_TRIGGER_HALLOWEEN);
-    log_event(EVENT_TRIGGER_HALLOWEEN, NULL);
+    int64_t origin_us = esp_timer_get_time();
+    APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Triggering Haunted Pumpkin Scarecrow via UART");
+    trigger_send(CMD_TRIGGER_HALLOWEEN, origin_us);
+    log_event(EVENT_TRIGGER_HALLOWEEN, EVENT_LOG_DEVICE_NONE);
 }
 
 void trigger_both_uart(void)
 {
-    ESP_LOGI(TAG, "Triggering BOTH devices via UART");
-    uart_send_command(CMD_TRIGGER_BOTH);
-    log_event(EVENT_TRIGGER_BOTH, NULL);
+    int64_t origin_us = esp_timer_get_time();
+    APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Triggering BOTH devices via UART");
+    trigger_send(CMD_TRIGGER_BOTH, origin_us);
+    log_event(EVENT_TRIGGER_BOTH, EVENT_LOG_DEVICE_NONE);
+}
+
+// Parse a choreography such as "g0@0 d1@350 d2@1200": per step a target
+// (d = device id, g = coordinator group, c = capability mask), '@' and the
+// offset in ms, separated by spaces or commas. Writes the CMD_CHOREOGRAPHY
+// step count and steps to out; returns the step count, or -1 on bad input.
+static int choreography_parse(const char *text, uint8_t *out)
+{
+    uint8_t *step = &out[1];
+    int n = 0;
+
+    while (*text) {
+        if (*text == ' ' || *text == ',' || *text == '\n' || *text == '\r') {
+            text++;
+            continue;
+        }
+        uint8_t kind;
+        switch (*text++) {
+            case 'd': kind = RULE_ACTION_TRIGGER_DEVICE; break;
+            case 'g': kind = RULE_ACTION_TRIGGER_GROUP; break;
+            case 'c': kind = RULE_ACTION_TRIGGER_CAPS; break;
+            default: return -1;
+        }
+        char *end;
+        unsigned long target = strtoul(text, &end, 0);
+        if (end == text || *end != '@' || target > UINT8_MAX) {
+            return -1;
+        }
+        text = end + 1;
+        unsigned long offset_ms = strtoul(text, &end, 10);
+        if (end == text || offset_ms > UINT16_MAX || n == CHOREO_MAX_STEPS) {
+            return -1;
+        }
+        text = end;
+
+        step[0] = kind;
+        step[1] = (uint8_t)target;
+        uart_frame_put_u16(&step[2], (uint16_t)offset_ms);
+        step += CHOREO_STEP_SIZE;
+        n++;
+    }
+    out[0] = (uint8_t)n;
+    return n;
+}
+
+// Send a whole sequence in one frame; the coordinator keeps its timing.
+// No steps cancels what the last one still has staged.
+void choreography_send(const uint8_t *steps, int count)
+{
+    int64_t origin_us = esp_timer_get_time();
+    APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Sending choreography (%d steps) via UART", count);
+    trigger_send_args(CMD_CHOREOGRAPHY, origin_us, steps, 1 + count * CHOREO_STEP_SIZE);
+    log_event(EVENT_CHOREOGRAPHY, EVENT_LOG_DEVICE_NONE);
 }
 
 void uart_send_time_sync(void)
@@ -652,101 +1262,231 @@ void uart_send_time_sync(void)
         return;
     }
 
-    time_t now = time(NULL);
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    // Payload: unix timestamp (u32), microseconds (u32)
+    uint8_t payload[8];
+    uart_frame_put_u32(&payload[0], (uint32_t)now.tv_sec);
+    uart_frame_put_u32(&payload[4], (uint32_t)now.tv_usec);
+    uart_send_frame(CMD_TIME_SYNC, payload, sizeof(payload));
+
+    ESP_LOGI(TAG, "UART sent time sync: %ld.%06ld (Unix timestamp)", (long)now.tv_sec, (long)now.tv_usec);
+
+    struct tm timeinfo;
+    localtime_r(&now.tv_sec, &timeinfo);
+    char time_str[64];
+    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
+    ESP_LOGI(TAG, "   Time: %s", time_str);
+}
+
+// ============================================================================
+// UART Receiver Task (for status updates from XIAO C6)
+// ============================================================================
+
+static void handle_uart_frame(void *ctx, uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    switch (cmd) {
+        case CMD_DEVICE_STATUS: {
+            prop_status_chunk_t chunk;
+            if (!prop_status_decode(devices, payload, len, &chunk)) {
+                break;
+            }
+
+            // Mark coordinator as online and update timestamp
+            coordinator_online = true;
+            time(&last_coordinator_response);
+
+            // Last chunk completes the snapshot; one summary line per snapshot
+            if (chunk.complete) {
+                device_count = (chunk.total < DEVICE_STATUS_MAX_DEVICES) ? chunk.total : DEVICE_STATUS_MAX_DEVICES;
+                last_status_seq = chunk.seq;
+                status_seq_valid = true;
+
+                int connected = 0;
+                for (size_t i = 0; i < device_count; i++) {
+                    connected += devices[i].is_connected;
+                }
+                APPLOG_RATELIMIT(STATUS, ESP_LOG_INFO, TAG, 5000, "Device status updated: %d/%u connected (seq %u)",
+                                 connected, (unsigned)device_count, chunk.seq);
+                publish_status_change();
+            }
+            break;
+        }
+
+        case CMD_TRIGGER_STATS: {
+            if (len < 16) {
+                break;
+            }
+            trigger_filter.accepted = uart_frame_get_u32(&payload[0]);
+            trigger_filter.dropped_cooldown = uart_frame_get_u32(&payload[4]);
+            trigger_filter.dropped_duplicate = uart_frame_get_u32(&payload[8]);
+            trigger_filter.dropped_offline = uart_frame_get_u32(&payload[12]);
+            break;
+        }
+
+        case CMD_RADIO_TELEMETRY: {
+            if (len < RADIO_TELEMETRY_HEADER_SIZE || !radio_telemetry) {
+                break;
+            }
+            uint8_t id = payload[0];
+            uint8_t count = payload[3];
+            if (id == 0 || id > DEVICE_STATUS_MAX_DEVICES || count > RADIO_TELEMETRY_MAX_BUCKETS ||
+                len < RADIO_TELEMETRY_HEADER_SIZE + count * RADIO_TELEMETRY_RECORD_SIZE) {
+                ESP_LOGW(TAG, "Malformed radio telemetry frame (%u bytes)", len);
+                break;
+            }
+            xSemaphoreTake(radio_mutex, portMAX_DELAY);
+            radio_telemetry_t *t = &radio_telemetry[id - 1];
+            t->valid = true;
+            t->count = count;
+            t->bucket_secs = uart_frame_get_u16(&payload[1]);
+            t->delivered = uart_frame_get_u32(&payload[4]);
+            t->failed = uart_frame_get_u32(&payload[8]);
+            t->received_us = esp_timer_get_time();
+            memcpy(t->buckets, &payload[RADIO_TELEMETRY_HEADER_SIZE], count * RADIO_TELEMETRY_RECORD_SIZE);
+            xSemaphoreGive(radio_mutex);
+            break;
+        }
+
+        case CMD_TRIGGER_ACK:
+            if (len >= 3) {
+                trigger_latency_ack(uart_frame_get_u16(payload), payload[2]);
+            }
+            break;
+
+        case CMD_TRIGGER_TRACE:
+            if (len >= TRIGGER_TRACE_SIZE) {
+                trigger_latency_trace(payload);
+            }
+            break;
+
+        case CMD_RULES_STATUS: {
+            if (len < RULE_STATUS_SIZE) {
+                break;
+            }
+            rules_status.builtin = payload[1] != 0;
+            rules_status.rules = uart_frame_get_u16(&payload[2]);
+            rules_status.size = uart_frame_get_u16(&payload[4]);
+            rules_status.crc = uart_frame_get_u16(&payload[6]);
+            rules_status.valid = true;
+            if (payload[0] != RULE_RESULT_REPORT) {
+                rules_status.result = payload[0];
+                xSemaphoreGive(rules_reply_sem);
+            }
+            break;
+        }
+
+        case CMD_OTA_ACK:
+            ota_upload_ack(payload, len);
+            break;
 
-    // Frame: 0xAA CMD_TIME_SYNC timestamp(4 bytes) 0x55
-    uint8_t data[7];
-    data[0] = 0xAA;  // Start byte
-    data[1] = CMD_TIME_SYNC;
-    data[2] = (now >> 24) & 0xFF;  // Unix timestamp big-endian
-    data[3] = (now >> 16) & 0xFF;
-    data[4] = (now >> 8) & 0xFF;
-    data[5] = now & 0xFF;
-    data[6] = 0x55;  // End byte
+        case CMD_OTA_STATUS:
+            ota_upload_status_frame(payload, len);
+            break;
 
-    uart_write_bytes(UART_NUM, data, sizeof(data));
+        case CMD_METRICS:
+            if (len >= 1) {
+                metrics_export_update(payload[0], &payload[1], len - 1);
+            }
+            break;
 
-    ESP_LOGI(TAG, "UART sent time sync: %ld (Unix timestamp)", now);
+        case CMD_HEARTBEAT: {
+            if (len < 1) {
+                break;
+            }
+            bool was_online = coordinator_online;
+            coordinator_online = true;
+            time(&last_coordinator_response);
+
+            // A sequence we haven't seen means a status push was lost (or the
+            // coordinator rebooted) - ask for a fresh snapshot
+            if (!was_online || !status_seq_valid || payload[0] != last_status_seq) {
+                ESP_LOGW(TAG, "Heartbeat seq %u (last status seq %u) - requesting status",
+                         payload[0], last_status_seq);
+                uart_request_status();
+            }
+            break;
+        }
 
-    struct tm timeinfo;
-    localtime_r(&now, &timeinfo);
-    char time_str[64];
-    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
-    ESP_LOGI(TAG, "   Time: %s", time_str);
-}
+        case CMD_DEVICE_JOINED:
+        case CMD_DEVICE_LEFT: {
+            if (len < 1) {
+                break;
+            }
+            const char *device_name = device_name_from_id(payload[0]);
+            if (cmd == CMD_DEVICE_JOINED) {
+                ESP_LOGI(TAG, "Device joined: %s", device_name);
+                log_event(EVENT_DEVICE_JOINED, payload[0]);
+            } else {
+                ESP_LOGI(TAG, "Device left: %s", device_name);
+                log_event(EVENT_DEVICE_LEFT, payload[0]);
+            }
+            break;
+        }
 
-// ============================================================================
-// UART Receiver Task (for status updates from XIAO C6)
-// ============================================================================
+        default:
+            APPLOG_RATELIMIT(UART, ESP_LOG_WARN, TAG, 1000, "UART received unknown frame: 0x%02x (%u bytes)", cmd, len);
+            break;
+    }
+}
 
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+void uart_receiver_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Gateway link receiver task started");
+    gateway_link_run(GATEWAY_LINK_WEB, handle_uart_frame, NULL);
+}
+#else
 void uart_receiver_task(void *pvParameters)
 {
-    uint8_t data[16];
+    static uint8_t data[UART_BUF_SIZE];
+    uart_event_t event;
 
+    uart_frame_parser_init(&uart_parser, handle_uart_frame, NULL);
     ESP_LOGI(TAG, "UART receiver task started");
 
+    // Driven by the UART driver's event queue; partial frames stay in the
+    // parser's ring until the rest arrives
     while (1) {
-        int len = uart_read_bytes(UART_NUM, data, sizeof(data), pdMS_TO_TICKS(100));
-
-        if (len > 0) {
-            // Look for status response frame: 0xAA CMD_STATUS_RESPONSE flags(2 bytes) 0x55
-            for (int i = 0; i < len - 4; i++) {
-                if (data[i] == 0xAA && data[i + 1] == CMD_STATUS_RESPONSE && data[i + 4] == 0x55) {
-                    uint16_t flags = ((uint16_t)data[i + 2] << 8) | data[i + 3];
-
-                    // Parse flags
-                    bool rip_time_synced = (flags & (1 << 0)) != 0;
-                    bool halloween_time_synced = (flags & (1 << 1)) != 0;
-                    bool rip_connected = (flags & (1 << 2)) != 0;
-                    bool halloween_connected = (flags & (1 << 3)) != 0;
-                    bool rip_cooldown = (flags & (1 << 4)) != 0;
-                    bool halloween_cooldown = (flags & (1 << 5)) != 0;
-
-                    // Mark coordinator as online and update timestamp
-                    coordinator_online = true;
-                    time(&last_coordinator_response);
-
-                    // Update device status
-                    rip_tombstone.time_synced = rip_time_synced;
-                    rip_tombstone.is_connected = rip_connected;
-                    rip_tombstone.in_cooldown = rip_cooldown;
-                    halloween_trigger.time_synced = halloween_time_synced;
-                    halloween_trigger.is_connected = halloween_connected;
-                    halloween_trigger.in_cooldown = halloween_cooldown;
-
-                    ESP_LOGI(TAG, "Device status updated: RIP[%s/%s/%s] Halloween[%s/%s/%s]",
-                             rip_connected ? "✓" : "✗",
-                             rip_time_synced ? "✓" : "✗",
-                             rip_cooldown ? "COOL" : "RDY",
-                             halloween_connected ? "✓" : "✗",
-                             halloween_time_synced ? "✓" : "✗",
-                             halloween_cooldown ? "COOL" : "RDY");
-                }
-            }
+        if (xQueueReceive(uart_event_queue, &event, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
 
-            // Look for device join/leave notifications: 0xAA CMD device_id(1 byte) 0x55
-            // device_id: 1 = RIP, 2 = Halloween
-            for (int i = 0; i < len - 3; i++) {
-                if (data[i] == 0xAA && data[i + 3] == 0x55) {
-                    uint8_t cmd = data[i + 1];
-                    uint8_t device_id = data[i + 2];
-
-                    if (cmd == CMD_DEVICE_JOINED) {
-                        const char *device_name = (device_id == 1) ? "RIP Tombstone" :
-                                                 (device_id == 2) ? "Haunted Pumpkin Scarecrow" : "Unknown";
-                        ESP_LOGI(TAG, "Device joined: %s", device_name);
-                        log_event(EVENT_DEVICE_JOINED, device_name);
-                    } else if (cmd == CMD_DEVICE_LEFT) {
-                        const char *device_name = (device_id == 1) ? "RIP Tombstone" :
-                                                 (device_id == 2) ? "Haunted Pumpkin Scarecrow" : "Unknown";
-                        ESP_LOGI(TAG, "Device left: %s", device_name);
-                        log_event(EVENT_DEVICE_LEFT, device_name);
+        switch (event.type) {
+            case UART_DATA: {
+                size_t pending = 0;
+                uart_get_buffered_data_len(UART_NUM, &pending);
+                while (pending > 0) {
+                    int len = uart_read_bytes(UART_NUM, data, pending < sizeof(data) ? pending : sizeof(data), 0);
+                    if (len <= 0) {
+                        break;
                     }
+                    uart_frame_parser_feed(&uart_parser, data, len);
+                    pending -= len;
                 }
+                break;
             }
+
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                ESP_LOGW(TAG, "UART RX overflow, flushing input");
+                uart_flush_input(UART_NUM);
+                xQueueReset(uart_event_queue);
+                uart_frame_parser_reset(&uart_parser);
+                break;
+
+            case UART_FRAME_ERR:
+            case UART_PARITY_ERR:
+                APPLOG_RATELIMIT(UART, ESP_LOG_WARN, TAG, 1000, "UART line error (event %d)", event.type);
+                break;
+
+            default:
+                break;
         }
     }
 }
+#endif
 
 // ============================================================================
 // NTP Time Sync (Los Angeles timezone)
@@ -827,10 +1567,17 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         ESP_LOGI(TAG, "WiFi station started");
 
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+        // The radio is time-shared with 802.15.4, and the coexistence
+        // arbiter needs modem sleep to hand it over between beacons
+        esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+        ESP_LOGI(TAG, "WiFi modem sleep enabled for Zigbee coexistence");
+#else
         // Disable WiFi power management EARLY to prevent WPA3 SA Query timeout
         // and ensure network stack is fully functional
         esp_wifi_set_ps(WIFI_PS_NONE);
         ESP_LOGI(TAG, "🔋 WiFi power management disabled (prevents WPA3 SA Query timeouts)");
+#endif
 
         // Don't connect here - let wifi_init_sta() handle initial connection
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
@@ -888,8 +1635,8 @@ void wifi_init_sta(void)
     esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
 
     // Set hostname for DHCP
-    ESP_ERROR_CHECK(esp_netif_set_hostname(sta_netif, "zigbeeween-tinys3"));
-    ESP_LOGI(TAG, "📛 Hostname set to: zigbeeween-tinys3");
+    ESP_ERROR_CHECK(esp_netif_set_hostname(sta_netif, GATEWAY_HOSTNAME));
+    ESP_LOGI(TAG, "📛 Hostname set to: " GATEWAY_HOSTNAME);
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -928,6 +1675,9 @@ void wifi_init_sta(void)
 
     // Start WiFi
     ESP_ERROR_CHECK(esp_wifi_start());
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP && CONFIG_ESP_COEX_SW_COEXIST_ENABLE
+    ESP_ERROR_CHECK(esp_coex_wifi_i154_enable());
+#endif
 
     // Wait for WiFi to initialize
     vTaskDelay(pdMS_TO_TICKS(200));
@@ -1001,124 +1751,37 @@ void wifi_init_sta(void)
 // HTTP Web Server Handlers
 // ============================================================================
 
-static esp_err_t root_handler(httpd_req_t *req)
+// Static UI (main/web/index.html), gzipped at build time. All live state is
+// fetched from /api/status, so the page itself never changes between builds.
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[] asm("_binary_index_html_gz_end");
+static char index_etag[12];  // Quoted FNV-1a hash of the blob
+
+static void init_index_etag(void)
 {
-    ESP_LOGI(TAG, "HTTP GET /");
+    uint32_t hash = 2166136261u;
+    for (const uint8_t *p = index_html_gz_start; p < index_html_gz_end; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    snprintf(index_etag, sizeof(index_etag), "\"%08lx\"", (unsigned long)hash);
+}
 
-    char time_str[64];
-    get_current_time_str(time_str, sizeof(time_str));
+static esp_err_t root_handler(httpd_req_t *req)
+{
+    httpd_resp_set_hdr(req, "ETag", index_etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "public, max-age=600");
+
+    char if_none_match[sizeof(index_etag) + 4];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, index_etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
 
+    APPLOGI(HTTP, TAG, "HTTP GET /");
     httpd_resp_set_type(req, "text/html; charset=utf-8");
-
-    // Send HTML in chunks
-    httpd_resp_sendstr_chunk(req,
-        "<!DOCTYPE html><html><head>"
-        "<meta charset='utf-8'>"
-        "<title>Zigbee Halloween Controller</title>"
-        "<meta name='viewport' content='width=device-width, initial-scale=1'>"
-        "<style>"
-        "body{font-family:Arial;background:#1a1a1a;color:#fff;padding:20px;text-align:center}"
-        "h1{color:#ff6b00}h2{color:#ff8c00}"
-        ".status{background:#2a2a2a;padding:15px;margin:20px 0;border-radius:10px}"
-        ".status p{margin:8px 0}"
-        ".button{background:#ff6b00;color:#fff;border:none;padding:15px 30px;font-size:18px;"
-        "margin:10px;border-radius:5px;cursor:pointer;min-width:200px}"
-        ".button:hover{background:#ff8c00}"
-        ".button:active{background:#cc5500}"
-        ".motion{color:#00ff00;font-weight:bold}"
-        ".time{color:#88aaff;font-size:14px}"
-        ".arch{color:#888;font-size:12px;margin-top:20px}"
-        "#rip-status b,#halloween-status b{font-size:16px}"
-        ".events{background:#2a2a2a;padding:15px;margin:20px 0;border-radius:10px;max-height:300px;overflow-y:auto;text-align:left}"
-        ".events h3{text-align:center;margin-top:0;color:#ff8c00}"
-        ".event{padding:5px 0;border-bottom:1px solid #444;font-size:13px}"
-        ".event:last-child{border-bottom:none}"
-        ".event-time{color:#88aaff;margin-right:10px}"
-        ".event-type{color:#ffa500}"
-        ".event-device{color:#aaa;margin-left:5px}"
-        "</style></head><body>"
-        "<h1>🎃 Zigbee Halloween Controller 🎃</h1>"
-        "<div class='status'>");
-
-    char buf[128];
-    snprintf(buf, sizeof(buf), "<p class='time'>%s</p>", time_str);
-    httpd_resp_sendstr_chunk(req, buf);
-
-    snprintf(buf, sizeof(buf), "<p>PIR Motion: <span class='motion' id='motion-status'>%s</span></p>",
-             pir_motion_detected ? "DETECTED" : "None");
-    httpd_resp_sendstr_chunk(req, buf);
-
-    // Check if coordinator is online
-    if (!coordinator_online) {
-        httpd_resp_sendstr_chunk(req, "<p style='color: #ff4444; font-weight: bold; font-size: 1.2em;'>⚠ Coordinator OFFLINE</p>");
-    } else {
-        snprintf(buf, sizeof(buf), "<p id='rip-status'>RIP Tombstone: %s | Time: %s | <b>%s</b></p>",
-                 rip_tombstone.is_connected ? "✓ Connected" : "✗ Not connected",
-                 rip_tombstone.time_synced ? "✓ Synced" : "✗ Not synced",
-                 rip_tombstone.in_cooldown ? "COOLDOWN" : "READY");
-        httpd_resp_sendstr_chunk(req, buf);
-
-        snprintf(buf, sizeof(buf), "<p id='halloween-status'>Haunted Pumpkin Scarecrow: %s | Time: %s | <b>%s</b></p>",
-                 halloween_trigger.is_connected ? "✓ Connected" : "✗ Not connected",
-                 halloween_trigger.time_synced ? "✓ Synced" : "✗ Not synced",
-                 halloween_trigger.in_cooldown ? "COOLDOWN" : "READY");
-        httpd_resp_sendstr_chunk(req, buf);
-    }
-
-    httpd_resp_sendstr_chunk(req,
-        "</div>"
-        "<div class='events'>"
-        "<h3>Event Log</h3>"
-        "<div id='event-log'></div>"
-        "</div>"
-        "<h2>Manual Control</h2>"
-        "<form method='POST' action='/trigger/rip'>"
-        "<button class='button' type='submit'>🪦 Trigger RIP Tombstone</button>"
-        "</form>"
-        "<form method='POST' action='/trigger/halloween'>"
-        "<button class='button' type='submit'>🎃 Trigger Pumpkin Scarecrow</button>"
-        "</form>"
-        "<form method='POST' action='/trigger/both'>"
-        "<button class='button' type='submit'>👻 Trigger BOTH</button>"
-        "</form>"
-        "<p class='arch'>TinyS3 (ESP32-S3) + XIAO C6 (Zigbee) via UART</p>"
-        "<script>"
-        "function getEventLabel(type){"
-            "const labels={'motion_detected':'🟢 Motion Detected','motion_stopped':'⚫ Motion Stopped',"
-            "'trigger_rip':'🪦 Trigger RIP','trigger_halloween':'🎃 Trigger Pumpkin Scarecrow',"
-            "'trigger_both':'👻 Trigger Both','device_joined':'✓ Device Joined','device_left':'✗ Device Left'};"
-            "return labels[type]||type;"
-        "}"
-        "function updateStatus(){"
-            "fetch('/api/status')"
-            ".then(r=>r.json())"
-            ".then(d=>{"
-                "document.querySelector('.time').textContent=d.time;"
-                "document.getElementById('motion-status').textContent=d.pir_motion?'DETECTED':'None';"
-                "document.getElementById('rip-status').innerHTML='RIP Tombstone: '+(d.rip_tombstone.connected?'✓ Connected':'✗ Not connected')+' | Time: '+(d.rip_tombstone.time_synced?'✓ Synced':'✗ Not synced')+' | <b>'+(d.rip_tombstone.in_cooldown?'COOLDOWN':'READY')+'</b>';"
-                "document.getElementById('halloween-status').innerHTML='Haunted Pumpkin Scarecrow: '+(d.halloween_trigger.connected?'✓ Connected':'✗ Not connected')+' | Time: '+(d.halloween_trigger.time_synced?'✓ Synced':'✗ Not synced')+' | <b>'+(d.halloween_trigger.in_cooldown?'COOLDOWN':'READY')+'</b>';"
-                "let eventsHtml='';"
-                "if(d.events&&d.events.length>0){"
-                    "d.events.forEach(e=>{"
-                        "eventsHtml+='<div class=\"event\"><span class=\"event-time\">'+e.time+'</span>';"
-                        "eventsHtml+='<span class=\"event-type\">'+getEventLabel(e.type)+'</span>';"
-                        "if(e.device)eventsHtml+='<span class=\"event-device\">- '+e.device+'</span>';"
-                        "eventsHtml+='</div>';"
-                    "});"
-                "}else{"
-                    "eventsHtml='<div style=\"color:#888;text-align:center\">No events yet</div>';"
-                "}"
-                "document.getElementById('event-log').innerHTML=eventsHtml;"
-            "})"
-            ".catch(e=>console.error('Status update failed:',e));"
-        "}"
-        "updateStatus();"  // Update immediately on load
-        "setInterval(updateStatus,2000);"  // Update every 2 seconds
-        "</script>"
-        "</body></html>");
-
-    httpd_resp_sendstr_chunk(req, NULL);
-    return ESP_OK;
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)index_html_gz_start, index_html_gz_end - index_html_gz_start);
 }
 
 static esp_err_t trigger_rip_handler(httpd_req_t *req)
@@ -1148,82 +1811,725 @@ static esp_err_t trigger_both_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+// json_writer flush callback: each full buffer goes out as one HTTP chunk
+static esp_err_t json_flush_httpd_chunk(void *ctx, const char *data, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+}
+
+// Unsigned query parameter; false (and *out untouched) if absent
+static bool query_u32(httpd_req_t *req, const char *key, uint32_t *out)
+{
+    char query[64];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, key, value, sizeof(value)) != ESP_OK) {
+        return false;
+    }
+    *out = (uint32_t)strtoul(value, NULL, 10);
+    return true;
+}
+
 static esp_err_t status_json_handler(httpd_req_t *req)
 {
-    ESP_LOGI(TAG, "HTTP GET /api/status");
+    APPLOGD(HTTP, TAG, "HTTP GET /api/status");
+
+    // ?since=<seq> returns only events newer than seq
+    uint32_t since = 0;
+    bool since_given = query_u32(req, "since", &since);
 
     char time_str[64];
     get_current_time_str(time_str, sizeof(time_str));
 
     httpd_resp_set_type(req, "application/json");
 
-    // Start building JSON (use chunked sending for large responses)
-    httpd_resp_sendstr_chunk(req, "{");
-
-    // Current status
-    char buf[512];
-    snprintf(buf, sizeof(buf),
-        "\"time\":\"%s\","
-        "\"pir_motion\":%s,"
-        "\"rip_tombstone\":{"
-            "\"connected\":%s,"
-            "\"time_synced\":%s,"
-            "\"in_cooldown\":%s"
-        "},"
-        "\"halloween_trigger\":{"
-            "\"connected\":%s,"
-            "\"time_synced\":%s,"
-            "\"in_cooldown\":%s"
-        "},",
-        time_str,
-        pir_motion_detected ? "true" : "false",
-        rip_tombstone.is_connected ? "true" : "false",
-        rip_tombstone.time_synced ? "true" : "false",
-        rip_tombstone.in_cooldown ? "true" : "false",
-        halloween_trigger.is_connected ? "true" : "false",
-        halloween_trigger.time_synced ? "true" : "false",
-        halloween_trigger.in_cooldown ? "true" : "false"
-    );
-    httpd_resp_sendstr_chunk(req, buf);
-
-    // Event log (last 20 events, newest first)
-    httpd_resp_sendstr_chunk(req, "\"events\":[");
-
-    int events_to_show = (event_log_count < 20) ? event_log_count : 20;
-    for (int i = 0; i < events_to_show; i++) {
-        // Calculate index (newest first)
-        int idx = (event_log_head - 1 - i + MAX_EVENTS) % MAX_EVENTS;
-        if (idx < 0 || idx >= event_log_count) continue;
-
-        const char *event_type;
-        switch (event_log[idx].type) {
-            case EVENT_MOTION_DETECTED: event_type = "motion_detected"; break;
-            case EVENT_MOTION_STOPPED: event_type = "motion_stopped"; break;
-            case EVENT_TRIGGER_RIP: event_type = "trigger_rip"; break;
-            case EVENT_TRIGGER_HALLOWEEN: event_type = "trigger_halloween"; break;
-            case EVENT_TRIGGER_BOTH: event_type = "trigger_both"; break;
-            case EVENT_DEVICE_JOINED: event_type = "device_joined"; break;
-            case EVENT_DEVICE_LEFT: event_type = "device_left"; break;
-            default: event_type = "unknown"; break;
+    // One MSS-sized buffer, flushed as a chunk only when full. httpd runs
+    // handlers on a single task, so it can be static.
+    static char send_buf[1436];
+    json_writer_t w;
+    json_writer_init(&w, send_buf, sizeof(send_buf), json_flush_httpd_chunk, req);
+
+    json_obj_open(&w, NULL);
+    json_str(&w, "time", time_str);
+    json_bool(&w, "pir_motion", pir_motion_detected);
+    json_bool(&w, "coordinator_online", coordinator_online);
+
+    // Every device the coordinator reported
+    prop_status_json(&w, "devices", devices, device_count);
+
+    json_obj_open(&w, "trigger_filter");
+    json_uint(&w, "accepted", trigger_filter.accepted);
+    json_uint(&w, "dropped_cooldown", trigger_filter.dropped_cooldown);
+    json_uint(&w, "dropped_duplicate", trigger_filter.dropped_duplicate);
+    json_uint(&w, "dropped_offline", trigger_filter.dropped_offline);
+    json_obj_close(&w);
+
+    json_obj_open(&w, "pir_latency_us");
+    json_uint(&w, "count", pir_latency.count);
+    json_int(&w, "last", pir_latency.last_us);
+    json_int(&w, "max", pir_latency.max_us);
+    json_int(&w, "avg", pir_latency.count ? pir_latency.sum_us / pir_latency.count : 0);
+    json_obj_close(&w);
+
+    event_clock_t clock = event_clock_now();
+    uint32_t latest = event_log_latest_seq();
+    uint32_t last_sent = latest;
+    bool more = false;
+    bool reset = false;
+
+    // A since past our newest means we rebooted; start the client over
+    if (since_given && since > latest) {
+        since_given = false;
+        reset = true;
+    }
+
+    json_arr_open(&w, "events");
+    if (since_given) {
+        // Everything after ?since=, oldest first, so a client can keep
+        // passing back event_seq
+        uint32_t seq = since + 1;
+        if (seq < event_log_oldest_seq()) {
+            seq = event_log_oldest_seq();
+        }
+        last_sent = since;
+        int sent = 0;
+        for (; seq <= latest; seq++) {
+            if (sent == STATUS_EVENTS_MAX) {
+                more = true;
+                break;
+            }
+            event_log_entry_t e;
+            event_log_read_t r = event_log_read(seq, &e);
+            if (r == EVENT_LOG_READ_PENDING) {
+                break;  // Still being written; the client picks it up next time
+            }
+            last_sent = seq;
+            if (r == EVENT_LOG_READ_OVERWRITTEN) {
+                continue;
+            }
+            event_json(&w, &e, &clock);
+            sent++;
+        }
+    } else {
+        // Latest events, newest first
+        int sent = 0;
+        for (uint32_t seq = latest; seq >= 1 && sent < STATUS_EVENTS_LATEST; seq--) {
+            event_log_entry_t e;
+            event_log_read_t r = event_log_read(seq, &e);
+            if (r == EVENT_LOG_READ_OVERWRITTEN) {
+                break;  // Everything older is gone too
+            }
+            if (r == EVENT_LOG_READ_PENDING) {
+                continue;
+            }
+            event_json(&w, &e, &clock);
+            sent++;
         }
+    }
+    json_arr_close(&w);
 
-        struct tm timeinfo;
-        localtime_r(&event_log[idx].timestamp, &timeinfo);
-        char event_time[32];
-        strftime(event_time, sizeof(event_time), "%H:%M:%S", &timeinfo);
+    json_uint(&w, "event_seq", last_sent);
+    json_bool(&w, "events_more", more);
+    json_bool(&w, "events_reset", reset);
+    json_obj_close(&w);
 
-        if (event_log[idx].device_name[0] != '\0') {
-            snprintf(buf, sizeof(buf), "%s{\"time\":\"%s\",\"type\":\"%s\",\"device\":\"%s\"}",
-                     (i > 0) ? "," : "", event_time, event_type, event_log[idx].device_name);
-        } else {
-            snprintf(buf, sizeof(buf), "%s{\"time\":\"%s\",\"type\":\"%s\"}",
-                     (i > 0) ? "," : "", event_time, event_type);
+    if (json_writer_finish(&w) != ESP_OK) {
+        ESP_LOGW(TAG, "/api/status send failed");
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+// GET /api/history?from=&to= - journal records between two Unix times
+// (inclusive, default everything), oldest first, streamed straight off flash
+static esp_err_t history_handler(httpd_req_t *req)
+{
+    uint32_t from = 0;
+    uint32_t to = UINT32_MAX;
+    query_u32(req, "from", &from);
+    query_u32(req, "to", &to);
+    APPLOGI(HTTP, TAG, "HTTP GET /api/history from %lu to %lu", (unsigned long)from, (unsigned long)to);
+
+    httpd_resp_set_type(req, "application/json");
+
+    static char send_buf[1436];  // httpd task only
+    json_writer_t w;
+    json_writer_init(&w, send_buf, sizeof(send_buf), json_flush_httpd_chunk, req);
+
+    json_obj_open(&w, NULL);
+    json_uint(&w, "from", from);
+    json_uint(&w, "to", to);
+
+    uint32_t totals[EVENT_TYPE_COUNT] = {0};
+    journal_iter_t it;
+    journal_record_t rec;
+    journal_iter_begin(&it, from, to);
+
+    json_arr_open(&w, "records");
+    while (w.err == ESP_OK && journal_iter_next(&it, &rec)) {
+        json_obj_open(&w, NULL);
+        json_uint(&w, "t", rec.time);
+        json_str(&w, "type", event_type_name(rec.type));
+        if (rec.device_id != EVENT_LOG_DEVICE_NONE) {
+            json_str(&w, "device", device_name_from_id(rec.device_id));
+        }
+        json_obj_close(&w);
+        if (rec.type < EVENT_TYPE_COUNT) {
+            totals[rec.type]++;
+        }
+    }
+    json_arr_close(&w);
+
+    json_obj_open(&w, "totals");
+    for (int type = 0; type < EVENT_TYPE_COUNT; type++) {
+        json_uint(&w, event_type_name(type), totals[type]);
+    }
+    json_obj_close(&w);
+
+    journal_stats_t stats;
+    journal_get_stats(&stats);
+    json_obj_open(&w, "journal");
+    json_uint(&w, "sectors", stats.sectors);
+    json_uint(&w, "records_written", stats.records_written);
+    json_uint(&w, "flushes", stats.flushes);
+    json_uint(&w, "erases", stats.erases);
+    json_uint(&w, "torn_records", stats.torn_records);
+    json_uint(&w, "dropped", stats.dropped);
+    json_obj_close(&w);
+    json_obj_close(&w);
+
+    if (json_writer_finish(&w) != ESP_OK) {
+        ESP_LOGW(TAG, "/api/history send failed");
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+static void radio_telemetry_init(void)
+{
+    size_t size = DEVICE_STATUS_MAX_DEVICES * sizeof(radio_telemetry_t);
+    radio_telemetry = heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM);
+    if (!radio_telemetry) {
+        radio_telemetry = calloc(1, size);
+    }
+    radio_mutex = xSemaphoreCreateMutex();
+}
+
+static void radio_triple(json_writer_t *w, const char *key, uint32_t a, uint32_t b, uint32_t c, bool is_signed)
+{
+    json_arr_open(w, key);
+    if (is_signed) {
+        json_int(w, NULL, (int8_t)a);
+        json_int(w, NULL, (int8_t)b);
+        json_int(w, NULL, (int8_t)c);
+    } else {
+        json_uint(w, NULL, a);
+        json_uint(w, NULL, b);
+        json_uint(w, NULL, c);
+    }
+    json_arr_close(w);
+}
+
+// GET /api/radio - per-device link history: overall min/avg/max LQI and RSSI,
+// delivery counts and a marginal flag, then each bucket oldest first
+static esp_err_t radio_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/json");
+
+    static char send_buf[1436];  // httpd task only
+    json_writer_t w;
+    json_writer_init(&w, send_buf, sizeof(send_buf), json_flush_httpd_chunk, req);
+
+    int64_t now = esp_timer_get_time();
+    json_obj_open(&w, NULL);
+    json_arr_open(&w, "devices");
+    for (size_t i = 0; radio_telemetry && i < device_count; i++) {
+        radio_telemetry_t t;
+        xSemaphoreTake(radio_mutex, portMAX_DELAY);
+        t = radio_telemetry[i];
+        xSemaphoreGive(radio_mutex);
+        if (!t.valid) {
+            continue;
+        }
+
+        // Totals over the buckets that have link samples
+        unsigned lqi_min = 255, lqi_max = 0, lqi_sum = 0, sampled = 0, window_ok = 0, window_fail = 0;
+        int rssi_min = 127, rssi_max = -128, rssi_sum = 0;
+        for (uint8_t k = 0; k < t.count; k++) {
+            const uint8_t *b = t.buckets[k];
+            window_ok += b[6];
+            window_fail += b[7];
+            if (b[1] == 0) {
+                continue;
+            }
+            sampled++;
+            lqi_min = b[0] < lqi_min ? b[0] : lqi_min;
+            lqi_max = b[2] > lqi_max ? b[2] : lqi_max;
+            lqi_sum += b[1];
+            rssi_min = (int8_t)b[3] < rssi_min ? (int8_t)b[3] : rssi_min;
+            rssi_max = (int8_t)b[5] > rssi_max ? (int8_t)b[5] : rssi_max;
+            rssi_sum += (int8_t)b[4];
+        }
+        unsigned lqi_avg = sampled ? lqi_sum / sampled : 0;
+        unsigned window_total = window_ok + window_fail;
+        bool marginal = (sampled && lqi_avg < RADIO_MARGINAL_LQI) ||
+                        (window_total && window_fail * 100 > window_total * RADIO_MARGINAL_FAIL_PCT);
+
+        json_obj_open(&w, NULL);
+        json_uint(&w, "id", i + 1);
+        json_str(&w, "name", devices[i].name);
+        json_uint(&w, "age_s", (uint32_t)((now - t.received_us) / 1000000));
+        json_uint(&w, "bucket_secs", t.bucket_secs);
+        json_uint(&w, "delivered", t.delivered);
+        json_uint(&w, "failed", t.failed);
+        json_bool(&w, "marginal", marginal);
+        if (sampled) {
+            radio_triple(&w, "lqi", lqi_min, lqi_avg, lqi_max, false);
+            radio_triple(&w, "rssi", (uint32_t)rssi_min, (uint32_t)(rssi_sum / (int)sampled), (uint32_t)rssi_max, true);
+        }
+        json_arr_open(&w, "buckets");
+        for (uint8_t k = 0; k < t.count; k++) {
+            const uint8_t *b = t.buckets[k];
+            json_obj_open(&w, NULL);
+            if (b[1] != 0) {
+                radio_triple(&w, "lqi", b[0], b[1], b[2], false);
+                radio_triple(&w, "rssi", b[3], b[4], b[5], true);
+            }
+            json_uint(&w, "ok", b[6]);
+            json_uint(&w, "fail", b[7]);
+            json_obj_close(&w);
+        }
+        json_arr_close(&w);
+        json_obj_close(&w);
+    }
+    json_arr_close(&w);
+    json_obj_close(&w);
+
+    if (json_writer_finish(&w) != ESP_OK) {
+        ESP_LOGW(TAG, "/api/radio send failed");
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+static void latency_summary_json(json_writer_t *w, const char *key, const latency_summary_t *s)
+{
+    json_obj_open(w, key);
+    json_uint(w, "count", s->count);
+    if (s->count > 0) {
+        json_uint(w, "p50_us", s->p50_us);
+        json_uint(w, "p95_us", s->p95_us);
+        json_uint(w, "p99_us", s->p99_us);
+        json_uint(w, "max_us", s->max_us);
+        json_uint(w, "avg_us", s->avg_us);
+    }
+    json_obj_close(w);
+}
+
+// GET /api/latency - trigger latency percentiles per hop, overall and per
+// device (see "Trigger Latency")
+static esp_err_t latency_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/json");
+
+    static char send_buf[1436];  // httpd task only
+    json_writer_t w;
+    json_writer_init(&w, send_buf, sizeof(send_buf), json_flush_httpd_chunk, req);
+
+    latency_summary_t summary[LATENCY_HOP_COUNT];
+    uint32_t unmatched;
+    xSemaphoreTake(latency_mutex, portMAX_DELAY);
+    for (int hop = 0; hop < LATENCY_HOP_COUNT; hop++) {
+        latency_hist_summarize(&latency_hops[hop], &summary[hop]);
+    }
+    unmatched = traces_unmatched;
+    xSemaphoreGive(latency_mutex);
+
+    json_obj_open(&w, NULL);
+    json_uint(&w, "unmatched", unmatched);
+    json_obj_open(&w, "hops");
+    for (int hop = 0; hop < LATENCY_HOP_COUNT; hop++) {
+        latency_summary_json(&w, latency_hop_names[hop], &summary[hop]);
+    }
+    json_obj_close(&w);
+
+    json_arr_open(&w, "devices");
+    for (size_t i = 0; device_latency && i < device_count; i++) {
+        xSemaphoreTake(latency_mutex, portMAX_DELAY);
+        const device_latency_t *d = &device_latency[i];
+        uint32_t traces = d->traces, not_sent = d->not_sent;
+        uint32_t no_response = d->no_response, no_actuation = d->no_actuation;
+        for (int k = 0; k < LATENCY_DEVICE_HOPS; k++) {
+            latency_hist_summarize(&d->hops[k], &summary[k]);
+        }
+        xSemaphoreGive(latency_mutex);
+        if (traces == 0) {
+            continue;
+        }
+
+        json_obj_open(&w, NULL);
+        json_uint(&w, "id", i + 1);
+        json_str(&w, "name", devices[i].name);
+        json_uint(&w, "traces", traces);
+        json_uint(&w, "not_sent", not_sent);
+        json_uint(&w, "no_response", no_response);
+        json_uint(&w, "no_actuation", no_actuation);
+        json_obj_open(&w, "hops");
+        for (int k = 0; k < LATENCY_DEVICE_HOPS; k++) {
+            latency_summary_json(&w, latency_hop_names[LATENCY_DEVICE_HOP_FIRST + k], &summary[k]);
+        }
+        json_obj_close(&w);
+        json_obj_close(&w);
+    }
+    json_arr_close(&w);
+    json_obj_close(&w);
+
+    if (json_writer_finish(&w) != ESP_OK) {
+        ESP_LOGW(TAG, "/api/latency send failed");
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+static const char *rule_result_name(uint8_t result)
+{
+    switch (result) {
+        case RULE_RESULT_OK: return "ok";
+        case RULE_RESULT_BAD_FORMAT: return "bad_format";
+        case RULE_RESULT_TOO_LARGE: return "too_large";
+        case RULE_RESULT_BAD_CRC: return "bad_crc";
+        case RULE_RESULT_STORAGE: return "storage";
+        case RULE_RESULT_SEQUENCE: return "sequence";
+        default: return "unknown";
+    }
+}
+
+// Stream a table (size 0 = revert to the built-in one) to the coordinator
+// and wait for its verdict. False on no reply. httpd task only.
+static bool rules_upload(const uint8_t *table, uint16_t size, uint8_t *result)
+{
+    static uint8_t frame[2 + RULE_DATA_CHUNK];
+
+    xSemaphoreTake(rules_reply_sem, 0);  // Drop a reply that came in late for an earlier upload
+    uart_frame_put_u16(frame, size);
+    uart_send_frame(CMD_RULES_BEGIN, frame, 2);
+    for (uint16_t offset = 0; offset < size; offset += RULE_DATA_CHUNK) {
+        uint16_t n = (size - offset < RULE_DATA_CHUNK) ? size - offset : RULE_DATA_CHUNK;
+        uart_frame_put_u16(frame, offset);
+        memcpy(&frame[2], &table[offset], n);
+        uart_send_frame(CMD_RULES_DATA, frame, 2 + n);
+    }
+    uart_send_command(CMD_RULES_COMMIT);
+
+    if (xSemaphoreTake(rules_reply_sem, pdMS_TO_TICKS(RULES_REPLY_TIMEOUT_MS)) != pdTRUE) {
+        return false;
+    }
+    *result = rules_status.result;
+    return true;
+}
+
+static esp_err_t rules_json_send(httpd_req_t *req, const char *result)
+{
+    httpd_resp_set_type(req, "application/json");
+
+    char buf[160];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf), json_flush_httpd_chunk, req);
+    json_obj_open(&w, NULL);
+    if (result) {
+        json_str(&w, "result", result);
+    }
+    json_bool(&w, "known", rules_status.valid);
+    json_bool(&w, "builtin", rules_status.builtin);
+    json_uint(&w, "rules", rules_status.rules);
+    json_uint(&w, "size", rules_status.size);
+    json_uint(&w, "crc", rules_status.crc);
+    json_obj_close(&w);
+
+    if (json_writer_finish(&w) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+// GET /api/rules - the coordinator's active rule table (see "Rule Tables")
+static esp_err_t rules_get_handler(httpd_req_t *req)
+{
+    return rules_json_send(req, NULL);
+}
+
+// POST /api/rules - body is a compiled table; DELETE reverts to the built-in one
+static esp_err_t rules_put_handler(httpd_req_t *req)
+{
+    static uint8_t table[RULE_TABLE_MAX_SIZE];  // httpd task only
+    size_t size = (req->method == HTTP_DELETE) ? 0 : req->content_len;
+
+    APPLOGI(HTTP, TAG, "HTTP %s /api/rules (%u bytes)", req->method == HTTP_DELETE ? "DELETE" : "POST", (unsigned)size);
+    if (size > sizeof(table)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Rule table too large");
+        return ESP_FAIL;
+    }
+    for (size_t got = 0; got < size;) {
+        int n = httpd_req_recv(req, (char *)&table[got], size - got);
+        if (n <= 0) {
+            if (n == HTTPD_SOCK_ERR_TIMEOUT) {
+                continue;
+            }
+            return ESP_FAIL;
+        }
+        got += n;
+    }
+    if (!coordinator_online) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "Coordinator offline");
+    }
+
+    uint8_t result;
+    if (!rules_upload(table, (uint16_t)size, &result)) {
+        httpd_resp_set_status(req, "504 Gateway Timeout");
+        return httpd_resp_sendstr(req, "No reply from the coordinator");
+    }
+    if (result != RULE_RESULT_OK && result != RULE_RESULT_STORAGE) {
+        httpd_resp_set_status(req, "422 Unprocessable Entity");
+    }
+    ESP_LOGI(TAG, "Rule table upload: %s", rule_result_name(result));
+    return rules_json_send(req, rule_result_name(result));
+}
+
+static esp_err_t ota_json_send(httpd_req_t *req, const ota_app_info_t *accepted)
+{
+    httpd_resp_set_type(req, "application/json");
+
+    static char buf[512];  // httpd task only
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf), json_flush_httpd_chunk, req);
+    json_obj_open(&w, NULL);
+    if (accepted) {
+        json_obj_open(&w, "accepted");
+        json_str(&w, "project", accepted->project);
+        json_str(&w, "version", accepted->version);
+        json_str(&w, "image", ota_file_image_name(accepted->image_type));
+        json_uint(&w, "file_version", accepted->file_version);
+        json_obj_close(&w);
+    }
+    json_bool(&w, "coordinator_online", coordinator_online);
+    ota_upload_json(&w, device_name_from_id);
+    json_obj_close(&w);
+
+    if (json_writer_finish(&w) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+// GET /api/ota - the upload in progress, the coordinator's staged image and
+// which props have it
+static esp_err_t ota_get_handler(httpd_req_t *req)
+{
+    return ota_json_send(req, NULL);
+}
+
+// POST /api/ota - body is a prop's app image (build/<project>.bin). It is
+// checked, wrapped in an OTA file and streamed to the coordinator in the
+// background; poll GET /api/ota for progress.
+#if !CONFIG_SPIRAM
+// ota_upload_stream() reader over the request body
+static bool ota_body_read(void *ctx, uint8_t *buf, size_t len)
+{
+    httpd_req_t *req = ctx;
+    for (size_t got = 0; got < len;) {
+        int n = httpd_req_recv(req, (char *)&buf[got], len - got);
+        if (n <= 0) {
+            if (n == HTTPD_SOCK_ERR_TIMEOUT) {
+                continue;
+            }
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+#endif
+
+static esp_err_t ota_post_handler(httpd_req_t *req)
+{
+    size_t size = req->content_len;
+
+    APPLOGI(HTTP, TAG, "HTTP POST /api/ota (%u bytes)", (unsigned)size);
+    if (!coordinator_online) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "Coordinator offline");
+    }
+    if (ota_upload_busy()) {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_sendstr(req, "An upload is already running");
+    }
+#if !CONFIG_SPIRAM
+    // No room to hold the image, so it goes to the coordinator as it
+    // arrives and the reply waits for the coordinator's verdict
+    ota_app_info_t info;
+    esp_err_t err = ota_upload_stream(size, ota_body_read, req, &info);
+    if (err == ESP_ERR_INVALID_SIZE) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Image size out of range");
+        return ESP_FAIL;
+    }
+    if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_set_status(req, "422 Unprocessable Entity");
+        return httpd_resp_sendstr(req, "Not an app image of a known prop");
+    }
+    if (err == ESP_FAIL) {
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        httpd_resp_set_status(req, "502 Bad Gateway");
+    }
+    return ota_json_send(req, &info);
+#else
+    uint8_t *image = ota_upload_buffer(size);
+    if (!image) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Image size out of range or no memory");
+        return ESP_FAIL;
+    }
+    for (size_t got = 0; got < size;) {
+        int n = httpd_req_recv(req, (char *)&image[got], size - got);
+        if (n <= 0) {
+            if (n == HTTPD_SOCK_ERR_TIMEOUT) {
+                continue;
+            }
+            ota_upload_discard();
+            return ESP_FAIL;
+        }
+        got += n;
+    }
+
+    ota_app_info_t info;
+    esp_err_t err = ota_upload_start(&info);
+    if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_set_status(req, "422 Unprocessable Entity");
+        return httpd_resp_sendstr(req, "Not an app image of a known prop");
+    }
+    if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not start the upload");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_status(req, "202 Accepted");
+    return ota_json_send(req, &info);
+#endif
+}
+
+// DELETE /api/ota - the coordinator stops offering its staged image
+static esp_err_t ota_delete_handler(httpd_req_t *req)
+{
+    APPLOGI(HTTP, TAG, "HTTP DELETE /api/ota");
+    if (!coordinator_online) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "Coordinator offline");
+    }
+    if (!ota_upload_drop()) {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_sendstr(req, "An upload is running");
+    }
+    return ota_json_send(req, NULL);
+}
+
+// POST /api/choreo - body is a step list for choreography_parse(), e.g.
+// "g0@0 d1@350"; an empty body cancels the staged steps
+static esp_err_t choreo_handler(httpd_req_t *req)
+{
+    char body[CHOREO_MAX_STEPS * 16];
+    if (req->content_len >= sizeof(body)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Choreography too long");
+        return ESP_FAIL;
+    }
+    size_t got = 0;
+    while (got < req->content_len) {
+        int n = httpd_req_recv(req, &body[got], req->content_len - got);
+        if (n <= 0) {
+            if (n == HTTPD_SOCK_ERR_TIMEOUT) {
+                continue;
+            }
+            return ESP_FAIL;
+        }
+        got += n;
+    }
+    body[got] = '\0';
+
+    uint8_t steps[1 + CHOREO_MAX_STEPS * CHOREO_STEP_SIZE];
+    int count = choreography_parse(body, steps);
+    if (count < 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad step list (expected e.g. \"g0@0 d1@350\")");
+        return ESP_FAIL;
+    }
+    if (!coordinator_online) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "Coordinator offline");
+    }
+    choreography_send(steps, count);
+
+    char resp[24];
+    snprintf(resp, sizeof(resp), "{\"steps\":%d}", count);
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, resp);
+}
+
+// GET /metrics - every board's metrics registry plus the trigger latency
+// hops, in Prometheus text format
+static esp_err_t metrics_handler(httpd_req_t *req)
+{
+    static metrics_snapshot_t local;   // httpd task only
+    static char send_buf[1436];
+
+#if !CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+    metrics_set(METRIC_UART_FRAMES_OK, (int32_t)uart_parser.stats.frames_ok);
+    metrics_set(METRIC_UART_CRC_ERRORS, (int32_t)uart_parser.stats.crc_errors);
+    metrics_set(METRIC_UART_BAD_HEADER, (int32_t)uart_parser.stats.bad_header);
+    metrics_set(METRIC_UART_DROPPED_BYTES, (int32_t)uart_parser.stats.dropped_bytes);
+#endif
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        metrics_set(METRIC_WIFI_RSSI, ap_info.rssi);
+    }
+    metrics_sample_system();
+    metrics_snapshot_local(&local);
+
+    latency_summary_t summary[LATENCY_HOP_COUNT];
+    uint64_t sum_us[LATENCY_HOP_COUNT];
+    xSemaphoreTake(latency_mutex, portMAX_DELAY);
+    for (int hop = 0; hop < LATENCY_HOP_COUNT; hop++) {
+        latency_hist_summarize(&latency_hops[hop], &summary[hop]);
+        sum_us[hop] = latency_hops[hop].sum_us;
+    }
+    xSemaphoreGive(latency_mutex);
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    prom_writer_t w;
+    prom_writer_init(&w, send_buf, sizeof(send_buf), req);
+    metrics_export_write(&w, &local, device_name_from_id);
+
+    prom_header(&w, "trigger_latency_us", "summary", "Trigger latency per hop (see /api/latency)");
+    for (int hop = 0; hop < LATENCY_HOP_COUNT; hop++) {
+        const latency_summary_t *s = &summary[hop];
+        const char *name = latency_hop_names[hop];
+        if (s->count > 0) {
+            prom_printf(&w, "zigbeeween_trigger_latency_us{hop=\"%s\",quantile=\"0.5\"} %lu\n", name, (unsigned long)s->p50_us);
+            prom_printf(&w, "zigbeeween_trigger_latency_us{hop=\"%s\",quantile=\"0.95\"} %lu\n", name, (unsigned long)s->p95_us);
+            prom_printf(&w, "zigbeeween_trigger_latency_us{hop=\"%s\",quantile=\"0.99\"} %lu\n", name, (unsigned long)s->p99_us);
         }
-        httpd_resp_sendstr_chunk(req, buf);
+        prom_printf(&w, "zigbeeween_trigger_latency_us_sum{hop=\"%s\"} %llu\n", name, (unsigned long long)sum_us[hop]);
+        prom_printf(&w, "zigbeeween_trigger_latency_us_count{hop=\"%s\"} %lu\n", name, (unsigned long)s->count);
     }
 
-    httpd_resp_sendstr_chunk(req, "]}");
-    httpd_resp_sendstr_chunk(req, NULL);
+    if (prom_writer_finish(&w) != ESP_OK) {
+        ESP_LOGW(TAG, "/metrics send failed");
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
 }
 
@@ -1232,6 +2538,11 @@ httpd_handle_t start_webserver(void)
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.lru_purge_enable = true;
+    config.close_fn = http_close_fn;
+    config.max_uri_handlers = 20;
+
+    init_index_etag();
+    sse_mutex = xSemaphoreCreateMutex();
 
     if (httpd_start(&server, &config) == ESP_OK) {
         httpd_uri_t root = {.uri = "/", .method = HTTP_GET, .handler = root_handler};
@@ -1240,6 +2551,42 @@ httpd_handle_t start_webserver(void)
         httpd_uri_t status_json = {.uri = "/api/status", .method = HTTP_GET, .handler = status_json_handler};
         httpd_register_uri_handler(server, &status_json);
 
+        httpd_uri_t events = {.uri = "/api/events", .method = HTTP_GET, .handler = events_handler};
+        httpd_register_uri_handler(server, &events);
+
+        httpd_uri_t history = {.uri = "/api/history", .method = HTTP_GET, .handler = history_handler};
+        httpd_register_uri_handler(server, &history);
+
+        httpd_uri_t radio = {.uri = "/api/radio", .method = HTTP_GET, .handler = radio_handler};
+        httpd_register_uri_handler(server, &radio);
+
+        httpd_uri_t latency = {.uri = "/api/latency", .method = HTTP_GET, .handler = latency_handler};
+        httpd_register_uri_handler(server, &latency);
+
+        httpd_uri_t rules_get = {.uri = "/api/rules", .method = HTTP_GET, .handler = rules_get_handler};
+        httpd_register_uri_handler(server, &rules_get);
+
+        httpd_uri_t rules_post = {.uri = "/api/rules", .method = HTTP_POST, .handler = rules_put_handler};
+        httpd_register_uri_handler(server, &rules_post);
+
+        httpd_uri_t rules_delete = {.uri = "/api/rules", .method = HTTP_DELETE, .handler = rules_put_handler};
+        httpd_register_uri_handler(server, &rules_delete);
+
+        httpd_uri_t choreo = {.uri = "/api/choreo", .method = HTTP_POST, .handler = choreo_handler};
+        httpd_register_uri_handler(server, &choreo);
+
+        httpd_uri_t ota_get = {.uri = "/api/ota", .method = HTTP_GET, .handler = ota_get_handler};
+        httpd_register_uri_handler(server, &ota_get);
+
+        httpd_uri_t ota_post = {.uri = "/api/ota", .method = HTTP_POST, .handler = ota_post_handler};
+        httpd_register_uri_handler(server, &ota_post);
+
+        httpd_uri_t ota_delete = {.uri = "/api/ota", .method = HTTP_DELETE, .handler = ota_delete_handler};
+        httpd_register_uri_handler(server, &ota_delete);
+
+        httpd_uri_t metrics = {.uri = "/metrics", .method = HTTP_GET, .handler = metrics_handler};
+        httpd_register_uri_handler(server, &metrics);
+
         httpd_uri_t trigger_rip = {.uri = "/trigger/rip", .method = HTTP_POST, .handler = trigger_rip_handler};
         httpd_register_uri_handler(server, &trigger_rip);
 
@@ -1261,47 +2608,78 @@ httpd_handle_t start_webserver(void)
 // PIR Monitoring Task
 // ============================================================================
 
-void pir_monitor_task(void *pvParameters)
+void pir_trigger_task(void *pvParameters)
 {
-    bool last_motion = false;
+    bool last_motion = read_pir_sensor();
+    pir_edge_t edge;
 
-    ESP_LOGI(TAG, "PIR monitoring task started");
+    ESP_LOGI(TAG, "PIR trigger task started");
 
     while (1) {
-        bool current_motion = read_pir_sensor();
-
-        if (current_motion != last_motion) {
-            pir_motion_detected = current_motion;
-
-            if (current_motion) {
-                ESP_LOGI(TAG, "🟢 Motion detected!");
-                log_event(EVENT_MOTION_DETECTED, NULL);
-                oled_print_2lines("MOTION!", "DETECTED");
-
-                // Auto-trigger via UART to XIAO C6 (intelligently trigger based on connected devices)
-                bool rip_ready = rip_tombstone.is_connected;
-                bool halloween_ready = halloween_trigger.is_connected;
-
-                if (rip_ready && halloween_ready) {
-                    trigger_both_uart();
-                } else if (halloween_ready) {
-                    trigger_halloween_decoration_uart();
-                } else if (rip_ready) {
-                    trigger_rip_tombstone_uart();
-                } else {
-                    ESP_LOGW(TAG, "Motion detected but no devices connected!");
+        if (xQueueReceive(pir_edge_queue, &edge, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        bool motion = edge.level != 0;
+        if (motion == last_motion) {
+            continue;  // Bounce, or the other half of a missed edge pair
+        }
+        last_motion = motion;
+        pir_motion_detected = motion;
+
+        pir_report_t report = { .motion = motion };
+        if (motion) {
+            metrics_inc(METRIC_PIR_MOTIONS);
+            // Which props this fires is up to the coordinator's rule table
+            report.cmd = coordinator_online ? CMD_GATEWAY_MOTION : 0;
+            if (report.cmd) {
+                // Auto-trigger via UART to XIAO C6 - no logging until it's on the wire
+                trigger_send(report.cmd, edge.edge_us);
+                report.latency_us = esp_timer_get_time() - edge.edge_us;
+
+                pir_latency.count++;
+                pir_latency.last_us = report.latency_us;
+                pir_latency.sum_us += report.latency_us;
+                if (report.latency_us > pir_latency.max_us) {
+                    pir_latency.max_us = report.latency_us;
                 }
-            } else {
-                ESP_LOGI(TAG, "⚫ Motion stopped");
-                log_event(EVENT_MOTION_STOPPED, NULL);
-                // Return to showing WiFi status
-                oled_print_2lines(wifi_ssid, wifi_ip);
             }
+        }
+
+        if (xQueueSend(pir_report_queue, &report, 0) != pdTRUE) {
+            APPLOG_RATELIMIT(TRIGGER, ESP_LOG_WARN, TAG, 1000, "PIR report queue full");
+        }
+    }
+}
 
-            last_motion = current_motion;
+// Logging and display for motion edges, off the trigger path
+void pir_report_task(void *pvParameters)
+{
+    pir_report_t report;
+
+    while (1) {
+        if (xQueueReceive(pir_report_queue, &report, portMAX_DELAY) != pdTRUE) {
+            continue;
         }
 
-        vTaskDelay(pdMS_TO_TICKS(100));
+        if (report.motion) {
+            ESP_LOGI(TAG, "🟢 Motion detected!");
+            log_event(EVENT_MOTION_DETECTED, EVENT_LOG_DEVICE_NONE);
+            oled_print_2lines("MOTION!", "DETECTED");
+
+            if (report.cmd != CMD_GATEWAY_MOTION) {
+                ESP_LOGW(TAG, "Motion detected but the coordinator is offline!");
+                continue;
+            }
+            log_event(EVENT_TRIGGER_RULES, EVENT_LOG_DEVICE_NONE);
+            APPLOGI(TRIGGER, TAG, "UART sent trigger 0x%02x %lld us after motion edge (avg %lld us, max %lld us)",
+                    report.cmd, report.latency_us, pir_latency.sum_us / pir_latency.count, pir_latency.max_us);
+        } else {
+            ESP_LOGI(TAG, "⚫ Motion stopped");
+            log_event(EVENT_MOTION_STOPPED, EVENT_LOG_DEVICE_NONE);
+            // Return to showing WiFi status
+            oled_print_2lines(wifi_ssid, wifi_ip);
+        }
     }
 }
 
@@ -1309,6 +2687,14 @@ void pir_monitor_task(void *pvParameters)
 // Main Application
 // ============================================================================
 
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+// Started by the coordinator's app_main next to its Zigbee task, without
+// waiting for the network to form. app_main has already done the logging
+// layer, NVS and the antenna.
+void web_gateway_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Single-chip gateway: WiFi/HTTP half starting");
+#else
 void app_main(void)
 {
     ESP_LOGI(TAG, "╔══════════════════════════════════════════════╗");
@@ -1316,6 +2702,9 @@ void app_main(void)
     ESP_LOGI(TAG, "║  ESP32-S3 WiFi/HTTP + XIAO C6 Zigbee         ║");
     ESP_LOGI(TAG, "╚══════════════════════════════════════════════╝");
 
+    // Deferred log lines are formatted just above idle, off the UART and HTTP tasks
+    applog_init(1);
+
     // Initialize NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -1323,15 +2712,33 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+#endif
+
+    event_log_init();
+    journal_init();
+    radio_telemetry_init();
+    trigger_latency_init();
+    metrics_export_init();
+    ota_upload_init(ota_send_frame);
 
     // Initialize hardware
+#if !CONFIG_ZIGBEEWEEN_SINGLE_CHIP
     setup_external_antenna();  // Configure external antenna BEFORE WiFi init
+#endif
     setup_i2c();
     oled_init();
+    xTaskCreate(display_task, "display", 3072, NULL, 2, &display_task_handle);
     oled_print("Starting...");
     setup_pir_sensor();
     setup_uart();
 
+    // Start UART receiver task to get device status from XIAO C6. Before
+    // WiFi and NTP (up to a minute), so the coordinator's status pushes and
+    // OTA acks are drained rather than filling the RX buffer or, on a
+    // single chip, the link ring that its senders block on.
+    TaskHandle_t uart_task_handle = NULL;
+    xTaskCreate(uart_receiver_task, "UART_receiver", 4096, NULL, 5, &uart_task_handle);
+
     // Initialize WiFi
     ESP_LOGI(TAG, "Connecting to WiFi...");
     oled_print("WiFi...");
@@ -1365,17 +2772,18 @@ void app_main(void)
         ESP_LOGI(TAG, "╚══════════════════════════════════════════════╝");
     }
 
-    // Start UART receiver task to get device status from XIAO C6
-    xTaskCreate(uart_receiver_task, "UART_receiver", 4096, NULL, 5, NULL);
+    // Start PIR handling: triggers at high priority, logging/OLED below it
+    TaskHandle_t pir_trigger_handle = NULL, pir_report_handle = NULL;
+    xTaskCreate(pir_trigger_task, "PIR_trigger", 3072, NULL, PIR_TRIGGER_TASK_PRIO, &pir_trigger_handle);
+    xTaskCreate(pir_report_task, "PIR_report", 4096, NULL, 4, &pir_report_handle);
 
-    // Start status request task (polls coordinator every 3 seconds)
-    xTaskCreate(status_request_task, "status_request", 4096, NULL, 4, NULL);
-    ESP_LOGI(TAG, "Status request task started (polls every 3 seconds)");
+    metrics_watch_task(xTaskGetCurrentTaskHandle());
+    metrics_watch_task(display_task_handle);
+    metrics_watch_task(uart_task_handle);
+    metrics_watch_task(pir_trigger_handle);
+    metrics_watch_task(pir_report_handle);
 
-    // Start PIR monitoring (increased stack size for UART + I2C operations)
-    xTaskCreate(pir_monitor_task, "PIR_monitor", 4096, NULL, 4, NULL);
-
-    // Request initial device status from XIAO C6
+    // Request initial device status from XIAO C6 (later updates are pushed)
     vTaskDelay(pdMS_TO_TICKS(1000));
     uart_request_status();
 
@@ -1393,20 +2801,27 @@ void app_main(void)
     // Main loop
     uint32_t time_sync_counter = 0;
     uint32_t oled_update_counter = 0;
-    const uint32_t TIME_SYNC_INTERVAL = 3600; // Sync time every hour (3600 seconds)
+    const uint32_t TIME_SYNC_INTERVAL = 300; // Sync time every 5 minutes (wired, so it costs no airtime)
     const uint32_t OLED_UPDATE_INTERVAL = 10;  // Update OLED every 10 seconds
 
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(1000));  // Check every 1 second
 
+        check_coordinator_timeout();
+        journal_tick(time_synced);
+
+        if (time_sync_counter % SSE_KEEPALIVE_SECS == 0) {
+            sse_keepalive();
+        }
+
         char time_str[64];
         get_current_time_str(time_str, sizeof(time_str));
 
-        // Log status every 5 seconds
+        // Log status every 5 seconds (counters and gauges are on /metrics)
         if (time_sync_counter % 5 == 0) {
-            ESP_LOGI(TAG, "Time: %s, Motion: %s",
-                     time_str,
-                     pir_motion_detected ? "YES" : "NO");
+            APPLOGD(STATUS, TAG, "Time: %s, Motion: %s",
+                    time_str,
+                    pir_motion_detected ? "YES" : "NO");
         }
 
         // Update OLED display with WiFi status every 10 seconds (unless motion detected)
@@ -1417,7 +2832,7 @@ void app_main(void)
             oled_update_counter = 0;
         }
 
-        // Periodically sync time with XIAO C6 (every hour)
+        // Periodically sync time with XIAO C6 (every 5 minutes)
         time_sync_counter++;
         if (time_sync_counter >= TIME_SYNC_INTERVAL) {
             ESP_LOGI(TAG, "Periodic time sync with XIAO C6...");
@@ -0,0 +1,198 @@
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "uart_proto.h"
+#include "metrics_export.h"
+
+static const char *TAG = "metrics_export";
+
+#define METRICS_PREFIX                "zigbeeween_"
+#define METRICS_SOURCES               (1 + DEVICE_STATUS_MAX_DEVICES)  // Coordinator, then device ids
+#define METRICS_COORDINATOR_STALE_US  (3 * METRICS_REPORT_INTERVAL_S * 1000000LL)
+#define METRICS_DEVICE_STALE_US       (1000 * 1000000LL)  // Props report every 5 minutes
+
+typedef struct {
+    bool valid;
+    int64_t received_us;
+    metrics_snapshot_t snap;
+} metrics_source_t;
+
+// sources is written by the UART receiver task; the renderer works on a
+// copy so a slow HTTP client never holds the lock
+static metrics_source_t *sources = NULL;
+static metrics_source_t *render_copy = NULL;
+static SemaphoreHandle_t sources_mutex = NULL;
+
+void prom_writer_init(prom_writer_t *w, char *buf, size_t cap, httpd_req_t *req)
+{
+    *w = (prom_writer_t){ .buf = buf, .cap = cap, .req = req, .err = ESP_OK };
+}
+
+static void prom_flush(prom_writer_t *w)
+{
+    if (w->err != ESP_OK || w->len == 0) {
+        return;
+    }
+    w->err = httpd_resp_send_chunk(w->req, w->buf, w->len);
+    w->len = 0;
+}
+
+void prom_printf(prom_writer_t *w, const char *fmt, ...)
+{
+    for (int attempt = 0; attempt < 2 && w->err == ESP_OK; attempt++) {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(w->buf + w->len, w->cap - w->len, fmt, args);
+        va_end(args);
+        if (n < 0) {
+            w->err = ESP_FAIL;
+            return;
+        }
+        if ((size_t)n < w->cap - w->len) {
+            w->len += n;
+            return;
+        }
+        if (w->len == 0) {
+            w->err = ESP_ERR_NO_MEM;  // Longer than the whole buffer
+            return;
+        }
+        prom_flush(w);
+    }
+}
+
+void prom_header(prom_writer_t *w, const char *name, const char *type, const char *help)
+{
+    prom_printf(w, "# HELP " METRICS_PREFIX "%s %s\n# TYPE " METRICS_PREFIX "%s %s\n", name, help, name, type);
+}
+
+esp_err_t prom_writer_finish(prom_writer_t *w)
+{
+    prom_flush(w);
+    return w->err;
+}
+
+void metrics_export_init(void)
+{
+    size_t size = METRICS_SOURCES * sizeof(metrics_source_t);
+    sources = heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM);
+    if (!sources) {
+        sources = calloc(1, size);
+    }
+    render_copy = heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM);
+    if (!render_copy) {
+        render_copy = calloc(1, size);
+    }
+    sources_mutex = xSemaphoreCreateMutex();
+}
+
+bool metrics_export_update(uint8_t source, const uint8_t *records, size_t len)
+{
+    if (!sources || source >= METRICS_SOURCES) {
+        return false;
+    }
+    xSemaphoreTake(sources_mutex, portMAX_DELAY);
+    metrics_source_t *s = &sources[source];
+    bool ok = metrics_decode(&s->snap, records, len);
+    s->valid = true;
+    s->received_us = esp_timer_get_time();
+    xSemaphoreGive(sources_mutex);
+    if (!ok) {
+        ESP_LOGW(TAG, "Malformed metrics from source %u (%u bytes)", source, (unsigned)len);
+    }
+    return ok;
+}
+
+// Label set for sample i: 0 = local, 1 = coordinator, 1 + id = device id
+static void source_labels(char *out, size_t size, size_t i, const char *(*device_name)(uint8_t id))
+{
+    if (i == 0) {
+        snprintf(out, size, "source=\"tinys3\"");
+    } else if (i == 1) {
+        snprintf(out, size, "source=\"coordinator\"");
+    } else {
+        // Label values can't hold a bare quote or backslash
+        char name[32];
+        snprintf(name, sizeof(name), "%s", device_name((uint8_t)(i - 1)));
+        for (char *c = name; *c; c++) {
+            if (*c == '"' || *c == '\\') {
+                *c = '_';
+            }
+        }
+        snprintf(out, size, "source=\"device\",id=\"%u\",device=\"%s\"", (unsigned)(i - 1), name);
+    }
+}
+
+void metrics_export_write(prom_writer_t *w, const metrics_snapshot_t *local, const char *(*device_name)(uint8_t id))
+{
+    // Snapshot 0 is local, the rest are the remote sources in order
+    const metrics_snapshot_t *snaps[1 + METRICS_SOURCES] = { local };
+    size_t count = 1;
+
+    if (sources && render_copy) {
+        int64_t now = esp_timer_get_time();
+        xSemaphoreTake(sources_mutex, portMAX_DELAY);
+        memcpy(render_copy, sources, METRICS_SOURCES * sizeof(metrics_source_t));
+        xSemaphoreGive(sources_mutex);
+        for (size_t i = 0; i < METRICS_SOURCES; i++) {
+            int64_t stale_us = i == 0 ? METRICS_COORDINATOR_STALE_US : METRICS_DEVICE_STALE_US;
+            bool fresh = render_copy[i].valid && now - render_copy[i].received_us < stale_us;
+            snaps[1 + i] = fresh ? &render_copy[i].snap : NULL;
+        }
+        count = 1 + METRICS_SOURCES;
+    }
+
+    char labels[96];
+    for (size_t id = 0; id < METRIC_SCALAR_COUNT; id++) {
+        const metric_info_t *info = metric_info((metric_id_t)id);
+        bool header = false;
+        for (size_t i = 0; i < count; i++) {
+            const metrics_snapshot_t *s = snaps[i];
+            if (!s || !metrics_is_used(s, (metric_id_t)id)) {
+                continue;
+            }
+            if (!header) {
+                prom_header(w, info->name, info->type == METRIC_COUNTER ? "counter" : "gauge", info->help);
+                header = true;
+            }
+            source_labels(labels, sizeof(labels), i, device_name);
+            if (info->type == METRIC_GAUGE) {
+                prom_printf(w, METRICS_PREFIX "%s{%s} %" PRId32 "\n", info->name, labels, (int32_t)s->values[id]);
+            } else {
+                prom_printf(w, METRICS_PREFIX "%s{%s} %" PRIu32 "\n", info->name, labels, s->values[id]);
+            }
+        }
+    }
+
+    for (size_t id = 0; id < METRIC_HIST_COUNT; id++) {
+        const metric_info_t *info = metric_hist_info((metric_hist_id_t)id);
+        bool header = false;
+        for (size_t i = 0; i < count; i++) {
+            const metrics_snapshot_t *s = snaps[i];
+            if (!s || !(s->hist_used & (1u << id))) {
+                continue;
+            }
+            if (!header) {
+                prom_header(w, info->name, "histogram", info->help);
+                header = true;
+            }
+            source_labels(labels, sizeof(labels), i, device_name);
+            const metric_hist_t *h = &s->hists[id];
+            uint32_t cumulative = 0;
+            for (size_t b = 0; b < METRIC_HIST_BUCKETS - 1; b++) {
+                cumulative += h->buckets[b];
+                prom_printf(w, METRICS_PREFIX "%s_bucket{%s,le=\"%lu\"} %" PRIu32 "\n", info->name, labels,
+                            1ul << (METRIC_HIST_MIN_SHIFT + b), cumulative);
+            }
+            prom_printf(w, METRICS_PREFIX "%s_bucket{%s,le=\"+Inf\"} %" PRIu32 "\n", info->name, labels, h->count);
+            prom_printf(w, METRICS_PREFIX "%s_sum{%s} %" PRIu64 "\n", info->name, labels, h->sum);
+            prom_printf(w, METRICS_PREFIX "%s_count{%s} %" PRIu32 "\n", info->name, labels, h->count);
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "metrics.h"
+
+// Prometheus text exposition of every board's metrics registry (metrics.h):
+// the TinyS3's own, plus the coordinator's and each prop's as the
+// coordinator relays them in CMD_METRICS frames. Samples carry a source
+// label ("tinys3", "coordinator" or "device" with id and name labels).
+//
+// Output goes through a prom_writer_t, which buffers lines like the JSON
+// writer and sends each full buffer as an HTTP chunk.
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    httpd_req_t *req;
+    esp_err_t err;       // First error; once set, all writes are no-ops
+} prom_writer_t;
+
+void prom_writer_init(prom_writer_t *w, char *buf, size_t cap, httpd_req_t *req);
+
+// One formatted piece of output; must be shorter than the buffer
+void prom_printf(prom_writer_t *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// # HELP and # TYPE lines for name (the zigbeeween_ prefix is added)
+void prom_header(prom_writer_t *w, const char *name, const char *type, const char *help);
+
+// Flush whatever is buffered. Returns the first error hit while writing.
+esp_err_t prom_writer_finish(prom_writer_t *w);
+
+// Allocate the per-source store (PSRAM when available)
+void metrics_export_init(void);
+
+// Apply the records of a CMD_METRICS frame. False if source is out of range
+// or the records are malformed.
+bool metrics_export_update(uint8_t source, const uint8_t *records, size_t len);
+
+// Write every known metric: local is the TinyS3's snapshot, device_name
+// maps a device id to its label. httpd task only.
+void metrics_export_write(prom_writer_t *w, const metrics_snapshot_t *local, const char *(*device_name)(uint8_t id));
@@ -0,0 +1,555 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "uart_frame.h"
+#include "uart_proto.h"
+#include "applog.h"
+#include "ota_upload.h"
+
+static const char *TAG = "ota_upload";
+
+#define ACK_QUEUE_LEN       (2 * OTA_WINDOW_CHUNKS + 2)
+#define ACK_DRAIN_MS        100   // Quiet time before END, so a stale data ack isn't taken for its reply
+#define OTA_STATUS_MAX      ((UART_FRAME_MAX_PAYLOAD - OTA_STATUS_HEADER_SIZE) / OTA_STATUS_RECORD_SIZE)
+
+typedef enum {
+    UPLOAD_IDLE,
+    UPLOAD_SENDING,
+    UPLOAD_VERIFYING,
+    UPLOAD_DONE,
+    UPLOAD_FAILED,
+} upload_state_t;
+
+typedef struct {
+    uint8_t result;
+    uint32_t stored;
+} ota_ack_t;
+
+typedef struct {
+    uint8_t id;
+    uint32_t version;
+    uint32_t served;
+} ota_device_t;
+
+static ota_upload_send_fn_t send_frame = NULL;
+static QueueHandle_t ack_queue = NULL;
+static SemaphoreHandle_t state_mutex = NULL;
+
+// The file being uploaded: header and tag, then the image. Only the upload
+// task touches it once started.
+static uint8_t *file = NULL;
+static size_t image_len = 0;
+
+// Everything below is guarded by state_mutex
+static struct {
+    upload_state_t state;
+    uint8_t result;            // OTA_RESULT_* of the last ack that mattered
+    bool timed_out;
+    ota_app_info_t info;
+    uint32_t size;             // File bytes
+    uint32_t acked;
+    uint32_t resends;          // Rewinds after a refused frame or a timeout
+    int64_t started_us;
+    int64_t finished_us;
+} upload;
+
+static struct {
+    bool valid;
+    uint8_t stage;
+    uint16_t image_type;
+    uint32_t file_version;
+    uint32_t size;
+    uint32_t stored;
+    uint8_t count;
+    ota_device_t devices[OTA_STATUS_MAX];
+} coordinator;
+
+void ota_upload_init(ota_upload_send_fn_t send)
+{
+    send_frame = send;
+    ack_queue = xQueueCreate(ACK_QUEUE_LEN, sizeof(ota_ack_t));
+    state_mutex = xSemaphoreCreateMutex();
+}
+
+bool ota_upload_busy(void)
+{
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    bool busy = upload.state == UPLOAD_SENDING || upload.state == UPLOAD_VERIFYING;
+    xSemaphoreGive(state_mutex);
+    return busy;
+}
+
+uint8_t *ota_upload_buffer(size_t len)
+{
+    if (len < OTA_APP_INFO_MIN_SIZE || len > OTA_UPLOAD_MAX_IMAGE || ota_upload_busy()) {
+        return NULL;
+    }
+    ota_upload_discard();
+    file = heap_caps_malloc(OTA_FILE_OVERHEAD + len, MALLOC_CAP_SPIRAM);
+    if (!file) {
+        return NULL;
+    }
+    image_len = len;
+    return file + OTA_FILE_OVERHEAD;
+}
+
+void ota_upload_discard(void)
+{
+    heap_caps_free(file);
+    file = NULL;
+    image_len = 0;
+}
+
+static void set_state(upload_state_t state, uint8_t result, uint32_t acked)
+{
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    upload.state = state;
+    upload.result = result;
+    upload.acked = acked;
+    if (state == UPLOAD_DONE || state == UPLOAD_FAILED) {
+        upload.finished_us = esp_timer_get_time();
+    }
+    xSemaphoreGive(state_mutex);
+}
+
+static bool wait_ack(ota_ack_t *ack, uint32_t timeout_ms)
+{
+    return xQueueReceive(ack_queue, ack, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
+
+#define BEGIN_SIZE 10
+
+static void begin_encode(uint8_t *payload, uint16_t image_type, uint32_t file_version, uint32_t size)
+{
+    uart_frame_put_u16(payload, image_type);
+    uart_frame_put_u32(&payload[2], file_version);
+    uart_frame_put_u32(&payload[6], size);
+}
+
+static void count_resend(void)
+{
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    upload.resends++;
+    xSemaphoreGive(state_mutex);
+}
+
+static void send_data(uint32_t offset, uint32_t size)
+{
+    static uint8_t frame[4 + OTA_DATA_CHUNK];
+    uint32_t n = size - offset < OTA_DATA_CHUNK ? size - offset : OTA_DATA_CHUNK;
+
+    uart_frame_put_u32(frame, offset);
+    memcpy(&frame[4], &file[offset], n);
+    send_frame(CMD_OTA_DATA, frame, (uint16_t)(4 + n));
+}
+
+// One request/reply step (BEGIN or END), resent on silence
+static bool exchange(uint8_t cmd, const uint8_t *payload, uint16_t len, uint32_t timeout_ms, ota_ack_t *ack)
+{
+    for (int attempt = 0; attempt < OTA_UPLOAD_RETRIES; attempt++) {
+        xQueueReset(ack_queue);
+        send_frame(cmd, payload, len);
+        if (wait_ack(ack, timeout_ms)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The data phase: from the coordinator's stored count to the end of the
+// file, keeping up to OTA_WINDOW_CHUNKS frames ahead of the last ack.
+// Returns OTA_RESULT_OK, the coordinator's refusal, or false on silence.
+static bool stream_data(uint32_t size, uint32_t acked, uint8_t *result)
+{
+    const uint32_t window = OTA_WINDOW_CHUNKS * OTA_DATA_CHUNK;
+    uint32_t next = acked;
+    uint32_t rewound_to = UINT32_MAX;  // A refusal at this offset is already being resent
+    int timeouts = 0;
+
+    while (acked < size) {
+        while (next < size && next - acked < window) {
+            send_data(next, size);
+            next += OTA_DATA_CHUNK;
+        }
+        if (next > size) {
+            next = size;
+        }
+
+        ota_ack_t ack;
+        if (!wait_ack(&ack, OTA_UPLOAD_ACK_TIMEOUT_MS)) {
+            if (++timeouts >= OTA_UPLOAD_RETRIES) {
+                return false;
+            }
+            APPLOGD(UART, TAG, "OTA ack timeout at %lu, resending", (unsigned long)acked);
+            next = acked;
+            rewound_to = acked;
+            count_resend();
+            continue;
+        }
+        timeouts = 0;
+
+        if (ack.result != OTA_RESULT_OK && ack.result != OTA_RESULT_OFFSET) {
+            *result = ack.result;
+            return true;
+        }
+        acked = ack.stored;
+        if (ack.result == OTA_RESULT_OFFSET && acked != rewound_to) {
+            // A frame went missing: everything after it is refused, so go
+            // back to what the coordinator has and ignore the rest of those
+            APPLOGD(UART, TAG, "OTA frame refused, resending from %lu", (unsigned long)acked);
+            next = acked;
+            rewound_to = acked;
+            count_resend();
+        } else if (next < acked) {
+            next = acked;
+        }
+        set_state(UPLOAD_SENDING, OTA_RESULT_OK, acked);
+    }
+    *result = OTA_RESULT_OK;
+    return true;
+}
+
+// Record how the upload ended. True if the coordinator took the whole file.
+static bool upload_finish(bool replied, uint8_t result)
+{
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    upload.timed_out = !replied;
+    xSemaphoreGive(state_mutex);
+    if (replied && result == OTA_RESULT_OK) {
+        set_state(UPLOAD_DONE, result, upload.size);
+        ESP_LOGI(TAG, "OTA upload of %s %s done (%lu bytes, %lu resends, %lld ms)",
+                 ota_file_image_name(upload.info.image_type), upload.info.version, (unsigned long)upload.size,
+                 (unsigned long)upload.resends, (upload.finished_us - upload.started_us) / 1000);
+        return true;
+    }
+    set_state(UPLOAD_FAILED, result, upload.acked);
+    ESP_LOGW(TAG, "OTA upload failed: %s (result %u)", replied ? "refused" : "no reply", result);
+    return false;
+}
+
+// The BEGIN and END exchanges around either data phase. False on silence;
+// otherwise result is the coordinator's reply.
+static bool upload_begin(uint32_t size, ota_ack_t *ack, uint8_t *result)
+{
+    uint8_t payload[BEGIN_SIZE];
+
+    begin_encode(payload, upload.info.image_type, upload.info.file_version, size);
+    if (!exchange(CMD_OTA_BEGIN, payload, BEGIN_SIZE, OTA_UPLOAD_ACK_TIMEOUT_MS, ack)) {
+        return false;
+    }
+    *result = ack->result;
+    if (*result == OTA_RESULT_OK && ack->stored > 0) {
+        APPLOGI(UART, TAG, "OTA upload resuming at %lu of %lu bytes", (unsigned long)ack->stored, (unsigned long)size);
+    }
+    return true;
+}
+
+static bool upload_end(uint32_t size, uint32_t crc, uint8_t *result)
+{
+    uint8_t payload[4];
+    ota_ack_t ack;
+
+    set_state(UPLOAD_VERIFYING, OTA_RESULT_OK, size);
+    while (wait_ack(&ack, ACK_DRAIN_MS)) {
+    }
+    uart_frame_put_u32(payload, crc);
+    if (!exchange(CMD_OTA_END, payload, 4, OTA_UPLOAD_END_TIMEOUT_MS, &ack)) {
+        return false;
+    }
+    *result = ack.result;
+    return true;
+}
+
+static void upload_task(void *arg)
+{
+    const uint32_t size = upload.size;
+    uint8_t result = OTA_RESULT_OK;
+    ota_ack_t ack;
+
+    bool replied = upload_begin(size, &ack, &result);
+    if (replied && result == OTA_RESULT_OK) {
+        replied = stream_data(size, ack.stored, &result);
+    }
+    if (replied && result == OTA_RESULT_OK) {
+        replied = upload_end(size, esp_rom_crc32_le(0, file, size), &result);
+    }
+
+    // Free the image first: once upload_finish() publishes the end state,
+    // ota_upload_busy() is false and a new POST may buffer its own file
+    ota_upload_discard();
+    upload_finish(replied, result);
+    vTaskDelete(NULL);
+}
+
+// Check that image (at least its first OTA_APP_INFO_MIN_SIZE bytes) is a
+// prop's app, write the OTA file header in front of it into out and mark the
+// upload as started
+static bool upload_prepare(uint8_t *out, const uint8_t *image, size_t len, size_t image_size, ota_app_info_t *info)
+{
+    if (!ota_file_app_info(image, len, info) || info->image_type == OTA_IMAGE_TYPE_UNKNOWN ||
+        info->file_version == 0) {
+        return false;
+    }
+
+    char header_string[OTA_FILE_HEADER_STRING_LEN + 1];
+    snprintf(header_string, sizeof(header_string), "%s %s", info->project, info->version);
+    ota_file_info_t file_info = {
+        .manufacturer_code = OTA_MANUFACTURER_CODE,
+        .image_type = info->image_type,
+        .file_version = info->file_version,
+    };
+    ota_file_header_encode(out, &file_info, (uint32_t)image_size, header_string);
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    upload.state = UPLOAD_SENDING;
+    upload.result = OTA_RESULT_OK;
+    upload.timed_out = false;
+    upload.info = *info;
+    upload.size = (uint32_t)(OTA_FILE_OVERHEAD + image_size);
+    upload.acked = 0;
+    upload.resends = 0;
+    upload.started_us = esp_timer_get_time();
+    upload.finished_us = 0;
+    xSemaphoreGive(state_mutex);
+    return true;
+}
+
+esp_err_t ota_upload_start(ota_app_info_t *info)
+{
+    if (!file || !upload_prepare(file, file + OTA_FILE_OVERHEAD, image_len, image_len, info)) {
+        ota_upload_discard();
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (xTaskCreate(upload_task, "OTA_upload", 4096, NULL, 4, NULL) != pdPASS) {
+        set_state(UPLOAD_FAILED, OTA_RESULT_OK, 0);
+        ota_upload_discard();
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "OTA upload of %s %s started (file version %lu, %lu bytes)", ota_file_image_name(info->image_type),
+             info->version, (unsigned long)info->file_version, (unsigned long)upload.size);
+    return ESP_OK;
+}
+
+// One data frame of the streamed upload, sent until the coordinator has
+// stored up to end. Acks trailing an earlier frame's resend are skipped.
+static bool send_chunk(const uint8_t *frame, uint16_t len, uint32_t offset, uint32_t end, uint8_t *result)
+{
+    for (int attempt = 0; attempt < OTA_UPLOAD_RETRIES; attempt++) {
+        if (attempt > 0) {
+            count_resend();
+        }
+        send_frame(CMD_OTA_DATA, frame, len);
+
+        ota_ack_t ack;
+        while (wait_ack(&ack, OTA_UPLOAD_ACK_TIMEOUT_MS)) {
+            if (ack.result != OTA_RESULT_OK && ack.result != OTA_RESULT_OFFSET) {
+                *result = ack.result;
+                return true;
+            }
+            if (ack.stored >= end) {
+                *result = OTA_RESULT_OK;
+                return true;
+            }
+            if (ack.stored < offset) {
+                *result = OTA_RESULT_OFFSET;  // A gap a stream can't go back for
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+esp_err_t ota_upload_stream(size_t len, ota_upload_read_fn_t read, void *ctx, ota_app_info_t *info)
+{
+    static uint8_t frame[4 + OTA_DATA_CHUNK];  // Offset, then file bytes; caller's task only
+    uint8_t *data = &frame[4];
+    const size_t head = OTA_FILE_OVERHEAD + OTA_APP_INFO_MIN_SIZE;  // Fits the first frame
+
+    if (len < OTA_APP_INFO_MIN_SIZE || len > OTA_UPLOAD_MAX_IMAGE || ota_upload_busy()) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (!read(ctx, &data[OTA_FILE_OVERHEAD], OTA_APP_INFO_MIN_SIZE)) {
+        return ESP_FAIL;
+    }
+    if (!upload_prepare(data, &data[OTA_FILE_OVERHEAD], OTA_APP_INFO_MIN_SIZE, len, info)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ESP_LOGI(TAG, "OTA upload of %s %s streaming (file version %lu, %lu bytes)", ota_file_image_name(info->image_type),
+             info->version, (unsigned long)info->file_version, (unsigned long)upload.size);
+
+    const uint32_t size = upload.size;
+    uint32_t crc = 0;
+    uint8_t result = OTA_RESULT_OK;
+    ota_ack_t ack = { 0 };
+
+    bool replied = upload_begin(size, &ack, &result);
+    uint32_t stored = ack.stored;
+    size_t have = head;
+    for (uint32_t offset = 0; replied && result == OTA_RESULT_OK && offset < size;) {
+        uint32_t n = size - offset < OTA_DATA_CHUNK ? size - offset : OTA_DATA_CHUNK;
+        if (!read(ctx, &data[have], n - have)) {
+            // The coordinator keeps what it has, for a retry to resume
+            set_state(UPLOAD_FAILED, OTA_RESULT_OK, offset);
+            ESP_LOGW(TAG, "OTA upload stopped: body ended at %lu of %lu bytes", (unsigned long)offset, (unsigned long)size);
+            return ESP_FAIL;
+        }
+        have = 0;
+        crc = esp_rom_crc32_le(crc, data, n);
+
+        // Chunks the coordinator kept from an earlier try are only read past
+        if (offset + n > stored) {
+            uart_frame_put_u32(frame, offset);
+            replied = send_chunk(frame, (uint16_t)(4 + n), offset, offset + n, &result);
+        }
+        offset += n;
+        if (replied && result == OTA_RESULT_OK) {
+            set_state(UPLOAD_SENDING, OTA_RESULT_OK, offset);
+        }
+    }
+    if (replied && result == OTA_RESULT_OK) {
+        replied = upload_end(size, crc, &result);
+    }
+    if (upload_finish(replied, result)) {
+        return ESP_OK;
+    }
+    return replied ? ESP_ERR_INVALID_RESPONSE : ESP_ERR_TIMEOUT;
+}
+
+bool ota_upload_drop(void)
+{
+    if (ota_upload_busy()) {
+        return false;
+    }
+    uint8_t payload[BEGIN_SIZE];
+
+    begin_encode(payload, OTA_IMAGE_TYPE_UNKNOWN, 0, 0);
+    send_frame(CMD_OTA_BEGIN, payload, BEGIN_SIZE);
+    return true;
+}
+
+void ota_upload_ack(const uint8_t *payload, uint16_t len)
+{
+    if (len < OTA_ACK_SIZE) {
+        return;
+    }
+    ota_ack_t ack = { .result = payload[0], .stored = uart_frame_get_u32(&payload[1]) };
+    xQueueSend(ack_queue, &ack, 0);  // Nobody waiting (a drop, or a late ack): the queue just fills
+}
+
+void ota_upload_status_frame(const uint8_t *payload, uint16_t len)
+{
+    if (len < OTA_STATUS_HEADER_SIZE) {
+        return;
+    }
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    coordinator.stage = payload[0];
+    coordinator.image_type = uart_frame_get_u16(&payload[1]);
+    coordinator.file_version = uart_frame_get_u32(&payload[3]);
+    coordinator.size = uart_frame_get_u32(&payload[7]);
+    coordinator.stored = uart_frame_get_u32(&payload[11]);
+    coordinator.count = 0;
+    const uint8_t *rec = &payload[OTA_STATUS_HEADER_SIZE];
+    for (uint8_t i = 0; i < payload[15] && coordinator.count < OTA_STATUS_MAX; i++, rec += OTA_STATUS_RECORD_SIZE) {
+        if (rec + OTA_STATUS_RECORD_SIZE > payload + len) {
+            break;
+        }
+        coordinator.devices[coordinator.count++] = (ota_device_t){
+            .id = rec[0],
+            .version = uart_frame_get_u32(&rec[1]),
+            .served = uart_frame_get_u32(&rec[5]),
+        };
+    }
+    coordinator.valid = true;
+    xSemaphoreGive(state_mutex);
+}
+
+static const char *state_name(upload_state_t state)
+{
+    switch (state) {
+        case UPLOAD_IDLE: return "idle";
+        case UPLOAD_SENDING: return "sending";
+        case UPLOAD_VERIFYING: return "verifying";
+        case UPLOAD_DONE: return "done";
+        case UPLOAD_FAILED: return "failed";
+        default: return "unknown";
+    }
+}
+
+static const char *result_name(uint8_t result)
+{
+    switch (result) {
+        case OTA_RESULT_OK: return "ok";
+        case OTA_RESULT_BAD_FORMAT: return "bad_format";
+        case OTA_RESULT_TOO_LARGE: return "too_large";
+        case OTA_RESULT_BAD_CRC: return "bad_crc";
+        case OTA_RESULT_STORAGE: return "storage";
+        case OTA_RESULT_SEQUENCE: return "sequence";
+        case OTA_RESULT_OFFSET: return "offset";
+        default: return "unknown";
+    }
+}
+
+static const char *stage_name(uint8_t stage)
+{
+    switch (stage) {
+        case OTA_STAGE_NONE: return "none";
+        case OTA_STAGE_RECEIVING: return "receiving";
+        case OTA_STAGE_READY: return "ready";
+        default: return "unknown";
+    }
+}
+
+void ota_upload_json(json_writer_t *w, const char *(*device_name)(uint8_t id))
+{
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+
+    json_obj_open(w, "upload");
+    json_str(w, "state", state_name(upload.state));
+    if (upload.state != UPLOAD_IDLE) {
+        json_str(w, "result", upload.timed_out ? "no_reply" : result_name(upload.result));
+        json_str(w, "image", ota_file_image_name(upload.info.image_type));
+        json_str(w, "project", upload.info.project);
+        json_str(w, "version", upload.info.version);
+        json_uint(w, "file_version", upload.info.file_version);
+        json_uint(w, "size", upload.size);
+        json_uint(w, "acked", upload.acked);
+        json_uint(w, "resends", upload.resends);
+        int64_t end_us = upload.finished_us ? upload.finished_us : esp_timer_get_time();
+        json_uint(w, "elapsed_ms", (uint32_t)((end_us - upload.started_us) / 1000));
+    }
+    json_obj_close(w);
+
+    json_obj_open(w, "staged");
+    json_bool(w, "known", coordinator.valid);
+    json_str(w, "stage", stage_name(coordinator.stage));
+    if (coordinator.stage != OTA_STAGE_NONE) {
+        json_str(w, "image", ota_file_image_name(coordinator.image_type));
+        json_uint(w, "file_version", coordinator.file_version);
+        json_uint(w, "size", coordinator.size);
+        json_uint(w, "stored", coordinator.stored);
+    }
+    json_obj_close(w);
+
+    json_arr_open(w, "devices");
+    for (uint8_t i = 0; i < coordinator.count; i++) {
+        const ota_device_t *dev = &coordinator.devices[i];
+        json_obj_open(w, NULL);
+        json_uint(w, "id", dev->id);
+        json_str(w, "name", device_name(dev->id));
+        json_uint(w, "file_version", dev->version);
+        json_bool(w, "current", coordinator.stage == OTA_STAGE_READY && dev->version == coordinator.file_version);
+        json_uint(w, "served", dev->served);
+        json_obj_close(w);
+    }
+    json_arr_close(w);
+
+    xSemaphoreGive(state_mutex);
+}
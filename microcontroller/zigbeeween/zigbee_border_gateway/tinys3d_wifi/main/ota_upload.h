@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "json_writer.h"
+#include "ota_file.h"
+
+// Upload of a prop's app image to the coordinator, which stages it and
+// serves it over Zigbee OTA (protocol in uart_proto.h). The image is held
+// in PSRAM behind the OTA_FILE_OVERHEAD bytes that make it an OTA file, and
+// a background task streams it in CMD_OTA_DATA frames, OTA_WINDOW_CHUNKS in
+// flight, resending from the coordinator's stored count whenever a frame is
+// refused or the acks stop.
+//
+// Without PSRAM (the single-chip gateway) the image is streamed instead:
+// ota_upload_stream() reads it from the request body one frame at a time
+// and waits for each ack, so no more than a frame is ever held.
+//
+// The coordinator's CMD_OTA_STATUS (staged image, per-prop progress) is
+// kept here too, so /api/ota is written from one place.
+
+#define OTA_UPLOAD_MAX_IMAGE        (1536 * 1024)  // The props' app slots
+#define OTA_UPLOAD_ACK_TIMEOUT_MS   500            // Resend the window after this
+#define OTA_UPLOAD_END_TIMEOUT_MS   5000           // The coordinator CRCs the whole file
+#define OTA_UPLOAD_RETRIES          8              // Timeouts in a row before giving up
+
+typedef void (*ota_upload_send_fn_t)(uint8_t cmd, const uint8_t *payload, uint16_t len);
+
+// Fill buf with exactly len more bytes of the image; false if it ends early
+typedef bool (*ota_upload_read_fn_t)(void *ctx, uint8_t *buf, size_t len);
+
+// Create the ack queue and status lock. Call once from app_main.
+void ota_upload_init(ota_upload_send_fn_t send);
+
+// Buffer to receive an app image of len bytes into. NULL if an upload is
+// running, len is out of range or PSRAM is short. Either hand it to
+// ota_upload_start() or give it back with ota_upload_discard().
+uint8_t *ota_upload_buffer(size_t len);
+void ota_upload_discard(void);
+
+// Check the image in the buffer and start streaming it. Fills info either
+// way; ESP_ERR_INVALID_ARG (buffer freed) if it isn't a prop's app image.
+esp_err_t ota_upload_start(ota_app_info_t *info);
+
+// Check and upload an app image of len bytes pulled through read, returning
+// when the coordinator has verified it or given up. Fills info once the
+// image's header is read. ESP_ERR_INVALID_SIZE (len out of range or an
+// upload running), ESP_ERR_INVALID_ARG (not a prop's app), ESP_FAIL (read
+// failed), ESP_ERR_INVALID_RESPONSE (refused) or ESP_ERR_TIMEOUT (no reply).
+esp_err_t ota_upload_stream(size_t len, ota_upload_read_fn_t read, void *ctx, ota_app_info_t *info);
+
+// Drop the coordinator's staged image (CMD_OTA_BEGIN with size 0). False
+// while an upload is running.
+bool ota_upload_drop(void);
+
+bool ota_upload_busy(void);
+
+// CMD_OTA_ACK and CMD_OTA_STATUS payloads. UART receiver task.
+void ota_upload_ack(const uint8_t *payload, uint16_t len);
+void ota_upload_status_frame(const uint8_t *payload, uint16_t len);
+
+// The upload's and the coordinator's state as "upload", "staged" and
+// "devices" members of the open object. device_name maps a device id to
+// its name.
+void ota_upload_json(json_writer_t *w, const char *(*device_name)(uint8_t id));
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include "uart_frame.h"
+#include "uart_proto.h"
+#include "prop_status.h"
+
+bool prop_status_decode(prop_status_t *table, const uint8_t *payload, uint16_t len, prop_status_chunk_t *chunk)
+{
+    if (len < DEVICE_STATUS_HEADER_SIZE) {
+        return false;
+    }
+    size_t first = payload[2];
+    size_t n = (len - DEVICE_STATUS_HEADER_SIZE) / DEVICE_STATUS_RECORD_SIZE;
+
+    chunk->seq = payload[0];
+    chunk->total = payload[1];
+    chunk->complete = first + n >= chunk->total;
+
+    const uint8_t *rec = &payload[DEVICE_STATUS_HEADER_SIZE];
+    for (size_t i = 0; i < n; i++, rec += DEVICE_STATUS_RECORD_SIZE) {
+        uint8_t id = rec[0];
+        if (id == 0 || id > DEVICE_STATUS_MAX_DEVICES) {
+            continue;
+        }
+        prop_status_t *dev = &table[id - 1];
+        dev->is_connected = (rec[1] & DEVICE_STATE_BOUND) != 0;
+        dev->time_synced = (rec[1] & DEVICE_STATE_TIME_SYNCED) != 0;
+        dev->in_cooldown = (rec[1] & DEVICE_STATE_COOLDOWN) != 0;
+        dev->lqi = rec[2];
+        dev->rssi = (int8_t)rec[3];
+        dev->cooldown_remaining = uart_frame_get_u16(&rec[4]);
+        dev->last_seen_age = uart_frame_get_u16(&rec[6]);
+        if (dev->name[0] == '\0') {
+            snprintf(dev->name, sizeof(dev->name), "Prop %u", id);
+        }
+    }
+    return true;
+}
+
+void prop_status_json(json_writer_t *w, const char *key, const prop_status_t *table, size_t count)
+{
+    json_arr_open(w, key);
+    for (size_t i = 0; i < count; i++) {
+        const prop_status_t *dev = &table[i];
+        json_obj_open(w, NULL);
+        json_uint(w, "id", i + 1);
+        json_str(w, "name", dev->name);
+        json_bool(w, "connected", dev->is_connected);
+        json_bool(w, "time_synced", dev->time_synced);
+        json_bool(w, "in_cooldown", dev->in_cooldown);
+        json_uint(w, "cooldown_remaining", dev->cooldown_remaining);
+        json_uint(w, "lqi", dev->lqi);
+        json_int(w, "rssi", dev->rssi);
+        json_int(w, "last_seen_age", dev->last_seen_age == DEVICE_STATUS_AGE_NEVER ? -1 : dev->last_seen_age);
+        json_obj_close(w);
+    }
+    json_arr_close(w);
+}
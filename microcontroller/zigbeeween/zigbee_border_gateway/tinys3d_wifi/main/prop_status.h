@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "json_writer.h"
+
+// The props' status as the coordinator reports it: CMD_DEVICE_STATUS chunks
+// (layout in uart_proto.h) decoded into a table indexed by device id - 1,
+// and the "devices" array of /api/status written from it. No RTOS calls;
+// the caller owns the table, and the host benchmarks build this file too.
+
+typedef struct {
+    char name[32];
+    bool is_connected;
+    bool time_synced;
+    bool in_cooldown;
+    uint8_t lqi;
+    int8_t rssi;
+    uint16_t cooldown_remaining;  // Seconds
+    uint16_t last_seen_age;       // Seconds, DEVICE_STATUS_AGE_NEVER if never seen
+} prop_status_t;
+
+typedef struct {
+    uint8_t seq;
+    uint8_t total;      // Devices in the whole snapshot
+    bool complete;      // This chunk was the snapshot's last
+} prop_status_chunk_t;
+
+// Decode one CMD_DEVICE_STATUS payload into table (DEVICE_STATUS_MAX_DEVICES
+// entries). Records with an id out of range are skipped; props without a
+// name get "Prop <id>". False if the payload is too short for its header.
+bool prop_status_decode(prop_status_t *table, const uint8_t *payload, uint16_t len, prop_status_chunk_t *chunk);
+
+// The first count entries of table as a JSON array under key
+void prop_status_json(json_writer_t *w, const char *key, const prop_status_t *table, size_t count);
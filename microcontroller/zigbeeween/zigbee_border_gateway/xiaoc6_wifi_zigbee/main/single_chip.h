@@ -0,0 +1,10 @@
+#pragma once
+
+// Glue between the halves of the single-chip gateway (xiaoc6_wifi_zigbee).
+// The coordinator owns app_main and starts what is app_main in the TinyS3
+// build as a task, next to the Zigbee task rather than after the network
+// forms; their frames go over gateway_link.
+
+#define WEB_GATEWAY_TASK_STACK 4096
+
+void web_gateway_task(void *pvParameters);
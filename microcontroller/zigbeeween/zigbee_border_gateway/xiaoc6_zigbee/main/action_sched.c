@@ -0,0 +1,105 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "action_sched.h"
+
+static const char *TAG = "action_sched";
+
+typedef struct {
+    int64_t due_us;
+    uint8_t kind;
+    uint8_t target;
+    uint8_t owner;
+} staged_action_t;
+
+static action_run_fn_t run_action;
+static esp_timer_handle_t sched_timer = NULL;
+static SemaphoreHandle_t sched_mutex = NULL;  // Held for list edits only; actions run outside it
+static staged_action_t staged[ACTION_SCHED_MAX];  // Sorted by due time
+static size_t staged_count = 0;
+
+static void sched_arm_locked(void)
+{
+    esp_timer_stop(sched_timer);  // Fails harmlessly when not running
+    if (staged_count > 0) {
+        int64_t wait = staged[0].due_us - esp_timer_get_time();
+        esp_timer_start_once(sched_timer, wait > 0 ? wait : 0);
+    }
+}
+
+static void sched_timer_cb(void *arg)
+{
+    static staged_action_t due[ACTION_SCHED_MAX];  // esp_timer task only
+    size_t n = 0;
+
+    xSemaphoreTake(sched_mutex, portMAX_DELAY);
+    int64_t horizon_us = esp_timer_get_time() + ACTION_SCHED_BATCH_US;
+    while (n < staged_count && staged[n].due_us <= horizon_us) {
+        due[n] = staged[n];
+        n++;
+    }
+    staged_count -= n;
+    memmove(staged, &staged[n], staged_count * sizeof(staged[0]));
+    sched_arm_locked();
+    xSemaphoreGive(sched_mutex);
+
+    for (size_t i = 0; i < n; i++) {
+        run_action(due[i].kind, due[i].target, 0, true);
+    }
+}
+
+void action_sched_init(action_run_fn_t run)
+{
+    run_action = run;
+    sched_mutex = xSemaphoreCreateMutex();
+    const esp_timer_create_args_t timer_args = {
+        .callback = sched_timer_cb,
+        .name = "action_sched",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &sched_timer));
+}
+
+bool action_sched_add(int64_t due_us, uint8_t kind, uint8_t target, action_owner_t owner)
+{
+    xSemaphoreTake(sched_mutex, portMAX_DELAY);
+    if (staged_count == ACTION_SCHED_MAX) {
+        xSemaphoreGive(sched_mutex);
+        ESP_LOGW(TAG, "Schedule full, dropping action %u -> %u", kind, target);
+        return false;
+    }
+
+    size_t i = staged_count++;
+    while (i > 0 && staged[i - 1].due_us > due_us) {
+        staged[i] = staged[i - 1];
+        i--;
+    }
+    staged[i] = (staged_action_t){ due_us, kind, target, (uint8_t)owner };
+    if (i == 0) {
+        sched_arm_locked();  // New head
+    }
+    xSemaphoreGive(sched_mutex);
+    return true;
+}
+
+size_t action_sched_cancel(action_owner_t owner)
+{
+    size_t kept = 0;
+    xSemaphoreTake(sched_mutex, portMAX_DELAY);
+    size_t before = staged_count;
+    for (size_t i = 0; i < staged_count; i++) {
+        if (staged[i].owner != owner) {
+            staged[kept++] = staged[i];
+        }
+    }
+    staged_count = kept;
+    sched_arm_locked();
+    xSemaphoreGive(sched_mutex);
+    return before - kept;
+}
+
+size_t action_sched_run_now(uint8_t kind, uint8_t target, uint16_t seq)
+{
+    return run_action(kind, target, seq, false);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Trigger actions staged for a later time: delayed rule actions and
+// choreography steps. Entries are kept sorted by due time behind a single
+// one-shot esp_timer armed for the earliest, so there is no periodic tick
+// and each step fires within the esp_timer task's latency of its time.
+// Steps due within ACTION_SCHED_BATCH_US of each other fire in one pass, so
+// props meant to go together aren't split across two timer wakeups.
+
+#define ACTION_SCHED_MAX       48
+#define ACTION_SCHED_BATCH_US  500
+
+// Who staged an entry, so one owner can cancel its own without the other's
+typedef enum {
+    ACTION_OWNER_RULES,
+    ACTION_OWNER_CHOREO,
+} action_owner_t;
+
+// Runs one RULE_ACTION_* and returns the number of devices fired. seq is
+// the TinyS3 trigger sequence (staged actions run with 0); scheduled is true
+// for staged actions and false for action_sched_run_now().
+typedef size_t (*action_run_fn_t)(uint8_t kind, uint8_t target, uint16_t seq, bool scheduled);
+
+void action_sched_init(action_run_fn_t run);
+
+// Stage kind/target to run at due_us (esp_timer time). False if full.
+bool action_sched_add(int64_t due_us, uint8_t kind, uint8_t target, action_owner_t owner);
+
+// Drop every staged entry of owner. Returns how many were dropped.
+size_t action_sched_cancel(action_owner_t owner);
+
+// Run an action now, through the same function staged ones use
+size_t action_sched_run_now(uint8_t kind, uint8_t target, uint16_t seq);
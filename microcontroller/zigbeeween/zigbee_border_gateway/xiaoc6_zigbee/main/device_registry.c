@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "uart_proto.h"
+#include "device_registry.h"
+
+static const char *TAG = "device_registry";
+
+#define INDEX_SIZE (1u << DEVICE_REGISTRY_INDEX_BITS)
+#define INDEX_MASK (INDEX_SIZE - 1)
+#define INDEX_EMPTY 0xFF
+
+_Static_assert(DEVICE_REGISTRY_MAX_DEVICES < INDEX_SIZE, "index must have a free slot");
+_Static_assert(DEVICE_REGISTRY_MAX_DEVICES < INDEX_EMPTY, "dense index must fit in a byte");
+
+#define NVS_NAMESPACE "devreg"
+#define NVS_KEY_DEVICES "devices_v1"
+
+// Props this installation ships with. On a fresh table they are added in this
+// order, so their ids match DEVICE_ID_RIP / DEVICE_ID_HALLOWEEN in uart_proto.h.
+static const struct {
+    uint64_t ieee_addr;
+    const char *name;
+    uint8_t caps;
+} builtin_props[] = {
+    { 0x9888e0fffe7f971cULL, "RIP Tombstone",
+      DEVICE_CAP_LIGHTS | DEVICE_CAP_MOTION | DEVICE_CAP_TIME_SYNC },
+    { 0x9888e0fffe7ade0cULL, "Haunted Pumpkin Scarecrow",
+      DEVICE_CAP_RELAY | DEVICE_CAP_TIME_SYNC },
+};
+
+// On-flash record, identity fields only
+typedef struct __attribute__((packed)) {
+    uint64_t ieee_addr;
+    uint16_t short_addr;
+    uint8_t endpoint;
+    uint8_t caps;
+    char name[DEVICE_NAME_LEN];
+} device_record_t;
+
+static zigbee_device_t devices[DEVICE_REGISTRY_MAX_DEVICES];
+static size_t device_count = 0;
+
+// Open-addressed (linear probing) indexes holding dense array positions
+static uint8_t ieee_index[INDEX_SIZE];
+static uint8_t short_index[INDEX_SIZE];
+
+static SemaphoreHandle_t registry_mutex = NULL;
+static bool registry_dirty = false;
+
+static inline uint32_t hash_ieee(uint64_t ieee_addr)
+{
+    // Fibonacci hashing; the low bytes of an IEEE address are the most random
+    return (uint32_t)((ieee_addr * 0x9E3779B97F4A7C15ULL) >> (64 - DEVICE_REGISTRY_INDEX_BITS));
+}
+
+static inline uint32_t hash_short(uint16_t short_addr)
+{
+    return ((uint32_t)short_addr * 0x9E3779B1u) >> (32 - DEVICE_REGISTRY_INDEX_BITS);
+}
+
+static int ieee_lookup_locked(uint64_t ieee_addr)
+{
+    for (uint32_t slot = hash_ieee(ieee_addr); ; slot = (slot + 1) & INDEX_MASK) {
+        uint8_t pos = ieee_index[slot];
+        if (pos == INDEX_EMPTY) {
+            return -1;
+        }
+        if (devices[pos].ieee_addr == ieee_addr) {
+            return pos;
+        }
+    }
+}
+
+static void ieee_insert_locked(uint8_t pos)
+{
+    uint32_t slot = hash_ieee(devices[pos].ieee_addr);
+    while (ieee_index[slot] != INDEX_EMPTY) {
+        slot = (slot + 1) & INDEX_MASK;
+    }
+    ieee_index[slot] = pos;
+}
+
+// Short addresses only change on join/leave, so the index is rebuilt rather
+// than supporting deletion
+static void short_rebuild_locked(void)
+{
+    memset(short_index, INDEX_EMPTY, sizeof(short_index));
+    for (size_t i = 0; i < device_count; i++) {
+        if (devices[i].short_addr == 0) {
+            continue;
+        }
+        uint32_t slot = hash_short(devices[i].short_addr);
+        while (short_index[slot] != INDEX_EMPTY) {
+            slot = (slot + 1) & INDEX_MASK;
+        }
+        short_index[slot] = (uint8_t)i;
+    }
+}
+
+static zigbee_device_t *append_locked(uint64_t ieee_addr, const char *name, uint8_t caps)
+{
+    if (device_count >= DEVICE_REGISTRY_MAX_DEVICES) {
+        return NULL;
+    }
+
+    zigbee_device_t *dev = &devices[device_count];
+    memset(dev, 0, sizeof(*dev));
+    dev->ieee_addr = ieee_addr;
+    dev->id = (uint8_t)(device_count + 1);
+    dev->endpoint = 1;
+    dev->caps = caps;
+    if (name) {
+        strncpy(dev->name, name, sizeof(dev->name) - 1);
+    } else {
+        snprintf(dev->name, sizeof(dev->name), "Prop %08lx", (unsigned long)(ieee_addr & 0xFFFFFFFF));
+    }
+
+    ieee_insert_locked((uint8_t)device_count);
+    device_count++;
+    registry_dirty = true;
+    return dev;
+}
+
+static void load_from_nvs(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        ESP_LOGI(TAG, "No saved device table");
+        return;
+    }
+
+    static device_record_t records[DEVICE_REGISTRY_MAX_DEVICES];
+    size_t size = sizeof(records);
+    esp_err_t err = nvs_get_blob(handle, NVS_KEY_DEVICES, records, &size);
+    nvs_close(handle);
+
+    if (err != ESP_OK || size % sizeof(device_record_t) != 0) {
+        ESP_LOGW(TAG, "Saved device table unreadable (%s), starting empty", esp_err_to_name(err));
+        return;
+    }
+
+    size_t n = size / sizeof(device_record_t);
+    for (size_t i = 0; i < n; i++) {
+        char name[DEVICE_NAME_LEN];
+        memcpy(name, records[i].name, sizeof(name));
+        name[sizeof(name) - 1] = '\0';
+
+        zigbee_device_t *dev = append_locked(records[i].ieee_addr, name, records[i].caps);
+        if (!dev) {
+            break;
+        }
+        dev->short_addr = records[i].short_addr;
+        dev->endpoint = records[i].endpoint;
+    }
+    registry_dirty = false;
+    ESP_LOGI(TAG, "Loaded %u device(s) from NVS", (unsigned)device_count);
+}
+
+void device_registry_init(void)
+{
+    registry_mutex = xSemaphoreCreateMutex();
+    memset(ieee_index, INDEX_EMPTY, sizeof(ieee_index));
+
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+    load_from_nvs();
+    for (size_t i = 0; i < sizeof(builtin_props) / sizeof(builtin_props[0]); i++) {
+        if (ieee_lookup_locked(builtin_props[i].ieee_addr) < 0) {
+            append_locked(builtin_props[i].ieee_addr, builtin_props[i].name, builtin_props[i].caps);
+        }
+    }
+    short_rebuild_locked();
+    xSemaphoreGive(registry_mutex);
+
+    // A fresh table gets the builtin props first; the TinyS3 still names them by these ids
+    if (devices[DEVICE_ID_RIP - 1].ieee_addr != builtin_props[0].ieee_addr ||
+        devices[DEVICE_ID_HALLOWEEN - 1].ieee_addr != builtin_props[1].ieee_addr) {
+        ESP_LOGW(TAG, "Builtin props are not at their expected ids");
+    }
+}
+
+zigbee_device_t *device_registry_find_ieee(uint64_t ieee_addr)
+{
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+    int pos = ieee_lookup_locked(ieee_addr);
+    xSemaphoreGive(registry_mutex);
+    return (pos >= 0) ? &devices[pos] : NULL;
+}
+
+zigbee_device_t *device_registry_find_short(uint16_t short_addr)
+{
+    if (short_addr == 0) {
+        return NULL;
+    }
+
+    zigbee_device_t *found = NULL;
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+    for (uint32_t slot = hash_short(short_addr); short_index[slot] != INDEX_EMPTY; slot = (slot + 1) & INDEX_MASK) {
+        if (devices[short_index[slot]].short_addr == short_addr) {
+            found = &devices[short_index[slot]];
+            break;
+        }
+    }
+    xSemaphoreGive(registry_mutex);
+    return found;
+}
+
+zigbee_device_t *device_registry_find_id(uint8_t id)
+{
+    // Records are never removed, so an id below the count is always valid
+    return (id != DEVICE_ID_NONE && id <= device_count) ? &devices[id - 1] : NULL;
+}
+
+zigbee_device_t *device_registry_add(uint64_t ieee_addr)
+{
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+    int pos = ieee_lookup_locked(ieee_addr);
+    zigbee_device_t *dev = (pos >= 0) ? &devices[pos] : append_locked(ieee_addr, NULL, DEVICE_CAP_TIME_SYNC);
+    xSemaphoreGive(registry_mutex);
+
+    if (pos < 0) {
+        if (dev) {
+            ESP_LOGI(TAG, "New device %u: %s (ieee=0x%016llx)", dev->id, dev->name, ieee_addr);
+        } else {
+            ESP_LOGE(TAG, "Device table full, ignoring ieee=0x%016llx", ieee_addr);
+        }
+    }
+    return dev;
+}
+
+void device_registry_set_short(zigbee_device_t *dev, uint16_t short_addr)
+{
+    if (dev->short_addr == short_addr) {
+        return;
+    }
+
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+    dev->short_addr = short_addr;
+    short_rebuild_locked();
+    registry_dirty = true;
+    xSemaphoreGive(registry_mutex);
+}
+
+size_t device_registry_count(void)
+{
+    return device_count;
+}
+
+zigbee_device_t *device_registry_at(size_t index)
+{
+    return (index < device_count) ? &devices[index] : NULL;
+}
+
+void device_registry_save(void)
+{
+    static device_record_t records[DEVICE_REGISTRY_MAX_DEVICES];
+
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+    if (!registry_dirty) {
+        xSemaphoreGive(registry_mutex);
+        return;
+    }
+    size_t n = device_count;
+    for (size_t i = 0; i < n; i++) {
+        records[i].ieee_addr = devices[i].ieee_addr;
+        records[i].short_addr = devices[i].short_addr;
+        records[i].endpoint = devices[i].endpoint;
+        records[i].caps = devices[i].caps;
+        memcpy(records[i].name, devices[i].name, sizeof(records[i].name));
+    }
+    registry_dirty = false;
+    xSemaphoreGive(registry_mutex);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, NVS_KEY_DEVICES, records, n * sizeof(device_record_t));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save device table: %s", esp_err_to_name(err));
+        registry_dirty = true;  // Retry on the next call
+    } else {
+        ESP_LOGI(TAG, "Saved %u device(s) to NVS", (unsigned)n);
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Table of every prop the coordinator knows about, keyed by IEEE address.
+//
+// Records live in a dense array (device id = index + 1, so ids are stable and
+// id lookups are O(1)) with two open-addressed hash indexes on top: one by
+// IEEE address and one by current short address. Identity fields are
+// persisted to NVS so props are recognized again right after a reboot.
+
+#define DEVICE_REGISTRY_MAX_DEVICES  48
+#define DEVICE_REGISTRY_INDEX_BITS   6    // 64 slots, keeps the load factor <= 0.75
+#define DEVICE_NAME_LEN              24
+
+// Capability bits. The 0xFC01 trigger request value is a mask of these: the
+// coordinator triggers every bound prop that has any of the requested bits.
+#define DEVICE_CAP_RELAY      (1 << 0)  // Relay prop fired by On/Off toggle (scarecrow)
+#define DEVICE_CAP_LIGHTS     (1 << 1)  // Light show fired by On/Off toggle (tombstone)
+#define DEVICE_CAP_MOTION     (1 << 2)  // Has a PIR and may send trigger requests
+#define DEVICE_CAP_TIME_SYNC  (1 << 3)  // Implements the 0xFC00 time sync cluster
+
+#define DEVICE_ID_NONE 0
+
+typedef struct {
+    uint64_t ieee_addr;
+    uint16_t short_addr;      // 0 = not currently on the network
+    uint8_t id;               // Stable id used on the UART link (1-based)
+    uint8_t endpoint;
+    uint8_t caps;
+    char name[DEVICE_NAME_LEN];
+
+    // Runtime state (not persisted)
+    bool is_bound;
+    bool time_synced;
+    time_t last_time_sync;
+    time_t last_seen;         // Last neighbor scan with valid signal values
+    uint8_t lqi;              // Smoothed link quality (rounded lqi_avg_q4)
+    int8_t rssi;              // Smoothed RSSI in dBm
+    uint16_t lqi_avg_q4;      // EWMA of neighbor table LQI, 1/16 units (0 = no samples yet)
+    int16_t rssi_avg_q4;      // EWMA of neighbor table RSSI, 1/16 dBm
+    uint8_t missed_scans;     // Consecutive neighbor scans the device was absent from
+    int64_t cooldown_until_us; // esp_timer time the current cooldown ends (0 = none)
+    uint8_t groups;           // Bit i: device confirmed membership of coordinator group i
+    bool sleepy;              // Rx off when idle (announce, neighbor table); polls us for frames
+    int16_t drift_ppm;        // Clock drift the device measured against our time syncs
+    bool drift_known;
+    uint32_t ota_version;     // Running OTA file version from its last image query (0 = unknown)
+    uint32_t ota_served;      // Bytes of the staged image served to it (highest offset reached)
+} zigbee_device_t;
+
+// Load the table from NVS and add any built-in props that are missing.
+// Call after nvs_flash_init().
+void device_registry_init(void);
+
+zigbee_device_t *device_registry_find_ieee(uint64_t ieee_addr);
+zigbee_device_t *device_registry_find_short(uint16_t short_addr);
+zigbee_device_t *device_registry_find_id(uint8_t id);
+
+// Find the record for ieee_addr, creating it (with a default name and
+// capabilities) if this prop has never been seen. NULL if the table is full.
+zigbee_device_t *device_registry_add(uint64_t ieee_addr);
+
+// Record a new short address (0 when the prop leaves) and keep the short
+// address index in sync. Marks the table for saving if the address changed.
+void device_registry_set_short(zigbee_device_t *dev, uint16_t short_addr);
+
+// Dense iteration: for (size_t i = 0; i < device_registry_count(); i++)
+size_t device_registry_count(void);
+zigbee_device_t *device_registry_at(size_t index);
+
+// Write identity fields to NVS if anything changed since the last save.
+// Flash writes are slow, so this is called from the main loop rather than
+// from the Zigbee callbacks that modify the table.
+void device_registry_save(void);
@@ -1,16 +1,35 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "driver/uart.h"
 #include "driver/gpio.h"
 #include "esp_zigbee_core.h"
 #include "nwk/esp_zigbee_nwk.h"
+#include "uart_frame.h"
+#include "uart_proto.h"
+#include "device_registry.h"
+#include "action_sched.h"
+#include "rule_engine.h"
+#include "trigger_filter.h"
+#include "metrics.h"
+#include "applog.h"
+#include "ota_file.h"
+#include "ota_stage.h"
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+#include "esp_ieee802154.h"
+#include "gateway_link.h"
+#include "single_chip.h"
+#endif
 
 static const char *TAG = "xiao_zigbee";
 
@@ -18,29 +37,20 @@ static const char *TAG = "xiao_zigbee";
 #define RF_SWITCH_PIN GPIO_NUM_3       // RF switch power
 #define ANTENNA_SELECT_PIN GPIO_NUM_14 // External antenna select
 
+#if !CONFIG_ZIGBEEWEEN_SINGLE_CHIP
 // UART pins for communication with TinyS3
 #define UART_TX_PIN GPIO_NUM_16  // TX to TinyS3 (D6)
 #define UART_RX_PIN GPIO_NUM_17  // RX from TinyS3 (D7)
 #define UART_NUM UART_NUM_1
 #define UART_BUF_SIZE (1024)
+#define UART_EVENT_QUEUE_LEN 20
 
-// UART command protocol (must match TinyS3)
-#define CMD_TRIGGER_RIP 0x01
-#define CMD_TRIGGER_HALLOWEEN 0x02
-#define CMD_TRIGGER_BOTH 0x03
-#define CMD_STATUS_REQUEST 0x10
-#define CMD_STATUS_RESPONSE 0x11
-#define CMD_TIME_SYNC 0x20
-#define CMD_DEVICE_JOINED 0x30
-#define CMD_DEVICE_LEFT 0x31
-
-// Device IDs for join/leave notifications
-#define DEVICE_ID_RIP 1
-#define DEVICE_ID_HALLOWEEN 2
-
-// Hardcoded IEEE addresses to identify specific devices
-#define HALLOWEEN_TRIGGER_IEEE 0x9888e0fffe7ade0cULL
-#define RIP_TOMBSTONE_IEEE     0x9888e0fffe7f971cULL  // RIP Tombstone device
+// UART command protocol and framing are shared with the TinyS3 (uart_proto.h)
+static QueueHandle_t uart_event_queue = NULL;
+static uart_frame_parser_t uart_parser;
+static SemaphoreHandle_t uart_tx_mutex = NULL;
+static uint8_t uart_tx_buf[UART_FRAME_MAX_SIZE];
+#endif
 
 // Zigbee configuration
 #define ZIGBEE_CHANNEL 15
@@ -48,32 +58,69 @@ static const char *TAG = "xiao_zigbee";
 
 // Zigbee Time Sync Cluster (must match end devices)
 #define ZB_TIME_SYNC_CLUSTER_ID 0xFC00
-#define ZB_TIME_SYNC_ATTR_ID 0x0000
+#define ZB_TIME_SYNC_ATTR_ID 0x0000        // U32 Unix seconds (legacy, no longer written)
+#define ZB_TIME_SYNC_US_ATTR_ID 0x0002     // U64 Unix microseconds
+#define ZB_TIME_SYNC_DRIFT_ATTR_ID 0x0003  // S16 drift measured by the device, ppm (read-only)
+#define ZB_ACTUATION_US_ATTR_ID    0x0004  // U32 last On/Off-to-actuation time on the device, us (read-only)
 
 // Trigger Request Cluster - for end devices to request coordinator to trigger other devices
 #define ZB_TRIGGER_REQUEST_CLUSTER_ID 0xFC01
 #define ZB_TRIGGER_REQUEST_ATTR_ID 0x0000
-
-// Device tracking (IEEE addresses of bound devices)
+#define ZB_TIME_REQUEST_CMD_ID     0x00  // Custom command from a prop: unicast me the time (u8 reason)
+#define ZB_TRIGGER_REQUEST_CMD_ID  0x01  // Custom command from a prop: motion, run my rules (u8 DEVICE_CAP_* hint)
+#define ZB_METRICS_CMD_ID          0x02  // Custom command from a prop: octet string of metric records
+#define TIME_REQUEST_WAKE          1     // Reason: woke from deep sleep (0 = boot)
+#define TIME_REQUEST_MIN_GAP_S     2     // A sync this recent (e.g. from its announce) answers it already
+
+// Zigbee groups the coordinator manages. Each prop is added to every group
+// whose caps it has any of, so triggering a group is a single groupcast
+// On/Off no matter how many props are in it.
 typedef struct {
-    uint64_t ieee_addr;
-    uint16_t short_addr;
-    uint8_t endpoint;
-    char name[32];
-    bool is_bound;
-    bool time_synced;
-    time_t last_time_sync;
-    time_t last_trigger;  // Track when device was last triggered
-} zigbee_device_t;
+    uint16_t group_id;
+    uint8_t caps;
+    const char *name;
+} zb_group_t;
+
+static const zb_group_t zb_groups[] = {
+    { 0x0F01, DEVICE_CAP_RELAY | DEVICE_CAP_LIGHTS, "all props" },
+    { 0x0F02, DEVICE_CAP_RELAY, "relay props" },
+    { 0x0F03, DEVICE_CAP_LIGHTS, "light props" },
+    { 0x0F04, DEVICE_CAP_TIME_SYNC, "time sync" },
+};
+#define ZB_GROUP_COUNT (sizeof(zb_groups) / sizeof(zb_groups[0]))
+#define ZB_GROUP_ALL_PROPS 0  // Index into zb_groups
+#define ZB_GROUP_TIME_SYNC 3
+
+_Static_assert(ZB_GROUP_COUNT <= 8, "zigbee_device_t.groups is a u8 bitmask");
+
+static inline bool device_in_group(const zigbee_device_t *dev, size_t group)
+{
+    return (dev->caps & zb_groups[group].caps) != 0;
+}
+
+// Groupcasts go out as broadcasts to rx-on-when-idle devices (0xFFFD), which
+// sleepy props never see, so those are always sent unicasts instead
+static inline bool device_hears_groupcast(const zigbee_device_t *dev, size_t group)
+{
+    return (dev->groups & (1 << group)) && !dev->sleepy;
+}
 
-static zigbee_device_t rip_tombstone = {0};
-static zigbee_device_t halloween_trigger = {0};
+// Receiver-on-when-idle bit of the MAC capability in a device announce
+#define ZB_MAC_CAP_RX_ON_WHEN_IDLE 0x08
 
 // ============================================================================
 // UART Communication with TinyS3
 // ============================================================================
 
-void setup_uart(void)
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+// Single-chip gateway: the web half runs on this chip, and what it would
+// have sent over the UART arrives through gateway_link instead
+static void uart_send_frame(uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    gateway_link_send(GATEWAY_LINK_WEB, cmd, payload, len);
+}
+#else
+static void setup_uart(void)
 {
     uart_config_t uart_config = {
         .baud_rate = 115200,
@@ -84,14 +131,32 @@ void setup_uart(void)
         .source_clk = UART_SCLK_DEFAULT,
     };
 
-    ESP_ERROR_CHECK(uart_driver_install(UART_NUM, UART_BUF_SIZE * 2, UART_BUF_SIZE * 2, 0, NULL, 0));
+    ESP_ERROR_CHECK(uart_driver_install(UART_NUM, UART_BUF_SIZE * 2, UART_BUF_SIZE * 2,
+                                        UART_EVENT_QUEUE_LEN, &uart_event_queue, 0));
     ESP_ERROR_CHECK(uart_param_config(UART_NUM, &uart_config));
     ESP_ERROR_CHECK(uart_set_pin(UART_NUM, UART_TX_PIN, UART_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
 
+    uart_tx_mutex = xSemaphoreCreateMutex();
+
     ESP_LOGI(TAG, "UART initialized (TX:%d, RX:%d) for TinyS3 communication", UART_TX_PIN, UART_RX_PIN);
 }
 
-void setup_external_antenna(void)
+// Encode and send one frame. Several tasks send frames, so the shared TX
+// buffer is guarded and each frame goes out in a single uart_write_bytes call.
+static void uart_send_frame(uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    xSemaphoreTake(uart_tx_mutex, portMAX_DELAY);
+    size_t n = uart_frame_encode(uart_tx_buf, sizeof(uart_tx_buf), cmd, payload, len);
+    if (n > 0) {
+        uart_write_bytes(UART_NUM, uart_tx_buf, n);
+    } else {
+        ESP_LOGE(TAG, "UART frame 0x%02x too large (%u bytes)", cmd, len);
+    }
+    xSemaphoreGive(uart_tx_mutex);
+}
+#endif
+
+static void setup_external_antenna(void)
 {
     // Configure RF switch power (GPIO3)
     gpio_config_t rf_switch_conf = {
@@ -118,218 +183,1096 @@ void setup_external_antenna(void)
     ESP_LOGI(TAG, "External antenna configured");
 }
 
-void uart_send_device_status(void)
+// ============================================================================
+// Trigger Admission
+// ============================================================================
+
+// Admission rules and counters live in trigger_filter.c; this wraps them in
+// the lock and logs the verdicts.
+
+static trigger_filter_t trigger_filter;
+static SemaphoreHandle_t trigger_mutex = NULL;  // Triggers arrive from the UART and Zigbee tasks
+
+// Decide whether a trigger for dev should go on air, and start its cooldown
+// if so. Does not queue anything.
+static bool trigger_admit_device(zigbee_device_t *dev, int64_t now_us)
+{
+    switch (trigger_filter_admit(&trigger_filter, dev, now_us)) {
+        case TRIGGER_ADMITTED:
+            return true;
+        case TRIGGER_DROPPED_OFFLINE:
+            ESP_LOGW(TAG, "%s not bound or not registered yet", dev->name);
+            return false;
+        case TRIGGER_DROPPED_COOLDOWN:
+            APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Skipping %s (cooldown, %lu s left)", (uintptr_t)dev->name,
+                         (uint32_t)((dev->cooldown_until_us - now_us) / 1000000));
+            return false;
+    }
+    return false;
+}
+
+void send_trigger_stats(void)
 {
-    // Frame format: 0xAA CMD_STATUS_RESPONSE flags(2 bytes) 0x55
-    // Flags bit 0: RIP tombstone time synced
-    // Flags bit 1: Haunted pumpkin scarecrow time synced
-    // Flags bit 2: RIP tombstone connected
-    // Flags bit 3: Haunted pumpkin scarecrow connected
-    // Flags bit 4: RIP tombstone in cooldown
-    // Flags bit 5: Haunted pumpkin scarecrow in cooldown
-    uint16_t flags = 0;
+    // Payload: accepted, dropped (cooldown), dropped (duplicate), dropped (offline), all u32
+    uint8_t payload[16];
+    uart_frame_put_u32(&payload[0], trigger_filter.stats.accepted);
+    uart_frame_put_u32(&payload[4], trigger_filter.stats.dropped_cooldown);
+    uart_frame_put_u32(&payload[8], trigger_filter.stats.dropped_duplicate);
+    uart_frame_put_u32(&payload[12], trigger_filter.stats.dropped_offline);
+    uart_send_frame(CMD_TRIGGER_STATS, payload, sizeof(payload));
+}
 
-    if (rip_tombstone.time_synced) flags |= (1 << 0);
-    if (halloween_trigger.time_synced) flags |= (1 << 1);
-    if (rip_tombstone.is_bound) flags |= (1 << 2);
-    if (halloween_trigger.is_bound) flags |= (1 << 3);
+// ============================================================================
+// Status Push to TinyS3
+// ============================================================================
 
-    // Check cooldown status (2 minutes = 120 seconds)
-    time_t now = time(NULL);
-    if (rip_tombstone.last_trigger > 0 && (now - rip_tombstone.last_trigger) < 120) {
-        flags |= (1 << 4);
+#define STATUS_REFRESH_INTERVAL_MS 30000  // Full snapshot even without changes, keeps LQI/ages fresh
+
+_Static_assert(DEVICE_REGISTRY_MAX_DEVICES <= DEVICE_STATUS_MAX_DEVICES, "registry larger than the status protocol allows");
+
+static TaskHandle_t status_push_task_handle = NULL;
+static volatile bool status_force_send = false;
+static uint8_t status_last_state[DEVICE_REGISTRY_MAX_DEVICES];
+static size_t status_last_count = SIZE_MAX;  // Forces a push on the first pass
+static uint8_t status_seq = 0;
+
+static uint8_t device_state_bits(const zigbee_device_t *dev, int64_t now_us)
+{
+    uint8_t state = 0;
+
+    if (dev->is_bound) state |= DEVICE_STATE_BOUND;
+    if (dev->time_synced) state |= DEVICE_STATE_TIME_SYNCED;
+    if (device_in_cooldown(dev, now_us)) state |= DEVICE_STATE_COOLDOWN;
+    return state;
+}
+
+// Recompute every device's state bits against the last snapshot sent.
+// Returns true if anything differs; next_change_us is set to the earliest
+// time a cooldown bit will clear (0 if none).
+static bool device_status_changed(int64_t now_us, int64_t *next_change_us)
+{
+    size_t count = device_registry_count();
+    bool changed = (count != status_last_count);
+    *next_change_us = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const zigbee_device_t *dev = device_registry_at(i);
+        if (device_state_bits(dev, now_us) != status_last_state[i]) {
+            changed = true;
+        }
+        if (device_in_cooldown(dev, now_us) &&
+            (*next_change_us == 0 || dev->cooldown_until_us < *next_change_us)) {
+            *next_change_us = dev->cooldown_until_us;
+        }
     }
-    if (halloween_trigger.last_trigger > 0 && (now - halloween_trigger.last_trigger) < 120) {
-        flags |= (1 << 5);
+
+    return changed;
+}
+
+// Send the whole registry as CMD_DEVICE_STATUS chunks under one sequence
+// number, and remember the state bits that were sent
+static void send_device_status_snapshot(void)
+{
+    time_t now = time(NULL);
+    int64_t now_us = esp_timer_get_time();
+    static uint8_t payload[DEVICE_STATUS_HEADER_SIZE + DEVICE_STATUS_MAX_PER_FRAME * DEVICE_STATUS_RECORD_SIZE];
+    size_t total = device_registry_count();
+    size_t first = 0;
+
+    status_seq++;
+    do {
+        size_t n = total - first;
+        if (n > DEVICE_STATUS_MAX_PER_FRAME) {
+            n = DEVICE_STATUS_MAX_PER_FRAME;
+        }
+
+        payload[0] = status_seq;
+        payload[1] = (uint8_t)total;
+        payload[2] = (uint8_t)first;
+
+        uint8_t *rec = &payload[DEVICE_STATUS_HEADER_SIZE];
+        for (size_t i = first; i < first + n; i++, rec += DEVICE_STATUS_RECORD_SIZE) {
+            const zigbee_device_t *dev = device_registry_at(i);
+            uint8_t state = device_state_bits(dev, now_us);
+            uint32_t cooldown_left = device_in_cooldown(dev, now_us) ?
+                                     (uint32_t)((dev->cooldown_until_us - now_us + 999999) / 1000000) : 0;
+            uint32_t age = (dev->last_seen > 0) ? (uint32_t)(now - dev->last_seen) : DEVICE_STATUS_AGE_NEVER;
+
+            rec[0] = dev->id;
+            rec[1] = state;
+            rec[2] = dev->lqi;
+            rec[3] = (uint8_t)dev->rssi;
+            uart_frame_put_u16(&rec[4], (uint16_t)cooldown_left);
+            uart_frame_put_u16(&rec[6], age < DEVICE_STATUS_AGE_NEVER ? (uint16_t)age : DEVICE_STATUS_AGE_NEVER);
+            status_last_state[i] = state;
+        }
+
+        uart_send_frame(CMD_DEVICE_STATUS, payload, DEVICE_STATUS_HEADER_SIZE + n * DEVICE_STATUS_RECORD_SIZE);
+        first += n;
+    } while (first < total);
+
+    status_last_count = total;
+    APPLOGD(STATUS, TAG, "UART pushed device status: %u device(s) seq=%u", (unsigned)total, status_seq);
+
+    send_trigger_stats();
+}
+
+// Called after anything that may change a status bit. Cheap: the push task
+// only sends a frame if the flags actually differ from the last push.
+void status_mark_dirty(void)
+{
+    if (status_push_task_handle != NULL) {
+        xTaskNotifyGive(status_push_task_handle);
     }
+}
+
+// Send the current status even if nothing changed (TinyS3 asked for it)
+void status_request_full(void)
+{
+    status_force_send = true;
+    status_mark_dirty();
+}
 
-    uint8_t data[5];
-    data[0] = 0xAA;  // Start byte
-    data[1] = CMD_STATUS_RESPONSE;
-    data[2] = (flags >> 8) & 0xFF;  // High byte
-    data[3] = flags & 0xFF;          // Low byte
-    data[4] = 0x55;  // End byte
+void status_push_task(void *pvParameters)
+{
+    const TickType_t heartbeat_ticks = pdMS_TO_TICKS(STATUS_HEARTBEAT_INTERVAL_MS);
+    const TickType_t refresh_ticks = pdMS_TO_TICKS(STATUS_REFRESH_INTERVAL_MS);
+    TickType_t last_frame = xTaskGetTickCount();
+    TickType_t last_snapshot = last_frame;
+
+    while (1) {
+        int64_t now_us = esp_timer_get_time();
+        int64_t next_change_us;
+        bool changed = device_status_changed(now_us, &next_change_us);
+
+        if (changed || status_force_send || xTaskGetTickCount() - last_snapshot >= refresh_ticks) {
+            status_force_send = false;
+            send_device_status_snapshot();
+            last_frame = last_snapshot = xTaskGetTickCount();
+        } else if (xTaskGetTickCount() - last_frame >= heartbeat_ticks) {
+            uart_send_frame(CMD_HEARTBEAT, &status_seq, sizeof(status_seq));
+            last_frame = xTaskGetTickCount();
+        }
 
-    uart_write_bytes(UART_NUM, data, sizeof(data));
-    ESP_LOGI(TAG, "UART sent device status: flags=0x%04x", flags);
+        // Sleep until the next heartbeat or cooldown expiry, or until notified
+        TickType_t elapsed = xTaskGetTickCount() - last_frame;
+        TickType_t wait = (elapsed < heartbeat_ticks) ? heartbeat_ticks - elapsed : 0;
+        if (next_change_us > now_us) {
+            TickType_t until_change = pdMS_TO_TICKS((uint32_t)((next_change_us - now_us) / 1000) + 1);
+            if (until_change < wait) {
+                wait = until_change;
+            }
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
 }
 
 void uart_send_device_event(uint8_t cmd, uint8_t device_id)
 {
-    // Frame format: 0xAA CMD device_id 0x55
-    uint8_t data[4];
-    data[0] = 0xAA;
-    data[1] = cmd;
-    data[2] = device_id;
-    data[3] = 0x55;
-
-    uart_write_bytes(UART_NUM, data, sizeof(data));
+    // Payload: device_id (u8)
+    uart_send_frame(cmd, &device_id, sizeof(device_id));
 
     const char *event_name = (cmd == CMD_DEVICE_JOINED) ? "joined" : "left";
-    const char *device_name = (device_id == DEVICE_ID_RIP) ? "RIP Tombstone" : "Haunted Pumpkin Scarecrow";
-    ESP_LOGI(TAG, "UART sent: Device %s - %s", event_name, device_name);
+    const zigbee_device_t *dev = device_registry_find_id(device_id);
+    APPLOGI(STATUS, TAG, "UART sent: Device %s - %s", event_name, dev ? dev->name : "Unknown");
 }
 
 // ============================================================================
-// Forward declarations
+// Zigbee Command Queue
 // ============================================================================
 
-void zigbee_send_time_sync_to_device(uint16_t short_addr, uint8_t endpoint, const char* device_name);
+// Everything the coordinator sends over Zigbee goes through this queue.
+// Producers (UART task, signal monitor, Zigbee callbacks) never touch the
+// stack or block on it; zb_dispatch_task drains the queue and holds the ZB
+// lock once per batch, so multi-target triggers go out back-to-back.
+
+#define ZB_REQUEST_QUEUE_LEN  32
+#define ZB_DISPATCH_BATCH_MAX 16   // Bounds how long the stack is held off
+
+typedef enum {
+    ZB_REQ_TOGGLE,        // On/Off toggle
+    ZB_REQ_TIME_SYNC,     // Write the current time to the 0xFC00 cluster
+    ZB_REQ_ADD_GROUP,     // Groups cluster Add Group (group_id) on the device
+    ZB_REQ_GROUP_TOGGLE,  // Groupcast On/Off toggle to group_id
+    ZB_REQ_GROUP_TIME_SYNC, // Groupcast the current time to group_id
+    ZB_REQ_READ_DRIFT,    // Read the device's measured clock drift
+    ZB_REQ_READ_ACTUATION, // Read the device's last actuation time (trigger tracing)
+    ZB_REQ_OTA_NOTIFY,    // Offer the staged OTA image (ota_stage.h) to the props
+} zb_request_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t endpoint;
+    uint16_t short_addr;
+    uint16_t group_id;
+    int64_t enqueued_us;
+} zb_request_t;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t dropped;          // Queue full
+    uint32_t batches;
+    int64_t latency_last_us;   // Queue-to-APS-send
+    int64_t latency_max_us;
+    int64_t latency_sum_us;
+} zb_dispatch_stats_t;
+
+static QueueHandle_t zb_request_queue = NULL;
+static zb_dispatch_stats_t zb_dispatch_stats;
+
+static bool zb_request_post(zb_request_t *req)
+{
+    req->enqueued_us = esp_timer_get_time();
+    if (xQueueSend(zb_request_queue, req, 0) != pdTRUE) {
+        zb_dispatch_stats.dropped++;
+        metrics_inc(METRIC_ZB_REQUESTS_DROPPED);
+        APPLOG_RATELIMIT(ZIGBEE, ESP_LOG_WARN, TAG, 1000, "Zigbee request queue full, dropping request type %u", req->type);
+        return false;
+    }
+    return true;
+}
+
+static bool zb_request_enqueue(uint8_t type, const zigbee_device_t *dev, uint16_t group_id)
+{
+    if (dev->short_addr == 0) {
+        ESP_LOGW(TAG, "Cannot queue Zigbee request - %s not registered (short address is 0)", dev->name);
+        return false;
+    }
+
+    zb_request_t req = {
+        .type = type,
+        .endpoint = dev->endpoint,
+        .short_addr = dev->short_addr,
+        .group_id = group_id,
+    };
+    return zb_request_post(&req);
+}
+
+static inline bool zb_queue_toggle(const zigbee_device_t *dev)
+{
+    return zb_request_enqueue(ZB_REQ_TOGGLE, dev, 0);
+}
+
+static inline bool zb_queue_time_sync(const zigbee_device_t *dev)
+{
+    return zb_request_enqueue(ZB_REQ_TIME_SYNC, dev, 0);
+}
+
+static inline bool zb_queue_add_group(const zigbee_device_t *dev, uint16_t group_id)
+{
+    return zb_request_enqueue(ZB_REQ_ADD_GROUP, dev, group_id);
+}
+
+static inline bool zb_queue_group_toggle(uint16_t group_id)
+{
+    zb_request_t req = {
+        .type = ZB_REQ_GROUP_TOGGLE,
+        .group_id = group_id,
+    };
+    return zb_request_post(&req);
+}
+
+static inline bool zb_queue_group_time_sync(uint16_t group_id)
+{
+    zb_request_t req = {
+        .type = ZB_REQ_GROUP_TIME_SYNC,
+        .group_id = group_id,
+    };
+    return zb_request_post(&req);
+}
+
+static inline bool zb_queue_read_drift(const zigbee_device_t *dev)
+{
+    return zb_request_enqueue(ZB_REQ_READ_DRIFT, dev, 0);
+}
+
+static inline bool zb_queue_read_actuation(const zigbee_device_t *dev)
+{
+    return zb_request_enqueue(ZB_REQ_READ_ACTUATION, dev, 0);
+}
+
+static inline bool zb_queue_ota_notify(void)
+{
+    zb_request_t req = {
+        .type = ZB_REQ_OTA_NOTIFY,
+    };
+    return zb_request_post(&req);
+}
 
 // ============================================================================
-// Neighbor Table and Signal Strength Monitoring
+// Trigger Tracing
 // ============================================================================
 
-void check_device_signal_strength(void)
+// Timing of the latest trigger of each device: trigger received, APS send,
+// ZCL default response, then the prop's own actuation time read back from
+// 0xFC00. Each finished trace goes to the TinyS3 as CMD_TRIGGER_TRACE; the
+// histograms live there. One trace per device is enough since cooldowns keep
+// its triggers seconds apart. zb_dispatch_task marks sends and runs the
+// timeouts, the Zigbee task records responses.
+
+#define TRACE_RESPONSE_TIMEOUT_MS 5000  // Sleepy props answer on their next poll
+#define TRACE_READ_TIMEOUT_MS     5000
+#define TRACE_GROUP_SETTLE_MS     1000  // Groupcasts get no response; read actuation after this
+#define TRACE_SERVICE_MS          250   // Dispatcher wake-up while traces are open
+
+typedef enum {
+    TRACE_IDLE,
+    TRACE_QUEUED,    // Waiting in the request queue
+    TRACE_SENT,      // Waiting for the default response (or the group settle time)
+    TRACE_READING,   // Waiting for the actuation attribute
+} trace_state_t;
+
+typedef struct {
+    uint8_t state;
+    uint8_t flags;         // TRIGGER_TRACE_*
+    uint16_t seq;
+    int64_t rx_us;
+    int64_t send_us;       // 0 = not sent
+    int64_t resp_us;       // 0 = no default response
+    int64_t deadline_us;   // For the current state
+} trigger_trace_t;
+
+static trigger_trace_t traces[DEVICE_REGISTRY_MAX_DEVICES];  // By registry position
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile int trace_open = 0;  // Traces not TRACE_IDLE
+
+static uint32_t trace_span_us(int64_t from_us, int64_t to_us)
 {
-    esp_zb_nwk_info_iterator_t iterator = ESP_ZB_NWK_INFO_ITERATOR_INIT;
-    esp_zb_nwk_neighbor_info_t nbr_info;
-    bool found_any = false;
-    int total_devices = 0;
-    bool found_scarecrow = false;
-    bool found_tombstone = false;
-
-    while (esp_zb_nwk_get_next_neighbor(&iterator, &nbr_info) == ESP_OK) {
-        total_devices++;
-
-        // Get IEEE address from neighbor info
-        uint64_t ieee_addr = 0;
-        memcpy(&ieee_addr, nbr_info.ieee_addr, sizeof(esp_zb_ieee_addr_t));
-
-        // Check if this is a known device by IEEE address FIRST
-        // (before filtering by signal quality)
-        bool is_known_device = (ieee_addr == HALLOWEEN_TRIGGER_IEEE) ||
-                               (ieee_addr == RIP_TOMBSTONE_IEEE && RIP_TOMBSTONE_IEEE != 0);
-
-        // Debug: Log ALL devices in neighbor table
-        ESP_LOGI(TAG, "Neighbor table entry %d: short=0x%04x, ieee=0x%016llx, LQI=%d, RSSI=%d %s",
-                 total_devices, nbr_info.short_addr, ieee_addr, nbr_info.lqi, nbr_info.rssi,
-                 is_known_device ? "[KNOWN]" : "");
-
-        // Skip devices with invalid signal values ONLY if they're unknown
-        if (!is_known_device && (nbr_info.lqi == 0 || nbr_info.rssi > 0)) {
-            ESP_LOGW(TAG, "  ^ Skipping unknown device (invalid signal values)");
-            continue;
-        }
+    if (from_us == 0 || to_us == 0) {
+        return TRIGGER_TRACE_UNKNOWN;
+    }
+    int64_t span = to_us - from_us;
+    return span < TRIGGER_TRACE_UNKNOWN ? (uint32_t)span : TRIGGER_TRACE_UNKNOWN - 1;
+}
 
-        // For known devices with invalid signals, we'll register them but won't log signal strength
-        bool has_valid_signals = !(nbr_info.lqi == 0 || nbr_info.rssi > 0);
-        found_any = true;
+// Caller holds trace_lock. Ends the trace and encodes its CMD_TRIGGER_TRACE
+// payload; send it once the lock is released.
+static void trace_close_locked(size_t index, uint8_t flags, uint32_t device_us, uint8_t *payload)
+{
+    trigger_trace_t *t = &traces[index];
+    uart_frame_put_u16(&payload[0], t->seq);
+    payload[2] = device_registry_at(index)->id;
+    payload[3] = t->flags | flags;
+    uart_frame_put_u32(&payload[4], trace_span_us(t->rx_us, t->send_us));
+    uart_frame_put_u32(&payload[8], trace_span_us(t->send_us, t->resp_us));
+    uart_frame_put_u32(&payload[12], device_us);
+    t->state = TRACE_IDLE;
+    trace_open--;
+}
 
-        // Match neighbor with our tracked devices by IEEE address
-        const char *device_name = NULL;
-        bool is_synced = false;
-        bool is_known = false;
+// Called for every admitted device before its toggle is queued. seq is the
+// TinyS3's trigger sequence (0 for triggers requested by a prop).
+static void trace_begin(const zigbee_device_t *dev, uint16_t seq, int64_t rx_us, bool groupcast)
+{
+    uint8_t payload[TRIGGER_TRACE_SIZE];
+    bool superseded = false;
+    trigger_trace_t *t = &traces[dev->id - 1];
+
+    taskENTER_CRITICAL(&trace_lock);
+    if (t->state != TRACE_IDLE) {
+        trace_close_locked(dev->id - 1, TRIGGER_TRACE_NO_ACTUATION, TRIGGER_TRACE_UNKNOWN, payload);
+        superseded = true;
+    }
+    *t = (trigger_trace_t){
+        .state = TRACE_QUEUED,
+        .flags = groupcast ? TRIGGER_TRACE_GROUPCAST : 0,
+        .seq = seq,
+        .rx_us = rx_us,
+        .deadline_us = rx_us + TRACE_RESPONSE_TIMEOUT_MS * 1000LL,
+    };
+    trace_open++;
+    taskEXIT_CRITICAL(&trace_lock);
 
-        if (ieee_addr == HALLOWEEN_TRIGGER_IEEE) {
-            device_name = "Pumpkin Scarecrow";
-            is_known = true;
+    if (superseded) {
+        uart_send_frame(CMD_TRIGGER_TRACE, payload, sizeof(payload));
+    }
+}
 
-            // Only mark as found if signal values are valid (device is actually online)
-            if (has_valid_signals) {
-                found_scarecrow = true;
+// The toggle never made it into the request queue
+static void trace_abort(const zigbee_device_t *dev)
+{
+    uint8_t payload[TRIGGER_TRACE_SIZE];
+    bool closed = false;
 
-                // Auto-register if not already registered (only when signals are valid)
-                if (halloween_trigger.short_addr == 0 || !halloween_trigger.is_bound) {
-                    halloween_trigger.short_addr = nbr_info.short_addr;
-                    halloween_trigger.ieee_addr = ieee_addr;
-                    halloween_trigger.endpoint = 1;
-                    halloween_trigger.is_bound = true;
+    taskENTER_CRITICAL(&trace_lock);
+    if (traces[dev->id - 1].state == TRACE_QUEUED) {
+        trace_close_locked(dev->id - 1, TRIGGER_TRACE_NOT_SENT, TRIGGER_TRACE_UNKNOWN, payload);
+        closed = true;
+    }
+    taskEXIT_CRITICAL(&trace_lock);
 
-                    ESP_LOGI(TAG, "Auto-registered Haunted Pumpkin Scarecrow (0x%04x, ieee=0x%016llx)",
-                             nbr_info.short_addr, ieee_addr);
+    if (closed) {
+        uart_send_frame(CMD_TRIGGER_TRACE, payload, sizeof(payload));
+    }
+}
 
-                    // Send time sync to newly registered device
-                    zigbee_send_time_sync_to_device(nbr_info.short_addr, 1, "Haunted Pumpkin Scarecrow");
-                    halloween_trigger.time_synced = true;
-                    halloween_trigger.last_time_sync = time(NULL);
+// zb_dispatch_task, right after the APS send. A NULL target marks every
+// queued groupcast trace.
+static void trace_mark_sent(const zigbee_device_t *target)
+{
+    int64_t now = esp_timer_get_time();
+    bool groupcast = target == NULL;
+
+    taskENTER_CRITICAL(&trace_lock);
+    for (size_t i = 0; i < device_registry_count(); i++) {
+        trigger_trace_t *t = &traces[i];
+        bool is_group = (t->flags & TRIGGER_TRACE_GROUPCAST) != 0;
+        if (t->state != TRACE_QUEUED || is_group != groupcast || (target && (size_t)(target->id - 1) != i)) {
+            continue;
+        }
+        t->state = TRACE_SENT;
+        t->send_us = now;
+        t->deadline_us = now + (groupcast ? TRACE_GROUP_SETTLE_MS : TRACE_RESPONSE_TIMEOUT_MS) * 1000LL;
+    }
+    taskEXIT_CRITICAL(&trace_lock);
+}
 
-                    // Notify TinyS3
-                    uart_send_device_event(CMD_DEVICE_JOINED, DEVICE_ID_HALLOWEEN);
+// Caller holds trace_lock. Reading the actuation attribute is queued by the
+// caller once the lock is released.
+static void trace_start_read_locked(trigger_trace_t *t, int64_t now_us)
+{
+    t->state = TRACE_READING;
+    t->deadline_us = now_us + TRACE_READ_TIMEOUT_MS * 1000LL;
+}
+
+// Zigbee task: default response to a unicast toggle
+static void trace_default_response(const zigbee_device_t *dev)
+{
+    int64_t now = esp_timer_get_time();
+    trigger_trace_t *t = &traces[dev->id - 1];
+    bool read = false;
+
+    taskENTER_CRITICAL(&trace_lock);
+    if (t->state == TRACE_SENT && !(t->flags & TRIGGER_TRACE_GROUPCAST)) {
+        t->resp_us = now;
+        trace_start_read_locked(t, now);
+        read = true;
+    }
+    taskEXIT_CRITICAL(&trace_lock);
+
+    if (read) {
+        zb_queue_read_actuation(dev);  // A full queue just ends in the read timeout
+    }
+}
+
+// Zigbee task: the prop reported its actuation time
+static void trace_actuation(const zigbee_device_t *dev, uint32_t device_us)
+{
+    uint8_t payload[TRIGGER_TRACE_SIZE];
+    bool closed = false;
+
+    taskENTER_CRITICAL(&trace_lock);
+    if (traces[dev->id - 1].state == TRACE_READING) {
+        trace_close_locked(dev->id - 1, device_us == TRIGGER_TRACE_UNKNOWN ? TRIGGER_TRACE_NO_ACTUATION : 0,
+                           device_us, payload);
+        closed = true;
+    }
+    taskEXIT_CRITICAL(&trace_lock);
+
+    if (closed) {
+        uart_send_frame(CMD_TRIGGER_TRACE, payload, sizeof(payload));
+    }
+}
+
+// zb_dispatch_task: advance traces whose deadline passed. A missing default
+// response still gets the actuation read, since the toggle may have landed.
+static void trace_service(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    for (size_t i = 0; trace_open > 0 && i < device_registry_count(); i++) {
+        uint8_t payload[TRIGGER_TRACE_SIZE];
+        bool closed = false;
+        bool read = false;
+        trigger_trace_t *t = &traces[i];
+
+        taskENTER_CRITICAL(&trace_lock);
+        if (t->state != TRACE_IDLE && now >= t->deadline_us) {
+            if (t->state == TRACE_QUEUED) {
+                trace_close_locked(i, TRIGGER_TRACE_NOT_SENT, TRIGGER_TRACE_UNKNOWN, payload);
+                closed = true;
+            } else if (t->state == TRACE_SENT) {
+                if (!(t->flags & TRIGGER_TRACE_GROUPCAST)) {
+                    t->flags |= TRIGGER_TRACE_NO_RESPONSE;
                 }
+                trace_start_read_locked(t, now);
+                read = true;
+            } else {
+                trace_close_locked(i, TRIGGER_TRACE_NO_ACTUATION, TRIGGER_TRACE_UNKNOWN, payload);
+                closed = true;
             }
+        }
+        taskEXIT_CRITICAL(&trace_lock);
 
-            is_synced = halloween_trigger.time_synced;
-        } else if (ieee_addr == RIP_TOMBSTONE_IEEE && RIP_TOMBSTONE_IEEE != 0) {
-            device_name = "RIP";
-            is_known = true;
+        if (closed) {
+            uart_send_frame(CMD_TRIGGER_TRACE, payload, sizeof(payload));
+        } else if (read) {
+            zb_queue_read_actuation(device_registry_at(i));
+        }
+    }
+}
 
-            // Only mark as found if signal values are valid (device is actually online)
-            if (has_valid_signals) {
-                found_tombstone = true;
+// ============================================================================
+// Device Presence
+// ============================================================================
 
-                // Auto-register if not already registered (only when signals are valid)
-                if (rip_tombstone.short_addr == 0 || !rip_tombstone.is_bound) {
-                    rip_tombstone.short_addr = nbr_info.short_addr;
-                    rip_tombstone.ieee_addr = ieee_addr;
-                    rip_tombstone.endpoint = 1;
-                    rip_tombstone.is_bound = true;
+// Mark a registered device as on the network at short_addr, sync its clock
+// and tell the TinyS3
+static void device_came_online(zigbee_device_t *dev, uint16_t short_addr)
+{
+    device_registry_set_short(dev, short_addr);
+    dev->is_bound = true;
+    dev->last_seen = time(NULL);
 
-                    ESP_LOGI(TAG, "Auto-registered RIP Tombstone (0x%04x, ieee=0x%016llx)",
-                             nbr_info.short_addr, ieee_addr);
+    if ((dev->caps & DEVICE_CAP_TIME_SYNC) && zb_queue_time_sync(dev)) {
+        dev->time_synced = true;
+        dev->last_time_sync = time(NULL);
+    }
 
-                    // Send time sync to newly registered device
-                    zigbee_send_time_sync_to_device(nbr_info.short_addr, 1, "RIP Tombstone");
-                    rip_tombstone.time_synced = true;
-                    rip_tombstone.last_time_sync = time(NULL);
+    // (Re)join its groups; membership counts once the device confirms it
+    dev->groups = 0;
+    for (size_t g = 0; g < ZB_GROUP_COUNT; g++) {
+        if (device_in_group(dev, g)) {
+            zb_queue_add_group(dev, zb_groups[g].group_id);
+        }
+    }
 
-                    // Notify TinyS3
-                    uart_send_device_event(CMD_DEVICE_JOINED, DEVICE_ID_RIP);
-                }
+    uart_send_device_event(CMD_DEVICE_JOINED, dev->id);
+    status_mark_dirty();
+}
+
+static void device_went_offline(zigbee_device_t *dev, const char *reason)
+{
+    if (!dev->is_bound) {
+        return;
+    }
+
+    ESP_LOGW(TAG, "%s disconnected (%s)", dev->name, reason);
+    dev->is_bound = false;
+    dev->time_synced = false;
+    dev->groups = 0;
+    dev->lqi_avg_q4 = 0;  // Re-seed link averages when it comes back
+    dev->missed_scans = 0;
+    device_registry_set_short(dev, 0);
+    uart_send_device_event(CMD_DEVICE_LEFT, dev->id);
+    status_mark_dirty();
+}
+
+// ============================================================================
+// Radio Telemetry
+// ============================================================================
+
+// Per-device ring of RADIO_TELEMETRY_BUCKET_SECS buckets: min/avg/max of the
+// raw neighbor table samples plus unicast delivery results, so a marginal
+// prop (or a bad antenna/TX power choice) shows up within minutes.
+
+typedef struct {
+    uint8_t lqi_min;
+    uint8_t lqi_max;
+    int8_t rssi_min;
+    int8_t rssi_max;
+    uint16_t lqi_sum;
+    int16_t rssi_sum;
+    uint8_t samples;
+    uint8_t delivered;
+    uint8_t failed;
+} radio_bucket_t;
+
+#define RADIO_RING_LEN (RADIO_TELEMETRY_MAX_BUCKETS + 1)
+
+typedef struct {
+    radio_bucket_t buckets[RADIO_RING_LEN];  // Closed ones plus the open one
+    uint8_t head;             // Open bucket
+    uint8_t closed;           // Closed buckets behind it
+    uint32_t delivered;
+    uint32_t failed;
+} radio_history_t;
+
+static radio_history_t radio_history[DEVICE_REGISTRY_MAX_DEVICES];  // By registry position
+static SemaphoreHandle_t radio_mutex = NULL;
+static int64_t radio_bucket_end_us = RADIO_TELEMETRY_BUCKET_SECS * 1000000LL;
+
+static inline uint8_t sat_inc_u8(uint8_t v)
+{
+    return v < UINT8_MAX ? v + 1 : v;
+}
+
+static void radio_sample(const zigbee_device_t *dev, uint8_t lqi, int8_t rssi)
+{
+    xSemaphoreTake(radio_mutex, portMAX_DELAY);
+    radio_history_t *h = &radio_history[dev->id - 1];
+    radio_bucket_t *b = &h->buckets[h->head];
+    if (b->samples == UINT8_MAX) {
+        xSemaphoreGive(radio_mutex);
+        return;
+    }
+    if (b->samples == 0) {
+        b->lqi_min = b->lqi_max = lqi;
+        b->rssi_min = b->rssi_max = rssi;
+    } else {
+        b->lqi_min = lqi < b->lqi_min ? lqi : b->lqi_min;
+        b->lqi_max = lqi > b->lqi_max ? lqi : b->lqi_max;
+        b->rssi_min = rssi < b->rssi_min ? rssi : b->rssi_min;
+        b->rssi_max = rssi > b->rssi_max ? rssi : b->rssi_max;
+    }
+    b->lqi_sum += lqi;
+    b->rssi_sum += rssi;
+    b->samples++;
+    xSemaphoreGive(radio_mutex);
+}
+
+// ZCL send confirmations (Zigbee task): attribute unicast results to the device
+static void radio_send_status_cb(esp_zb_zcl_command_send_status_message_t message)
+{
+    if (message.dst_addr.addr_type != ESP_ZB_ZCL_ADDR_TYPE_SHORT) {
+        return;  // Groupcasts have no single device to charge
+    }
+    const zigbee_device_t *dev = device_registry_find_short(message.dst_addr.u.short_addr);
+    if (!dev) {
+        return;
+    }
+
+    xSemaphoreTake(radio_mutex, portMAX_DELAY);
+    radio_history_t *h = &radio_history[dev->id - 1];
+    radio_bucket_t *b = &h->buckets[h->head];
+    if (message.status == ESP_OK) {
+        h->delivered++;
+        b->delivered = sat_inc_u8(b->delivered);
+    } else {
+        h->failed++;
+        b->failed = sat_inc_u8(b->failed);
+    }
+    xSemaphoreGive(radio_mutex);
+    metrics_inc(message.status == ESP_OK ? METRIC_ZB_FRAMES_DELIVERED : METRIC_ZB_FRAMES_FAILED);
+}
+
+static void radio_telemetry_init(void)
+{
+    radio_mutex = xSemaphoreCreateMutex();
+}
+
+// Close the open bucket once it's due and send every device's history.
+// Called from the main loop.
+void radio_telemetry_tick(void)
+{
+    int64_t now = esp_timer_get_time();
+    if (now < radio_bucket_end_us) {
+        return;
+    }
+    radio_bucket_end_us = now + RADIO_TELEMETRY_BUCKET_SECS * 1000000LL;
+
+    uint8_t payload[RADIO_TELEMETRY_HEADER_SIZE + RADIO_TELEMETRY_MAX_BUCKETS * RADIO_TELEMETRY_RECORD_SIZE];
+    for (size_t i = 0; i < device_registry_count(); i++) {
+        const zigbee_device_t *dev = device_registry_at(i);
+        radio_history_t *h = &radio_history[i];
+
+        xSemaphoreTake(radio_mutex, portMAX_DELAY);
+        if (h->closed < RADIO_TELEMETRY_MAX_BUCKETS) {
+            h->closed++;
+        }
+        uint8_t count = h->closed;
+        uint8_t first = (h->head + RADIO_RING_LEN - (count - 1)) % RADIO_RING_LEN;
+        uint8_t *rec = &payload[RADIO_TELEMETRY_HEADER_SIZE];
+        for (uint8_t k = 0; k < count; k++, rec += RADIO_TELEMETRY_RECORD_SIZE) {
+            const radio_bucket_t *b = &h->buckets[(first + k) % RADIO_RING_LEN];
+            bool sampled = b->samples > 0;
+            rec[0] = sampled ? b->lqi_min : 0;
+            rec[1] = sampled ? (uint8_t)(b->lqi_sum / b->samples) : 0;
+            rec[2] = sampled ? b->lqi_max : 0;
+            rec[3] = (uint8_t)(sampled ? b->rssi_min : 0);
+            rec[4] = (uint8_t)(sampled ? (int8_t)(b->rssi_sum / b->samples) : 0);
+            rec[5] = (uint8_t)(sampled ? b->rssi_max : 0);
+            rec[6] = b->delivered;
+            rec[7] = b->failed;
+        }
+        payload[0] = dev->id;
+        uart_frame_put_u16(&payload[1], RADIO_TELEMETRY_BUCKET_SECS);
+        payload[3] = count;
+        uart_frame_put_u32(&payload[4], h->delivered);
+        uart_frame_put_u32(&payload[8], h->failed);
+
+        // Open a fresh bucket
+        h->head = (h->head + 1) % RADIO_RING_LEN;
+        h->buckets[h->head] = (radio_bucket_t){0};
+        xSemaphoreGive(radio_mutex);
+
+        uart_send_frame(CMD_RADIO_TELEMETRY, payload,
+                        RADIO_TELEMETRY_HEADER_SIZE + count * RADIO_TELEMETRY_RECORD_SIZE);
+    }
+}
+
+// ============================================================================
+// Metrics
+// ============================================================================
+
+// Most counters are bumped where things happen; tallies kept elsewhere for
+// their own frames are copied in just before a report.
+static void metrics_refresh(void)
+{
+#if !CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+    metrics_set(METRIC_UART_FRAMES_OK, (int32_t)uart_parser.stats.frames_ok);
+    metrics_set(METRIC_UART_CRC_ERRORS, (int32_t)uart_parser.stats.crc_errors);
+    metrics_set(METRIC_UART_BAD_HEADER, (int32_t)uart_parser.stats.bad_header);
+    metrics_set(METRIC_UART_DROPPED_BYTES, (int32_t)uart_parser.stats.dropped_bytes);
+#endif
+    metrics_set(METRIC_TRIGGERS_ACCEPTED, (int32_t)trigger_filter.stats.accepted);
+    metrics_set(METRIC_TRIGGERS_COOLDOWN, (int32_t)trigger_filter.stats.dropped_cooldown);
+    metrics_set(METRIC_TRIGGERS_DUPLICATE, (int32_t)trigger_filter.stats.dropped_duplicate);
+    metrics_set(METRIC_TRIGGERS_OFFLINE, (int32_t)trigger_filter.stats.dropped_offline);
+
+    int bound = 0;
+    for (size_t i = 0; i < device_registry_count(); i++) {
+        bound += device_registry_at(i)->is_bound;
+    }
+    metrics_set(METRIC_ZB_DEVICES_BOUND, bound);
+    metrics_sample_system();
+}
+
+static void metrics_send(uint8_t source, const metrics_snapshot_t *snap, bool with_hists)
+{
+    uint8_t payload[1 + METRICS_FRAME_MAX];
+    size_t next = 0;
+
+    payload[0] = source;
+    while (next != SIZE_MAX) {
+        size_t len = metrics_encode(snap, with_hists, &next, &payload[1], METRICS_FRAME_MAX);
+        if (len == 0) {
+            break;
+        }
+        uart_send_frame(CMD_METRICS, payload, 1 + len);
+    }
+}
+
+// Called from the main loop. On the single-chip gateway both halves share
+// one registry, which the web half already serves as its own.
+void metrics_report(void)
+{
+    metrics_refresh();
+#if !CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+    static metrics_snapshot_t snap;
+    metrics_snapshot_local(&snap);
+    metrics_send(METRICS_SOURCE_COORDINATOR, &snap, true);
+#endif
+}
+
+// Zigbee task: a prop's report, an octet string (length byte first) of
+// scalar records. Checked here so the TinyS3 never sees a torn one.
+static void metrics_forward(const zigbee_device_t *dev, const uint8_t *data, uint16_t size)
+{
+    static metrics_snapshot_t snap;
+
+    if (!dev || size < 1 || data[0] != size - 1) {
+        ESP_LOGW(TAG, "Dropping metrics report from %s (%u bytes)", dev ? dev->name : "unknown prop", size);
+        return;
+    }
+    memset(&snap, 0, sizeof(snap));
+    if (!metrics_decode(&snap, &data[1], data[0])) {
+        ESP_LOGW(TAG, "Malformed metrics report from %s", dev->name);
+        return;
+    }
+    metrics_send(dev->id, &snap, false);
+}
+
+// ============================================================================
+// OTA Server
+// ============================================================================
+
+// The TinyS3 uploads one OTA file at a time (CMD_OTA_*, staged by
+// ota_stage.c) and the OTA Upgrade server on endpoint 1 hands it out. Props
+// ask for it on their own query timer and download blocks in parallel, each
+// at its own pace; every block is read through the stage's cache.
+
+_Static_assert(OTA_STATUS_HEADER_SIZE + DEVICE_REGISTRY_MAX_DEVICES * OTA_STATUS_RECORD_SIZE <= UART_FRAME_MAX_PAYLOAD,
+               "CMD_OTA_STATUS must fit one frame");
+
+static uint32_t ota_progress = 0;  // Bumped by the Zigbee task when a record in CMD_OTA_STATUS changes
+
+static void send_ota_ack(uint8_t result)
+{
+    ota_stage_status_t st;
+    uint8_t payload[OTA_ACK_SIZE];
+
+    ota_stage_status(&st);
+    payload[0] = result;
+    uart_frame_put_u32(&payload[1], st.stored);
+    uart_send_frame(CMD_OTA_ACK, payload, sizeof(payload));
+}
+
+static void send_ota_status(void)
+{
+    ota_stage_status_t st;
+    uint8_t payload[OTA_STATUS_HEADER_SIZE + DEVICE_REGISTRY_MAX_DEVICES * OTA_STATUS_RECORD_SIZE];
+    uint8_t count = 0;
+
+    ota_stage_status(&st);
+    payload[0] = st.stage;
+    uart_frame_put_u16(&payload[1], st.image_type);
+    uart_frame_put_u32(&payload[3], st.file_version);
+    uart_frame_put_u32(&payload[7], st.size);
+    uart_frame_put_u32(&payload[11], st.stored);
+    uint8_t *rec = &payload[OTA_STATUS_HEADER_SIZE];
+    for (size_t i = 0; i < device_registry_count(); i++) {
+        const zigbee_device_t *dev = device_registry_at(i);
+        if (dev->ota_version == 0 && dev->ota_served == 0) {
+            continue;
+        }
+        rec[0] = dev->id;
+        uart_frame_put_u32(&rec[1], dev->ota_version);
+        uart_frame_put_u32(&rec[5], dev->ota_served);
+        rec += OTA_STATUS_RECORD_SIZE;
+        count++;
+    }
+    payload[15] = count;
+    uart_send_frame(CMD_OTA_STATUS, payload, (uint16_t)(rec - payload));
+}
+
+// Zigbee task, once per Image Block Request. The block is served straight
+// from the stage's cache line; the stack copies it into the response.
+static esp_err_t ota_next_data_cb(esp_zb_ota_zcl_information_t message, uint16_t index, uint8_t zcl_len, uint8_t **zcl_data)
+{
+    uint32_t offset = message.offset;
+    uint8_t size = zcl_len;
+    const uint8_t *data = ota_stage_read(offset, &size);
+
+    if (data == NULL) {
+        APPLOG_RATELIMIT(ZIGBEE, ESP_LOG_WARN, TAG, 1000, "OTA block at %lu not available", (unsigned long)offset);
+        return ESP_FAIL;
+    }
+    *zcl_data = (uint8_t *)data;
+
+    zigbee_device_t *dev = device_registry_find_short(message.src_addr.u.short_addr);
+    if (dev && offset + size > dev->ota_served) {
+        dev->ota_served = offset + size;
+        ota_progress++;
+    }
+    return ESP_OK;
+}
+
+// Caller must hold the ZB lock (zb_dispatch_task only). Registers the staged
+// file with the server and sends Image Notify; sleepy props miss that and
+// find the image at their next query.
+static void zigbee_send_ota_notify(void)
+{
+    ota_file_info_t info;
+
+    if (!ota_stage_info(&info)) {
+        return;
+    }
+    esp_zb_ota_upgrade_server_notify_req_t req = {
+        .endpoint = 1,
+        .index = 0,
+        .notify_on = 1,
+        .ota_upgrade_time = 0,   // Apply as soon as the download is verified
+        .ota_file_header = {
+            .manufacturer_code = info.manufacturer_code,
+            .image_type = info.image_type,
+            .file_version = info.file_version,
+            .image_size = info.total_size,
+        },
+        .next_data_cb = ota_next_data_cb,
+    };
+    esp_err_t err = esp_zb_ota_upgrade_server_notify_req(&req);
+    APPLOGI(ZIGBEE, TAG, "Offering %s image version %lu (%lu bytes): %s", ota_file_image_name(info.image_type),
+            (unsigned long)info.file_version, (unsigned long)info.total_size, esp_err_to_name(err));
+}
+
+// Zigbee task: a prop's Query Next Image tells us what it runs
+static void ota_query_image(const esp_zb_zcl_ota_upgrade_query_image_message_t *query)
+{
+    zigbee_device_t *dev = device_registry_find_short(query->zcl_addr.u.short_addr);
+
+    APPLOGD(ZIGBEE, TAG, "OTA query from %s: %s image version %lu", dev ? dev->name : "unknown prop",
+            ota_file_image_name(query->image_type), (unsigned long)query->version);
+    if (dev && dev->ota_version != query->version) {
+        dev->ota_version = query->version;
+        ota_progress++;
+    }
+}
+
+// UART task: a completed upload is offered right away, and progress starts over
+static void ota_upload_end(const uint8_t *payload, uint16_t len)
+{
+    uint8_t result = len >= 4 ? ota_stage_end(uart_frame_get_u32(payload)) : OTA_RESULT_BAD_FORMAT;
+
+    send_ota_ack(result);
+    if (result == OTA_RESULT_OK) {
+        for (size_t i = 0; i < device_registry_count(); i++) {
+            device_registry_at(i)->ota_served = 0;
+        }
+        zb_queue_ota_notify();
+    }
+    send_ota_status();
+}
+
+// ============================================================================
+// Neighbor Table and Signal Strength Monitoring
+// ============================================================================
+
+// Device announce / leave / unavailable signals are the primary liveness
+// source. The neighbor scan only smooths link quality and catches devices
+// that went quiet without a signal, so it backs off while nothing changes:
+// every change (or a ZDO signal via neighbor_scan_kick) drops the interval
+// back to NEIGHBOR_SCAN_MIN_MS, each quiet scan doubles it.
+
+#define NEIGHBOR_SNAPSHOT_MAX    32
+#define NEIGHBOR_SCAN_MIN_MS     3000
+#define NEIGHBOR_SCAN_MAX_MS     60000
+#define NEIGHBOR_MISS_LIMIT      3      // Consecutive absent scans before a device is offline
+#define NEIGHBOR_EWMA_SHIFT      2      // Smoothing weight 1/4
+#define NEIGHBOR_LQI_CHANGE      16     // Smoothed LQI move that counts as a change
+#define NEIGHBOR_LOG_INTERVAL_S  300    // Summary line at most this often while stable
+
+static TaskHandle_t signal_task_handle = NULL;
+
+// Rescan soon; called on ZDO join/leave signals
+static void neighbor_scan_kick(void)
+{
+    if (signal_task_handle) {
+        xTaskNotifyGive(signal_task_handle);
+    }
+}
+
+// Fold one neighbor table sample into the device's averages. True if the
+// smoothed LQI moved enough to be worth pushing.
+static bool neighbor_update_link(zigbee_device_t *dev, uint8_t lqi, int8_t rssi)
+{
+    uint8_t old_lqi = dev->lqi;
+
+    if (dev->lqi_avg_q4 == 0) {
+        dev->lqi_avg_q4 = (uint16_t)(lqi << 4);
+        dev->rssi_avg_q4 = (int16_t)(rssi * 16);
+    } else {
+        dev->lqi_avg_q4 += ((int32_t)(lqi << 4) - dev->lqi_avg_q4) >> NEIGHBOR_EWMA_SHIFT;
+        dev->rssi_avg_q4 += ((int32_t)rssi * 16 - dev->rssi_avg_q4) / (1 << NEIGHBOR_EWMA_SHIFT);
+    }
+    radio_sample(dev, lqi, rssi);
+    dev->lqi = (uint8_t)((dev->lqi_avg_q4 + 8) >> 4);
+    dev->rssi = (int8_t)((dev->rssi_avg_q4 + (dev->rssi_avg_q4 < 0 ? -8 : 8)) / 16);
+
+    return abs((int)dev->lqi - (int)old_lqi) >= NEIGHBOR_LQI_CHANGE;
+}
+
+// One scan. Returns true if anything changed (join, leave, link quality).
+static bool check_device_signal_strength(void)
+{
+    static esp_zb_nwk_neighbor_info_t neighbors[NEIGHBOR_SNAPSHOT_MAX];
+    static time_t last_summary = 0;
+    esp_zb_nwk_info_iterator_t iterator = ESP_ZB_NWK_INFO_ITERATOR_INIT;
+    uint64_t seen = 0;  // Bit i: registry entry i is in the table
+    int unknown = 0;
+    bool changed = false;
+
+    _Static_assert(DEVICE_REGISTRY_MAX_DEVICES <= 64, "seen is a 64-bit mask");
+
+    // Copy the neighbor table under the ZB lock, then work through it without
+    // holding the stack up
+    int neighbor_count = 0;
+    esp_zb_lock_acquire(portMAX_DELAY);
+    while (neighbor_count < NEIGHBOR_SNAPSHOT_MAX &&
+           esp_zb_nwk_get_next_neighbor(&iterator, &neighbors[neighbor_count]) == ESP_OK) {
+        neighbor_count++;
+    }
+    esp_zb_lock_release();
+
+    time_t now = time(NULL);
+    for (int n = 0; n < neighbor_count; n++) {
+        const esp_zb_nwk_neighbor_info_t *nbr = &neighbors[n];
+        bool has_valid_signals = !(nbr->lqi == 0 || nbr->rssi > 0);
+
+        // Short address index first; the IEEE lookup is only for strangers
+        zigbee_device_t *dev = device_registry_find_short(nbr->short_addr);
+        if (!dev) {
+            if (!has_valid_signals) {
+                unknown++;
+                continue;
+            }
+            uint64_t ieee_addr;
+            memcpy(&ieee_addr, nbr->ieee_addr, sizeof(esp_zb_ieee_addr_t));
+            dev = device_registry_add(ieee_addr);  // New props are added the first time they show up
+            if (!dev) {
+                unknown++;
+                continue;
             }
+        }
+
+        APPLOGV(ZIGBEE, TAG, "Neighbor 0x%04x (%s): LQI %d, RSSI %d", nbr->short_addr, dev->name, nbr->lqi, nbr->rssi);
 
-            is_synced = rip_tombstone.time_synced;
-        } else {
-            // Unknown device - log it so user can add to hardcoded list
-            ESP_LOGW(TAG, "Unknown device (0x%04x, ieee=0x%016llx): LQI %3d | RSSI %4d dBm",
-                     nbr_info.short_addr, ieee_addr, nbr_info.lqi, nbr_info.rssi);
-            continue;  // Skip logging in main output
+        // The announce isn't seen again after a coordinator reboot, and a
+        // prop added from this table never announced to us; groupcasts to
+        // a prop wrongly taken for rx-on would go unheard
+        dev->sleepy = !nbr->rx_on_when_idle;
+        if (!has_valid_signals) {
+            continue;  // Registered but no signal data yet
         }
 
-        // Only log known devices with valid signal values
-        if (is_known && has_valid_signals) {
-            // LQI: 0-255 (higher is better, >200 is excellent, 100-200 is good, <100 is poor)
-            // RSSI: dBm (closer to 0 is better, -40 is excellent, -70 is good, -90 is poor)
-            ESP_LOGI(TAG, "%s (0x%04x): LQI %3d/255 | RSSI %4d dBm | Sync %s",
-                     device_name, nbr_info.short_addr, nbr_info.lqi, nbr_info.rssi, is_synced ? "Y" : "N");
-        } else if (is_known && !has_valid_signals) {
-            ESP_LOGI(TAG, "%s (0x%04x): Registered (waiting for signal data) | Sync %s",
-                     device_name, nbr_info.short_addr, is_synced ? "Y" : "N");
+        seen |= 1ULL << (dev->id - 1);
+        dev->last_seen = now;
+        dev->missed_scans = 0;
+        changed |= neighbor_update_link(dev, nbr->lqi, nbr->rssi);
+
+        if (!dev->is_bound || dev->short_addr != nbr->short_addr) {
+            ESP_LOGI(TAG, "Auto-registered %s (0x%04x) from neighbor table", dev->name, nbr->short_addr);
+            device_came_online(dev, nbr->short_addr);
+            changed = true;
         }
     }
 
-    if (total_devices == 0) {
-        ESP_LOGI(TAG, "No devices in neighbor table");
-    } else if (!found_any) {
-        ESP_LOGI(TAG, "Found %d device(s) in neighbor table, but none with valid signal values", total_devices);
+    // Bound devices absent for several scans in a row went quiet without a leave
+    for (size_t i = 0; i < device_registry_count(); i++) {
+        zigbee_device_t *dev = device_registry_at(i);
+        if (!dev->is_bound || (seen & (1ULL << i))) {
+            continue;
+        }
+        changed = true;  // Rescan quickly to confirm
+        if (++dev->missed_scans >= NEIGHBOR_MISS_LIMIT) {
+            device_went_offline(dev, "not in neighbor table");
+        }
     }
 
-    // Check if previously connected devices are now missing from neighbor table
-    if (!found_scarecrow && halloween_trigger.is_bound) {
-        ESP_LOGW(TAG, "Haunted Pumpkin Scarecrow disconnected (not in neighbor table)");
-        halloween_trigger.is_bound = false;
-        halloween_trigger.short_addr = 0;
-        halloween_trigger.time_synced = false;
-        uart_send_device_event(CMD_DEVICE_LEFT, DEVICE_ID_HALLOWEEN);
+    if (changed || now - last_summary >= NEIGHBOR_LOG_INTERVAL_S) {
+        last_summary = now;
+        int bound = 0;
+        for (size_t i = 0; i < device_registry_count(); i++) {
+            bound += device_registry_at(i)->is_bound;
+        }
+        APPLOGI(ZIGBEE, TAG, "Neighbor scan: %d entries, %d/%u devices online, %d unknown%s",
+                neighbor_count, bound, (unsigned)device_registry_count(), unknown, changed ? " (changed)" : "");
+        // Per-device lines are debug level: /api/radio and /metrics have the numbers
+        for (size_t i = 0; APPLOG_ENABLED(ZIGBEE, ESP_LOG_DEBUG) && changed && i < device_registry_count(); i++) {
+            const zigbee_device_t *dev = device_registry_at(i);
+            if (dev->is_bound) {
+                // LQI: 0-255 (>200 excellent, 100-200 good, <100 poor); RSSI: -40 excellent, -90 poor
+                APPLOGD(ZIGBEE, TAG, "  %s (0x%04x): LQI %3u | RSSI %4d dBm | Sync %s",
+                        dev->name, dev->short_addr, dev->lqi, dev->rssi, dev->time_synced ? "Y" : "N");
+            }
+        }
     }
 
-    if (!found_tombstone && rip_tombstone.is_bound) {
-        ESP_LOGW(TAG, "RIP Tombstone disconnected (not in neighbor table)");
-        rip_tombstone.is_bound = false;
-        rip_tombstone.short_addr = 0;
-        rip_tombstone.time_synced = false;
-        uart_send_device_event(CMD_DEVICE_LEFT, DEVICE_ID_RIP);
+    if (changed) {
+        status_mark_dirty();
     }
+    return changed;
 }
 
 void signal_strength_task(void *pvParameters)
 {
+    uint32_t interval_ms = NEIGHBOR_SCAN_MIN_MS;
+
     // Wait 5 seconds before first check (let devices join)
     vTaskDelay(pdMS_TO_TICKS(5000));
 
     while (1) {
-        check_device_signal_strength();
-        vTaskDelay(pdMS_TO_TICKS(3000)); // Check every 3 seconds
+        if (check_device_signal_strength()) {
+            interval_ms = NEIGHBOR_SCAN_MIN_MS;
+        } else if (interval_ms < NEIGHBOR_SCAN_MAX_MS) {
+            interval_ms = (interval_ms * 2 < NEIGHBOR_SCAN_MAX_MS) ? interval_ms * 2 : NEIGHBOR_SCAN_MAX_MS;
+        }
+
+        // A join/leave signal cuts the wait short and restarts the back-off
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(interval_ms)) > 0) {
+            interval_ms = NEIGHBOR_SCAN_MIN_MS;
+            vTaskDelay(pdMS_TO_TICKS(1000));  // Let the stack settle its tables
+        }
     }
 }
 
@@ -337,15 +1280,9 @@ void signal_strength_task(void *pvParameters)
 // Zigbee Coordinator Functions
 // ============================================================================
 
-void zigbee_send_on_command(uint16_t short_addr, uint8_t endpoint)
+// Caller must hold the ZB lock (zb_dispatch_task only)
+static void zigbee_send_on_command(uint16_t short_addr, uint8_t endpoint)
 {
-    if (short_addr == 0) {
-        ESP_LOGW(TAG, "Cannot send command - device not registered (short address is 0)");
-        return;
-    }
-
-    ESP_LOGI(TAG, "Sending Zigbee TOGGLE command to device 0x%04hx endpoint %d", short_addr, endpoint);
-
     esp_zb_zcl_on_off_cmd_t cmd_req;
     cmd_req.zcl_basic_cmd.dst_addr_u.addr_short = short_addr; // Unicast to specific device
     cmd_req.zcl_basic_cmd.dst_endpoint = endpoint;
@@ -356,34 +1293,57 @@ void zigbee_send_on_command(uint16_t short_addr, uint8_t endpoint)
     esp_zb_zcl_on_off_cmd_req(&cmd_req);
 }
 
-void zigbee_send_time_sync_to_device(uint16_t short_addr, uint8_t endpoint, const char* device_name)
+// Caller must hold the ZB lock (zb_dispatch_task only). One frame reaches every
+// member of the group.
+static void zigbee_send_group_toggle(uint16_t group_id)
 {
-    if (short_addr == 0) {
-        ESP_LOGW(TAG, "Cannot send time sync to %s - device not registered", device_name);
-        return;
-    }
+    esp_zb_zcl_on_off_cmd_t cmd_req;
+    cmd_req.zcl_basic_cmd.dst_addr_u.addr_short = group_id;
+    cmd_req.zcl_basic_cmd.src_endpoint = 1;
+    cmd_req.address_mode = ESP_ZB_APS_ADDR_MODE_16_GROUP_ENDP_NOT_PRESENT;
+    cmd_req.on_off_cmd_id = ESP_ZB_ZCL_CMD_ON_OFF_TOGGLE_ID;
 
-    time_t now = time(NULL);
-    if (now < 1000000000) {
-        ESP_LOGW(TAG, "System time not set, skipping time sync to %s", device_name);
+    esp_zb_zcl_on_off_cmd_req(&cmd_req);
+}
+
+// Caller must hold the ZB lock (zb_dispatch_task only)
+static void zigbee_send_add_group(uint16_t short_addr, uint8_t endpoint, uint16_t group_id)
+{
+    esp_zb_zcl_groups_add_group_cmd_t cmd_req;
+    cmd_req.zcl_basic_cmd.dst_addr_u.addr_short = short_addr;
+    cmd_req.zcl_basic_cmd.dst_endpoint = endpoint;
+    cmd_req.zcl_basic_cmd.src_endpoint = 1;
+    cmd_req.address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
+    cmd_req.group_id = group_id;
+
+    esp_zb_zcl_groups_add_group_cmd_req(&cmd_req);
+}
+
+// Caller must hold the ZB lock (zb_dispatch_task only). The timestamp is taken
+// here rather than at enqueue time so a queued sync is never stale. Pass
+// ESP_ZB_APS_ADDR_MODE_16_GROUP_ENDP_NOT_PRESENT and a group id as dst_addr
+// to sync every member with one frame.
+static void zigbee_send_time_sync(uint8_t address_mode, uint16_t dst_addr, uint8_t endpoint)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    if (now.tv_sec < 1000000000) {
         return;
     }
 
-    uint32_t timestamp = (uint32_t)now;
-
-    ESP_LOGI(TAG, "Sending time sync to %s (0x%04hx): timestamp=%lu", device_name, short_addr, timestamp);
+    uint64_t timestamp_us = (uint64_t)now.tv_sec * 1000000 + now.tv_usec;
 
     // Create attribute write command for custom time sync cluster
     esp_zb_zcl_write_attr_cmd_t write_req;
     esp_zb_zcl_attribute_t attr;
 
-    attr.id = ZB_TIME_SYNC_ATTR_ID;
-    attr.data.type = ESP_ZB_ZCL_ATTR_TYPE_U32;
-    attr.data.value = &timestamp;
-    attr.data.size = sizeof(uint32_t);
+    attr.id = ZB_TIME_SYNC_US_ATTR_ID;
+    attr.data.type = ESP_ZB_ZCL_ATTR_TYPE_U64;
+    attr.data.value = &timestamp_us;
+    attr.data.size = sizeof(uint64_t);
 
-    write_req.address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
-    write_req.zcl_basic_cmd.dst_addr_u.addr_short = short_addr;
+    write_req.address_mode = address_mode;
+    write_req.zcl_basic_cmd.dst_addr_u.addr_short = dst_addr;
     write_req.zcl_basic_cmd.dst_endpoint = endpoint;
     write_req.zcl_basic_cmd.src_endpoint = 1;
     write_req.clusterID = ZB_TIME_SYNC_CLUSTER_ID;
@@ -391,8 +1351,146 @@ void zigbee_send_time_sync_to_device(uint16_t short_addr, uint8_t endpoint, cons
     write_req.attr_field = &attr;
 
     esp_zb_zcl_write_attr_cmd_req(&write_req);
+}
+
+// Caller must hold the ZB lock (zb_dispatch_task only). Reads one 0xFC00
+// attribute; the reply arrives in zb_action_handler as
+// ESP_ZB_CORE_CMD_READ_ATTR_RESP_CB_ID.
+static void zigbee_send_read_attr(uint16_t short_addr, uint8_t endpoint, uint16_t attr_id)
+{
+    esp_zb_zcl_read_attr_cmd_t read_req = {0};
+
+    read_req.address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
+    read_req.zcl_basic_cmd.dst_addr_u.addr_short = short_addr;
+    read_req.zcl_basic_cmd.dst_endpoint = endpoint;
+    read_req.zcl_basic_cmd.src_endpoint = 1;
+    read_req.clusterID = ZB_TIME_SYNC_CLUSTER_ID;
+    read_req.attr_number = 1;
+    read_req.attr_field = &attr_id;
+
+    esp_zb_zcl_read_attr_cmd_req(&read_req);
+}
+
+static void zb_dispatch_one(const zb_request_t *req)
+{
+    switch (req->type) {
+        case ZB_REQ_TOGGLE: {
+            zigbee_send_on_command(req->short_addr, req->endpoint);
+            const zigbee_device_t *dev = device_registry_find_short(req->short_addr);
+            if (dev) {
+                trace_mark_sent(dev);
+            }
+            break;
+        }
+        case ZB_REQ_TIME_SYNC:
+            zigbee_send_time_sync(ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT, req->short_addr, req->endpoint);
+            break;
+        case ZB_REQ_ADD_GROUP:
+            zigbee_send_add_group(req->short_addr, req->endpoint, req->group_id);
+            break;
+        case ZB_REQ_GROUP_TOGGLE:
+            zigbee_send_group_toggle(req->group_id);
+            trace_mark_sent(NULL);
+            break;
+        case ZB_REQ_GROUP_TIME_SYNC:
+            zigbee_send_time_sync(ESP_ZB_APS_ADDR_MODE_16_GROUP_ENDP_NOT_PRESENT, req->group_id, 0);
+            break;
+        case ZB_REQ_READ_DRIFT:
+            zigbee_send_read_attr(req->short_addr, req->endpoint, ZB_TIME_SYNC_DRIFT_ATTR_ID);
+            break;
+        case ZB_REQ_READ_ACTUATION:
+            zigbee_send_read_attr(req->short_addr, req->endpoint, ZB_ACTUATION_US_ATTR_ID);
+            break;
+        case ZB_REQ_OTA_NOTIFY:
+            zigbee_send_ota_notify();
+            break;
+        default:
+            return;
+    }
+
+    int64_t latency = esp_timer_get_time() - req->enqueued_us;
+    zb_dispatch_stats.sent++;
+    zb_dispatch_stats.latency_last_us = latency;
+    zb_dispatch_stats.latency_sum_us += latency;
+    if (latency > zb_dispatch_stats.latency_max_us) {
+        zb_dispatch_stats.latency_max_us = latency;
+    }
+    metrics_inc(METRIC_ZB_REQUESTS_SENT);
+    metrics_observe(METRIC_HIST_ZB_DISPATCH_US, (uint32_t)latency);
+}
+
+void zb_dispatch_task(void *pvParameters)
+{
+    zb_request_t req;
+
+    while (1) {
+        // Wake up periodically only while trigger traces wait on a deadline
+        TickType_t wait = trace_open > 0 ? pdMS_TO_TICKS(TRACE_SERVICE_MS) : portMAX_DELAY;
+        bool got = xQueueReceive(zb_request_queue, &req, wait) == pdTRUE;
+        trace_service();
+        if (!got) {
+            continue;
+        }
+
+        // One lock acquisition for everything already queued
+        int batch = 0;
+        esp_zb_lock_acquire(portMAX_DELAY);
+        do {
+            zb_dispatch_one(&req);
+            batch++;
+        } while (batch < ZB_DISPATCH_BATCH_MAX && xQueueReceive(zb_request_queue, &req, 0) == pdTRUE);
+        esp_zb_lock_release();
+
+        zb_dispatch_stats.batches++;
+        APPLOGD(ZIGBEE, TAG, "Dispatched %d Zigbee request(s), last latency %lld us", batch, zb_dispatch_stats.latency_last_us);
+    }
+}
+
+// ============================================================================
+// Time Sync
+// ============================================================================
+
+// The coordinator's clock goes to every time-sync prop as one groupcast, so
+// airtime doesn't grow with the number of props. Each prop measures its own
+// drift against these syncs and exposes it as ZB_TIME_SYNC_DRIFT_ATTR_ID; the
+// coordinator reads one prop's drift per round and schedules the next round
+// so the worst prop stays within TIME_SYNC_TOLERANCE_US.
+
+#define TIME_SYNC_TOLERANCE_US   20000  // Keeps is_sleep_time() boundaries aligned across props
+#define TIME_SYNC_ASSUMED_PPM    40     // Until a prop has reported its drift
+#define TIME_SYNC_MIN_INTERVAL_S 60
+#define TIME_SYNC_MAX_INTERVAL_S 3600
+#define TIME_SYNC_RETRY_S        10     // After the groupcast found the Zigbee queue full
+#define TIME_SYNC_STEP_RESYNC_US (TIME_SYNC_TOLERANCE_US / 2)  // TinyS3 correction that warrants a resync
+
+static size_t time_sync_drift_next = 0;  // Round-robin index for drift reads
+static int64_t time_sync_next_us = 0;    // esp_timer time of the next scheduled round
+
+// Seconds until the next sync round, from the worst drift among connected props
+uint32_t time_sync_interval_s(void)
+{
+    uint32_t worst_ppm = 0;
+
+    for (size_t i = 0; i < device_registry_count(); i++) {
+        const zigbee_device_t *dev = device_registry_at(i);
+        if (!dev->is_bound || !(dev->caps & DEVICE_CAP_TIME_SYNC)) {
+            continue;
+        }
+        uint32_t ppm = dev->drift_known ? (uint32_t)abs(dev->drift_ppm) : TIME_SYNC_ASSUMED_PPM;
+        if (ppm > worst_ppm) {
+            worst_ppm = ppm;
+        }
+    }
+
+    if (worst_ppm == 0) {
+        return TIME_SYNC_MAX_INTERVAL_S;
+    }
 
-    ESP_LOGI(TAG, "Time sync command sent to %s", device_name);
+    // 1 ppm drifts 1 us per second
+    uint32_t interval = TIME_SYNC_TOLERANCE_US / worst_ppm;
+    if (interval < TIME_SYNC_MIN_INTERVAL_S) interval = TIME_SYNC_MIN_INTERVAL_S;
+    if (interval > TIME_SYNC_MAX_INTERVAL_S) interval = TIME_SYNC_MAX_INTERVAL_S;
+    return interval;
 }
 
 void zigbee_broadcast_time_sync(void)
@@ -406,64 +1504,290 @@ void zigbee_broadcast_time_sync(void)
     struct tm timeinfo;
     localtime_r(&now, &timeinfo);
 
-    ESP_LOGI(TAG, "Broadcasting time sync: %02d:%02d:%02d",
-             timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
+    // Queue the groupcast before marking anyone synced: if the queue is full,
+    // the grouped props stay due and the round is retried shortly
+    bool any_grouped = false;
+    for (size_t i = 0; i < device_registry_count(); i++) {
+        const zigbee_device_t *dev = device_registry_at(i);
+        if (dev->is_bound && dev->short_addr != 0 && (dev->caps & DEVICE_CAP_TIME_SYNC) &&
+            device_hears_groupcast(dev, ZB_GROUP_TIME_SYNC)) {
+            any_grouped = true;
+            break;
+        }
+    }
+    bool group_queued = any_grouped && zb_queue_group_time_sync(zb_groups[ZB_GROUP_TIME_SYNC].group_id);
 
-    // Send time sync to each registered device
-    if (halloween_trigger.is_bound && halloween_trigger.short_addr != 0) {
-        zigbee_send_time_sync_to_device(halloween_trigger.short_addr, halloween_trigger.endpoint, "Haunted Pumpkin Scarecrow");
-        halloween_trigger.time_synced = true;
-        halloween_trigger.last_time_sync = now;
+    // Props that haven't confirmed the time sync group yet (or sleep) get a unicast
+    int grouped = 0, unicast = 0;
+    for (size_t i = 0; i < device_registry_count(); i++) {
+        zigbee_device_t *dev = device_registry_at(i);
+        if (!dev->is_bound || dev->short_addr == 0 || !(dev->caps & DEVICE_CAP_TIME_SYNC)) {
+            continue;
+        }
+        if (device_hears_groupcast(dev, ZB_GROUP_TIME_SYNC)) {
+            if (!group_queued) {
+                continue;
+            }
+            grouped++;
+        } else if (zb_queue_time_sync(dev)) {
+            unicast++;
+        } else {
+            continue;
+        }
+        dev->time_synced = true;
+        dev->last_time_sync = now;
     }
 
-    if (rip_tombstone.is_bound && rip_tombstone.short_addr != 0) {
-        zigbee_send_time_sync_to_device(rip_tombstone.short_addr, rip_tombstone.endpoint, "RIP Tombstone");
-        rip_tombstone.time_synced = true;
-        rip_tombstone.last_time_sync = now;
+    if (any_grouped && !group_queued) {
+        ESP_LOGW(TAG, "Zigbee queue full, time sync groupcast retried in %d s", TIME_SYNC_RETRY_S);
+        time_sync_next_us = esp_timer_get_time() + (int64_t)TIME_SYNC_RETRY_S * 1000000;
+        return;
+    }
+    time_sync_next_us = esp_timer_get_time() + (int64_t)time_sync_interval_s() * 1000000;
+
+    ESP_LOGI(TAG, "Broadcasting time sync: %02d:%02d:%02d (groupcast to %d, unicast to %d)",
+             timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec, grouped, unicast);
+
+    // Refresh one prop's drift estimate per round
+    size_t count = device_registry_count();
+    for (size_t n = 0; n < count; n++) {
+        zigbee_device_t *dev = device_registry_at((time_sync_drift_next + n) % count);
+        if (dev->is_bound && dev->short_addr != 0 && (dev->caps & DEVICE_CAP_TIME_SYNC)) {
+            zb_queue_read_drift(dev);
+            time_sync_drift_next = (time_sync_drift_next + n + 1) % count;
+            break;
+        }
     }
+
+    status_mark_dirty();
 }
 
-void trigger_rip_tombstone(void)
+// seq is the TinyS3's trigger sequence for tracing (0 = not from the TinyS3).
+// Returns whether the toggle was queued.
+static bool trigger_device_locked(zigbee_device_t *dev, int64_t now_us, uint16_t seq)
 {
-    if (rip_tombstone.is_bound && rip_tombstone.short_addr != 0) {
-        time_t now = time(NULL);
+    if (!trigger_admit_device(dev, now_us)) {
+        return false;
+    }
 
-        // Only update last_trigger if device is not in cooldown
-        // This prevents extending cooldown on repeated trigger attempts
-        bool in_cooldown = (rip_tombstone.last_trigger > 0 && (now - rip_tombstone.last_trigger) < 120);
+    APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Triggering %s", (uintptr_t)dev->name);
+    trace_begin(dev, seq, now_us, false);
+    bool queued = zb_queue_toggle(dev);
+    if (!queued) {
+        trigger_filter_revoke(&trigger_filter, dev);
+        trace_abort(dev);
+    }
+    status_mark_dirty();
+    return queued;
+}
 
-        if (!in_cooldown) {
-            ESP_LOGI(TAG, "🎃 Triggering RIP Tombstone");
-            zigbee_send_on_command(rip_tombstone.short_addr, rip_tombstone.endpoint);
-            rip_tombstone.last_trigger = now;
-        } else {
-            ESP_LOGI(TAG, "🎃 Triggering RIP Tombstone (device in cooldown, not updating timer)");
-            zigbee_send_on_command(rip_tombstone.short_addr, rip_tombstone.endpoint);
+// Returns the number of devices fired (0 or 1). dedup drops a repeat of a
+// trigger for the same target within TRIGGER_DEDUP_WINDOW_MS; sequence steps
+// pass false, since a sequence repeats targets on purpose.
+size_t trigger_device_id(uint8_t device_id, uint16_t seq, bool dedup)
+{
+    zigbee_device_t *dev = device_registry_find_id(device_id);
+    if (!dev) {
+        ESP_LOGW(TAG, "No device with id %u", device_id);
+        return 0;
+    }
+
+    bool fired = false;
+    int64_t now_us = esp_timer_get_time();
+    xSemaphoreTake(trigger_mutex, portMAX_DELAY);
+    if (!dedup || !trigger_filter_is_duplicate(&trigger_filter, TRIGGER_TARGET_DEVICE, device_id, now_us)) {
+        fired = trigger_device_locked(dev, now_us, seq);
+    }
+    xSemaphoreGive(trigger_mutex);
+    return fired ? 1 : 0;
+}
+
+// Fire every admitted member of a group. When every member that would hear
+// the groupcast is admitted, that's one frame; if some are in cooldown (or a
+// member hasn't confirmed the group yet, or sleeps through groupcasts) the
+// admitted ones get unicasts so nothing is sent to props that would ignore
+// it. Returns the number fired.
+static size_t trigger_group_locked(size_t group, int64_t now_us, uint16_t seq)
+{
+    static zigbee_device_t *admitted[DEVICE_REGISTRY_MAX_DEVICES];
+    const zb_group_t *g = &zb_groups[group];
+    size_t n_admitted = 0;
+    bool groupcast_ok = true;
+
+    for (size_t i = 0; i < device_registry_count(); i++) {
+        zigbee_device_t *dev = device_registry_at(i);
+        if (!dev->is_bound || !device_in_group(dev, group)) {
+            continue;
+        }
+        bool confirmed = device_hears_groupcast(dev, group);
+        if (trigger_admit_device(dev, now_us)) {
+            admitted[n_admitted++] = dev;
+            groupcast_ok &= confirmed;
+        } else if (confirmed) {
+            groupcast_ok = false;  // Would hear a groupcast it is going to ignore
+        }
+    }
+
+    if (n_admitted == 0) {
+        APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Nothing to trigger in group %s", (uintptr_t)g->name);
+        return 0;
+    }
+
+    size_t fired = n_admitted;
+    if (groupcast_ok) {
+        APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Triggering %s: groupcast to %u device(s)", (uintptr_t)g->name, n_admitted);
+        for (size_t i = 0; i < n_admitted; i++) {
+            trace_begin(admitted[i], seq, now_us, true);
+        }
+        if (!zb_queue_group_toggle(g->group_id)) {
+            for (size_t i = 0; i < n_admitted; i++) {
+                trigger_filter_revoke(&trigger_filter, admitted[i]);
+                trace_abort(admitted[i]);
+            }
+            fired = 0;
         }
     } else {
-        ESP_LOGW(TAG, "RIP Tombstone not bound or not registered yet");
+        APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Triggering %s: unicast to %u device(s)", (uintptr_t)g->name, n_admitted);
+        for (size_t i = 0; i < n_admitted; i++) {
+            trace_begin(admitted[i], seq, now_us, false);
+            if (!zb_queue_toggle(admitted[i])) {
+                trigger_filter_revoke(&trigger_filter, admitted[i]);
+                trace_abort(admitted[i]);
+                fired--;
+            }
+        }
     }
+    status_mark_dirty();
+    return fired;
 }
 
-void trigger_halloween_decoration(void)
+size_t trigger_group(size_t group, uint16_t seq, bool dedup)
 {
-    if (halloween_trigger.is_bound && halloween_trigger.short_addr != 0) {
-        time_t now = time(NULL);
+    size_t fired = 0;
+    int64_t now_us = esp_timer_get_time();
+    xSemaphoreTake(trigger_mutex, portMAX_DELAY);
+    if (!dedup || !trigger_filter_is_duplicate(&trigger_filter, TRIGGER_TARGET_GROUP, (uint8_t)group, now_us)) {
+        fired = trigger_group_locked(group, now_us, seq);
+    }
+    xSemaphoreGive(trigger_mutex);
+    return fired;
+}
 
-        // Only update last_trigger if device is not in cooldown
-        // This prevents extending cooldown on repeated trigger attempts
-        bool in_cooldown = (halloween_trigger.last_trigger > 0 && (now - halloween_trigger.last_trigger) < 120);
+// Trigger every bound device that has any of the capability bits in caps.
+// Uses the matching group when there is one. Returns the number fired.
+size_t trigger_devices_with_caps(uint8_t caps, uint16_t seq, bool dedup)
+{
+    size_t fired = 0;
+    int64_t now_us = esp_timer_get_time();
+    xSemaphoreTake(trigger_mutex, portMAX_DELAY);
+
+    if (!dedup || !trigger_filter_is_duplicate(&trigger_filter, TRIGGER_TARGET_CAPS, caps, now_us)) {
+        size_t g = 0;
+        while (g < ZB_GROUP_COUNT && zb_groups[g].caps != caps) {
+            g++;
+        }
 
-        if (!in_cooldown) {
-            ESP_LOGI(TAG, "🎃 Triggering Haunted Pumpkin Scarecrow");
-            zigbee_send_on_command(halloween_trigger.short_addr, halloween_trigger.endpoint);
-            halloween_trigger.last_trigger = now;
+        if (g < ZB_GROUP_COUNT) {
+            fired = trigger_group_locked(g, now_us, seq);
         } else {
-            ESP_LOGI(TAG, "🎃 Triggering Haunted Pumpkin Scarecrow (device in cooldown, not updating timer)");
-            zigbee_send_on_command(halloween_trigger.short_addr, halloween_trigger.endpoint);
+            int matched = 0;
+            for (size_t i = 0; i < device_registry_count(); i++) {
+                zigbee_device_t *dev = device_registry_at(i);
+                if ((dev->caps & caps) && dev->is_bound) {
+                    fired += trigger_device_locked(dev, now_us, seq);
+                    matched++;
+                }
+            }
+            if (matched == 0) {
+                ESP_LOGW(TAG, "No connected device with capabilities 0x%02x", caps);
+            }
         }
-    } else {
-        ESP_LOGW(TAG, "Haunted Pumpkin Scarecrow not bound or not registered yet");
+    }
+
+    xSemaphoreGive(trigger_mutex);
+    return fired;
+}
+
+// Rule and choreography actions. Groups past the prop groups (time sync)
+// aren't something to toggle. A scheduled action (a delayed rule action or
+// a choreography step) skips the duplicate check, but a prop in its
+// cooldown still ignores it, so one that fires nothing is warned about.
+static size_t rule_action(uint8_t kind, uint8_t target, uint16_t seq, bool scheduled)
+{
+    size_t fired = 0;
+    switch (kind) {
+        case RULE_ACTION_TRIGGER_DEVICE:
+            fired = trigger_device_id(target, seq, !scheduled);
+            break;
+        case RULE_ACTION_TRIGGER_GROUP:
+            if (target >= ZB_GROUP_TIME_SYNC) {
+                ESP_LOGW(TAG, "Rule targets group %u, which can't be triggered", target);
+                return 0;
+            }
+            fired = trigger_group(target, seq, !scheduled);
+            break;
+        case RULE_ACTION_TRIGGER_CAPS:
+            fired = trigger_devices_with_caps(target, seq, !scheduled);
+            break;
+        default:
+            return 0;
+    }
+    if (scheduled && fired == 0) {
+        APPLOG_RATELIMIT(TRIGGER, ESP_LOG_WARN, TAG, 1000, "Scheduled step %u -> %u fired nothing (cooldown or offline)",
+                         kind, target);
+    }
+    return fired;
+}
+
+// Stage a CMD_CHOREOGRAPHY sequence against the time its frame arrived.
+// Returns the number of devices the offset-0 steps fired.
+static size_t choreography_start(const uint8_t *payload, uint16_t len)
+{
+    int64_t rx_us = esp_timer_get_time();
+    if (len < CHOREO_HEADER_SIZE) {
+        return 0;
+    }
+    uint16_t seq = uart_frame_get_u16(payload);
+    uint8_t steps = payload[2];
+    if (steps > CHOREO_MAX_STEPS || len < CHOREO_HEADER_SIZE + steps * CHOREO_STEP_SIZE) {
+        ESP_LOGW(TAG, "Malformed choreography (%u steps, %u bytes)", steps, len);
+        return 0;
+    }
+    if (steps == 0) {
+        ESP_LOGI(TAG, "Choreography cancelled, %u step(s) dropped",
+                 (unsigned)action_sched_cancel(ACTION_OWNER_CHOREO));
+        return 0;
+    }
+
+    // Stage first so the timer is running before the inline steps take their
+    // share of the radio queue
+    size_t fired = 0;
+    uint32_t last_ms = 0;
+    const uint8_t *step = &payload[CHOREO_HEADER_SIZE];
+    for (uint8_t i = 0; i < steps; i++) {
+        uint16_t offset_ms = uart_frame_get_u16(&step[i * CHOREO_STEP_SIZE + 2]);
+        if (offset_ms > 0) {
+            action_sched_add(rx_us + (int64_t)offset_ms * 1000, step[i * CHOREO_STEP_SIZE],
+                             step[i * CHOREO_STEP_SIZE + 1], ACTION_OWNER_CHOREO);
+            last_ms = offset_ms > last_ms ? offset_ms : last_ms;
+        }
+    }
+    for (uint8_t i = 0; i < steps; i++) {
+        if (uart_frame_get_u16(&step[i * CHOREO_STEP_SIZE + 2]) == 0) {
+            fired += rule_action(step[i * CHOREO_STEP_SIZE], step[i * CHOREO_STEP_SIZE + 1], seq, true);
+        }
+    }
+    APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Choreography: %u step(s) over %lu ms", steps, last_ms);
+    return fired;
+}
+
+// Scheduled from DEVICE_ANNCE so the device has a moment to get ready without
+// blocking the Zigbee task
+static void device_announce_alarm(uint8_t device_id)
+{
+    zigbee_device_t *dev = device_registry_find_id(device_id);
+    if (dev && dev->short_addr != 0) {
+        device_came_online(dev, dev->short_addr);
     }
 }
 
@@ -475,31 +1799,118 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
         case ESP_ZB_CORE_SET_ATTR_VALUE_CB_ID: {
             const esp_zb_zcl_set_attr_value_message_t *attr_msg = (esp_zb_zcl_set_attr_value_message_t *)message;
 
-            ESP_LOGI(TAG, "Zigbee attribute write - Cluster: 0x%04x, Attr: 0x%04x",
-                     attr_msg->info.cluster, attr_msg->attribute.id);
+            APPLOGD(ZIGBEE, TAG, "Zigbee attribute write - Cluster: 0x%04x, Attr: 0x%04x",
+                    attr_msg->info.cluster, attr_msg->attribute.id);
 
             // Check for Trigger Request cluster (0xFC01)
             if (attr_msg->info.cluster == ZB_TRIGGER_REQUEST_CLUSTER_ID) {
                 if (attr_msg->attribute.id == ZB_TRIGGER_REQUEST_ATTR_ID) {
+                    // Value is a DEVICE_CAP_* mask (1 = relay props, i.e. the scarecrow).
+                    // Attribute writes don't tell us the sender, so source rules can't match.
                     uint8_t trigger_target = *(uint8_t *)attr_msg->attribute.data.value;
-                    ESP_LOGI(TAG, "Received trigger request for target: %d", trigger_target);
-
-                    // 1 = trigger scarecrow
-                    if (trigger_target == 1) {
-                        ESP_LOGI(TAG, "Triggering haunted pumpkin scarecrow...");
-                        if (halloween_trigger.short_addr != 0 && halloween_trigger.is_bound) {
-                            zigbee_send_on_command(halloween_trigger.short_addr, halloween_trigger.endpoint);
-                        } else {
-                            ESP_LOGW(TAG, "Scarecrow not connected, cannot trigger");
-                        }
+                    APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Received trigger request for target: %u", trigger_target);
+                    rule_engine_event(RULE_EVENT_PROP_REQUEST, DEVICE_ID_NONE, trigger_target, 0);
+                }
+            }
+            break;
+        }
+        case ESP_ZB_CORE_CMD_OPERATE_GROUP_RESP_CB_ID: {
+            const esp_zb_zcl_groups_operate_group_resp_message_t *resp = (esp_zb_zcl_groups_operate_group_resp_message_t *)message;
+            zigbee_device_t *dev = device_registry_find_short(resp->info.src_address.u.short_addr);
+            bool ok = resp->info.status == ESP_ZB_ZCL_STATUS_SUCCESS ||
+                      resp->info.status == ESP_ZB_ZCL_STATUS_DUPE_EXISTS;
+
+            for (size_t g = 0; dev && g < ZB_GROUP_COUNT; g++) {
+                if (zb_groups[g].group_id == resp->group_id) {
+                    if (ok) {
+                        dev->groups |= (1 << g);
+                    }
+                    APPLOGI(ZIGBEE, TAG, "%s %s group %s (status 0x%02x)", dev->name,
+                            ok ? "joined" : "failed to join", zb_groups[g].name, resp->info.status);
+                }
+            }
+            break;
+        }
+        case ESP_ZB_CORE_CMD_READ_ATTR_RESP_CB_ID: {
+            const esp_zb_zcl_cmd_read_attr_resp_message_t *resp = (esp_zb_zcl_cmd_read_attr_resp_message_t *)message;
+            if (resp->info.cluster != ZB_TIME_SYNC_CLUSTER_ID) {
+                break;
+            }
+            zigbee_device_t *dev = device_registry_find_short(resp->info.src_address.u.short_addr);
+            for (esp_zb_zcl_read_attr_resp_variable_t *var = resp->variables; dev && var; var = var->next) {
+                if (var->status == ESP_ZB_ZCL_STATUS_SUCCESS && var->attribute.id == ZB_TIME_SYNC_DRIFT_ATTR_ID &&
+                    var->attribute.data.size == sizeof(int16_t)) {
+                    dev->drift_ppm = *(int16_t *)var->attribute.data.value;
+                    dev->drift_known = true;
+                    APPLOGI(ZIGBEE, TAG, "%s clock drift %d ppm, next time sync in %lu s",
+                            dev->name, dev->drift_ppm, time_sync_interval_s());
+                } else if (var->attribute.id == ZB_ACTUATION_US_ATTR_ID) {
+                    // Props without the attribute answer UNSUPPORTED_ATTRIBUTE
+                    bool ok = var->status == ESP_ZB_ZCL_STATUS_SUCCESS && var->attribute.data.size == sizeof(uint32_t);
+                    uint32_t device_us = TRIGGER_TRACE_UNKNOWN;
+                    if (ok) {
+                        memcpy(&device_us, var->attribute.data.value, sizeof(device_us));
                     }
+                    trace_actuation(dev, device_us);
+                }
+            }
+            break;
+        }
+        case ESP_ZB_CORE_CMD_DEFAULT_RESP_CB_ID: {
+            const esp_zb_zcl_cmd_default_resp_message_t *resp = (esp_zb_zcl_cmd_default_resp_message_t *)message;
+            APPLOGD(ZIGBEE, TAG, "Default response from 0x%04x: cluster 0x%04x cmd 0x%02x status 0x%02x",
+                     resp->info.src_address.u.short_addr, resp->info.cluster, resp->resp_to_cmd, resp->status_code);
+            if (resp->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_ON_OFF && resp->resp_to_cmd == ESP_ZB_ZCL_CMD_ON_OFF_TOGGLE_ID) {
+                metrics_inc(METRIC_ZB_DEFAULT_RESPONSES);
+                const zigbee_device_t *dev = device_registry_find_short(resp->info.src_address.u.short_addr);
+                if (dev) {
+                    trace_default_response(dev);
                 }
             }
             break;
         }
-        case ESP_ZB_CORE_CMD_DEFAULT_RESP_CB_ID:
-            ESP_LOGI(TAG, "Zigbee command response received");
+        case ESP_ZB_CORE_CMD_CUSTOM_CLUSTER_REQ_CB_ID: {
+            const esp_zb_zcl_custom_cluster_command_message_t *cmd = (esp_zb_zcl_custom_cluster_command_message_t *)message;
+            if (cmd->info.cluster != ZB_TRIGGER_REQUEST_CLUSTER_ID) {
+                break;
+            }
+            zigbee_device_t *dev = device_registry_find_short(cmd->info.src_address.u.short_addr);
+            uint8_t arg = cmd->data.size >= 1 ? *(uint8_t *)cmd->data.value : 0;
+            if (cmd->info.command.id == ZB_TRIGGER_REQUEST_CMD_ID) {
+                APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Trigger request from %s (hint 0x%02x)",
+                             (uintptr_t)(dev ? dev->name : "unknown prop"), arg);
+                rule_engine_event(RULE_EVENT_PROP_REQUEST, dev ? dev->id : DEVICE_ID_NONE, arg, 0);
+                break;
+            }
+            if (cmd->info.command.id == ZB_METRICS_CMD_ID) {
+                metrics_forward(dev, cmd->data.value, cmd->data.size);
+                break;
+            }
+            if (cmd->info.command.id != ZB_TIME_REQUEST_CMD_ID || !dev || !(dev->caps & DEVICE_CAP_TIME_SYNC)) {
+                break;
+            }
+            uint8_t reason = arg;
+            time_t now = time(NULL);
+            APPLOG_DEFER(ZIGBEE, ESP_LOG_INFO, TAG, "Time request from %s (%s)", (uintptr_t)dev->name,
+                         (uintptr_t)(reason == TIME_REQUEST_WAKE ? "wake" : "boot"));
+            if (dev->time_synced && now - dev->last_time_sync < TIME_REQUEST_MIN_GAP_S) {
+                break;
+            }
+            if (zb_queue_time_sync(dev)) {
+                dev->time_synced = true;
+                dev->last_time_sync = now;
+            }
+            break;
+        }
+        case ESP_ZB_CORE_OTA_UPGRADE_SRV_QUERY_IMAGE_CB_ID:
+            ota_query_image((const esp_zb_zcl_ota_upgrade_query_image_message_t *)message);
+            break;
+        case ESP_ZB_CORE_OTA_UPGRADE_SRV_STATUS_CB_ID: {
+            const esp_zb_zcl_ota_upgrade_server_status_message_t *st = (esp_zb_zcl_ota_upgrade_server_status_message_t *)message;
+            APPLOGD(ZIGBEE, TAG, "OTA server status 0x%02x for 0x%04x (version %lu)", st->server_status,
+                    st->zcl_addr.u.short_addr, (unsigned long)st->version);
             break;
+        }
         default:
             ESP_LOGW(TAG, "Receive Zigbee action(0x%x) callback", callback_id);
             break;
@@ -542,6 +1953,9 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
             ESP_LOGI(TAG, "Opening network for joining (permit join = 255 seconds / infinite)");
             esp_zb_bdb_open_network(255);
 
+            // Any image staged before the reboot is offered again
+            zb_queue_ota_notify();
+
             esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
         } else {
             ESP_LOGI(TAG, "Restart network formation (status: %s)", esp_err_to_name(err_status));
@@ -551,7 +1965,7 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
     case ESP_ZB_BDB_SIGNAL_STEERING:
         if (err_status == ESP_OK) {
             ESP_LOGI(TAG, "Network steering started - devices can now join");
-            ESP_LOGI(TAG, "Signal strength task will auto-discover devices every 3 seconds");
+            ESP_LOGI(TAG, "Neighbor scan will auto-discover devices (every 3-60 seconds)");
         }
         break;
     case ESP_ZB_ZDO_SIGNAL_DEVICE_ANNCE:
@@ -563,40 +1977,15 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
 
             ESP_LOGI(TAG, "Device announced: short=0x%04hx, ieee=0x%016llx", short_addr, ieee_addr);
 
-            // Identify device by its hardcoded IEEE address
-            if (ieee_addr == HALLOWEEN_TRIGGER_IEEE) {
-                halloween_trigger.short_addr = short_addr;
-                halloween_trigger.ieee_addr = ieee_addr;
-                halloween_trigger.endpoint = 1;
-                halloween_trigger.is_bound = true;
-                ESP_LOGI(TAG, "Registered as Haunted Pumpkin Scarecrow device");
-
-                // Send time sync to newly joined device
-                vTaskDelay(pdMS_TO_TICKS(500)); // Small delay for device to be ready
-                zigbee_send_time_sync_to_device(short_addr, halloween_trigger.endpoint, "Haunted Pumpkin Scarecrow");
-                halloween_trigger.time_synced = true;
-                halloween_trigger.last_time_sync = time(NULL);
-
-                // Notify TinyS3 of device join
-                uart_send_device_event(CMD_DEVICE_JOINED, DEVICE_ID_HALLOWEEN);
-            } else if (ieee_addr == RIP_TOMBSTONE_IEEE && RIP_TOMBSTONE_IEEE != 0) {
-                rip_tombstone.short_addr = short_addr;
-                rip_tombstone.ieee_addr = ieee_addr;
-                rip_tombstone.endpoint = 1;
-                rip_tombstone.is_bound = true;
-                ESP_LOGI(TAG, "Registered as RIP Tombstone device");
-
-                // Send time sync to newly joined device
-                vTaskDelay(pdMS_TO_TICKS(500)); // Small delay for device to be ready
-                zigbee_send_time_sync_to_device(short_addr, rip_tombstone.endpoint, "RIP Tombstone");
-                rip_tombstone.time_synced = true;
-                rip_tombstone.last_time_sync = time(NULL);
-
-                // Notify TinyS3 of device join
-                uart_send_device_event(CMD_DEVICE_JOINED, DEVICE_ID_RIP);
-            } else {
-                ESP_LOGW(TAG, "Unknown device joined: ieee=0x%016llx (not in hardcoded list)", ieee_addr);
+            // Props seen for the first time are added to the registry
+            zigbee_device_t *dev = device_registry_add(ieee_addr);
+            if (dev) {
+                ESP_LOGI(TAG, "Registered as %s (id %u)", dev->name, dev->id);
+                device_registry_set_short(dev, short_addr);
+                dev->sleepy = !(dev_annce_params->capability & ZB_MAC_CAP_RX_ON_WHEN_IDLE);
+                esp_zb_scheduler_alarm(device_announce_alarm, dev->id, 500); // Small delay for device to be ready
             }
+            neighbor_scan_kick();
         }
         break;
 
@@ -609,19 +1998,11 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
             ESP_LOGI(TAG, "Device left network: short=0x%04hx, ieee=0x%016llx", leave_params->short_addr, ieee_addr);
 
             // Mark device as disconnected
-            if (ieee_addr == HALLOWEEN_TRIGGER_IEEE) {
-                halloween_trigger.is_bound = false;
-                halloween_trigger.short_addr = 0;
-                halloween_trigger.time_synced = false;
-                ESP_LOGI(TAG, "Haunted Pumpkin Scarecrow disconnected");
-                uart_send_device_event(CMD_DEVICE_LEFT, DEVICE_ID_HALLOWEEN);
-            } else if (ieee_addr == RIP_TOMBSTONE_IEEE) {
-                rip_tombstone.is_bound = false;
-                rip_tombstone.short_addr = 0;
-                rip_tombstone.time_synced = false;
-                ESP_LOGI(TAG, "RIP Tombstone disconnected");
-                uart_send_device_event(CMD_DEVICE_LEFT, DEVICE_ID_RIP);
+            zigbee_device_t *dev = device_registry_find_ieee(ieee_addr);
+            if (dev) {
+                device_went_offline(dev, "left network");
             }
+            neighbor_scan_kick();
         }
         break;
 
@@ -633,18 +2014,9 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
                 ESP_LOGI(TAG, "Device unavailable: short=0x%04x", short_addr);
 
                 // Mark device as disconnected if it matches one of our known devices
-                if (halloween_trigger.is_bound && halloween_trigger.short_addr == short_addr) {
-                    halloween_trigger.is_bound = false;
-                    halloween_trigger.short_addr = 0;
-                    halloween_trigger.time_synced = false;
-                    ESP_LOGI(TAG, "Haunted Pumpkin Scarecrow marked unavailable");
-                    uart_send_device_event(CMD_DEVICE_LEFT, DEVICE_ID_HALLOWEEN);
-                } else if (rip_tombstone.is_bound && rip_tombstone.short_addr == short_addr) {
-                    rip_tombstone.is_bound = false;
-                    rip_tombstone.short_addr = 0;
-                    rip_tombstone.time_synced = false;
-                    ESP_LOGI(TAG, "RIP Tombstone marked unavailable");
-                    uart_send_device_event(CMD_DEVICE_LEFT, DEVICE_ID_RIP);
+                zigbee_device_t *dev = device_registry_find_short(short_addr);
+                if (dev) {
+                    device_went_offline(dev, "unavailable");
                 }
             }
         }
@@ -707,6 +2079,10 @@ static void esp_zb_task(void *pvParameters)
     esp_zb_attribute_list_t *on_off_cluster = esp_zb_on_off_cluster_create(&on_off_cfg);
     esp_zb_cluster_list_add_on_off_cluster(cluster_list, on_off_cluster, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
 
+    // Add groups cluster (client role) to put props into trigger groups
+    esp_zb_attribute_list_t *groups_cluster = esp_zb_groups_cluster_create(NULL);
+    esp_zb_cluster_list_add_groups_cluster(cluster_list, groups_cluster, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
+
     // Add trigger request cluster (0xFC01) - SERVER role to receive requests from end devices
     esp_zb_attribute_list_t *trigger_request_cluster = esp_zb_zcl_attr_list_create(ZB_TRIGGER_REQUEST_CLUSTER_ID);
     uint8_t trigger_value = 0;
@@ -714,6 +2090,23 @@ static void esp_zb_task(void *pvParameters)
                                           ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &trigger_value);
     esp_zb_cluster_list_add_custom_cluster(cluster_list, trigger_request_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
 
+    // Add time sync cluster (0xFC00) - CLIENT role, writes time to and reads drift from end devices
+    esp_zb_attribute_list_t *time_sync_cluster = esp_zb_zcl_attr_list_create(ZB_TIME_SYNC_CLUSTER_ID);
+    esp_zb_cluster_list_add_custom_cluster(cluster_list, time_sync_cluster, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
+
+    // Add OTA Upgrade cluster - SERVER role, serves the staged image (one file)
+    esp_zb_ota_cluster_cfg_t ota_cfg = {
+        .ota_upgrade_manufacturer = OTA_MANUFACTURER_CODE,
+    };
+    esp_zb_attribute_list_t *ota_cluster = esp_zb_ota_cluster_create(&ota_cfg);
+    esp_zb_zcl_ota_upgrade_server_variable_t ota_server_var = {
+        .query_jitter = 100,    // Every querying prop gets the image (percent)
+        .current_time = 0,
+        .file_count = 1,
+    };
+    esp_zb_ota_cluster_add_attr(ota_cluster, ESP_ZB_ZCL_ATTR_OTA_UPGRADE_SERVER_DATA_ID, &ota_server_var);
+    esp_zb_cluster_list_add_ota_cluster(cluster_list, ota_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+
     // Create endpoint
     esp_zb_endpoint_config_t endpoint_config = {
         .endpoint = 1,
@@ -727,6 +2120,7 @@ static void esp_zb_task(void *pvParameters)
 
     // Set action handler
     esp_zb_core_action_handler_register(zb_action_handler);
+    esp_zb_zcl_command_send_status_handler_register(radio_send_status_cb);
 
     ESP_LOGI(TAG, "Starting Zigbee coordinator on channel %d", ZIGBEE_CHANNEL);
     ESP_ERROR_CHECK(esp_zb_start(false));
@@ -735,6 +2129,19 @@ static void esp_zb_task(void *pvParameters)
     esp_zb_set_tx_power(20);
     ESP_LOGI(TAG, "Zigbee TX power set to maximum (20 dBm)");
 
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP && CONFIG_ESP_COEX_SW_COEXIST_ENABLE
+    // WiFi shares the radio here, and the coexistence scheduler grants it by
+    // priority. Triggers are what must not wait, so our own transmissions
+    // and their acks outrank WiFi; idle listening yields, and a prop's frame
+    // missed meanwhile is retried by its MAC.
+    esp_ieee802154_coex_config_t coex = {
+        .idle = IEEE802154_LOW,
+        .txrx = IEEE802154_HIGH,
+        .txrx_at = IEEE802154_HIGH,
+    };
+    esp_ieee802154_set_coex_config(coex);
+#endif
+
     esp_zb_main_loop_iteration();
 }
 
@@ -742,84 +2149,217 @@ static void esp_zb_task(void *pvParameters)
 // UART Command Handler Task
 // ============================================================================
 
+// Trigger frames may carry a u16 sequence for tracing; 0 or absent = untraced
+static inline uint16_t trigger_seq(const uint8_t *payload, uint16_t len)
+{
+    return len >= 2 ? uart_frame_get_u16(payload) : 0;
+}
+
+// Sent once the trigger has been admitted so the TinyS3 can time the UART hop
+static void trigger_ack(const uint8_t *payload, uint16_t len, size_t fired)
+{
+    uint16_t seq = trigger_seq(payload, len);
+    if (seq == 0) {
+        return;
+    }
+    uint8_t ack[3];
+    uart_frame_put_u16(ack, seq);
+    ack[2] = (uint8_t)fired;
+    uart_send_frame(CMD_TRIGGER_ACK, ack, sizeof(ack));
+}
+
+static void send_rules_status(uint8_t result)
+{
+    rule_engine_status_t st;
+    rule_engine_status(&st);
+    uint8_t payload[RULE_STATUS_SIZE];
+    payload[0] = result;
+    payload[1] = st.builtin;
+    uart_frame_put_u16(&payload[2], st.rules);
+    uart_frame_put_u16(&payload[4], st.size);
+    uart_frame_put_u16(&payload[6], st.crc);
+    uart_send_frame(CMD_RULES_STATUS, payload, sizeof(payload));
+}
+
+static void handle_uart_frame(void *ctx, uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    switch (cmd) {
+        case CMD_TRIGGER_RIP:
+            APPLOG_DEFER(UART, ESP_LOG_INFO, TAG, "UART received: CMD_TRIGGER_RIP");
+            trigger_ack(payload, len, trigger_device_id(DEVICE_ID_RIP, trigger_seq(payload, len), true));
+            break;
+
+        case CMD_TRIGGER_HALLOWEEN:
+            APPLOG_DEFER(UART, ESP_LOG_INFO, TAG, "UART received: CMD_TRIGGER_HALLOWEEN");
+            trigger_ack(payload, len, trigger_device_id(DEVICE_ID_HALLOWEEN, trigger_seq(payload, len), true));
+            break;
+
+        case CMD_TRIGGER_BOTH:
+            APPLOG_DEFER(UART, ESP_LOG_INFO, TAG, "UART received: CMD_TRIGGER_BOTH");
+            trigger_ack(payload, len, trigger_group(ZB_GROUP_ALL_PROPS, trigger_seq(payload, len), true));
+            break;
+
+        case CMD_GATEWAY_MOTION:
+            APPLOG_DEFER(UART, ESP_LOG_INFO, TAG, "UART received: CMD_GATEWAY_MOTION");
+            trigger_ack(payload, len, rule_engine_event(RULE_EVENT_GATEWAY_MOTION, DEVICE_ID_NONE, 0,
+                                                        trigger_seq(payload, len)));
+            break;
+
+        case CMD_CHOREOGRAPHY:
+            APPLOG_DEFER(UART, ESP_LOG_INFO, TAG, "UART received: CMD_CHOREOGRAPHY");
+            trigger_ack(payload, len, choreography_start(payload, len));
+            break;
+
+        case CMD_STATUS_REQUEST:
+            APPLOG_DEFER(UART, ESP_LOG_INFO, TAG, "UART received: CMD_STATUS_REQUEST");
+            status_request_full();
+            send_rules_status(RULE_RESULT_REPORT);
+            send_ota_status();
+            break;
+
+        // A failed step is reported right away; the TinyS3 gives up on the upload
+        case CMD_RULES_BEGIN: {
+            uint8_t result = len >= 2 ? rule_engine_upload_begin(uart_frame_get_u16(payload)) : RULE_RESULT_BAD_FORMAT;
+            if (result != RULE_RESULT_OK) {
+                send_rules_status(result);
+            }
+            break;
+        }
+
+        case CMD_RULES_DATA: {
+            uint8_t result = len >= 2 ? rule_engine_upload_data(uart_frame_get_u16(payload), &payload[2], len - 2)
+                                      : RULE_RESULT_BAD_FORMAT;
+            if (result != RULE_RESULT_OK) {
+                send_rules_status(result);
+            }
+            break;
+        }
+
+        case CMD_RULES_COMMIT:
+            APPLOG_DEFER(UART, ESP_LOG_INFO, TAG, "UART received: CMD_RULES_COMMIT");
+            send_rules_status(rule_engine_upload_commit());
+            break;
+
+        // Every OTA frame is acked with the stored count, which paces the TinyS3
+        case CMD_OTA_BEGIN: {
+            APPLOG_DEFER(UART, ESP_LOG_INFO, TAG, "UART received: CMD_OTA_BEGIN");
+            uint8_t result = len >= 10 ? ota_stage_begin(uart_frame_get_u16(payload), uart_frame_get_u32(&payload[2]),
+                                                         uart_frame_get_u32(&payload[6]))
+                                       : OTA_RESULT_BAD_FORMAT;
+            send_ota_ack(result);
+            send_ota_status();
+            break;
+        }
+
+        case CMD_OTA_DATA:
+            send_ota_ack(len > 4 ? ota_stage_data(uart_frame_get_u32(payload), &payload[4], len - 4)
+                                 : OTA_RESULT_BAD_FORMAT);
+            break;
+
+        case CMD_OTA_END:
+            APPLOG_DEFER(UART, ESP_LOG_INFO, TAG, "UART received: CMD_OTA_END");
+            ota_upload_end(payload, len);
+            break;
+
+        case CMD_TIME_SYNC: {
+            if (len < 4) {
+                ESP_LOGW(TAG, "UART time sync frame too short (%u bytes)", len);
+                break;
+            }
+            time_t timestamp = uart_frame_get_u32(payload);
+            uint32_t usec = (len >= 8) ? uart_frame_get_u32(&payload[4]) % 1000000 : 0;
+
+            // How far our clock was off decides whether the props need resyncing now
+            struct timeval before;
+            gettimeofday(&before, NULL);
+            int64_t step_us = ((int64_t)timestamp - before.tv_sec) * 1000000 + ((int64_t)usec - before.tv_usec);
+            bool was_set = before.tv_sec >= 1000000000;
+
+            struct timeval tv = { .tv_sec = timestamp, .tv_usec = usec };
+            settimeofday(&tv, NULL);
+
+            // Set timezone to Los Angeles
+            setenv("TZ", "PST8PDT,M3.2.0,M11.1.0", 1);
+            tzset();
+
+            struct tm timeinfo;
+            localtime_r(&timestamp, &timeinfo);
+            char time_str[64];
+            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
+
+            ESP_LOGI(TAG, "✓ Time synchronized from TinyS3!");
+            ESP_LOGI(TAG, "   Unix timestamp: %ld.%06lu (correction %lld us)", timestamp, usec, step_us);
+            ESP_LOGI(TAG, "   Time: %s", time_str);
+
+            // Small corrections are left to the next scheduled round
+            if (!was_set || llabs(step_us) > TIME_SYNC_STEP_RESYNC_US) {
+                ESP_LOGI(TAG, "Forwarding time to Zigbee devices...");
+                zigbee_broadcast_time_sync();
+            }
+            break;
+        }
+
+        default:
+            ESP_LOGW(TAG, "UART received unknown command: 0x%02x", cmd);
+            break;
+    }
+}
+
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+void uart_handler_task(void *pvParameters)
+{
+    gateway_link_run(GATEWAY_LINK_COORDINATOR, handle_uart_frame, NULL);
+}
+#else
 void uart_handler_task(void *pvParameters)
 {
-    uint8_t data[16];
+    static uint8_t data[UART_BUF_SIZE];
+    uart_event_t event;
 
+    uart_frame_parser_init(&uart_parser, handle_uart_frame, NULL);
     ESP_LOGI(TAG, "UART handler task started");
 
+    // Block on the driver's event queue instead of polling; frames that span
+    // several reads are reassembled by the parser
     while (1) {
-        int len = uart_read_bytes(UART_NUM, data, sizeof(data), pdMS_TO_TICKS(100));
-
-        if (len > 0) {
-            // Look for command frame: 0xAA <cmd> [data...] 0x55
-            for (int i = 0; i < len - 2; i++) {
-                if (data[i] == 0xAA) {
-                    uint8_t cmd = data[i + 1];
-
-                    switch (cmd) {
-                        case CMD_TRIGGER_RIP:
-                            ESP_LOGI(TAG, "UART received: CMD_TRIGGER_RIP");
-                            trigger_rip_tombstone();
-                            break;
-
-                        case CMD_TRIGGER_HALLOWEEN:
-                            ESP_LOGI(TAG, "UART received: CMD_TRIGGER_HALLOWEEN");
-                            trigger_halloween_decoration();
-                            break;
-
-                        case CMD_TRIGGER_BOTH:
-                            ESP_LOGI(TAG, "UART received: CMD_TRIGGER_BOTH");
-                            trigger_rip_tombstone();
-                            vTaskDelay(pdMS_TO_TICKS(100));
-                            trigger_halloween_decoration();
-                            break;
-
-                        case CMD_STATUS_REQUEST:
-                            ESP_LOGI(TAG, "UART received: CMD_STATUS_REQUEST");
-                            uart_send_device_status();
-                            break;
-
-                        case CMD_TIME_SYNC:
-                            // Time sync frame: 0xAA 0x20 timestamp(4 bytes) 0x55
-                            if (i + 6 < len && data[i + 6] == 0x55) {
-                                time_t timestamp = ((uint32_t)data[i + 2] << 24) |
-                                                 ((uint32_t)data[i + 3] << 16) |
-                                                 ((uint32_t)data[i + 4] << 8) |
-                                                 ((uint32_t)data[i + 5]);
-
-                                struct timeval tv = { .tv_sec = timestamp, .tv_usec = 0 };
-                                settimeofday(&tv, NULL);
-
-                                // Set timezone to Los Angeles
-                                setenv("TZ", "PST8PDT,M3.2.0,M11.1.0", 1);
-                                tzset();
-
-                                struct tm timeinfo;
-                                localtime_r(&timestamp, &timeinfo);
-                                char time_str[64];
-                                strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
-
-                                ESP_LOGI(TAG, "✓ Time synchronized from TinyS3!");
-                                ESP_LOGI(TAG, "   Unix timestamp: %ld", timestamp);
-                                ESP_LOGI(TAG, "   Time: %s", time_str);
-
-                                // Broadcast time to all Zigbee end devices
-                                ESP_LOGI(TAG, "Forwarding time to Zigbee devices...");
-                                vTaskDelay(pdMS_TO_TICKS(100)); // Small delay for Zigbee stack
-                                zigbee_broadcast_time_sync();
-                            }
-                            break;
-
-                        default:
-                            ESP_LOGW(TAG, "UART received unknown command: 0x%02x", cmd);
-                            break;
+        if (xQueueReceive(uart_event_queue, &event, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        switch (event.type) {
+            case UART_DATA: {
+                size_t pending = 0;
+                uart_get_buffered_data_len(UART_NUM, &pending);
+                while (pending > 0) {
+                    int len = uart_read_bytes(UART_NUM, data, pending < sizeof(data) ? pending : sizeof(data), 0);
+                    if (len <= 0) {
+                        break;
                     }
+                    uart_frame_parser_feed(&uart_parser, data, len);
+                    pending -= len;
                 }
+                break;
             }
+
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                ESP_LOGW(TAG, "UART RX overflow, flushing input");
+                uart_flush_input(UART_NUM);
+                xQueueReset(uart_event_queue);
+                uart_frame_parser_reset(&uart_parser);
+                break;
+
+            case UART_FRAME_ERR:
+            case UART_PARITY_ERR:
+                ESP_LOGW(TAG, "UART line error (event %d)", event.type);
+                break;
+
+            default:
+                break;
         }
     }
 }
+#endif
 
 // ============================================================================
 // Main Application
@@ -829,9 +2369,16 @@ void app_main(void)
 {
     ESP_LOGI(TAG, "╔══════════════════════════════════════════════╗");
     ESP_LOGI(TAG, "║  XIAO ESP32-C6 Zigbee Coordinator            ║");
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+    ESP_LOGI(TAG, "║  Single chip: web half over gateway_link     ║");
+#else
     ESP_LOGI(TAG, "║  Controlled via UART from TinyS3             ║");
+#endif
     ESP_LOGI(TAG, "╚══════════════════════════════════════════════╝");
 
+    // Deferred log lines are formatted just above idle, off the UART and Zigbee tasks
+    applog_init(1);
+
     // Initialize NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -842,67 +2389,107 @@ void app_main(void)
 
     // Initialize hardware
     setup_external_antenna();
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+    gateway_link_init();
+#else
     setup_uart();
+#endif
 
-    // Initialize device records
-    strcpy(rip_tombstone.name, "RIP Tombstone");
-    rip_tombstone.endpoint = 1;
-    rip_tombstone.is_bound = false;  // Will be set when device announces
+    // Load known devices (bound state is set when a device announces or is seen)
+    device_registry_init();
 
-    strcpy(halloween_trigger.name, "Haunted Pumpkin Scarecrow");
-    halloween_trigger.endpoint = 1;
-    halloween_trigger.is_bound = false;  // Will be set when device announces
+    // Zigbee requests from every task funnel through one dispatcher
+    zb_request_queue = xQueueCreate(ZB_REQUEST_QUEUE_LEN, sizeof(zb_request_t));
+    trigger_mutex = xSemaphoreCreateMutex();
+    trigger_filter_init(&trigger_filter);
+    action_sched_init(rule_action);
+    rule_engine_init();
+    radio_telemetry_init();
+    ota_stage_init();
 
     // Start UART handler task
-    xTaskCreate(uart_handler_task, "UART_handler", 2048, NULL, 10, NULL);
+    TaskHandle_t uart_task_handle = NULL;
+    xTaskCreate(uart_handler_task, "UART_handler", 3072, NULL, 10, &uart_task_handle);
 
     // Start Zigbee coordinator
     ESP_LOGI(TAG, "Starting Zigbee coordinator...");
     ESP_LOGI(TAG, "   Channel: %d (2.4GHz @ ~%d MHz)", ZIGBEE_CHANNEL, 2405 + 5 * ZIGBEE_CHANNEL);
-    xTaskCreate(esp_zb_task, "Zigbee_main", 4096, NULL, 5, NULL);
+    TaskHandle_t zb_task_handle = NULL, dispatch_task_handle = NULL;
+    xTaskCreate(esp_zb_task, "Zigbee_main", 4096, NULL, 5, &zb_task_handle);
+    xTaskCreate(zb_dispatch_task, "zb_dispatch", 3072, NULL, 6, &dispatch_task_handle);
+
+    // Start status push task (sends a frame only when status changes, plus heartbeat)
+    xTaskCreate(status_push_task, "status_push", 3072, NULL, 6, &status_push_task_handle);
 
     // Start signal strength monitoring task
-    xTaskCreate(signal_strength_task, "signal_monitor", 2048, NULL, 3, NULL);
+    xTaskCreate(signal_strength_task, "signal_monitor", 2048, NULL, 3, &signal_task_handle);
     ESP_LOGI(TAG, "Signal strength monitoring started");
 
+#if CONFIG_ZIGBEEWEEN_SINGLE_CHIP
+    // The TinyS3's firmware, minus its UART, in place of the TinyS3. It
+    // starts without waiting for the network, and its link receiver runs
+    // before WiFi and NTP, so sends from our tasks find room in the ring.
+    xTaskCreate(web_gateway_task, "web_main", WEB_GATEWAY_TASK_STACK, NULL, 1, NULL);
+#endif
+
+    metrics_watch_task(xTaskGetCurrentTaskHandle());
+    metrics_watch_task(uart_task_handle);
+    metrics_watch_task(zb_task_handle);
+    metrics_watch_task(dispatch_task_handle);
+    metrics_watch_task(status_push_task_handle);
+    metrics_watch_task(signal_task_handle);
+
     ESP_LOGI(TAG, "╔══════════════════════════════════════════════╗");
     ESP_LOGI(TAG, "║  System Ready!                               ║");
     ESP_LOGI(TAG, "║  - Zigbee coordinator active                 ║");
     ESP_LOGI(TAG, "║  - UART receiver listening for commands      ║");
     ESP_LOGI(TAG, "╚══════════════════════════════════════════════╝");
 
-    // Main loop - periodic status and time sync
-    uint32_t time_sync_counter = 0;
-    uint32_t status_counter = 0;
-    const uint32_t TIME_SYNC_INTERVAL = 300; // Broadcast time every 5 minutes (300 seconds)
-    const uint32_t STATUS_UPDATE_INTERVAL = 30; // Send status to TinyS3 every 30 seconds
+    // Main loop - periodic time sync and metrics (status is pushed by status_push_task)
+    time_sync_next_us = esp_timer_get_time() + (int64_t)time_sync_interval_s() * 1000000;
+    uint32_t ota_progress_sent = 0;
 
     while (1) {
-        vTaskDelay(pdMS_TO_TICKS(10000)); // Check every 10 seconds
+        vTaskDelay(pdMS_TO_TICKS(METRICS_REPORT_INTERVAL_S * 1000));
 
         time_t now = time(NULL);
         struct tm timeinfo;
         localtime_r(&now, &timeinfo);
         char time_str[64];
         strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
-        ESP_LOGI(TAG, "Time: %s | RIP sync: %s | Halloween sync: %s",
-                 time_str,
-                 rip_tombstone.time_synced ? "✓" : "✗",
-                 halloween_trigger.time_synced ? "✓" : "✗");
-
-        // Periodic time sync broadcast (every 5 minutes)
-        time_sync_counter += 10;
-        if (time_sync_counter >= TIME_SYNC_INTERVAL) {
-            ESP_LOGI(TAG, "Periodic time sync broadcast to Zigbee devices...");
-            zigbee_broadcast_time_sync();
-            time_sync_counter = 0;
+        int bound = 0, synced = 0;
+        for (size_t i = 0; i < device_registry_count(); i++) {
+            const zigbee_device_t *dev = device_registry_at(i);
+            bound += dev->is_bound;
+            synced += dev->time_synced;
+        }
+        APPLOGD(STATUS, TAG, "Time: %s | Devices: %d connected, %d synced, %u known",
+                time_str, bound, synced, (unsigned)device_registry_count());
+        if (zb_dispatch_stats.sent > 0) {
+            APPLOGD(STATUS, TAG, "Zigbee queue: %lu sent in %lu batches, %lu dropped | latency avg %lld us, max %lld us",
+                    zb_dispatch_stats.sent, zb_dispatch_stats.batches, zb_dispatch_stats.dropped,
+                    zb_dispatch_stats.latency_sum_us / zb_dispatch_stats.sent, zb_dispatch_stats.latency_max_us);
+        }
+        if (trigger_filter.stats.accepted + trigger_filter.stats.dropped_cooldown + trigger_filter.stats.dropped_duplicate +
+            trigger_filter.stats.dropped_offline > 0) {
+            APPLOGD(STATUS, TAG, "Triggers: %lu accepted | dropped %lu cooldown, %lu duplicate, %lu offline",
+                    trigger_filter.stats.accepted, trigger_filter.stats.dropped_cooldown,
+                    trigger_filter.stats.dropped_duplicate, trigger_filter.stats.dropped_offline);
         }
 
-        // Periodic status update to TinyS3 (every 30 seconds)
-        status_counter += 10;
-        if (status_counter >= STATUS_UPDATE_INTERVAL) {
-            uart_send_device_status();
-            status_counter = 0;
+        // Persist any new devices or address changes
+        device_registry_save();
+        radio_telemetry_tick();
+        metrics_report();
+        if (ota_progress != ota_progress_sent) {
+            ota_progress_sent = ota_progress;
+            send_ota_status();
+        }
+
+        // Periodic time sync broadcast, spaced by the worst measured drift
+        if (esp_timer_get_time() >= time_sync_next_us) {
+            ESP_LOGI(TAG, "Periodic time sync broadcast to Zigbee devices...");
+            zigbee_broadcast_time_sync();
         }
     }
 }
@@ -0,0 +1,313 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "uart_proto.h"
+#include "metrics.h"
+#include "ota_stage.h"
+
+static const char *TAG = "ota_stage";
+
+#define OTA_STAGE_PARTITION_LABEL "ota_stage"
+#define SECTOR_SIZE        4096
+#define MAGIC_SIZE         4      // Written last, see ota_stage.h
+#define CACHE_LINES        8
+#define CACHE_LINE_SIZE    512
+#define CRC_CHUNK          512
+
+typedef struct {
+    uint32_t base;             // File offset of data[0]
+    uint32_t last_use;         // cache_clock at the last hit; 0 = empty
+    uint8_t data[CACHE_LINE_SIZE];
+} cache_line_t;
+
+static const esp_partition_t *part = NULL;
+static SemaphoreHandle_t stage_mutex = NULL;  // st and the cache, against the Zigbee task's reads
+static ota_stage_status_t st;
+
+// Upload state, UART task only
+static uint8_t magic[MAGIC_SIZE];
+static uint32_t erased_to;     // Sectors below this offset are erased or written this upload
+static uint8_t crc_buf[CRC_CHUNK];
+
+// Zigbee task only, apart from ota_stage_begin() emptying it
+static cache_line_t cache[CACHE_LINES];
+static uint32_t cache_clock;
+static uint8_t bounce[UINT8_MAX];
+
+static void cache_clear(void)
+{
+    for (size_t i = 0; i < CACHE_LINES; i++) {
+        cache[i].last_use = 0;
+    }
+}
+
+static void set_stage(uint8_t stage, uint32_t stored)
+{
+    xSemaphoreTake(stage_mutex, portMAX_DELAY);
+    st.stage = stage;
+    st.stored = stored;
+    if (stage != OTA_STAGE_READY) {
+        cache_clear();
+    }
+    xSemaphoreGive(stage_mutex);
+}
+
+// Erasing sector 0 takes the magic with it, so nothing is staged after a reboot
+static void drop_staged(void)
+{
+    if (esp_partition_erase_range(part, 0, SECTOR_SIZE) != ESP_OK) {
+        ESP_LOGE(TAG, "Erase of the staged header failed");
+    }
+    set_stage(OTA_STAGE_NONE, 0);
+}
+
+void ota_stage_init(void)
+{
+    uint8_t header[OTA_FILE_OVERHEAD];
+    ota_file_info_t info;
+
+    stage_mutex = xSemaphoreCreateMutex();
+    memset(&st, 0, sizeof(st));
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, OTA_STAGE_PARTITION_LABEL);
+    if (part == NULL) {
+        ESP_LOGW(TAG, "No \"%s\" partition, OTA uploads will be refused", OTA_STAGE_PARTITION_LABEL);
+        return;
+    }
+    if (esp_partition_read(part, 0, header, sizeof(header)) != ESP_OK ||
+        !ota_file_header_parse(header, sizeof(header), &info) || info.total_size > part->size) {
+        ESP_LOGI(TAG, "Nothing staged (%lu KB partition)", (unsigned long)(part->size / 1024));
+        return;
+    }
+    st = (ota_stage_status_t){
+        .stage = OTA_STAGE_READY, .image_type = info.image_type, .file_version = info.file_version,
+        .size = info.total_size, .stored = info.total_size,
+    };
+    ESP_LOGI(TAG, "Staged: %s image, version %lu, %lu bytes", ota_file_image_name(info.image_type),
+             (unsigned long)info.file_version, (unsigned long)info.total_size);
+}
+
+uint8_t ota_stage_begin(uint16_t image_type, uint32_t file_version, uint32_t size)
+{
+    if (part == NULL) {
+        return OTA_RESULT_STORAGE;
+    }
+    if (size == 0) {
+        if (st.stage != OTA_STAGE_NONE) {
+            ESP_LOGI(TAG, "Staged image dropped");
+            drop_staged();
+        }
+        return OTA_RESULT_OK;
+    }
+    if (size < OTA_FILE_OVERHEAD || image_type == OTA_IMAGE_TYPE_UNKNOWN) {
+        return OTA_RESULT_BAD_FORMAT;
+    }
+    if (size > part->size) {
+        return OTA_RESULT_TOO_LARGE;
+    }
+    if (st.stage != OTA_STAGE_NONE && st.image_type == image_type && st.file_version == file_version &&
+        st.size == size) {
+        ESP_LOGI(TAG, "Upload resumes at %lu of %lu bytes", (unsigned long)st.stored, (unsigned long)size);
+        return OTA_RESULT_OK;
+    }
+
+    // The old file stays valid until the first data frame erases sector 0
+    xSemaphoreTake(stage_mutex, portMAX_DELAY);
+    st = (ota_stage_status_t){
+        .stage = OTA_STAGE_RECEIVING, .image_type = image_type, .file_version = file_version, .size = size,
+    };
+    cache_clear();
+    xSemaphoreGive(stage_mutex);
+    erased_to = 0;
+    ESP_LOGI(TAG, "Receiving %s image, version %lu, %lu bytes", ota_file_image_name(image_type),
+             (unsigned long)file_version, (unsigned long)size);
+    return OTA_RESULT_OK;
+}
+
+uint8_t ota_stage_data(uint32_t offset, const uint8_t *data, uint16_t len)
+{
+    if (st.stage != OTA_STAGE_RECEIVING) {
+        return OTA_RESULT_SEQUENCE;
+    }
+    if (offset != st.stored) {
+        return OTA_RESULT_OFFSET;
+    }
+    if (len == 0 || len > st.size - offset) {
+        return OTA_RESULT_BAD_FORMAT;
+    }
+    if (offset == 0) {
+        ota_file_info_t info;
+        if (!ota_file_header_parse(data, len, &info) || info.image_type != st.image_type ||
+            info.file_version != st.file_version || info.total_size != st.size) {
+            return OTA_RESULT_BAD_FORMAT;
+        }
+        memcpy(magic, data, MAGIC_SIZE);
+    }
+
+    while (erased_to < offset + len) {
+        if (esp_partition_erase_range(part, erased_to, SECTOR_SIZE) != ESP_OK) {
+            ESP_LOGE(TAG, "Erase at %lu failed", (unsigned long)erased_to);
+            return OTA_RESULT_STORAGE;
+        }
+        erased_to += SECTOR_SIZE;
+    }
+    // Offset 0 always carries the whole header, so the magic is never split
+    esp_err_t err = offset == 0 ? esp_partition_write(part, MAGIC_SIZE, data + MAGIC_SIZE, len - MAGIC_SIZE)
+                                : esp_partition_write(part, offset, data, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Write at %lu failed: %s", (unsigned long)offset, esp_err_to_name(err));
+        return OTA_RESULT_STORAGE;
+    }
+    set_stage(OTA_STAGE_RECEIVING, offset + len);
+    return OTA_RESULT_OK;
+}
+
+// CRC-32 of the file as it is in flash, with the magic taken from head
+static bool flash_crc(const uint8_t *head, uint32_t *out)
+{
+    uint32_t crc = esp_rom_crc32_le(0, head, MAGIC_SIZE);
+
+    for (uint32_t pos = MAGIC_SIZE; pos < st.size;) {
+        uint32_t n = st.size - pos < CRC_CHUNK ? st.size - pos : CRC_CHUNK;
+        if (esp_partition_read(part, pos, crc_buf, n) != ESP_OK) {
+            return false;
+        }
+        crc = esp_rom_crc32_le(crc, crc_buf, n);
+        pos += n;
+    }
+    *out = crc;
+    return true;
+}
+
+uint8_t ota_stage_end(uint32_t crc)
+{
+    uint32_t actual;
+
+    if (st.stage == OTA_STAGE_NONE || st.stored != st.size) {
+        return OTA_RESULT_SEQUENCE;
+    }
+    if (st.stage == OTA_STAGE_READY) {
+        // A resumed upload of what is already staged: check it is still intact
+        uint8_t head[MAGIC_SIZE];
+        if (esp_partition_read(part, 0, head, sizeof(head)) != ESP_OK || !flash_crc(head, &actual)) {
+            return OTA_RESULT_STORAGE;
+        }
+        if (actual != crc) {
+            ESP_LOGW(TAG, "Staged image no longer matches, dropped");
+            drop_staged();
+            return OTA_RESULT_BAD_CRC;
+        }
+        return OTA_RESULT_OK;
+    }
+
+    if (!flash_crc(magic, &actual)) {
+        return OTA_RESULT_STORAGE;
+    }
+    if (actual != crc) {
+        // Start over: the next begin for this image finds nothing stored
+        ESP_LOGW(TAG, "CRC mismatch (0x%08lx, expected 0x%08lx), upload discarded",
+                 (unsigned long)actual, (unsigned long)crc);
+        erased_to = 0;
+        set_stage(OTA_STAGE_RECEIVING, 0);
+        return OTA_RESULT_BAD_CRC;
+    }
+    if (esp_partition_write(part, 0, magic, MAGIC_SIZE) != ESP_OK) {
+        return OTA_RESULT_STORAGE;
+    }
+    set_stage(OTA_STAGE_READY, st.size);
+    ESP_LOGI(TAG, "Staged %s image, version %lu, %lu bytes", ota_file_image_name(st.image_type),
+             (unsigned long)st.file_version, (unsigned long)st.size);
+    return OTA_RESULT_OK;
+}
+
+void ota_stage_status(ota_stage_status_t *out)
+{
+    xSemaphoreTake(stage_mutex, portMAX_DELAY);
+    *out = st;
+    xSemaphoreGive(stage_mutex);
+}
+
+bool ota_stage_info(ota_file_info_t *out)
+{
+    ota_stage_status_t s;
+
+    ota_stage_status(&s);
+    if (s.stage != OTA_STAGE_READY) {
+        return false;
+    }
+    *out = (ota_file_info_t){
+        .manufacturer_code = OTA_MANUFACTURER_CODE, .image_type = s.image_type,
+        .file_version = s.file_version, .total_size = s.size,
+    };
+    return true;
+}
+
+// Line holding offset, filled from flash on a miss (evicting the least
+// recently used). Called with stage_mutex held.
+static const cache_line_t *cache_line(uint32_t offset)
+{
+    uint32_t base = offset - offset % CACHE_LINE_SIZE;
+    cache_line_t *victim = &cache[0];
+
+    cache_clock++;
+    for (size_t i = 0; i < CACHE_LINES; i++) {
+        cache_line_t *line = &cache[i];
+        if (line->last_use != 0 && line->base == base) {
+            line->last_use = cache_clock;
+            return line;
+        }
+        if (line->last_use < victim->last_use) {
+            victim = line;
+        }
+    }
+    // The partition is sector-sized, so a whole line is always readable
+    if (esp_partition_read(part, base, victim->data, CACHE_LINE_SIZE) != ESP_OK) {
+        victim->last_use = 0;
+        return NULL;
+    }
+    victim->base = base;
+    victim->last_use = cache_clock;
+    metrics_inc(METRIC_OTA_CACHE_MISSES);
+    return victim;
+}
+
+// Called with stage_mutex held
+static const uint8_t *read_locked(uint32_t offset, uint8_t *size)
+{
+    if (st.stage != OTA_STAGE_READY || offset >= st.size) {
+        return NULL;
+    }
+    uint8_t n = st.size - offset < *size ? (uint8_t)(st.size - offset) : *size;
+    const cache_line_t *first = cache_line(offset);
+    if (first == NULL) {
+        return NULL;
+    }
+    const uint8_t *out = &first->data[offset - first->base];
+    uint32_t in_first = first->base + CACHE_LINE_SIZE - offset;
+    if (n > in_first) {
+        // Straddles two lines. Copy the first part before the second lookup
+        // can evict its line.
+        memcpy(bounce, out, in_first);
+        const cache_line_t *second = cache_line(first->base + CACHE_LINE_SIZE);
+        if (second == NULL) {
+            return NULL;
+        }
+        memcpy(bounce + in_first, second->data, n - in_first);
+        out = bounce;
+    }
+    *size = n;
+    return out;
+}
+
+const uint8_t *ota_stage_read(uint32_t offset, uint8_t *size)
+{
+    xSemaphoreTake(stage_mutex, portMAX_DELAY);
+    const uint8_t *out = read_locked(offset, size);
+    xSemaphoreGive(stage_mutex);
+    if (out != NULL) {
+        metrics_inc(METRIC_OTA_BLOCKS_SERVED);
+    }
+    return out;
+}
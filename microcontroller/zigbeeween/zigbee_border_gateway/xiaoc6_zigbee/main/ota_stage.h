@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ota_file.h"
+
+// Staging of the one OTA file the coordinator serves to the props. The
+// TinyS3 uploads it in CMD_OTA_* frames (uart_proto.h) and it is written
+// straight to the "ota_stage" partition, sector by sector as the data
+// arrives, so nothing but the upload state is held in RAM.
+//
+// The file's first four bytes (its magic) are written last, once the end
+// frame's CRC-32 matches what is in flash: a staged file found at boot is
+// valid exactly when its header parses. Blocks served to the props go
+// through a small LRU cache of flash lines, since props downloading in
+// parallel each read their own offset a few tens of bytes at a time.
+//
+// The upload calls run on the UART task, ota_stage_read() on the Zigbee
+// task; a new upload takes the staged file away from the readers first.
+
+typedef struct {
+    uint8_t stage;            // OTA_STAGE_*
+    uint16_t image_type;
+    uint32_t file_version;
+    uint32_t size;            // File bytes, header included
+    uint32_t stored;          // Bytes in flash (size once READY)
+} ota_stage_status_t;
+
+// Find the partition and pick up a file staged before the last reboot
+void ota_stage_init(void);
+
+// Upload steps, each returning an OTA_RESULT_*. A begin with size 0 drops
+// the staged file; a begin repeating the file being received (or already
+// staged) keeps what is stored, so an interrupted upload resumes. The data
+// at offset 0 must hold the whole OTA_FILE_OVERHEAD, which is checked
+// against the begin's type, version and size.
+uint8_t ota_stage_begin(uint16_t image_type, uint32_t file_version, uint32_t size);
+uint8_t ota_stage_data(uint32_t offset, const uint8_t *data, uint16_t len);
+uint8_t ota_stage_end(uint32_t crc);
+
+void ota_stage_status(ota_stage_status_t *out);
+
+// Header of the staged file. False unless it is READY.
+bool ota_stage_info(ota_file_info_t *out);
+
+// size bytes of the staged file at offset, clamped to the end of the file
+// (*size is updated). The pointer is valid until the next call. NULL unless
+// READY or if offset is past the end or the flash read fails.
+const uint8_t *ota_stage_read(uint32_t offset, uint8_t *size);
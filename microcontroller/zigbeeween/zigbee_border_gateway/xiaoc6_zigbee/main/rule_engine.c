@@ -0,0 +1,348 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "uart_frame.h"
+#include "uart_proto.h"
+#include "action_sched.h"
+#include "rule_engine.h"
+
+static const char *TAG = "rule_engine";
+
+#define NVS_NAMESPACE "rules"
+#define NVS_KEY_TABLE "table_v1"
+
+#define RULE_EVENT_MAX      RULE_EVENT_PROP_REQUEST
+#define RULE_TOTAL_ACTIONS  64   // Across all rules
+#define RULE_NONE           0xFF
+
+_Static_assert(RULE_MAX_RULES < RULE_NONE, "rule chains are u8 indexes");
+
+typedef struct {
+    uint8_t kind;
+    uint8_t target;
+    uint16_t delay_ms;
+} rule_action_t;
+
+typedef struct {
+    uint8_t source;
+    uint8_t value_mask;
+    uint8_t count;
+    uint8_t window_s;
+    uint8_t flags;
+    uint8_t action_count;
+    uint8_t first_action;      // Index into rule_table_t.actions
+    uint8_t next;              // Next rule for the same event, RULE_NONE ends the chain
+} rule_t;
+
+typedef struct {
+    rule_t rules[RULE_MAX_RULES];
+    rule_action_t actions[RULE_TOTAL_ACTIONS];
+    uint8_t first[RULE_EVENT_MAX + 1];  // Head of each event's chain
+    uint8_t rule_count;
+    uint16_t size;
+    uint16_t crc;
+    bool builtin;
+} rule_table_t;
+
+// Count condition progress, by rule index
+typedef struct {
+    int64_t first_us;
+    uint8_t hits;
+} rule_state_t;
+
+// TinyS3 motion fires all props; a prop request fires what it asks for
+static const uint8_t builtin_table[] = {
+    RULE_TABLE_MAGIC, RULE_TABLE_VERSION, 2, 0, 0, 0,
+    RULE_EVENT_GATEWAY_MOTION, 0, 0, 0, 0, 0, 1, 0,
+        RULE_ACTION_TRIGGER_GROUP, 0, 0, 0,
+    RULE_EVENT_PROP_REQUEST, 0, 0, 0, 0, 0, 1, 0,
+        RULE_ACTION_TRIGGER_CAPS, 0, 0, 0,
+};
+
+static SemaphoreHandle_t rule_mutex = NULL;  // Events come from the UART and Zigbee tasks
+static rule_table_t table;
+static rule_state_t states[RULE_MAX_RULES];
+
+// Upload staging, UART task only
+static uint8_t upload_buf[RULE_TABLE_MAX_SIZE];
+static uint16_t upload_size;
+static uint16_t upload_received;
+static bool upload_open = false;
+
+static uint16_t table_crc(const uint8_t *data, size_t size)
+{
+    return uart_frame_crc16(0xFFFF, data + RULE_TABLE_HEADER_SIZE, size - RULE_TABLE_HEADER_SIZE);
+}
+
+// Decode and index a binary table into out. The built-in table carries no CRC.
+static uint8_t table_parse(const uint8_t *data, size_t size, bool check_crc, rule_table_t *out)
+{
+    if (size > RULE_TABLE_MAX_SIZE) {
+        return RULE_RESULT_TOO_LARGE;
+    }
+    if (size < RULE_TABLE_HEADER_SIZE || data[0] != RULE_TABLE_MAGIC || data[1] != RULE_TABLE_VERSION) {
+        return RULE_RESULT_BAD_FORMAT;
+    }
+    uint16_t crc = table_crc(data, size);
+    if (check_crc && crc != uart_frame_get_u16(&data[4])) {
+        return RULE_RESULT_BAD_CRC;
+    }
+    uint16_t rule_count = uart_frame_get_u16(&data[2]);
+    if (rule_count > RULE_MAX_RULES) {
+        return RULE_RESULT_TOO_LARGE;
+    }
+
+    memset(out, 0, sizeof(*out));
+    memset(out->first, RULE_NONE, sizeof(out->first));
+    uint8_t tail[RULE_EVENT_MAX + 1] = { 0 };
+    size_t pos = RULE_TABLE_HEADER_SIZE;
+    size_t n_actions = 0;
+
+    for (uint16_t i = 0; i < rule_count; i++) {
+        if (pos + RULE_SIZE > size) {
+            return RULE_RESULT_BAD_FORMAT;
+        }
+        const uint8_t *r = &data[pos];
+        uint8_t event = r[0];
+        if (event == 0 || event > RULE_EVENT_MAX || r[6] > RULE_MAX_ACTIONS) {
+            return RULE_RESULT_BAD_FORMAT;
+        }
+        if (n_actions + r[6] > RULE_TOTAL_ACTIONS) {
+            return RULE_RESULT_TOO_LARGE;
+        }
+        pos += RULE_SIZE;
+
+        rule_t *rule = &out->rules[i];
+        *rule = (rule_t){
+            .source = r[1], .value_mask = r[2], .count = r[3], .window_s = r[4],
+            .flags = r[5], .action_count = r[6], .first_action = (uint8_t)n_actions, .next = RULE_NONE,
+        };
+        for (uint8_t a = 0; a < rule->action_count; a++, pos += RULE_ACTION_SIZE) {
+            if (pos + RULE_ACTION_SIZE > size) {
+                return RULE_RESULT_BAD_FORMAT;
+            }
+            uint8_t kind = data[pos];
+            if (kind < RULE_ACTION_TRIGGER_DEVICE || kind > RULE_ACTION_TRIGGER_CAPS) {
+                return RULE_RESULT_BAD_FORMAT;
+            }
+            out->actions[n_actions++] = (rule_action_t){ kind, data[pos + 1], uart_frame_get_u16(&data[pos + 2]) };
+        }
+
+        // Chains keep table order, so RULE_FLAG_STOP means what it says
+        if (out->first[event] == RULE_NONE) {
+            out->first[event] = (uint8_t)i;
+        } else {
+            out->rules[tail[event]].next = (uint8_t)i;
+        }
+        tail[event] = (uint8_t)i;
+    }
+    if (pos != size) {
+        return RULE_RESULT_BAD_FORMAT;  // Trailing bytes: the rule count is wrong
+    }
+
+    out->rule_count = (uint8_t)rule_count;
+    out->size = (uint16_t)size;
+    out->crc = crc;
+    return RULE_RESULT_OK;
+}
+
+// Swap in a parsed table. Old count progress and staged actions belonged to
+// the old rules, so both are dropped.
+static void table_activate(const rule_table_t *t)
+{
+    xSemaphoreTake(rule_mutex, portMAX_DELAY);
+    table = *t;
+    memset(states, 0, sizeof(states));
+    size_t cancelled = action_sched_cancel(ACTION_OWNER_RULES);
+    xSemaphoreGive(rule_mutex);
+    if (cancelled > 0) {
+        ESP_LOGI(TAG, "Cancelled %u delayed action(s)", (unsigned)cancelled);
+    }
+    ESP_LOGI(TAG, "Active rule table: %s, %u rule(s), %u bytes, crc 0x%04x",
+             t->builtin ? "built-in" : "uploaded", t->rule_count, t->size, t->crc);
+}
+
+static void load_builtin(void)
+{
+    static rule_table_t parsed;
+    if (table_parse(builtin_table, sizeof(builtin_table), false, &parsed) != RULE_RESULT_OK) {
+        ESP_LOGE(TAG, "Built-in rule table is invalid");
+        return;
+    }
+    parsed.builtin = true;
+    table_activate(&parsed);
+}
+
+static bool load_from_nvs(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        ESP_LOGI(TAG, "No saved rule table");
+        return false;
+    }
+
+    size_t size = sizeof(upload_buf);
+    esp_err_t err = nvs_get_blob(handle, NVS_KEY_TABLE, upload_buf, &size);
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        ESP_LOGI(TAG, "No saved rule table (%s)", esp_err_to_name(err));
+        return false;
+    }
+
+    static rule_table_t parsed;
+    uint8_t result = table_parse(upload_buf, size, true, &parsed);
+    if (result != RULE_RESULT_OK) {
+        ESP_LOGW(TAG, "Saved rule table invalid (result %u), using the built-in one", result);
+        return false;
+    }
+    table_activate(&parsed);
+    return true;
+}
+
+// Count conditions: the rule fires on the count-th match inside window_s of
+// the first one, then starts over
+static bool rule_condition_met(const rule_t *rule, rule_state_t *st, int64_t now_us)
+{
+    if (rule->count <= 1) {
+        return true;
+    }
+    if (st->hits == 0 || now_us - st->first_us > (int64_t)rule->window_s * 1000000) {
+        st->first_us = now_us;
+        st->hits = 0;
+    }
+    if (++st->hits < rule->count) {
+        return false;
+    }
+    st->hits = 0;
+    return true;
+}
+
+void rule_engine_init(void)
+{
+    rule_mutex = xSemaphoreCreateMutex();
+    if (!load_from_nvs()) {
+        load_builtin();
+    }
+}
+
+size_t rule_engine_event(uint8_t event, uint8_t source, uint8_t value, uint16_t seq)
+{
+    if (event == 0 || event > RULE_EVENT_MAX) {
+        return 0;
+    }
+
+    size_t fired = 0;
+    size_t matched = 0;
+    int64_t now_us = esp_timer_get_time();
+    xSemaphoreTake(rule_mutex, portMAX_DELAY);
+
+    for (uint8_t i = table.first[event]; i != RULE_NONE; i = table.rules[i].next) {
+        const rule_t *rule = &table.rules[i];
+        if ((rule->source != 0 && rule->source != source) ||
+            (rule->value_mask != 0 && !(rule->value_mask & value)) ||
+            !rule_condition_met(rule, &states[i], now_us)) {
+            continue;
+        }
+
+        matched++;
+        for (uint8_t a = 0; a < rule->action_count; a++) {
+            const rule_action_t *act = &table.actions[rule->first_action + a];
+            uint8_t target = act->kind == RULE_ACTION_TRIGGER_CAPS && act->target == 0 ? value : act->target;
+            if (act->delay_ms == 0) {
+                fired += action_sched_run_now(act->kind, target, seq);
+            } else {
+                action_sched_add(now_us + (int64_t)act->delay_ms * 1000, act->kind, target, ACTION_OWNER_RULES);
+            }
+        }
+        if (rule->flags & RULE_FLAG_STOP) {
+            break;
+        }
+    }
+
+    xSemaphoreGive(rule_mutex);
+    if (matched == 0) {
+        ESP_LOGI(TAG, "Event %u from %u (value 0x%02x) matched no rule", event, source, value);
+    }
+    return fired;
+}
+
+uint8_t rule_engine_upload_begin(uint16_t size)
+{
+    if (size > RULE_TABLE_MAX_SIZE) {
+        upload_open = false;
+        return RULE_RESULT_TOO_LARGE;
+    }
+    upload_size = size;
+    upload_received = 0;
+    upload_open = true;
+    return RULE_RESULT_OK;
+}
+
+uint8_t rule_engine_upload_data(uint16_t offset, const uint8_t *data, uint16_t len)
+{
+    if (!upload_open || offset != upload_received || len > upload_size - upload_received) {
+        upload_open = false;
+        return RULE_RESULT_SEQUENCE;
+    }
+    memcpy(&upload_buf[offset], data, len);
+    upload_received += len;
+    return RULE_RESULT_OK;
+}
+
+uint8_t rule_engine_upload_commit(void)
+{
+    if (!upload_open || upload_received != upload_size) {
+        upload_open = false;
+        return RULE_RESULT_SEQUENCE;
+    }
+    upload_open = false;
+
+    nvs_handle_t handle;
+    esp_err_t err;
+    if (upload_size == 0) {
+        load_builtin();
+        err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+        if (err == ESP_OK) {
+            err = nvs_erase_key(handle, NVS_KEY_TABLE);
+            if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) {
+                err = nvs_commit(handle);
+            }
+            nvs_close(handle);
+        }
+    } else {
+        static rule_table_t parsed;
+        uint8_t result = table_parse(upload_buf, upload_size, true, &parsed);
+        if (result != RULE_RESULT_OK) {
+            ESP_LOGW(TAG, "Rejected uploaded rule table (result %u)", result);
+            return result;
+        }
+        table_activate(&parsed);
+        err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+        if (err == ESP_OK) {
+            err = nvs_set_blob(handle, NVS_KEY_TABLE, upload_buf, upload_size);
+            if (err == ESP_OK) {
+                err = nvs_commit(handle);
+            }
+            nvs_close(handle);
+        }
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save rule table: %s", esp_err_to_name(err));
+        return RULE_RESULT_STORAGE;
+    }
+    return RULE_RESULT_OK;
+}
+
+void rule_engine_status(rule_engine_status_t *out)
+{
+    xSemaphoreTake(rule_mutex, portMAX_DELAY);
+    out->builtin = table.builtin;
+    out->rules = table.rule_count;
+    out->size = table.size;
+    out->crc = table.crc;
+    xSemaphoreGive(rule_mutex);
+}
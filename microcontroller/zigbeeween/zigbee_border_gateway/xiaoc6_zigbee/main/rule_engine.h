@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Table-driven automation: an event (the TinyS3's PIR, a prop's trigger
+// request) is looked up in a compiled rule table and fires the actions of
+// every rule it matches. The binary format is in uart_proto.h.
+//
+// Rules are chained per event when the table is loaded, so an event only
+// walks the rules written for it. Actions without a delay run before
+// rule_engine_event() returns; delayed ones are staged on the action
+// scheduler (action_sched.h), so sequences need no sleeping task.
+//
+// The active table is kept in NVS. Without one (or if it fails to validate)
+// the built-in table reproduces the fixed behaviour: TinyS3 motion fires all
+// props, a prop request fires the props with the requested capabilities.
+
+typedef struct {
+    bool builtin;           // No uploaded table is active
+    uint16_t rules;
+    uint16_t size;          // Table bytes including the header
+    uint16_t crc;           // Of the rules, as in the table header
+} rule_engine_status_t;
+
+// Load the saved table (or the built-in one). Call after nvs_flash_init()
+// and action_sched_init(); actions run through the scheduler's function,
+// with a RULE_ACTION_TRIGGER_CAPS target of 0 resolved to the event value.
+void rule_engine_init(void);
+
+// Evaluate event from source (device id, 0 = not a prop) carrying value.
+// Returns the number of devices fired by the immediate actions.
+size_t rule_engine_event(uint8_t event, uint8_t source, uint8_t value, uint16_t seq);
+
+// Upload a new table in pieces, as the CMD_RULES_* frames deliver it. Each
+// returns a RULE_RESULT_*. Commit validates the staged table, saves it and
+// makes it active (cancelling pending delayed actions); a begin with size 0
+// followed by commit drops the saved table and reverts to the built-in one.
+uint8_t rule_engine_upload_begin(uint16_t size);
+uint8_t rule_engine_upload_data(uint16_t offset, const uint8_t *data, uint16_t len);
+uint8_t rule_engine_upload_commit(void);
+
+void rule_engine_status(rule_engine_status_t *out);
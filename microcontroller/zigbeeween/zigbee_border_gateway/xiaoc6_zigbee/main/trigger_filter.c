@@ -0,0 +1,54 @@
+#include <string.h>
+#include "trigger_filter.h"
+
+static uint32_t device_cooldown_ms(const zigbee_device_t *dev)
+{
+    if (dev->caps & DEVICE_CAP_RELAY) return RELAY_COOLDOWN_MS;
+    if (dev->caps & DEVICE_CAP_LIGHTS) return LIGHTS_COOLDOWN_MS;
+    return 0;
+}
+
+void trigger_filter_init(trigger_filter_t *f)
+{
+    memset(f, 0, sizeof(*f));
+}
+
+bool trigger_filter_is_duplicate(trigger_filter_t *f, uint8_t kind, uint8_t target, int64_t now_us)
+{
+    const int64_t window_us = (int64_t)TRIGGER_DEDUP_WINDOW_MS * 1000;
+
+    for (size_t i = 0; i < TRIGGER_DEDUP_SLOTS; i++) {
+        const recent_trigger_t *r = &f->recent[i];
+        if (r->at_us != 0 && r->kind == kind && r->target == target && now_us - r->at_us < window_us) {
+            f->stats.dropped_duplicate++;
+            return true;
+        }
+    }
+
+    f->recent[f->recent_next] = (recent_trigger_t){ kind, target, now_us };
+    f->recent_next = (f->recent_next + 1) % TRIGGER_DEDUP_SLOTS;
+    return false;
+}
+
+trigger_verdict_t trigger_filter_admit(trigger_filter_t *f, zigbee_device_t *dev, int64_t now_us)
+{
+    if (!dev->is_bound || dev->short_addr == 0) {
+        f->stats.dropped_offline++;
+        return TRIGGER_DROPPED_OFFLINE;
+    }
+    if (device_in_cooldown(dev, now_us)) {
+        f->stats.dropped_cooldown++;
+        return TRIGGER_DROPPED_COOLDOWN;
+    }
+
+    f->stats.accepted++;
+    dev->cooldown_until_us = now_us + (int64_t)device_cooldown_ms(dev) * 1000;
+    return TRIGGER_ADMITTED;
+}
+
+void trigger_filter_revoke(trigger_filter_t *f, zigbee_device_t *dev)
+{
+    f->stats.accepted--;
+    f->stats.dropped_offline++;
+    dev->cooldown_until_us = 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "device_registry.h"
+
+// Trigger admission: every trigger passes through here before anything is
+// queued for the radio. A prop that is offline or still in its cooldown
+// would ignore the command, and a request repeating one for the same target
+// inside the dedup window (e.g. the TinyS3 and tombstone PIRs seeing the
+// same visitor) adds nothing, so neither is transmitted.
+//
+// Pure bookkeeping on the caller's clock: no locking or logging, so the
+// coordinator wraps it in its trigger mutex and the host benchmarks drive
+// it with simulated time.
+
+#define TRIGGER_DEDUP_WINDOW_MS 1500
+#define TRIGGER_DEDUP_SLOTS     8
+
+#define RELAY_COOLDOWN_MS  120000  // Scarecrow ignores triggers for 2 minutes after firing
+#define LIGHTS_COOLDOWN_MS 6000    // Tombstone's red blink runs ~6 s; a new trigger would restart it
+
+typedef enum {
+    TRIGGER_TARGET_DEVICE,   // target = device id
+    TRIGGER_TARGET_GROUP,    // target = coordinator group index
+    TRIGGER_TARGET_CAPS,     // target = capability mask
+} trigger_target_kind_t;
+
+typedef enum {
+    TRIGGER_ADMITTED,
+    TRIGGER_DROPPED_OFFLINE,   // Not bound or no short address yet
+    TRIGGER_DROPPED_COOLDOWN,
+} trigger_verdict_t;
+
+typedef struct {
+    uint32_t accepted;
+    uint32_t dropped_cooldown;
+    uint32_t dropped_duplicate;
+    uint32_t dropped_offline;
+} trigger_filter_stats_t;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t target;
+    int64_t at_us;
+} recent_trigger_t;
+
+typedef struct {
+    trigger_filter_stats_t stats;
+    recent_trigger_t recent[TRIGGER_DEDUP_SLOTS];
+    size_t recent_next;
+} trigger_filter_t;
+
+static inline bool device_in_cooldown(const zigbee_device_t *dev, int64_t now_us)
+{
+    return dev->cooldown_until_us > now_us;
+}
+
+void trigger_filter_init(trigger_filter_t *f);
+
+// True if the same target was requested within the dedup window; otherwise
+// records this request
+bool trigger_filter_is_duplicate(trigger_filter_t *f, uint8_t kind, uint8_t target, int64_t now_us);
+
+// Decide whether a trigger for dev should go on air, and start its cooldown
+// if so. Does not queue anything.
+trigger_verdict_t trigger_filter_admit(trigger_filter_t *f, zigbee_device_t *dev, int64_t now_us);
+
+// Undo trigger_filter_admit when the request couldn't be queued
+void trigger_filter_revoke(trigger_filter_t *f, zigbee_device_t *dev);
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
@@ -8,8 +9,15 @@
 #include "esp_timer.h"
 #include "driver/gpio.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "esp_zigbee_core.h"
 #include "esp_sleep.h"
+#include "esp_pm.h"
+#include "metrics.h"
+#include "applog.h"
+#include "ota_client.h"
+#include "net_cache.h"
+#include "prop_time.h"
 
 static const char *TAG = "haunted_pumpkin_scarecrow";
 
@@ -28,16 +36,27 @@ static const char *TAG = "haunted_pumpkin_scarecrow";
 
 // Trigger duration
 #define RELAY_TRIGGER_DURATION_MS 500  // Hold relay closed for 500ms
+#define RELAY_COOLDOWN_MS 120000       // Ignore triggers for 2 minutes after firing
 
 // Sleep hours (12am to 6am)
 #define SLEEP_START_HOUR 0
 #define SLEEP_END_HOUR 6
 
-// Zigbee configuration
-#define ESP_ZB_PRIMARY_CHANNEL_MASK ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK
+// Sleepy end-device profile. With ZED_SLEEPY the radio is off between parent
+// polls and the chip light-sleeps whenever the stack allows it. The parent
+// holds our frames until we poll, so ZED_KEEP_ALIVE_MS is the worst-case
+// delay for a trigger to arrive; after a trigger we poll every
+// ZED_FAST_POLL_MS through the cooldown. Set ZED_SLEEPY to 0 for an
+// always-on (rx on when idle) end device.
+#define ZED_SLEEPY             1
+#define ZED_AGING_TIMEOUT      ESP_ZB_ED_AGING_TIMEOUT_512MIN  // Outlasts the 6 h night, so the parent keeps our entry
+#define ZED_KEEP_ALIVE_MS      1000
+#define ZED_FAST_POLL_MS       250
+#define ZED_OTA_POLL_MS        50     // While an OTA download runs (ota_client.h)
+#define ZED_OTA_POLL_WINDOW_MS 10000  // Renewed by every block
+#define ZED_CPU_MAX_MHZ        160
+#define ZED_CPU_MIN_MHZ        40  // XTAL; the CPU drops to it when idle but awake
 
-// Time synchronization
-static bool time_synced = false;
 static bool triggered_recently = false;
 
 // Timer handle for non-blocking cooldown
@@ -46,34 +65,23 @@ static esp_timer_handle_t cooldown_timer = NULL;
 // Task handle for relay trigger
 static TaskHandle_t relay_task_handle = NULL;
 
-// Zigbee Time Sync Cluster (using custom manufacturer-specific cluster)
-#define ZB_TIME_SYNC_CLUSTER_ID 0xFC00  // Custom cluster for time synchronization
-#define ZB_TIME_SYNC_ATTR_ID 0x0000     // Attribute ID for Unix timestamp
+// Our attribute on the time sync cluster (prop_time.h)
+#define ZB_ACTUATION_US_ATTR_ID    0x0004  // U32 On/Off received -> relay closed for the last trigger, us
+#define ACTUATION_UNKNOWN          UINT32_MAX  // Not actuated (yet) for the last On/Off
 
-void set_system_time(time_t timestamp)
-{
-    struct timeval tv = { .tv_sec = timestamp, .tv_usec = 0 };
-    settimeofday(&tv, NULL);
-
-    // Set timezone to Los Angeles (PST/PDT)
-    setenv("TZ", "PST8PDT,M3.2.0,M11.1.0", 1);
-    tzset();
-
-    struct tm timeinfo;
-    localtime_r(&timestamp, &timeinfo);
-    char time_str[64];
-    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
+// Coordinator's request cluster; we send it metrics (and, in prop_time, time requests)
+#define ZB_TRIGGER_REQUEST_CLUSTER_ID 0xFC01
+#define ZB_METRICS_CMD_ID      0x02        // Custom command: octet string of metric records
+#define TIME_REQUEST_POLL_MS   3000          // Fast poll this long for the reply
+#define METRICS_REPORT_INTERVAL_S 300        // Each report costs a radio wake-up
+#define METRICS_REPORT_MAX     60            // Record bytes; keeps the command in one unfragmented frame
 
-    ESP_LOGI(TAG, "✓ Time synchronized from coordinator!");
-    ESP_LOGI(TAG, "   Unix timestamp: %ld", timestamp);
-    ESP_LOGI(TAG, "   Time: %s", time_str);
-
-    time_synced = true;
-}
+// esp_timer time the last On/Off arrived, handed to the relay task with its notification
+static volatile int64_t onoff_rx_us = 0;
 
 bool is_sleep_time(void)
 {
-    if (!time_synced) {
+    if (!time_is_synced()) {
         ESP_LOGI(TAG, "Time not synced yet, assuming awake hours");
         return false;
     }
@@ -93,6 +101,22 @@ bool is_sleep_time(void)
     return false;
 }
 
+// Milliseconds until SLEEP_START_HOUR:00:00 local time, so the sleep check
+// lands on the boundary instead of up to a minute after it
+uint32_t ms_until_sleep_start(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    struct tm timeinfo;
+    localtime_r(&now.tv_sec, &timeinfo);
+
+    int32_t secs_left = SLEEP_START_HOUR * 3600 - (timeinfo.tm_hour * 3600 + timeinfo.tm_min * 60 + timeinfo.tm_sec);
+    if (secs_left <= 0) {
+        secs_left += 24 * 3600;
+    }
+    return (uint32_t)secs_left * 1000 - now.tv_usec / 1000;
+}
+
 void setup_relay_pin(void)
 {
     gpio_config_t relay_conf = {
@@ -165,9 +189,49 @@ static void cooldown_timer_callback(void* arg)
     ESP_LOGI(TAG, "Cooldown expired, ready for next trigger");
 }
 
-// Status task - prints device status every 3 seconds
+// Send our metrics to the coordinator, which forwards them to the TinyS3.
+// Fire and forget: a lost report is replaced by the next one.
+static void report_metrics(void)
+{
+    static metrics_snapshot_t snap;
+    uint8_t payload[1 + METRICS_REPORT_MAX];
+    size_t next = 0;
+
+    metrics_sample_system();
+    metrics_snapshot_local(&snap);
+    payload[0] = (uint8_t)metrics_encode(&snap, false, &next, &payload[1], METRICS_REPORT_MAX);
+
+    esp_zb_zcl_custom_cluster_cmd_req_t req = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = 0x0000,
+            .dst_endpoint = 1,
+            .src_endpoint = 1,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+        .cluster_id = ZB_TRIGGER_REQUEST_CLUSTER_ID,
+        .custom_cmd_id = ZB_METRICS_CMD_ID,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV,
+        .data = {
+            .type = ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+            .size = 1 + payload[0],
+            .value = payload,
+        },
+    };
+
+    esp_zb_lock_acquire(portMAX_DELAY);
+    if (esp_zb_bdb_dev_joined()) {
+        esp_zb_zcl_custom_cluster_cmd_req(&req);
+    }
+    esp_zb_lock_release();
+}
+
+// Status task - logs device status every 3 seconds, reports metrics every
+// METRICS_REPORT_INTERVAL_S
 void status_task(void *pvParameters)
 {
+    int64_t next_report_us = esp_timer_get_time() + METRICS_REPORT_INTERVAL_S * 1000000LL;
+
     while (1) {
         time_t now;
         struct tm timeinfo;
@@ -176,19 +240,46 @@ void status_task(void *pvParameters)
         time(&now);
         localtime_r(&now, &timeinfo);
 
-        if (time_synced) {
+        if (time_is_synced()) {
             strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
         } else {
             strcpy(time_str, "NOT SYNCED");
         }
 
         const char *status = triggered_recently ? "COOLDOWN" : "READY";
-        ESP_LOGI(TAG, "Status: %s | Time: %s", status, time_str);
+        APPLOGD(STATUS, TAG, "Status: %s | Time: %s", status, time_str);
+
+        if (esp_timer_get_time() >= next_report_us) {
+            next_report_us += METRICS_REPORT_INTERVAL_S * 1000000LL;
+            report_metrics();
+        }
 
         vTaskDelay(pdMS_TO_TICKS(3000));  // Wait 3 seconds
     }
 }
 
+// Poll the parent every ZED_FAST_POLL_MS for the next ms milliseconds, so
+// follow-up frames (the coordinator's actuation read, a re-trigger after the
+// cooldown) aren't held for a full keep-alive. Caller holds the Zigbee lock.
+static void zed_fast_poll(uint32_t ms)
+{
+#if ZED_SLEEPY
+    esp_zb_zdo_pim_start_turbo_poll_continuous(ms);
+#endif
+}
+
+// Each OTA block response waits at the parent for our next poll, so a
+// download polls a lot faster than a trigger does. Caller holds the Zigbee lock.
+static void zed_ota_poll(bool busy)
+{
+#if ZED_SLEEPY
+    esp_zb_zdo_pim_set_fast_poll_interval(busy ? ZED_OTA_POLL_MS : ZED_FAST_POLL_MS);
+    if (busy) {
+        esp_zb_zdo_pim_start_turbo_poll_continuous(ZED_OTA_POLL_WINDOW_MS);
+    }
+#endif
+}
+
 // Task that handles relay triggering (runs in separate task, not Zigbee stack)
 void relay_trigger_task(void *pvParameters)
 {
@@ -197,11 +288,12 @@ void relay_trigger_task(void *pvParameters)
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
         if (triggered_recently) {
-            ESP_LOGI(TAG, "Ignoring trigger - recently activated (cooldown)");
+            APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Ignoring trigger - recently activated (cooldown)");
             continue;
         }
 
-        ESP_LOGI(TAG, "🎃 TRIGGERING RELAY (Halloween Decoration)!");
+        APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "🎃 TRIGGERING RELAY (Halloween Decoration)!");
+        metrics_inc(METRIC_ACTUATIONS);
 
         // Turn on LED to indicate activity
         gpio_set_level(LED_PIN, 1);
@@ -213,6 +305,14 @@ void relay_trigger_task(void *pvParameters)
             gpio_set_level(RELAY_TRIGGER_PIN, 1);  // HIGH = ON for active-high relay
         #endif
 
+        // Read back by the coordinator for trigger latency tracing
+        uint32_t actuation_us = (uint32_t)(esp_timer_get_time() - onoff_rx_us);
+        esp_zb_lock_acquire(portMAX_DELAY);
+        esp_zb_zcl_set_attribute_val(1, ZB_TIME_SYNC_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                     ZB_ACTUATION_US_ATTR_ID, &actuation_us, false);
+        zed_fast_poll(RELAY_COOLDOWN_MS);
+        esp_zb_lock_release();
+
         // Hold for duration (OK to block here - we're in our own task)
         vTaskDelay(pdMS_TO_TICKS(RELAY_TRIGGER_DURATION_MS));
 
@@ -234,7 +334,7 @@ void relay_trigger_task(void *pvParameters)
         // Start non-blocking timer to clear cooldown after 2 minutes
         if (cooldown_timer != NULL) {
             esp_timer_stop(cooldown_timer);
-            esp_timer_start_once(cooldown_timer, 120000000); // 120 seconds (2 minutes) in microseconds
+            esp_timer_start_once(cooldown_timer, RELAY_COOLDOWN_MS * 1000ULL);
         }
     }
 }
@@ -247,6 +347,18 @@ void trigger_relay(void)
     }
 }
 
+// Scheduled after a failed steering attempt
+static void steering_retry_alarm(uint8_t param)
+{
+    net_cache_apply();
+    esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+}
+
+static void log_joined(const char *how)
+{
+    ESP_LOGI(TAG, "Network ready %lld ms after boot (%s)", esp_timer_get_time() / 1000, how);
+}
+
 // Zigbee action handler
 static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id, const void *message)
 {
@@ -256,17 +368,23 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
         case ESP_ZB_CORE_SET_ATTR_VALUE_CB_ID: {
             const esp_zb_zcl_set_attr_value_message_t *attr_msg = (esp_zb_zcl_set_attr_value_message_t *)message;
 
-            ESP_LOGI(TAG, "Zigbee attribute update - Endpoint: %d, Cluster: 0x%04x, Attr: 0x%04x",
-                     attr_msg->info.dst_endpoint,
-                     attr_msg->info.cluster,
-                     attr_msg->attribute.id);
+            APPLOG_DEFER(ZIGBEE, ESP_LOG_DEBUG, TAG, "Zigbee attribute update - Endpoint: %u, Cluster: 0x%04x, Attr: 0x%04x",
+                         attr_msg->info.dst_endpoint,
+                         attr_msg->info.cluster,
+                         attr_msg->attribute.id);
 
             // Check for On/Off cluster (0x0006)
             if (attr_msg->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_ON_OFF) {
                 if (attr_msg->attribute.id == ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID) {
                     uint8_t value = *(uint8_t *)attr_msg->attribute.data.value;
 
-                    ESP_LOGI(TAG, "Received On/Off command: %s", value ? "ON" : "OFF");
+                    APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Received On/Off command: %s", (uintptr_t)(value ? "ON" : "OFF"));
+
+                    // Stays unknown if the relay task ignores it (cooldown)
+                    uint32_t actuation_us = ACTUATION_UNKNOWN;
+                    esp_zb_zcl_set_attribute_val(1, ZB_TIME_SYNC_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                                 ZB_ACTUATION_US_ATTR_ID, &actuation_us, false);
+                    onoff_rx_us = esp_timer_get_time();
 
                     // Trigger on ANY state change (both ON and OFF)
                     // The coordinator sends TOGGLE commands which alternate states
@@ -275,9 +393,14 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
             }
             // Check for Time Sync cluster (custom cluster 0xFC00)
             else if (attr_msg->info.cluster == ZB_TIME_SYNC_CLUSTER_ID) {
-                ESP_LOGI(TAG, "Received time sync cluster write (cluster=0x%04x, attr=0x%04x)",
-                         attr_msg->info.cluster, attr_msg->attribute.id);
-                if (attr_msg->attribute.id == ZB_TIME_SYNC_ATTR_ID) {
+                APPLOGD(ZIGBEE, TAG, "Received time sync cluster write (cluster=0x%04x, attr=0x%04x)",
+                        attr_msg->info.cluster, attr_msg->attribute.id);
+                if (attr_msg->attribute.id == ZB_TIME_SYNC_US_ATTR_ID &&
+                    attr_msg->attribute.data.size == sizeof(uint64_t)) {
+                    int64_t unix_us;
+                    memcpy(&unix_us, attr_msg->attribute.data.value, sizeof(unix_us));
+                    set_system_time_us(unix_us);
+                } else if (attr_msg->attribute.id == ZB_TIME_SYNC_ATTR_ID) {
                     // Expecting 4-byte Unix timestamp (uint32_t)
                     if (attr_msg->attribute.data.size == 4) {
                         time_t timestamp = *(uint32_t *)attr_msg->attribute.data.value;
@@ -292,7 +415,11 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
             break;
         }
         case ESP_ZB_CORE_CMD_DEFAULT_RESP_CB_ID:
-            ESP_LOGI(TAG, "Zigbee command response received");
+            APPLOGD(ZIGBEE, TAG, "Zigbee command response received");
+            break;
+        case ESP_ZB_CORE_OTA_UPGRADE_VALUE_CB_ID:
+            ret = ota_client_handle((const esp_zb_zcl_ota_upgrade_value_message_t *)message);
+            zed_ota_poll(ota_client_busy());
             break;
         default:
             ESP_LOGW(TAG, "Receive Zigbee action(0x%x) callback", callback_id);
@@ -317,10 +444,23 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
     case ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT:
         if (err_status == ESP_OK) {
             ESP_LOGI(TAG, "Device started successfully!");
-            ESP_LOGI(TAG, "Attempting to join network");
-            esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+            if (esp_zb_bdb_is_factory_new()) {
+                ESP_LOGI(TAG, "Attempting to join network");
+                esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+            } else {
+                // Network restored from zb_storage (e.g. waking from deep sleep), no scan needed
+                ESP_LOGI(TAG, "Rejoined network (PAN ID: 0x%04hx, Channel: %d)",
+                         esp_zb_get_pan_id(), esp_zb_get_current_channel());
+                net_cache_save();
+                log_joined("restored from zb_storage");
+                ota_client_confirm();
+                request_time_sync();
+                zed_fast_poll(TIME_REQUEST_POLL_MS);  // The sync is a write our parent holds until we poll
+            }
         } else {
-            ESP_LOGE(TAG, "Failed to initialize Zigbee stack (status: %s)", esp_err_to_name(err_status));
+            // Parent unreachable or rejoin refused; steer from scratch
+            ESP_LOGW(TAG, "Failed to start from saved network (status: %s). Steering...", esp_err_to_name(err_status));
+            esp_zb_scheduler_alarm(steering_retry_alarm, 0, 1000);
         }
         break;
     case ESP_ZB_BDB_SIGNAL_STEERING:
@@ -333,11 +473,24 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
                      extended_pan_id[3], extended_pan_id[2], extended_pan_id[1], extended_pan_id[0]);
             ESP_LOGI(TAG, "  PAN ID: 0x%04hx", esp_zb_get_pan_id());
             ESP_LOGI(TAG, "  Channel: %d", esp_zb_get_current_channel());
+            log_joined(net_cache_joined_cached() ? "cached channel" : "channel scan");
+            net_cache_save();
+            ota_client_confirm();
+            request_time_sync();
+            zed_fast_poll(TIME_REQUEST_POLL_MS);  // The sync is a write our parent holds until we poll
         } else {
             ESP_LOGI(TAG, "Network steering failed (status: %s). Retrying...", esp_err_to_name(err_status));
-            esp_zb_scheduler_alarm((esp_zb_callback_t)esp_zb_bdb_start_top_level_commissioning, ESP_ZB_BDB_MODE_NETWORK_STEERING, 1000);
+            if (net_cache_in_use()) {
+                // Not on the cached channel or any other: the network was re-formed
+                ESP_LOGW(TAG, "Cached network not found, dropping it");
+                net_cache_forget();
+            }
+            esp_zb_scheduler_alarm(steering_retry_alarm, 0, 1000);
         }
         break;
+    case ESP_ZB_COMMON_SIGNAL_CAN_SLEEP:
+        esp_zb_sleep_now();
+        break;
     default:
         ESP_LOGI(TAG, "ZDO signal: %s (0x%x), status: %s", esp_zb_zdo_signal_to_string(sig_type), sig_type,
                  esp_err_to_name(err_status));
@@ -351,11 +504,22 @@ static void esp_zb_task(void *pvParameters)
     esp_zb_cfg_t zb_nwk_cfg;
     zb_nwk_cfg.esp_zb_role = ESP_ZB_DEVICE_TYPE_ED;
     zb_nwk_cfg.install_code_policy = false;
-    zb_nwk_cfg.nwk_cfg.zed_cfg.ed_timeout = ESP_ZB_ED_AGING_TIMEOUT_64MIN;
-    zb_nwk_cfg.nwk_cfg.zed_cfg.keep_alive = 3000;
-
+    zb_nwk_cfg.nwk_cfg.zed_cfg.ed_timeout = ZED_AGING_TIMEOUT;
+    zb_nwk_cfg.nwk_cfg.zed_cfg.keep_alive = ZED_KEEP_ALIVE_MS;
+
+#if ZED_SLEEPY
+    // Must be set before esp_zb_init
+    esp_zb_sleep_enable(true);
+    ESP_LOGI(TAG, "Initializing Zigbee stack as SLEEPY END DEVICE (poll %d ms)", ZED_KEEP_ALIVE_MS);
+#else
     ESP_LOGI(TAG, "Initializing Zigbee stack as END DEVICE");
+#endif
     esp_zb_init(&zb_nwk_cfg);
+#if ZED_SLEEPY
+    esp_zb_set_rx_on_when_idle(false);
+    esp_zb_zdo_pim_set_long_poll_interval(ZED_KEEP_ALIVE_MS);
+    esp_zb_zdo_pim_set_fast_poll_interval(ZED_FAST_POLL_MS);
+#endif
 
     // Create endpoint list
     esp_zb_ep_list_t *ep_list = esp_zb_ep_list_create();
@@ -371,6 +535,10 @@ static void esp_zb_task(void *pvParameters)
     esp_zb_attribute_list_t *identify_cluster = esp_zb_identify_cluster_create(NULL);
     esp_zb_cluster_list_add_identify_cluster(cluster_list, identify_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
 
+    // Add groups cluster (server role) so the coordinator can fire all props with one groupcast
+    esp_zb_attribute_list_t *groups_cluster = esp_zb_groups_cluster_create(NULL);
+    esp_zb_cluster_list_add_groups_cluster(cluster_list, groups_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+
     // Add on/off cluster
     esp_zb_on_off_cluster_cfg_t on_off_cfg = {
         .on_off = ESP_ZB_ZCL_ON_OFF_ON_OFF_DEFAULT_VALUE,
@@ -383,8 +551,20 @@ static void esp_zb_task(void *pvParameters)
     uint32_t time_value = 0;
     esp_zb_custom_cluster_add_custom_attr(time_sync_cluster, ZB_TIME_SYNC_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U32,
                                           ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &time_value);
+    uint64_t time_us_value = 0;
+    esp_zb_custom_cluster_add_custom_attr(time_sync_cluster, ZB_TIME_SYNC_US_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U64,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &time_us_value);
+    int16_t drift_value = time_drift_ppm();  // Retained across deep sleep
+    esp_zb_custom_cluster_add_custom_attr(time_sync_cluster, ZB_TIME_SYNC_DRIFT_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &drift_value);
+    uint32_t actuation_value = ACTUATION_UNKNOWN;
+    esp_zb_custom_cluster_add_custom_attr(time_sync_cluster, ZB_ACTUATION_US_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U32,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &actuation_value);
     esp_zb_cluster_list_add_custom_cluster(cluster_list, time_sync_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
 
+    // Add OTA Upgrade cluster - CLIENT role, downloads new firmware from the coordinator
+    ota_client_add_cluster(cluster_list);
+
     // Create endpoint
     esp_zb_endpoint_config_t endpoint_config = {
         .endpoint = 1,
@@ -400,6 +580,8 @@ static void esp_zb_task(void *pvParameters)
     esp_zb_core_action_handler_register(zb_action_handler);
 
     ESP_LOGI(TAG, "Starting Zigbee stack");
+    net_cache_load();
+    net_cache_apply();
     ESP_ERROR_CHECK(esp_zb_start(false));
 
     // Set Zigbee TX power to maximum (20 dBm) for better range
@@ -412,8 +594,9 @@ static void esp_zb_task(void *pvParameters)
 void enter_deep_sleep(void)
 {
     ESP_LOGI(TAG, "Entering deep sleep until 6am...");
+    applog_flush();
 
-    if (!time_synced) {
+    if (!time_is_synced()) {
         ESP_LOGE(TAG, "Time not synced, cannot calculate sleep duration. Sleeping for 6 hours.");
         esp_sleep_enable_timer_wakeup(6 * 60 * 60 * 1000000ULL);
         gpio_set_level(LED_PIN, 0);
@@ -422,9 +605,10 @@ void enter_deep_sleep(void)
     }
 
     // Calculate sleep duration (until 6am)
-    time_t now = time(NULL);
+    struct timeval now;
+    gettimeofday(&now, NULL);
     struct tm timeinfo;
-    localtime_r(&now, &timeinfo);
+    localtime_r(&now.tv_sec, &timeinfo);
 
     int hours_until_wakeup = SLEEP_END_HOUR - timeinfo.tm_hour;
     if (hours_until_wakeup <= 0) {
@@ -437,10 +621,11 @@ void enter_deep_sleep(void)
     ESP_LOGI(TAG, "Sleeping for %d seconds (~%d hours)", total_seconds, hours_until_wakeup);
 
     // Configure timer wakeup
-    esp_sleep_enable_timer_wakeup(total_seconds * 1000000ULL);  // microseconds
+    esp_sleep_enable_timer_wakeup(total_seconds * 1000000ULL - now.tv_usec);  // microseconds
 
     // Turn off LED before sleep
     gpio_set_level(LED_PIN, 0);
+    time_retain_for_sleep();
 
     // Enter deep sleep
     esp_deep_sleep_start();
@@ -455,6 +640,9 @@ void app_main(void)
     ESP_LOGI(TAG, "║  Active hours: 6am-12am, Sleep: 12am-6am     ║");
     ESP_LOGI(TAG, "╚══════════════════════════════════════════════╝");
 
+    // Deferred log lines are formatted just above idle, off the Zigbee task
+    applog_init(1);
+
     // Initialize NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -463,6 +651,16 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
+#if ZED_SLEEPY
+    // Light sleep whenever every task is blocked; the Zigbee stack wakes us for polls
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = ZED_CPU_MAX_MHZ,
+        .min_freq_mhz = ZED_CPU_MIN_MHZ,
+        .light_sleep_enable = true,
+    };
+    ESP_ERROR_CHECK(esp_pm_configure(&pm_config));
+#endif
+
     // Initialize hardware
     setup_external_antenna();
     setup_relay_pin();
@@ -477,13 +675,20 @@ void app_main(void)
     ESP_LOGI(TAG, "Cooldown timer initialized");
 
     // Create relay trigger task (separate from Zigbee stack)
-    xTaskCreate(relay_trigger_task, "relay_trigger", 2048, NULL, 5, &relay_task_handle);
+    xTaskCreate(relay_trigger_task, "relay_trigger", 3072, NULL, 5, &relay_task_handle);
     ESP_LOGI(TAG, "Relay trigger task created");
 
-    // Create status task (prints status every 3 seconds)
-    xTaskCreate(status_task, "status", 2048, NULL, 3, NULL);
+    // Create status task (status every 3 seconds, metrics every few minutes)
+    TaskHandle_t status_task_handle = NULL;
+    xTaskCreate(status_task, "status", 2048, NULL, 3, &status_task_handle);
     ESP_LOGI(TAG, "Status task created");
 
+    metrics_watch_task(xTaskGetCurrentTaskHandle());
+    metrics_watch_task(relay_task_handle);
+    metrics_watch_task(status_task_handle);
+
+    time_restore_after_sleep();
+
     // Check if it's sleep time
     if (is_sleep_time()) {
         enter_deep_sleep();
@@ -501,13 +706,21 @@ void app_main(void)
     }
 
     // Start Zigbee
-    xTaskCreate(esp_zb_task, "Zigbee_main", 4096, NULL, 5, NULL);
+    TaskHandle_t zb_task_handle = NULL;
+    xTaskCreate(esp_zb_task, "Zigbee_main", 4096, NULL, 5, &zb_task_handle);
+    metrics_watch_task(zb_task_handle);
 
     // Periodic sleep check task
     while (1) {
-        vTaskDelay(pdMS_TO_TICKS(60000));  // Check every minute
+        // Check every minute, or right at the sleep boundary if that's sooner
+        uint32_t delay_ms = 60000;
+        if (time_is_synced() && ms_until_sleep_start() < delay_ms) {
+            delay_ms = ms_until_sleep_start() + 1;
+        }
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
 
-        if (is_sleep_time()) {
+        // A download in flight finishes first; it reboots into the new image
+        if (is_sleep_time() && !ota_client_busy()) {
             enter_deep_sleep();
         }
     }
@@ -1,18 +1,29 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "esp_random.h"
 #include "esp_mac.h"
 #include "driver/gpio.h"
+#include "hal/gpio_ll.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "esp_zigbee_core.h"
 #include "esp_sleep.h"
-#include "led_strip.h"
+#include "esp_pm.h"
+#include "neopixel_anim.h"
+#include "motion_counter.h"
+#include "metrics.h"
+#include "applog.h"
+#include "ota_client.h"
+#include "net_cache.h"
+#include "prop_time.h"
 
 static const char *TAG = "rip_tombstone";
 
@@ -28,54 +39,63 @@ static const char *TAG = "rip_tombstone";
 #define SLEEP_START_HOUR 0
 #define SLEEP_END_HOUR 6
 
-// Zigbee configuration - scan all channels to find coordinator
-#define ESP_ZB_PRIMARY_CHANNEL_MASK ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK
+// Sleepy end-device profile. With ZED_SLEEPY the tombstone joins as an end
+// device with the radio off between parent polls, and the chip light-sleeps
+// whenever the stack allows it; the PIR wakes it. The parent holds our frames
+// until we poll, so ZED_KEEP_ALIVE_MS is the worst-case delay for an On/Off to
+// arrive; after motion or a show we poll every ZED_FAST_POLL_MS for
+// ZED_FAST_POLL_WINDOW_MS. ZED_SLEEPY 0 keeps the old always-on router.
+// Switching changes the device type, so erase zb_storage when you do.
+#define ZED_SLEEPY             1
+#define ZED_AGING_TIMEOUT      ESP_ZB_ED_AGING_TIMEOUT_512MIN  // Outlasts the 6 h night, so the parent keeps our entry
+#define ZED_KEEP_ALIVE_MS      1000
+#define ZED_FAST_POLL_MS       250
+#define ZED_OTA_POLL_MS        50     // While an OTA download runs (ota_client.h)
+#define ZED_FAST_POLL_WINDOW_MS 10000  // Motion cooldown; also covers the longest show
+#define ZED_CPU_MAX_MHZ        160
+#define ZED_CPU_MIN_MHZ        40  // XTAL; the CPU drops to it when idle but awake
 
-// Time synchronization
-static bool time_synced = false;
 static bool triggered_recently = false;
 
 // Timer handle for non-blocking cooldown
 static esp_timer_handle_t cooldown_timer = NULL;
 
-// LED strip handle
-static led_strip_handle_t neopixel_strip;
-
 // Task handles
 static TaskHandle_t motion_task_handle = NULL;
+static TaskHandle_t scarecrow_task_handle = NULL;
 
-// Zigbee Time Sync Cluster (using custom manufacturer-specific cluster)
-#define ZB_TIME_SYNC_CLUSTER_ID 0xFC00  // Custom cluster for time synchronization
-#define ZB_TIME_SYNC_ATTR_ID 0x0000     // Attribute ID for Unix timestamp
+// PIR edges are timestamped in the GPIO ISR and queued for motion_detection_task
+#define PIR_EDGE_QUEUE_LEN     8
+#define PIR_WARMUP_MS          30000
+#define MOTION_TASK_PRIO       7   // Above the animation task; only posts work
+#define SCARECROW_TASK_PRIO    8   // Sends the scarecrow request the moment motion is accepted
+#define MOTION_COOLDOWN_US     (10 * 1000000LL)
 
-// Custom Trigger Request Cluster - to ask coordinator to trigger scarecrow
-#define ZB_TRIGGER_REQUEST_CLUSTER_ID 0xFC01  // Custom cluster for trigger requests
-#define ZB_TRIGGER_REQUEST_ATTR_ID 0x0000     // Attribute for trigger target (1=scarecrow)
+typedef struct {
+    int64_t edge_us;    // esp_timer time of the GPIO edge
+    uint8_t level;
+} pir_edge_t;
 
-void set_system_time(time_t timestamp)
-{
-    struct timeval tv = { .tv_sec = timestamp, .tv_usec = 0 };
-    settimeofday(&tv, NULL);
+static QueueHandle_t pir_edge_queue = NULL;
 
-    // Set timezone to Los Angeles (PST/PDT)
-    setenv("TZ", "PST8PDT,M3.2.0,M11.1.0", 1);
-    tzset();
+// Our attribute on the time sync cluster (prop_time.h)
+#define ZB_ACTUATION_US_ATTR_ID    0x0004  // U32 On/Off received -> LEDs lit for the last trigger, us
+#define ACTUATION_UNKNOWN          UINT32_MAX  // Not actuated (yet) for the last On/Off
 
-    struct tm timeinfo;
-    localtime_r(&timestamp, &timeinfo);
-    char time_str[64];
-    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
-
-    ESP_LOGI(TAG, "Time synchronized from coordinator!");
-    ESP_LOGI(TAG, "   Unix timestamp: %ld", timestamp);
-    ESP_LOGI(TAG, "   Time: %s", time_str);
+// esp_timer time the last On/Off arrived, for report_actuation()
+static volatile int64_t onoff_rx_us = 0;
 
-    time_synced = true;
-}
+// Custom Trigger Request Cluster - to ask coordinator to trigger scarecrow
+#define ZB_TRIGGER_REQUEST_CLUSTER_ID 0xFC01  // Custom cluster for trigger requests
+#define ZB_TRIGGER_REQUEST_CMD_ID 0x01     // Custom command: motion here, run my rules (u8 caps hint)
+#define ZB_METRICS_CMD_ID 0x02             // Custom command: octet string of metric records
+#define TRIGGER_REQUEST_HINT   (1 << 0)      // Relay props, what the built-in rules fire for us
+#define METRICS_REPORT_INTERVAL_S 300        // Each report costs a radio wake-up
+#define METRICS_REPORT_MAX     60            // Record bytes; keeps the command in one unfragmented frame
 
 bool is_sleep_time(void)
 {
-    if (!time_synced) {
+    if (!time_is_synced()) {
         ESP_LOGI(TAG, "Time not synced yet, assuming awake hours");
         return false;
     }
@@ -95,6 +115,43 @@ bool is_sleep_time(void)
     return false;
 }
 
+// Milliseconds until SLEEP_START_HOUR:00:00 local time, so the sleep check
+// lands on the boundary instead of up to a minute after it
+uint32_t ms_until_sleep_start(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    struct tm timeinfo;
+    localtime_r(&now.tv_sec, &timeinfo);
+
+    int32_t secs_left = SLEEP_START_HOUR * 3600 - (timeinfo.tm_hour * 3600 + timeinfo.tm_min * 60 + timeinfo.tm_sec);
+    if (secs_left <= 0) {
+        secs_left += 24 * 3600;
+    }
+    return (uint32_t)secs_left * 1000 - now.tv_usec / 1000;
+}
+
+// Edges can't wake the chip from light sleep, levels can. So the PIR pin
+// runs as a level interrupt armed for the opposite of its current level, and
+// the ISR re-arms it for the other level on every change. That is an any-edge
+// interrupt that also serves as the light sleep wakeup source.
+static inline gpio_int_type_t pir_next_intr(int level)
+{
+    return level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL;
+}
+
+static void IRAM_ATTR pir_isr_handler(void *arg)
+{
+    pir_edge_t edge = {
+        .edge_us = esp_timer_get_time(),
+        .level = (uint8_t)gpio_ll_get_level(&GPIO, PIR_PIN),
+    };
+    gpio_ll_set_intr_type(&GPIO, PIR_PIN, pir_next_intr(edge.level));
+    BaseType_t woken = pdFALSE;
+    xQueueSendFromISR(pir_edge_queue, &edge, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
 void setup_pir(void)
 {
     gpio_config_t pir_conf = {
@@ -106,7 +163,16 @@ void setup_pir(void)
     };
     gpio_config(&pir_conf);
 
-    ESP_LOGI(TAG, "PIR sensor initialized on GPIO%d", PIR_PIN);
+    pir_edge_queue = xQueueCreate(PIR_EDGE_QUEUE_LEN, sizeof(pir_edge_t));
+    ESP_ERROR_CHECK(gpio_install_isr_service(0));
+    ESP_ERROR_CHECK(gpio_isr_handler_add(PIR_PIN, pir_isr_handler, NULL));
+
+    // Also sets the interrupt type, armed for the next change
+    ESP_ERROR_CHECK(gpio_wakeup_enable(PIR_PIN, pir_next_intr(gpio_get_level(PIR_PIN))));
+    ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
+    gpio_intr_enable(PIR_PIN);
+
+    ESP_LOGI(TAG, "PIR sensor initialized on GPIO%d (change interrupt, wakes light sleep)", PIR_PIN);
 }
 
 void setup_led(void)
@@ -151,74 +217,37 @@ void setup_external_antenna(void)
     ESP_LOGI(TAG, "External antenna configured");
 }
 
-void setup_neopixels(void)
+// Poll the parent every ZED_FAST_POLL_MS for ZED_FAST_POLL_WINDOW_MS, so the
+// replies and follow-up reads a trigger brings aren't held for a full
+// keep-alive. Caller holds the Zigbee lock.
+static void zed_fast_poll(void)
 {
-    led_strip_config_t strip_config = {
-        .strip_gpio_num = NEOPIXEL_PIN,
-        .max_leds = NEOPIXEL_COUNT,
-        .led_pixel_format = LED_PIXEL_FORMAT_GRB,
-        .led_model = LED_MODEL_WS2812,
-        .flags.invert_out = false,
-    };
-
-    led_strip_rmt_config_t rmt_config = {
-        .clk_src = RMT_CLK_SRC_DEFAULT,
-        .resolution_hz = 10 * 1000 * 1000,
-        .flags.with_dma = false,
-    };
-
-    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &neopixel_strip));
-    led_strip_clear(neopixel_strip);
-
-    ESP_LOGI(TAG, "NeoPixel strip initialized on GPIO%d (%d LEDs)", NEOPIXEL_PIN, NEOPIXEL_COUNT);
+#if ZED_SLEEPY
+    esp_zb_zdo_pim_start_turbo_poll_continuous(ZED_FAST_POLL_WINDOW_MS);
+#endif
 }
 
-void blink_neopixels_red(void)
+// Each OTA block response waits at the parent for our next poll, so a
+// download polls a lot faster than a trigger does. Caller holds the Zigbee lock.
+static void zed_ota_poll(bool busy)
 {
-    ESP_LOGI(TAG, "Blinking NeoPixels red 20 times!");
-
-    for (int blink = 0; blink < 20; blink++) {
-        for (int i = 0; i < NEOPIXEL_COUNT; i++) {
-            led_strip_set_pixel(neopixel_strip, i, 255, 0, 0);
-        }
-        led_strip_refresh(neopixel_strip);
-        vTaskDelay(pdMS_TO_TICKS(150));
-
-        led_strip_clear(neopixel_strip);
-        vTaskDelay(pdMS_TO_TICKS(150));
+#if ZED_SLEEPY
+    esp_zb_zdo_pim_set_fast_poll_interval(busy ? ZED_OTA_POLL_MS : ZED_FAST_POLL_MS);
+    if (busy) {
+        esp_zb_zdo_pim_start_turbo_poll_continuous(ZED_FAST_POLL_WINDOW_MS);
     }
-
-    ESP_LOGI(TAG, "Blink complete");
+#endif
 }
 
-void blink_neopixels_rainbow(void)
+// Animation task: the coordinator-requested flash is on the strip. Read back
+// by the coordinator for trigger latency tracing.
+static void report_actuation(int64_t lit_us)
 {
-    ESP_LOGI(TAG, "RAINBOW SHOW! Blinking NeoPixels random rainbow 50 times!");
-
-    for (int blink = 0; blink < 50; blink++) {
-        for (int i = 0; i < NEOPIXEL_COUNT; i++) {
-            int color = esp_random() % 6;
-            uint8_t r = 0, g = 0, b = 0;
-
-            switch(color) {
-                case 0: r = 255; g = 0;   b = 0;   break;
-                case 1: r = 255; g = 127; b = 0;   break;
-                case 2: r = 255; g = 255; b = 0;   break;
-                case 3: r = 0;   g = 255; b = 0;   break;
-                case 4: r = 0;   g = 0;   b = 255; break;
-                case 5: r = 128; g = 0;   b = 255; break;
-            }
-
-            led_strip_set_pixel(neopixel_strip, i, g, r, b);
-        }
-        led_strip_refresh(neopixel_strip);
-        vTaskDelay(pdMS_TO_TICKS(75));
-
-        led_strip_clear(neopixel_strip);
-        vTaskDelay(pdMS_TO_TICKS(75));
-    }
-
-    ESP_LOGI(TAG, "Rainbow show complete!");
+    uint32_t actuation_us = (uint32_t)(lit_us - onoff_rx_us);
+    esp_zb_lock_acquire(portMAX_DELAY);
+    esp_zb_zcl_set_attribute_val(1, ZB_TIME_SYNC_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 ZB_ACTUATION_US_ATTR_ID, &actuation_us, false);
+    esp_zb_lock_release();
 }
 
 // Timer callback to reset cooldown
@@ -228,44 +257,82 @@ static void cooldown_timer_callback(void* arg)
     ESP_LOGI(TAG, "Cooldown expired, ready for next trigger");
 }
 
-// Trigger the haunted scarecrow via coordinator
+// Tell the coordinator we saw motion. What it fires is up to its rule table;
+// the built-in rules fire the props with the hinted capabilities (the
+// scarecrow). The command, unlike an attribute write, tells it who asked.
 void trigger_haunted_scarecrow(void)
 {
-    ESP_LOGI(TAG, "Sending trigger request to coordinator for scarecrow...");
+    uint8_t hint = TRIGGER_REQUEST_HINT;
+    esp_zb_zcl_custom_cluster_cmd_req_t req = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = 0x0000,  // Coordinator address is always 0x0000
+            .dst_endpoint = 1,
+            .src_endpoint = 1,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+        .cluster_id = ZB_TRIGGER_REQUEST_CLUSTER_ID,
+        .custom_cmd_id = ZB_TRIGGER_REQUEST_CMD_ID,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV,
+        .data = {
+            .type = ESP_ZB_ZCL_ATTR_TYPE_U8,
+            .size = sizeof(hint),
+            .value = &hint,
+        },
+    };
 
-    // Send trigger request to coordinator using custom cluster
-    // We write to the trigger request attribute on the coordinator
-    esp_zb_zcl_write_attr_cmd_t write_req;
+    esp_zb_lock_acquire(portMAX_DELAY);
+    esp_zb_zcl_custom_cluster_cmd_req(&req);
+    zed_fast_poll();
+    esp_zb_lock_release();
+    metrics_inc(METRIC_TRIGGER_REQUESTS);
 
-    uint8_t trigger_target = 1; // 1 = trigger scarecrow
+    ESP_LOGI(TAG, "Trigger request sent to coordinator");
+}
 
-    esp_zb_zcl_attribute_t attr_list[] = {
-        {
-            .id = ZB_TRIGGER_REQUEST_ATTR_ID,
-            .data.type = ESP_ZB_ZCL_ATTR_TYPE_U8,
-            .data.value = &trigger_target,
-            .data.size = sizeof(trigger_target),
-        }
+// Send our metrics to the coordinator, which forwards them to the TinyS3.
+// Fire and forget: a lost report is replaced by the next one.
+static void report_metrics(void)
+{
+    static metrics_snapshot_t snap;
+    uint8_t payload[1 + METRICS_REPORT_MAX];
+    size_t next = 0;
+
+    metrics_sample_system();
+    metrics_snapshot_local(&snap);
+    payload[0] = (uint8_t)metrics_encode(&snap, false, &next, &payload[1], METRICS_REPORT_MAX);
+
+    esp_zb_zcl_custom_cluster_cmd_req_t req = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = 0x0000,
+            .dst_endpoint = 1,
+            .src_endpoint = 1,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+        .cluster_id = ZB_TRIGGER_REQUEST_CLUSTER_ID,
+        .custom_cmd_id = ZB_METRICS_CMD_ID,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV,
+        .data = {
+            .type = ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+            .size = 1 + payload[0],
+            .value = payload,
+        },
     };
 
-    write_req.address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
-    write_req.zcl_basic_cmd.dst_addr_u.addr_short = 0x0000; // Coordinator address is always 0x0000
-    write_req.zcl_basic_cmd.dst_endpoint = 1;
-    write_req.zcl_basic_cmd.src_endpoint = 1;
-    write_req.clusterID = ZB_TRIGGER_REQUEST_CLUSTER_ID;
-    write_req.attr_number = 1;
-    write_req.attr_field = attr_list;
-
     esp_zb_lock_acquire(portMAX_DELAY);
-    esp_zb_zcl_write_attr_cmd_req(&write_req);
+    if (esp_zb_bdb_dev_joined()) {
+        esp_zb_zcl_custom_cluster_cmd_req(&req);
+    }
     esp_zb_lock_release();
-
-    ESP_LOGI(TAG, "Trigger request sent to coordinator");
 }
 
-// Status task - prints device status every 10 seconds
+// Status task - logs device status every 10 seconds, reports metrics every
+// METRICS_REPORT_INTERVAL_S
 void status_task(void *pvParameters)
 {
+    int64_t next_report_us = esp_timer_get_time() + METRICS_REPORT_INTERVAL_S * 1000000LL;
+
     while (1) {
         time_t now;
         struct tm timeinfo;
@@ -274,105 +341,114 @@ void status_task(void *pvParameters)
         time(&now);
         localtime_r(&now, &timeinfo);
 
-        if (time_synced) {
+        if (time_is_synced()) {
             strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
         } else {
             strcpy(time_str, "NOT SYNCED");
         }
 
         const char *status = triggered_recently ? "COOLDOWN" : "READY";
-        ESP_LOGI(TAG, "Status: %s | Time: %s",
-                 status, time_str);
+        APPLOGD(STATUS, TAG, "Status: %s | Time: %s",
+                status, time_str);
+
+        if (esp_timer_get_time() >= next_report_us) {
+            next_report_us += METRICS_REPORT_INTERVAL_S * 1000000LL;
+            report_metrics();
+        }
 
         vTaskDelay(pdMS_TO_TICKS(10000));
     }
 }
 
-// Motion detection task
+// Sends the scarecrow trigger request as soon as motion_detection_task
+// accepts a motion, independent of the light show
+void scarecrow_trigger_task(void *pvParameters)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        trigger_haunted_scarecrow();
+    }
+}
+
+// Count a motion at edge_us and return the light show it earns
+static anim_id_t motion_show(motion_counter_t *m, int64_t edge_us)
+{
+    int was = m->count;
+    bool rainbow = motion_counter_feed(m, edge_us);
+
+    if (m->reset == MOTION_RESET_IDLE) {
+        ESP_LOGI(TAG, "No motion for 30s - Resetting counter (was %d/3)", was);
+    } else if (m->reset == MOTION_RESET_WINDOW) {
+        ESP_LOGI(TAG, "Timer reset (>90s). Starting new count.");
+    }
+    ESP_LOGI(TAG, "MOTION DETECTED! Count: %d/3", m->count);
+    return rainbow ? ANIM_RAINBOW : ANIM_RED_BLINK;
+}
+
+// Motion detection task: PIR edges from the ISR queue
 void motion_detection_task(void *pvParameters)
 {
     ESP_LOGI(TAG, "Warming up PIR sensor (30 seconds)...");
-    vTaskDelay(pdMS_TO_TICKS(30000));
+    vTaskDelay(pdMS_TO_TICKS(PIR_WARMUP_MS));
+    xQueueReset(pir_edge_queue);  // Edges while warming up are noise
     ESP_LOGI(TAG, "PIR sensor ready!");
 
-    bool last_motion = false;
-    int motion_count = 0;
-    int64_t first_motion_time = 0;
-    int64_t last_motion_time = 0;
+    bool last_motion = gpio_get_level(PIR_PIN);
+    motion_counter_t counter;
+    motion_counter_init(&counter);
+    pir_edge_t edge;
 
     while (1) {
-        bool motion_detected = gpio_get_level(PIR_PIN);
-        int64_t current_time = esp_timer_get_time() / 1000000;
-
-        // Reset counter if 30 seconds passed since last motion
-        if (motion_count > 0 && last_motion_time > 0) {
-            if ((current_time - last_motion_time) > 30) {
-                ESP_LOGI(TAG, "No motion for 30s - Resetting counter (was %d/3)", motion_count);
-                motion_count = 0;
-                first_motion_time = 0;
-                last_motion_time = 0;
-            }
+        if (xQueueReceive(pir_edge_queue, &edge, portMAX_DELAY) != pdTRUE) {
+            continue;
         }
 
-        if (motion_detected) {
-            gpio_set_level(LED_PIN, 1);
-
-            if (!last_motion && !triggered_recently) {
-                if (motion_count == 0) {
-                    first_motion_time = current_time;
-                    motion_count = 1;
-                    last_motion_time = current_time;
-                    ESP_LOGI(TAG, "MOTION DETECTED! Count: 1/3");
-                } else {
-                    // Check if within 90 second window
-                    if ((current_time - first_motion_time) <= 90) {
-                        motion_count++;
-                        last_motion_time = current_time;
-                        ESP_LOGI(TAG, "MOTION DETECTED! Count: %d/3", motion_count);
-                    } else {
-                        ESP_LOGI(TAG, "Timer reset (>90s). Starting new count.");
-                        first_motion_time = current_time;
-                        motion_count = 1;
-                        last_motion_time = current_time;
-                        ESP_LOGI(TAG, "MOTION DETECTED! Count: 1/3");
-                    }
-                }
-
-                triggered_recently = true;
-
-                // Trigger appropriate light show
-                if (motion_count >= 3) {
-                    ESP_LOGI(TAG, "THREE MOTIONS IN 90 SECONDS! RAINBOW SHOW TIME!");
-                    blink_neopixels_rainbow();
-                    motion_count = 0;
-                    first_motion_time = 0;
-                    last_motion_time = 0;
-                } else {
-                    blink_neopixels_red();
-                }
-
-                // Always try to trigger the haunted scarecrow on ANY motion
-                trigger_haunted_scarecrow();
+        bool motion = edge.level != 0;
+        if (motion == last_motion) {
+            continue;  // Bounce, or the other half of a missed edge pair
+        }
+        last_motion = motion;
+        gpio_set_level(LED_PIN, motion);
 
-                // Start cooldown timer (10 seconds)
-                if (cooldown_timer != NULL) {
-                    esp_timer_stop(cooldown_timer);
-                    esp_timer_start_once(cooldown_timer, 10000000); // 10 seconds
-                }
-            }
-        } else {
-            gpio_set_level(LED_PIN, 0);
+        if (!motion) {
+            ESP_LOGI(TAG, "No motion");
+            continue;
+        }
+        metrics_inc(METRIC_PIR_MOTIONS);
+        if (triggered_recently) {
+            continue;
+        }
 
-            if (last_motion) {
-                ESP_LOGI(TAG, "No motion");
-            }
+        // Scarecrow request and light show both start now; neither waits on the other
+        triggered_recently = true;
+        xTaskNotifyGive(scarecrow_task_handle);
+        anim_id_t show = motion_show(&counter, edge.edge_us);
+        anim_play(show, NULL);
+        metrics_inc(METRIC_ACTUATIONS);
+        if (show == ANIM_RAINBOW) {
+            ESP_LOGI(TAG, "THREE MOTIONS IN 90 SECONDS! RAINBOW SHOW TIME!");
         }
 
-        last_motion = motion_detected;
-        vTaskDelay(pdMS_TO_TICKS(100));
+        // Start cooldown timer
+        if (cooldown_timer != NULL) {
+            esp_timer_stop(cooldown_timer);
+            esp_timer_start_once(cooldown_timer, MOTION_COOLDOWN_US);
+        }
     }
 }
 
+// Scheduled after a failed steering attempt
+static void steering_retry_alarm(uint8_t param)
+{
+    net_cache_apply();
+    esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+}
+
+static void log_joined(const char *how)
+{
+    ESP_LOGI(TAG, "Network ready %lld ms after boot (%s)", esp_timer_get_time() / 1000, how);
+}
+
 // Zigbee action handler
 static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id, const void *message)
 {
@@ -382,27 +458,40 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
         case ESP_ZB_CORE_SET_ATTR_VALUE_CB_ID: {
             const esp_zb_zcl_set_attr_value_message_t *attr_msg = (esp_zb_zcl_set_attr_value_message_t *)message;
 
-            ESP_LOGI(TAG, "Zigbee attribute update - Endpoint: %d, Cluster: 0x%04x, Attr: 0x%04x",
-                     attr_msg->info.dst_endpoint,
-                     attr_msg->info.cluster,
-                     attr_msg->attribute.id);
+            APPLOG_DEFER(ZIGBEE, ESP_LOG_DEBUG, TAG, "Zigbee attribute update - Endpoint: %u, Cluster: 0x%04x, Attr: 0x%04x",
+                         attr_msg->info.dst_endpoint,
+                         attr_msg->info.cluster,
+                         attr_msg->attribute.id);
 
             // Check for On/Off cluster (0x0006) - trigger NeoPixel animation
             if (attr_msg->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_ON_OFF) {
                 if (attr_msg->attribute.id == ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID) {
                     bool on_off = *(bool *)attr_msg->attribute.data.value;
-                    ESP_LOGI(TAG, "Received On/Off command: %s", on_off ? "ON" : "OFF");
+                    APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Received On/Off command: %s", (uintptr_t)(on_off ? "ON" : "OFF"));
+
+                    // Unknown until the animation task reports the first frame
+                    uint32_t actuation_us = ACTUATION_UNKNOWN;
+                    esp_zb_zcl_set_attribute_val(1, ZB_TIME_SYNC_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                                 ZB_ACTUATION_US_ATTR_ID, &actuation_us, false);
 
                     if (on_off) {
-                        // Trigger NeoPixel flash animation
-                        ESP_LOGI(TAG, "Triggering NeoPixel flash from coordinator");
-                        blink_neopixels_red();
+                        // Trigger NeoPixel flash animation; returns at once
+                        APPLOG_DEFER(TRIGGER, ESP_LOG_INFO, TAG, "Triggering NeoPixel flash from coordinator");
+                        onoff_rx_us = esp_timer_get_time();
+                        anim_play(ANIM_RED_BLINK, report_actuation);
+                        metrics_inc(METRIC_ACTUATIONS);
+                        zed_fast_poll();  // The coordinator reads the actuation time back
                     }
                 }
             }
             // Check for Time Sync cluster (custom cluster 0xFC00)
             else if (attr_msg->info.cluster == ZB_TIME_SYNC_CLUSTER_ID) {
-                if (attr_msg->attribute.id == ZB_TIME_SYNC_ATTR_ID) {
+                if (attr_msg->attribute.id == ZB_TIME_SYNC_US_ATTR_ID &&
+                    attr_msg->attribute.data.size == sizeof(uint64_t)) {
+                    int64_t unix_us;
+                    memcpy(&unix_us, attr_msg->attribute.data.value, sizeof(unix_us));
+                    set_system_time_us(unix_us);
+                } else if (attr_msg->attribute.id == ZB_TIME_SYNC_ATTR_ID) {
                     if (attr_msg->attribute.data.size == 4) {
                         time_t timestamp = *(uint32_t *)attr_msg->attribute.data.value;
                         set_system_time(timestamp);
@@ -415,7 +504,11 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
             break;
         }
         case ESP_ZB_CORE_CMD_DEFAULT_RESP_CB_ID:
-            ESP_LOGI(TAG, "Zigbee command response received");
+            APPLOGD(ZIGBEE, TAG, "Zigbee command response received");
+            break;
+        case ESP_ZB_CORE_OTA_UPGRADE_VALUE_CB_ID:
+            ret = ota_client_handle((const esp_zb_zcl_ota_upgrade_value_message_t *)message);
+            zed_ota_poll(ota_client_busy());
             break;
         default:
             ESP_LOGW(TAG, "Receive Zigbee action(0x%x) callback", callback_id);
@@ -440,10 +533,23 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
     case ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT:
         if (err_status == ESP_OK) {
             ESP_LOGI(TAG, "Device started successfully!");
-            ESP_LOGI(TAG, "Attempting to join network");
-            esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+            if (esp_zb_bdb_is_factory_new()) {
+                ESP_LOGI(TAG, "Attempting to join network");
+                esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+            } else {
+                // Network restored from zb_storage (e.g. waking from deep sleep), no scan needed
+                ESP_LOGI(TAG, "Rejoined network (PAN ID: 0x%04hx, Channel: %d)",
+                         esp_zb_get_pan_id(), esp_zb_get_current_channel());
+                net_cache_save();
+                log_joined("restored from zb_storage");
+                ota_client_confirm();
+                request_time_sync();
+                zed_fast_poll();  // The sync is a write our parent holds until we poll
+            }
         } else {
-            ESP_LOGE(TAG, "Failed to initialize Zigbee stack (status: %s)", esp_err_to_name(err_status));
+            // Parent unreachable or rejoin refused; steer from scratch
+            ESP_LOGW(TAG, "Failed to start from saved network (status: %s). Steering...", esp_err_to_name(err_status));
+            esp_zb_scheduler_alarm(steering_retry_alarm, 0, 1000);
         }
         break;
     case ESP_ZB_BDB_SIGNAL_STEERING:
@@ -456,11 +562,24 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
                      extended_pan_id[3], extended_pan_id[2], extended_pan_id[1], extended_pan_id[0]);
             ESP_LOGI(TAG, "  PAN ID: 0x%04hx", esp_zb_get_pan_id());
             ESP_LOGI(TAG, "  Channel: %d", esp_zb_get_current_channel());
+            log_joined(net_cache_joined_cached() ? "cached channel" : "channel scan");
+            net_cache_save();
+            ota_client_confirm();
+            request_time_sync();
+            zed_fast_poll();  // The sync is a write our parent holds until we poll
         } else {
             ESP_LOGI(TAG, "Network steering failed (status: %s). Retrying...", esp_err_to_name(err_status));
-            esp_zb_scheduler_alarm((esp_zb_callback_t)esp_zb_bdb_start_top_level_commissioning, ESP_ZB_BDB_MODE_NETWORK_STEERING, 1000);
+            if (net_cache_in_use()) {
+                // Not on the cached channel or any other: the network was re-formed
+                ESP_LOGW(TAG, "Cached network not found, dropping it");
+                net_cache_forget();
+            }
+            esp_zb_scheduler_alarm(steering_retry_alarm, 0, 1000);
         }
         break;
+    case ESP_ZB_COMMON_SIGNAL_CAN_SLEEP:
+        esp_zb_sleep_now();
+        break;
     default:
         ESP_LOGI(TAG, "ZDO signal: %s (0x%x), status: %s", esp_zb_zdo_signal_to_string(sig_type), sig_type,
                  esp_err_to_name(err_status));
@@ -470,15 +589,30 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
 
 static void esp_zb_task(void *pvParameters)
 {
-    // Initialize Zigbee router configuration
     esp_zb_cfg_t zb_nwk_cfg;
-    zb_nwk_cfg.esp_zb_role = ESP_ZB_DEVICE_TYPE_ROUTER;
     zb_nwk_cfg.install_code_policy = false;
+#if ZED_SLEEPY
+    // Initialize Zigbee sleepy end device configuration
+    zb_nwk_cfg.esp_zb_role = ESP_ZB_DEVICE_TYPE_ED;
+    zb_nwk_cfg.nwk_cfg.zed_cfg.ed_timeout = ZED_AGING_TIMEOUT;
+    zb_nwk_cfg.nwk_cfg.zed_cfg.keep_alive = ZED_KEEP_ALIVE_MS;
+
+    // Must be set before esp_zb_init
+    esp_zb_sleep_enable(true);
+    ESP_LOGI(TAG, "Initializing Zigbee stack as SLEEPY END DEVICE (poll %d ms)", ZED_KEEP_ALIVE_MS);
+    esp_zb_init(&zb_nwk_cfg);
+    esp_zb_set_rx_on_when_idle(false);
+    esp_zb_zdo_pim_set_long_poll_interval(ZED_KEEP_ALIVE_MS);
+    esp_zb_zdo_pim_set_fast_poll_interval(ZED_FAST_POLL_MS);
+#else
+    // Initialize Zigbee router configuration
+    zb_nwk_cfg.esp_zb_role = ESP_ZB_DEVICE_TYPE_ROUTER;
     zb_nwk_cfg.nwk_cfg.zed_cfg.ed_timeout = ESP_ZB_ED_AGING_TIMEOUT_64MIN;
     zb_nwk_cfg.nwk_cfg.zed_cfg.keep_alive = 3000;
 
     ESP_LOGI(TAG, "Initializing Zigbee stack as ROUTER");
     esp_zb_init(&zb_nwk_cfg);
+#endif
 
     // Create endpoint list
     esp_zb_ep_list_t *ep_list = esp_zb_ep_list_create();
@@ -494,6 +628,10 @@ static void esp_zb_task(void *pvParameters)
     esp_zb_attribute_list_t *identify_cluster = esp_zb_identify_cluster_create(NULL);
     esp_zb_cluster_list_add_identify_cluster(cluster_list, identify_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
 
+    // Add groups cluster (server role) so the coordinator can fire all props with one groupcast
+    esp_zb_attribute_list_t *groups_cluster = esp_zb_groups_cluster_create(NULL);
+    esp_zb_cluster_list_add_groups_cluster(cluster_list, groups_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+
     // Add on/off cluster (server role - to be controlled by coordinator)
     esp_zb_on_off_cluster_cfg_t on_off_cfg = {
         .on_off = ESP_ZB_ZCL_ON_OFF_ON_OFF_DEFAULT_VALUE,
@@ -510,12 +648,24 @@ static void esp_zb_task(void *pvParameters)
     uint32_t time_value = 0;
     esp_zb_custom_cluster_add_custom_attr(time_sync_cluster, ZB_TIME_SYNC_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U32,
                                           ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &time_value);
+    uint64_t time_us_value = 0;
+    esp_zb_custom_cluster_add_custom_attr(time_sync_cluster, ZB_TIME_SYNC_US_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U64,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &time_us_value);
+    int16_t drift_value = time_drift_ppm();  // Retained across deep sleep
+    esp_zb_custom_cluster_add_custom_attr(time_sync_cluster, ZB_TIME_SYNC_DRIFT_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &drift_value);
+    uint32_t actuation_value = ACTUATION_UNKNOWN;
+    esp_zb_custom_cluster_add_custom_attr(time_sync_cluster, ZB_ACTUATION_US_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U32,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &actuation_value);
     esp_zb_cluster_list_add_custom_cluster(cluster_list, time_sync_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
 
     // Add trigger request cluster (0xFC01) - CLIENT role to send trigger requests to coordinator
     esp_zb_attribute_list_t *trigger_request_cluster = esp_zb_zcl_attr_list_create(ZB_TRIGGER_REQUEST_CLUSTER_ID);
     esp_zb_cluster_list_add_custom_cluster(cluster_list, trigger_request_cluster, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
 
+    // Add OTA Upgrade cluster - CLIENT role, downloads new firmware from the coordinator
+    ota_client_add_cluster(cluster_list);
+
     // Create endpoint
     esp_zb_endpoint_config_t endpoint_config = {
         .endpoint = 1,
@@ -541,6 +691,8 @@ static void esp_zb_task(void *pvParameters)
     ESP_LOGI(TAG, "========================================");
 
     ESP_LOGI(TAG, "Starting Zigbee stack");
+    net_cache_load();
+    net_cache_apply();
     ESP_ERROR_CHECK(esp_zb_start(false));
 
     // Set Zigbee TX power to maximum (20 dBm) for better range
@@ -553,8 +705,9 @@ static void esp_zb_task(void *pvParameters)
 void enter_deep_sleep(void)
 {
     ESP_LOGI(TAG, "Entering deep sleep until 6am...");
+    applog_flush();
 
-    if (!time_synced) {
+    if (!time_is_synced()) {
         ESP_LOGE(TAG, "Time not synced, cannot calculate sleep duration. Sleeping for 6 hours.");
         esp_sleep_enable_timer_wakeup(6 * 60 * 60 * 1000000ULL);
         gpio_set_level(LED_PIN, 0);
@@ -563,9 +716,10 @@ void enter_deep_sleep(void)
     }
 
     // Calculate sleep duration (until 6am)
-    time_t now = time(NULL);
+    struct timeval now;
+    gettimeofday(&now, NULL);
     struct tm timeinfo;
-    localtime_r(&now, &timeinfo);
+    localtime_r(&now.tv_sec, &timeinfo);
 
     int hours_until_wakeup = SLEEP_END_HOUR - timeinfo.tm_hour;
     if (hours_until_wakeup <= 0) {
@@ -577,9 +731,10 @@ void enter_deep_sleep(void)
     ESP_LOGI(TAG, "Current time: %02d:%02d:%02d", timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
     ESP_LOGI(TAG, "Sleeping for %d seconds (~%d hours)", total_seconds, hours_until_wakeup);
 
-    esp_sleep_enable_timer_wakeup(total_seconds * 1000000ULL);
+    esp_sleep_enable_timer_wakeup(total_seconds * 1000000ULL - now.tv_usec);
     gpio_set_level(LED_PIN, 0);
-    led_strip_clear(neopixel_strip);
+    anim_stop();
+    time_retain_for_sleep();
 
     esp_deep_sleep_start();
 }
@@ -594,6 +749,9 @@ void app_main(void)
     ESP_LOGI(TAG, "|  Active hours: 6am-12am, Sleep: 12am-6am    |");
     ESP_LOGI(TAG, "+----------------------------------------------+");
 
+    // Deferred log lines are formatted just above idle, off the Zigbee task
+    applog_init(1);
+
     // Initialize NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -602,11 +760,21 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
+#if ZED_SLEEPY
+    // Light sleep whenever every task is blocked; Zigbee polls and the PIR wake us
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = ZED_CPU_MAX_MHZ,
+        .min_freq_mhz = ZED_CPU_MIN_MHZ,
+        .light_sleep_enable = true,
+    };
+    ESP_ERROR_CHECK(esp_pm_configure(&pm_config));
+#endif
+
     // Initialize hardware
     setup_external_antenna();
     setup_pir();
     setup_led();
-    setup_neopixels();
+    anim_init(NEOPIXEL_PIN, NEOPIXEL_COUNT);
 
     // Initialize cooldown timer
     const esp_timer_create_args_t cooldown_timer_args = {
@@ -617,13 +785,22 @@ void app_main(void)
     ESP_LOGI(TAG, "Cooldown timer initialized");
 
     // Create status task
-    xTaskCreate(status_task, "status", 2048, NULL, 3, NULL);
+    TaskHandle_t status_task_handle = NULL;
+    xTaskCreate(status_task, "status", 2048, NULL, 3, &status_task_handle);
     ESP_LOGI(TAG, "Status task created");
 
-    // Create motion detection task
-    xTaskCreate(motion_detection_task, "motion", 4096, NULL, 5, &motion_task_handle);
+    // Create motion detection task and the scarecrow request worker it wakes
+    xTaskCreate(scarecrow_trigger_task, "scarecrow_trig", 3072, NULL, SCARECROW_TASK_PRIO, &scarecrow_task_handle);
+    xTaskCreate(motion_detection_task, "motion", 4096, NULL, MOTION_TASK_PRIO, &motion_task_handle);
     ESP_LOGI(TAG, "Motion detection task created");
 
+    metrics_watch_task(xTaskGetCurrentTaskHandle());
+    metrics_watch_task(status_task_handle);
+    metrics_watch_task(scarecrow_task_handle);
+    metrics_watch_task(motion_task_handle);
+
+    time_restore_after_sleep();
+
     // Check if it's sleep time
     if (is_sleep_time()) {
         enter_deep_sleep();
@@ -640,13 +817,21 @@ void app_main(void)
     }
 
     // Start Zigbee
-    xTaskCreate(esp_zb_task, "Zigbee_main", 4096, NULL, 5, NULL);
+    TaskHandle_t zb_task_handle = NULL;
+    xTaskCreate(esp_zb_task, "Zigbee_main", 4096, NULL, 5, &zb_task_handle);
+    metrics_watch_task(zb_task_handle);
 
     // Periodic sleep check task
     while (1) {
-        vTaskDelay(pdMS_TO_TICKS(60000));  // Check every minute
+        // Check every minute, or right at the sleep boundary if that's sooner
+        uint32_t delay_ms = 60000;
+        if (time_is_synced() && ms_until_sleep_start() < delay_ms) {
+            delay_ms = ms_until_sleep_start() + 1;
+        }
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
 
-        if (is_sleep_time()) {
+        // A download in flight finishes first; it reboots into the new image
+        if (is_sleep_time() && !ota_client_busy()) {
             enter_deep_sleep();
         }
     }
@@ -0,0 +1,27 @@
+#include "motion_counter.h"
+
+bool motion_counter_feed(motion_counter_t *m, int64_t edge_us)
+{
+    m->reset = MOTION_RESET_NONE;
+    if (m->state == MOTION_COUNTING && edge_us - m->last_us > MOTION_IDLE_RESET_US) {
+        m->reset = MOTION_RESET_IDLE;
+        m->state = MOTION_IDLE;
+    } else if (m->state == MOTION_COUNTING && edge_us - m->first_us > MOTION_WINDOW_US) {
+        m->reset = MOTION_RESET_WINDOW;
+        m->state = MOTION_IDLE;
+    }
+
+    if (m->state == MOTION_IDLE) {
+        m->state = MOTION_COUNTING;
+        m->count = 0;
+        m->first_us = edge_us;
+    }
+    m->count++;
+    m->last_us = edge_us;
+
+    if (m->count >= MOTION_SHOW_COUNT) {
+        m->state = MOTION_IDLE;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Motion count state machine. motion_detection_task feeds it the timestamp
+// of every accepted PIR rising edge; MOTION_SHOW_COUNT motions within
+// MOTION_WINDOW_US of the first earn the rainbow show, and a gap of
+// MOTION_IDLE_RESET_US starts the count over. No RTOS or driver calls, so
+// it also builds on the host (see host/).
+
+#define MOTION_SHOW_COUNT      3
+#define MOTION_WINDOW_US       (90 * 1000000LL)
+#define MOTION_IDLE_RESET_US   (30 * 1000000LL)
+
+typedef enum {
+    MOTION_IDLE,       // No motion counted
+    MOTION_COUNTING,   // 1..MOTION_SHOW_COUNT-1 motions inside the window
+} motion_state_t;
+
+// Why the last feed started a new count, for the caller to log
+typedef enum {
+    MOTION_RESET_NONE,
+    MOTION_RESET_IDLE,     // No motion for MOTION_IDLE_RESET_US
+    MOTION_RESET_WINDOW,   // First motion older than MOTION_WINDOW_US
+} motion_reset_t;
+
+typedef struct {
+    motion_state_t state;
+    int count;
+    int64_t first_us;
+    int64_t last_us;
+    motion_reset_t reset;  // Set by every feed
+} motion_counter_t;
+
+static inline void motion_counter_init(motion_counter_t *m)
+{
+    *m = (motion_counter_t){ .state = MOTION_IDLE };
+}
+
+// Count a motion at edge_us. True when it completes a MOTION_SHOW_COUNT
+// series (the count starts over); m->count is the motion's place in it.
+bool motion_counter_feed(motion_counter_t *m, int64_t edge_us);
@@ -0,0 +1,241 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_pm.h"
+#include "soc/soc_caps.h"
+#include "led_strip.h"
+#include "neopixel_anim.h"
+
+static const char *TAG = "neopixel_anim";
+
+#define ANIM_TASK_PRIO      6       // Above the Zigbee task, so frames stay on time
+#define ANIM_TASK_STACK     3072
+#define ANIM_EVT_REQUEST    (1 << 0)
+#define ANIM_EVT_FRAME      (1 << 1)
+#define ANIM_EARLY_US       500     // A frame event this early is a stale one from a preempted timer
+#define ANIM_STOP_WAIT_MS   100
+
+typedef struct {
+    uint8_t rgb[ANIM_MAX_LEDS][3];  // Arguments to led_strip_set_pixel
+    uint16_t hold_ms;
+} anim_frame_t;
+
+static led_strip_handle_t strip;
+static uint16_t led_count;
+static TaskHandle_t anim_task_handle = NULL;
+static esp_timer_handle_t frame_timer = NULL;
+static SemaphoreHandle_t stopped_sem = NULL;
+
+// Light sleep would stretch frame holds to the next wakeup, so hold it off
+// while an animation plays
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t pm_lock = NULL;
+#endif
+static bool awake_held;
+
+// Latest request; anim_play overwrites it, so only the newest is played
+static portMUX_TYPE request_lock = portMUX_INITIALIZER_UNLOCKED;
+static anim_id_t request_id;
+static anim_started_fn_t request_started;
+
+// Animation task only
+static anim_frame_t frames[ANIM_MAX_FRAMES];
+static size_t frame_count;
+static size_t frame_next = 1;  // Past frame_count when idle
+static int64_t frame_due_us;
+
+static void frame_fill(anim_frame_t *f, uint8_t a, uint8_t b, uint8_t c, uint16_t hold_ms)
+{
+    for (uint16_t i = 0; i < led_count; i++) {
+        f->rgb[i][0] = a;
+        f->rgb[i][1] = b;
+        f->rgb[i][2] = c;
+    }
+    f->hold_ms = hold_ms;
+}
+
+static size_t render_red_blink(void)
+{
+    size_t n = 0;
+    for (int blink = 0; blink < 20; blink++) {
+        frame_fill(&frames[n++], 255, 0, 0, 150);
+        frame_fill(&frames[n++], 0, 0, 0, 150);
+    }
+    return n;
+}
+
+static size_t render_rainbow(void)
+{
+    static const uint8_t palette[6][3] = {
+        {255, 0, 0}, {255, 127, 0}, {255, 255, 0}, {0, 255, 0}, {0, 0, 255}, {128, 0, 255},
+    };
+    size_t n = 0;
+    for (int blink = 0; blink < 50; blink++) {
+        anim_frame_t *f = &frames[n++];
+        for (uint16_t i = 0; i < led_count; i++) {
+            const uint8_t *c = palette[esp_random() % 6];
+            // Red and green go in swapped, as the show has always looked
+            f->rgb[i][0] = c[1];
+            f->rgb[i][1] = c[0];
+            f->rgb[i][2] = c[2];
+        }
+        f->hold_ms = 75;
+        frame_fill(&frames[n++], 0, 0, 0, 75);
+    }
+    return n;
+}
+
+static void show_frame(const anim_frame_t *f)
+{
+    for (uint16_t i = 0; i < led_count; i++) {
+        led_strip_set_pixel(strip, i, f->rgb[i][0], f->rgb[i][1], f->rgb[i][2]);
+    }
+    led_strip_refresh(strip);
+}
+
+static void hold_awake(bool hold)
+{
+    if (hold == awake_held) {
+        return;
+    }
+    awake_held = hold;
+#if CONFIG_PM_ENABLE
+    if (hold) {
+        esp_pm_lock_acquire(pm_lock);
+    } else {
+        esp_pm_lock_release(pm_lock);
+    }
+#endif
+}
+
+static void frame_timer_cb(void *arg)
+{
+    xTaskNotify(anim_task_handle, ANIM_EVT_FRAME, eSetBits);
+}
+
+// Schedule against the planned time rather than now, so holds don't drift
+static void arm_frame_timer(uint16_t hold_ms)
+{
+    frame_due_us += (int64_t)hold_ms * 1000;
+    int64_t wait = frame_due_us - esp_timer_get_time();
+    esp_timer_start_once(frame_timer, wait > 0 ? wait : 0);
+}
+
+static void anim_task(void *pvParameters)
+{
+    while (1) {
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+
+        if (events & ANIM_EVT_REQUEST) {
+            taskENTER_CRITICAL(&request_lock);
+            anim_id_t id = request_id;
+            anim_started_fn_t started = request_started;
+            taskEXIT_CRITICAL(&request_lock);
+
+            esp_timer_stop(frame_timer);  // Fails harmlessly when idle
+            switch (id) {
+                case ANIM_RED_BLINK: frame_count = render_red_blink(); break;
+                case ANIM_RAINBOW:   frame_count = render_rainbow(); break;
+                default:             frame_count = 0; break;
+            }
+
+            if (frame_count == 0) {
+                led_strip_clear(strip);
+                hold_awake(false);
+                xSemaphoreGive(stopped_sem);
+                continue;
+            }
+
+            hold_awake(true);
+            frame_due_us = esp_timer_get_time();
+            show_frame(&frames[0]);
+            int64_t lit_us = esp_timer_get_time();
+            frame_next = 1;
+            arm_frame_timer(frames[0].hold_ms);
+            if (started) {
+                started(lit_us);
+            }
+            continue;  // Any frame event that raced the request belonged to the old animation
+        }
+
+        if ((events & ANIM_EVT_FRAME) && frame_next <= frame_count) {
+            if (esp_timer_get_time() + ANIM_EARLY_US < frame_due_us) {
+                continue;
+            }
+            if (frame_next == frame_count) {
+                led_strip_clear(strip);
+                frame_next++;
+                hold_awake(false);
+                continue;
+            }
+            const anim_frame_t *f = &frames[frame_next++];
+            show_frame(f);
+            arm_frame_timer(f->hold_ms);
+        }
+    }
+}
+
+void anim_init(gpio_num_t gpio, uint16_t count)
+{
+    led_count = count <= ANIM_MAX_LEDS ? count : ANIM_MAX_LEDS;
+
+    led_strip_config_t strip_config = {
+        .strip_gpio_num = gpio,
+        .max_leds = led_count,
+        .led_pixel_format = LED_PIXEL_FORMAT_GRB,
+        .led_model = LED_MODEL_WS2812,
+        .flags.invert_out = false,
+    };
+
+    // The C6's RMT has no DMA. Without it the driver refills the channel
+    // memory from an interrupt, so give the channel both TX blocks: fewer
+    // refills and more slack against the radio's interrupts.
+    led_strip_rmt_config_t rmt_config = {
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = 10 * 1000 * 1000,
+#if SOC_RMT_SUPPORT_DMA
+        .flags.with_dma = true,
+#else
+        .mem_block_symbols = 2 * SOC_RMT_MEM_WORDS_PER_CHANNEL,
+#endif
+    };
+
+    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &strip));
+    led_strip_clear(strip);
+
+    stopped_sem = xSemaphoreCreateBinary();
+#if CONFIG_PM_ENABLE
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "neopixel_anim", &pm_lock));
+#endif
+    const esp_timer_create_args_t timer_args = {
+        .callback = frame_timer_cb,
+        .name = "anim_frame",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &frame_timer));
+    xTaskCreate(anim_task, "neopixel_anim", ANIM_TASK_STACK, NULL, ANIM_TASK_PRIO, &anim_task_handle);
+
+    ESP_LOGI(TAG, "NeoPixel strip initialized on GPIO%d (%u LEDs)", gpio, led_count);
+}
+
+void anim_play(anim_id_t id, anim_started_fn_t started)
+{
+    taskENTER_CRITICAL(&request_lock);
+    request_id = id;
+    request_started = started;
+    taskEXIT_CRITICAL(&request_lock);
+    xTaskNotify(anim_task_handle, ANIM_EVT_REQUEST, eSetBits);
+}
+
+void anim_stop(void)
+{
+    xSemaphoreTake(stopped_sem, 0);  // Drop a stale give from an earlier stop
+    anim_play(ANIM_OFF, NULL);
+    if (xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(ANIM_STOP_WAIT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Animation task didn't stop in time");
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include "driver/gpio.h"
+
+// NeoPixel animation engine. Animations run on their own task: each one is
+// rendered into a frame buffer up front, then an esp_timer paces the frames
+// out over RMT. anim_play() only posts the request and returns, so it is safe
+// from the Zigbee callback and never holds up the motion loop. A new request
+// preempts whatever is playing.
+
+#define ANIM_MAX_LEDS   16
+#define ANIM_MAX_FRAMES 100
+
+typedef enum {
+    ANIM_OFF,        // Stop and clear the strip
+    ANIM_RED_BLINK,  // 20 red flashes, 150 ms on / 150 ms off (~6 s)
+    ANIM_RAINBOW,    // 50 random rainbow frames, 75 ms on / 75 ms off (~7.5 s)
+} anim_id_t;
+
+// Called on the animation task once the first frame is on the strip.
+// lit_us is the esp_timer time of that refresh.
+typedef void (*anim_started_fn_t)(int64_t lit_us);
+
+// Create the RMT strip and start the animation task
+void anim_init(gpio_num_t gpio, uint16_t led_count);
+
+// Play id (replacing anything in progress); started may be NULL
+void anim_play(anim_id_t id, anim_started_fn_t started);
+
+// Stop and wait (briefly) until the strip is dark, e.g. before deep sleep
+void anim_stop(void);